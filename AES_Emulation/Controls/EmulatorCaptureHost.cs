@@ -723,6 +723,8 @@ public class EmulatorCaptureHost : ContentControl
                 linuxBackend.Saturation = Saturation;
                 linuxBackend.ColorTint = ColorTint;
                 linuxBackend.DisableVSync = DisableVSync;
+                // Same mapping as the DirectComposition path: VSync off requests VRR presents.
+                linuxBackend.EnableVrr = DisableVSync;
                 linuxBackend.ShaderPath = ShaderPath;
                 linuxBackend.ClearShaderWhenPathEmpty = ClearShaderWhenPathEmpty;
                 linuxBackend.ForceUseTargetClientArea = ForceUseTargetClientArea;
@@ -731,6 +733,7 @@ public class EmulatorCaptureHost : ContentControl
                 linuxBackend.ClientAreaCropTopInset = ClientAreaCropTopInset;
                 linuxBackend.ClientAreaCropRightInset = ClientAreaCropRightInset;
                 linuxBackend.ClientAreaCropBottomInset = ClientAreaCropBottomInset;
+                linuxBackend.EnablePillarboxCrop = EnablePillarboxCrop;
                 break;
         }
     }
@@ -1,9 +1,124 @@
 using System;
+using System.Collections.Generic;
 using System.Runtime.InteropServices;
 using System.Text;
+using System.Threading;
 
 namespace AES_Emulation.Linux.API;
 
+internal enum LinuxCaptureSourceTiming
+{
+    None = 0,
+    Damage = 1,
+    Present = 2
+}
+
+[StructLayout(LayoutKind.Sequential)]
+internal struct LinuxCaptureStats
+{
+    public int StructSize;
+    public LinuxCaptureSourceTiming SourceTiming;
+    public double SourceFps;
+    public double SourceFrameTimeMs;
+    public double PresentFps;
+    public double PresentFrameTimeMs;
+    public double CaptureLatencyMs;
+    public ulong SourceFrames;
+    public ulong PresentedFrames;
+    public ulong LastSourceMsc;
+    public double DisplayRefreshHz;
+    public int VrrRequested;
+    public int SwapInterval;
+    public ulong CroppedDamageSkips;
+    public ulong PartialRedraws;
+    public int CopySourceActive;
+    public int CopyRingSize;
+    public ulong CopiedFrames;
+    public ulong CopyFenceWaits;
+    public int AutoCropLeft;
+    public int AutoCropTop;
+    public int AutoCropRight;
+    public int AutoCropBottom;
+    public ulong ContentBarScans;
+    public ulong PreviewFrames;
+    public int PreviewWidth;
+    public int PreviewHeight;
+    public int Headless;
+    public ulong OutputFrames;
+    public ulong ScreenshotsWritten;
+    public ulong ScreenshotsFailed;
+    public ulong UniqueFrames;
+    public ulong DuplicateFrames;
+    public ulong DuplicateSkips;
+    public double UniqueFps;
+    public int SourceViews;
+    public ulong RoundTrips;
+    public double RoundTripsPerFrame;
+    public int SearchRoundTrips;
+    public int CompositorBypassActive;
+    public ulong CompositorBypassTransitions;
+    public int HostOccluded;
+    public ulong OccludedSkips;
+    public double InitMs;
+    public double FirstFrameMs;
+    public ulong Reacquisitions;
+    public double LastReacquireMs;
+    public int SurfaceProbeActive;
+    public ulong SurfaceSwitches;
+    public ulong InputEvents;
+    public ulong InputOutside;
+    public double InputLatencyMs;
+    public double InputLatencyMaxMs;
+    public LinuxInputPath InputPath;
+    public LinuxRenderThreadMode RenderThreadMode;
+    public ulong RenderThreadCpus;
+    public double WakeLateMs;
+    public double WakeLateMaxMs;
+}
+
+public enum LinuxRenderThreadMode
+{
+    Normal = 0,
+    Raised = 1,
+    Realtime = 2
+}
+
+public enum LinuxDuplicateDetection
+{
+    Off = 0,
+    Stats = 1,
+    Skip = 2
+}
+
+public enum LinuxInputPath
+{
+    None = 0,
+    XTest = 1,
+    CoreEvents = 2
+}
+
+public enum LinuxPointerEventKind
+{
+    Move = 0,
+    Press = 1,
+    Release = 2,
+    Leave = 3
+}
+
+public enum LinuxScreenshotFormat
+{
+    Png = 0,
+    Qoi = 1
+}
+
+public enum LinuxScreenshotStatus
+{
+    Unknown = -2,
+    Failed = -1,
+    Pending = 0,
+    Done = 1
+}
+
 internal static class LinuxCaptureBridge
 {
     private const string LibraryName = "libAesLinuxCaptureBridge";
@@ -11,6 +126,9 @@ internal static class LinuxCaptureBridge
     [DllImport(LibraryName)]
     public static extern IntPtr aes_linux_capture_create(IntPtr parentWindowHandle);
 
+    [DllImport(LibraryName)]
+    public static extern IntPtr aes_linux_capture_create_headless(int outputWidth, int outputHeight);
+
     [DllImport(LibraryName)]
     public static extern void aes_linux_capture_destroy(IntPtr capture);
 
@@ -26,6 +144,9 @@ internal static class LinuxCaptureBridge
     [DllImport(LibraryName)]
     public static extern void aes_linux_capture_forward_focus(IntPtr capture);
 
+    [DllImport(LibraryName)]
+    public static extern int aes_linux_capture_forward_pointer(IntPtr capture, int kind, int x, int y, int button, uint eventTimeMs);
+
     [DllImport(LibraryName)]
     public static extern void aes_linux_capture_set_stretch(IntPtr capture, int stretch);
 
@@ -51,6 +172,58 @@ internal static class LinuxCaptureBridge
     [DllImport(LibraryName)]
     public static extern void aes_linux_capture_set_disable_vsync(IntPtr capture, int disableVsync);
 
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_vrr_enabled(IntPtr capture, int enabled);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_compositor_bypass(IntPtr capture, int enabled);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_auto_reacquire(IntPtr capture, int enabled);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_render_thread(IntPtr capture, int mode, string? cpus);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_copy_source(IntPtr capture, int enabled);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_duplicate_detection(IntPtr capture, int mode);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_auto_crop_enabled(IntPtr capture, int enabled);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_auto_crop_threshold(IntPtr capture, int lumaThreshold);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_enable_preview(IntPtr capture, int maxWidth, double fps);
+
+    [DllImport(LibraryName)]
+    private static extern int aes_linux_capture_copy_preview(IntPtr capture, byte[]? buffer, int bufferSize, out int width, out int height, ref ulong sequence);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_output_size(IntPtr capture, int width, int height);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_output_readback(IntPtr capture, int enabled);
+
+    [DllImport(LibraryName)]
+    private static extern int aes_linux_capture_copy_output(IntPtr capture, byte[]? buffer, int bufferSize, out int width, out int height, ref ulong sequence);
+
+    [DllImport(LibraryName)]
+    public static extern int aes_linux_capture_screenshot(IntPtr capture, string path, int format, int postShader);
+
+    [DllImport(LibraryName)]
+    public static extern int aes_linux_capture_get_screenshot_status(IntPtr capture, int id);
+
+    // Invoked on the native encoder thread.
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate void ScreenshotCallback(int id, int status, IntPtr userData);
+
+    [DllImport(LibraryName)]
+    public static extern void aes_linux_capture_set_screenshot_callback(IntPtr capture, ScreenshotCallback? callback, IntPtr userData);
+
     [DllImport(LibraryName)]
     public static extern void aes_linux_capture_set_shader_path(IntPtr capture, string? shaderPath);
 
@@ -63,6 +236,54 @@ internal static class LinuxCaptureBridge
     [DllImport(LibraryName)]
     public static extern IntPtr aes_linux_capture_find_window_by_pid(int pid, string? titleHint);
 
+    [DllImport(LibraryName)]
+    public static extern IntPtr aes_linux_capture_find_window_by_class(string wmClass);
+
+    // Invoked on the native scheduler thread.
+    [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+    public delegate void WindowWatchCallback(int watchId, IntPtr window, int pid, IntPtr userData);
+
+    [DllImport(LibraryName)]
+    private static extern int aes_linux_capture_watch_window(int pid, string? titleHint, WindowWatchCallback callback, IntPtr userData);
+
+    [DllImport(LibraryName)]
+    private static extern void aes_linux_capture_unwatch_window(int watchId);
+
+    // Delegates handed to native watches, kept alive until unwatched.
+    private static readonly Dictionary<int, WindowWatchCallback> WindowWatchCallbacks = new();
+
+    // Reports each window of pid (any when 0) whose title contains titleHint
+    // as it appears, including ones that already exist. Dispose to stop.
+    public static IDisposable? WatchWindow(int pid, string? titleHint, Action<IntPtr> onWindow)
+    {
+        WindowWatchCallback callback = (_, window, _, _) => onWindow(window);
+        lock (WindowWatchCallbacks)
+        {
+            var id = aes_linux_capture_watch_window(pid, titleHint, callback, IntPtr.Zero);
+            if (id == 0)
+                return null;
+
+            WindowWatchCallbacks[id] = callback;
+            return new WindowWatch(id);
+        }
+    }
+
+    private sealed class WindowWatch(int id) : IDisposable
+    {
+        private int _id = id;
+
+        public void Dispose()
+        {
+            var watchId = Interlocked.Exchange(ref _id, 0);
+            if (watchId == 0)
+                return;
+
+            aes_linux_capture_unwatch_window(watchId);
+            lock (WindowWatchCallbacks)
+                WindowWatchCallbacks.Remove(watchId);
+        }
+    }
+
     [DllImport(LibraryName)]
     public static extern int aes_linux_capture_is_active(IntPtr capture);
 
@@ -84,6 +305,38 @@ internal static class LinuxCaptureBridge
     [DllImport(LibraryName)]
     private static extern int aes_linux_capture_get_gpu_vendor(IntPtr capture, StringBuilder buffer, int bufferChars);
 
+    [DllImport(LibraryName)]
+    private static extern int aes_linux_capture_get_stats(IntPtr capture, ref LinuxCaptureStats stats);
+
+    public static bool TryGetStats(IntPtr capture, out LinuxCaptureStats stats)
+    {
+        stats = new LinuxCaptureStats { StructSize = Marshal.SizeOf<LinuxCaptureStats>() };
+        return capture != IntPtr.Zero && aes_linux_capture_get_stats(capture, ref stats) != 0;
+    }
+
+    // Copy the newest preview/output frame (top-down BGRA) when it is newer
+    // than sequence, growing buffer to fit.
+    public static bool TryCopyPreview(IntPtr capture, ref byte[]? buffer, ref ulong sequence, out int width, out int height) =>
+        TryCopyFrame(capture, aes_linux_capture_copy_preview, ref buffer, ref sequence, out width, out height);
+
+    public static bool TryCopyOutput(IntPtr capture, ref byte[]? buffer, ref ulong sequence, out int width, out int height) =>
+        TryCopyFrame(capture, aes_linux_capture_copy_output, ref buffer, ref sequence, out width, out height);
+
+    private delegate int CopyFrameFunc(IntPtr capture, byte[]? buffer, int bufferSize, out int width, out int height, ref ulong sequence);
+
+    private static bool TryCopyFrame(IntPtr capture, CopyFrameFunc copy, ref byte[]? buffer, ref ulong sequence, out int width, out int height)
+    {
+        if (copy(capture, buffer, buffer?.Length ?? 0, out width, out height, ref sequence) != 0)
+            return true;
+
+        var required = width * height * 4;
+        if (required <= 0 || (buffer != null && buffer.Length >= required))
+            return false;
+
+        buffer = new byte[required];
+        return copy(capture, buffer, buffer.Length, out width, out height, ref sequence) != 0;
+    }
+
     public static string GetStatusText(IntPtr capture) => GetString(capture, aes_linux_capture_get_status_text, string.Empty);
 
     public static string GetGpuRenderer(IntPtr capture) => GetString(capture, aes_linux_capture_get_gpu_renderer, string.Empty);
@@ -1,6 +1,7 @@
 using System;
 using Avalonia;
 using Avalonia.Controls;
+using Avalonia.Input;
 using Avalonia.Media;
 using Avalonia.Platform;
 using Avalonia.Threading;
@@ -34,6 +35,42 @@ public class LinuxCaptureHost : NativeControlHost
     public static readonly StyledProperty<bool> DisableVSyncProperty =
         AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(DisableVSync), false);
 
+    public static readonly StyledProperty<bool> EnableVrrProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(EnableVrr), false);
+
+    public static readonly StyledProperty<bool> CopySourceFramesProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(CopySourceFrames), false);
+
+    public static readonly StyledProperty<bool> SkipDuplicateFramesProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(SkipDuplicateFrames), false);
+
+    public static readonly StyledProperty<bool> BypassCompositorProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(BypassCompositor), true);
+
+    public static readonly StyledProperty<bool> ForwardPointerInputProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(ForwardPointerInput), false);
+
+    public static readonly StyledProperty<bool> AutoReacquireTargetProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(AutoReacquireTarget), true);
+
+    public static readonly StyledProperty<LinuxRenderThreadMode> RenderThreadModeProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, LinuxRenderThreadMode>(nameof(RenderThreadMode), LinuxRenderThreadMode.Normal);
+
+    public static readonly StyledProperty<string?> RenderThreadCpusProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, string?>(nameof(RenderThreadCpus), null);
+
+    public static readonly StyledProperty<bool> EnablePillarboxCropProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, bool>(nameof(EnablePillarboxCrop), false);
+
+    public static readonly StyledProperty<int> PillarboxCropThresholdProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, int>(nameof(PillarboxCropThreshold), 16);
+
+    public static readonly StyledProperty<int> PreviewMaxWidthProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, int>(nameof(PreviewMaxWidth), 0);
+
+    public static readonly StyledProperty<double> PreviewFpsProperty =
+        AvaloniaProperty.Register<LinuxCaptureHost, double>(nameof(PreviewFps), 0);
+
     public static readonly StyledProperty<string?> ShaderPathProperty =
         AvaloniaProperty.Register<LinuxCaptureHost, string?>(nameof(ShaderPath), null);
 
@@ -98,6 +135,7 @@ public class LinuxCaptureHost : NativeControlHost
 
     private readonly DispatcherTimer _statusTimer;
     private IntPtr _capture;
+    private LinuxCaptureScreenshots? _screenshots;
     private bool _isAttached;
     private bool _hasAppliedRenderOptions;
     private double _lastBrightness = -1;
@@ -111,6 +149,18 @@ public class LinuxCaptureHost : NativeControlHost
     private bool _lastHideTargetWindowAfterCaptureStarts = false;
     private string? _lastShaderPath = null;
     private bool? _lastDisableVSync = null;
+    private bool? _lastEnableVrr = null;
+    private bool? _lastCopySourceFrames = null;
+    private bool? _lastSkipDuplicateFrames = null;
+    private bool? _lastBypassCompositor = null;
+    private bool? _lastAutoReacquireTarget = null;
+    private LinuxRenderThreadMode? _lastRenderThreadMode = null;
+    private string? _lastRenderThreadCpus = null;
+    private bool? _lastEnablePillarboxCrop = null;
+    private int? _lastPillarboxCropThreshold = null;
+    private int? _lastPreviewMaxWidth = null;
+    private double? _lastPreviewFps = null;
+    private ulong _previewSequence;
     private bool? _lastPreferPipeWire = null;
     private int _renderOptionsUpdateCount = 0;
 
@@ -175,6 +225,80 @@ public class LinuxCaptureHost : NativeControlHost
         set => SetValue(DisableVSyncProperty, value);
     }
 
+    // Marks the host for variable refresh. Adaptive VSync is used with it
+    // where available, but DisableVSync still turns VSync off.
+    public bool EnableVrr
+    {
+        get => GetValue(EnableVrrProperty);
+        set => SetValue(EnableVrrProperty, value);
+    }
+
+    public bool CopySourceFrames
+    {
+        get => GetValue(CopySourceFramesProperty);
+        set => SetValue(CopySourceFramesProperty, value);
+    }
+
+    public bool SkipDuplicateFrames
+    {
+        get => GetValue(SkipDuplicateFramesProperty);
+        set => SetValue(SkipDuplicateFramesProperty, value);
+    }
+
+    public bool BypassCompositor
+    {
+        get => GetValue(BypassCompositorProperty);
+        set => SetValue(BypassCompositorProperty, value);
+    }
+
+    public bool ForwardPointerInput
+    {
+        get => GetValue(ForwardPointerInputProperty);
+        set => SetValue(ForwardPointerInputProperty, value);
+    }
+
+    public bool AutoReacquireTarget
+    {
+        get => GetValue(AutoReacquireTargetProperty);
+        set => SetValue(AutoReacquireTargetProperty, value);
+    }
+
+    public LinuxRenderThreadMode RenderThreadMode
+    {
+        get => GetValue(RenderThreadModeProperty);
+        set => SetValue(RenderThreadModeProperty, value);
+    }
+
+    public string? RenderThreadCpus
+    {
+        get => GetValue(RenderThreadCpusProperty);
+        set => SetValue(RenderThreadCpusProperty, value);
+    }
+
+    public bool EnablePillarboxCrop
+    {
+        get => GetValue(EnablePillarboxCropProperty);
+        set => SetValue(EnablePillarboxCropProperty, value);
+    }
+
+    public int PillarboxCropThreshold
+    {
+        get => GetValue(PillarboxCropThresholdProperty);
+        set => SetValue(PillarboxCropThresholdProperty, value);
+    }
+
+    public int PreviewMaxWidth
+    {
+        get => GetValue(PreviewMaxWidthProperty);
+        set => SetValue(PreviewMaxWidthProperty, value);
+    }
+
+    public double PreviewFps
+    {
+        get => GetValue(PreviewFpsProperty);
+        set => SetValue(PreviewFpsProperty, value);
+    }
+
     public string? ShaderPath
     {
         get => GetValue(ShaderPathProperty);
@@ -277,6 +401,81 @@ public class LinuxCaptureHost : NativeControlHost
             LinuxCaptureBridge.aes_linux_capture_forward_focus(_capture);
     }
 
+    // Pointer input over the view goes to the captured window, mapped through
+    // the crop and stretch of the frame on screen.
+    protected override void OnPointerMoved(PointerEventArgs e)
+    {
+        base.OnPointerMoved(e);
+        ForwardPointer(LinuxPointerEventKind.Move, e, 0);
+    }
+
+    protected override void OnPointerPressed(PointerPressedEventArgs e)
+    {
+        base.OnPointerPressed(e);
+        ForwardPointer(LinuxPointerEventKind.Press, e, ToX11Button(e.GetCurrentPoint(this).Properties.PointerUpdateKind));
+    }
+
+    protected override void OnPointerReleased(PointerReleasedEventArgs e)
+    {
+        base.OnPointerReleased(e);
+        ForwardPointer(LinuxPointerEventKind.Release, e, ToX11Button(e.GetCurrentPoint(this).Properties.PointerUpdateKind));
+    }
+
+    protected override void OnPointerWheelChanged(PointerWheelEventArgs e)
+    {
+        base.OnPointerWheelChanged(e);
+        if (e.Delta.Y == 0)
+            return;
+
+        // X reports each wheel step as a click of button 4 (up) or 5 (down).
+        var button = e.Delta.Y > 0 ? 4 : 5;
+        ForwardPointer(LinuxPointerEventKind.Press, e, button);
+        ForwardPointer(LinuxPointerEventKind.Release, e, button);
+    }
+
+    protected override void OnPointerExited(PointerEventArgs e)
+    {
+        base.OnPointerExited(e);
+        ForwardPointer(LinuxPointerEventKind.Leave, e, 0);
+    }
+
+    private void ForwardPointer(LinuxPointerEventKind kind, PointerEventArgs e, int button)
+    {
+        if (_capture == IntPtr.Zero || !ForwardPointerInput || (kind != LinuxPointerEventKind.Move && kind != LinuxPointerEventKind.Leave && button == 0))
+            return;
+
+        var scaling = TopLevel.GetTopLevel(this)?.RenderScaling ?? 1.0;
+        var position = e.GetPosition(this);
+        LinuxCaptureBridge.aes_linux_capture_forward_pointer(
+            _capture,
+            (int)kind,
+            (int)Math.Floor(position.X * scaling),
+            (int)Math.Floor(position.Y * scaling),
+            button,
+            (uint)e.Timestamp);
+    }
+
+    private static int ToX11Button(PointerUpdateKind kind) => kind switch
+    {
+        PointerUpdateKind.LeftButtonPressed or PointerUpdateKind.LeftButtonReleased => 1,
+        PointerUpdateKind.MiddleButtonPressed or PointerUpdateKind.MiddleButtonReleased => 2,
+        PointerUpdateKind.RightButtonPressed or PointerUpdateKind.RightButtonReleased => 3,
+        PointerUpdateKind.XButton1Pressed or PointerUpdateKind.XButton1Released => 8,
+        PointerUpdateKind.XButton2Pressed or PointerUpdateKind.XButton2Released => 9,
+        _ => 0
+    };
+
+    public bool TryCopyPreviewFrame(ref byte[]? buffer, out int width, out int height)
+    {
+        width = 0;
+        height = 0;
+        return _capture != IntPtr.Zero &&
+               LinuxCaptureBridge.TryCopyPreview(_capture, ref buffer, ref _previewSequence, out width, out height);
+    }
+
+    // Null until the native view exists.
+    public LinuxCaptureScreenshots? Screenshots => _screenshots;
+
     protected override void OnAttachedToVisualTree(VisualTreeAttachmentEventArgs e)
     {
         base.OnAttachedToVisualTree(e);
@@ -312,6 +511,17 @@ public class LinuxCaptureHost : NativeControlHost
                  change.Property == SaturationProperty ||
                  change.Property == ColorTintProperty ||
                  change.Property == DisableVSyncProperty ||
+                 change.Property == EnableVrrProperty ||
+                 change.Property == CopySourceFramesProperty ||
+                 change.Property == SkipDuplicateFramesProperty ||
+                 change.Property == BypassCompositorProperty ||
+                 change.Property == AutoReacquireTargetProperty ||
+                 change.Property == RenderThreadModeProperty ||
+                 change.Property == RenderThreadCpusProperty ||
+                 change.Property == EnablePillarboxCropProperty ||
+                 change.Property == PillarboxCropThresholdProperty ||
+                 change.Property == PreviewMaxWidthProperty ||
+                 change.Property == PreviewFpsProperty ||
                  change.Property == ShaderPathProperty ||
                  change.Property == ClearShaderWhenPathEmptyProperty ||
                  change.Property == PreferPipeWireProperty ||
@@ -357,6 +567,8 @@ public class LinuxCaptureHost : NativeControlHost
         }
 
         _hasAppliedRenderOptions = false;
+        _previewSequence = 0;
+        _screenshots = new LinuxCaptureScreenshots(_capture);
 
         var view = LinuxCaptureBridge.aes_linux_capture_get_view(_capture);
         if (view == IntPtr.Zero)
@@ -375,7 +587,11 @@ public class LinuxCaptureHost : NativeControlHost
 
         if (_capture != IntPtr.Zero)
         {
+            // A callback already running holds the delegate until destroy
+            // has joined the encoder.
+            _screenshots?.Dispose();
             LinuxCaptureBridge.aes_linux_capture_destroy(_capture);
+            _screenshots = null;
             _capture = IntPtr.Zero;
             _hasAppliedRenderOptions = false;
         }
@@ -486,6 +702,64 @@ public class LinuxCaptureHost : NativeControlHost
             _lastDisableVSync = DisableVSync;
         }
 
+        if (!_hasAppliedRenderOptions || _lastEnableVrr != EnableVrr)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_vrr_enabled(_capture, EnableVrr ? 1 : 0);
+            _lastEnableVrr = EnableVrr;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastCopySourceFrames != CopySourceFrames)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_copy_source(_capture, CopySourceFrames ? 1 : 0);
+            _lastCopySourceFrames = CopySourceFrames;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastSkipDuplicateFrames != SkipDuplicateFrames)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_duplicate_detection(
+                _capture,
+                (int)(SkipDuplicateFrames ? LinuxDuplicateDetection.Skip : LinuxDuplicateDetection.Stats));
+            _lastSkipDuplicateFrames = SkipDuplicateFrames;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastBypassCompositor != BypassCompositor)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_compositor_bypass(_capture, BypassCompositor ? 1 : 0);
+            _lastBypassCompositor = BypassCompositor;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastAutoReacquireTarget != AutoReacquireTarget)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_auto_reacquire(_capture, AutoReacquireTarget ? 1 : 0);
+            _lastAutoReacquireTarget = AutoReacquireTarget;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastRenderThreadMode != RenderThreadMode || _lastRenderThreadCpus != RenderThreadCpus)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_render_thread(_capture, (int)RenderThreadMode, RenderThreadCpus);
+            _lastRenderThreadMode = RenderThreadMode;
+            _lastRenderThreadCpus = RenderThreadCpus;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastEnablePillarboxCrop != EnablePillarboxCrop)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_auto_crop_enabled(_capture, EnablePillarboxCrop ? 1 : 0);
+            _lastEnablePillarboxCrop = EnablePillarboxCrop;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastPillarboxCropThreshold != PillarboxCropThreshold)
+        {
+            LinuxCaptureBridge.aes_linux_capture_set_auto_crop_threshold(_capture, PillarboxCropThreshold);
+            _lastPillarboxCropThreshold = PillarboxCropThreshold;
+        }
+
+        if (!_hasAppliedRenderOptions || _lastPreviewMaxWidth != PreviewMaxWidth || _lastPreviewFps != PreviewFps)
+        {
+            LinuxCaptureBridge.aes_linux_capture_enable_preview(_capture, PreviewMaxWidth, PreviewFps);
+            _lastPreviewMaxWidth = PreviewMaxWidth;
+            _lastPreviewFps = PreviewFps;
+        }
+
         if (!_hasAppliedRenderOptions || _lastPreferPipeWire != PreferPipeWire)
         {
             LinuxCaptureBridge.aes_linux_capture_set_use_pipewire(_capture, PreferPipeWire ? 1 : 0);
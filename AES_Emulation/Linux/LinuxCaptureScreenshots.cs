@@ -0,0 +1,46 @@
+using System;
+using AES_Emulation.Linux.API;
+
+namespace AES_Emulation.Linux;
+
+// Screenshots of one capture handle, shared by LinuxCaptureHost and
+// LinuxHeadlessCapture. Owners dispose it before destroying the handle.
+public sealed class LinuxCaptureScreenshots : IDisposable
+{
+    private IntPtr _capture;
+
+    // Handed to native code, so it lives as long as this object.
+    private readonly LinuxCaptureBridge.ScreenshotCallback _callback;
+
+    internal LinuxCaptureScreenshots(IntPtr capture)
+    {
+        _capture = capture;
+        _callback = (id, status, _) => Completed?.Invoke(id, (LinuxScreenshotStatus)status);
+        LinuxCaptureBridge.aes_linux_capture_set_screenshot_callback(_capture, _callback, IntPtr.Zero);
+    }
+
+    // Raised once per id, Done or Failed, on the native encoder thread.
+    public event Action<int, LinuxScreenshotStatus>? Completed;
+
+    // Queues a screenshot of the next frame; the file is encoded and written
+    // off the render thread. Returns 0 when rejected, otherwise an id for
+    // GetStatus and Completed.
+    public int Take(string path, LinuxScreenshotFormat format = LinuxScreenshotFormat.Png, bool postShader = true) =>
+        _capture != IntPtr.Zero && !string.IsNullOrEmpty(path)
+            ? LinuxCaptureBridge.aes_linux_capture_screenshot(_capture, path, (int)format, postShader ? 1 : 0)
+            : 0;
+
+    public LinuxScreenshotStatus GetStatus(int id) =>
+        _capture != IntPtr.Zero
+            ? (LinuxScreenshotStatus)LinuxCaptureBridge.aes_linux_capture_get_screenshot_status(_capture, id)
+            : LinuxScreenshotStatus.Unknown;
+
+    public void Dispose()
+    {
+        if (_capture == IntPtr.Zero)
+            return;
+
+        LinuxCaptureBridge.aes_linux_capture_set_screenshot_callback(_capture, null, IntPtr.Zero);
+        _capture = IntPtr.Zero;
+    }
+}
@@ -0,0 +1,107 @@
+using System;
+using AES_Emulation.Linux.API;
+
+namespace AES_Emulation.Linux;
+
+// Captures a target window without a host window, e.g. to record or stream a
+// game while the UI shows something else. Frames are only available through
+// TryCopyFrame and the preview stream.
+public sealed class LinuxHeadlessCapture : IDisposable
+{
+    private IntPtr _capture;
+    private ulong _outputSequence;
+    private ulong _previewSequence;
+
+    private LinuxHeadlessCapture(IntPtr capture)
+    {
+        _capture = capture;
+        Screenshots = new LinuxCaptureScreenshots(capture);
+    }
+
+    public static LinuxHeadlessCapture? TryCreate(int outputWidth = 0, int outputHeight = 0)
+    {
+        if (!OperatingSystem.IsLinux())
+            return null;
+
+        try
+        {
+            var capture = LinuxCaptureBridge.aes_linux_capture_create_headless(outputWidth, outputHeight);
+            return capture == IntPtr.Zero ? null : new LinuxHeadlessCapture(capture);
+        }
+        catch (DllNotFoundException)
+        {
+            return null;
+        }
+        catch (EntryPointNotFoundException)
+        {
+            return null;
+        }
+    }
+
+    public LinuxCaptureScreenshots Screenshots { get; }
+
+    public bool IsActive => _capture != IntPtr.Zero && LinuxCaptureBridge.IsCaptureActive(_capture);
+
+    public string StatusText => _capture != IntPtr.Zero ? LinuxCaptureBridge.GetStatusText(_capture) : string.Empty;
+
+    public void Start(int processId, string? windowTitleHint)
+    {
+        if (_capture == IntPtr.Zero)
+            return;
+
+        LinuxCaptureBridge.aes_linux_capture_set_target(_capture, processId, windowTitleHint);
+        LinuxCaptureBridge.aes_linux_capture_set_output_readback(_capture, 1);
+    }
+
+    public void Stop()
+    {
+        if (_capture != IntPtr.Zero)
+            LinuxCaptureBridge.aes_linux_capture_stop(_capture);
+    }
+
+    public void SetOutputSize(int width, int height)
+    {
+        if (_capture != IntPtr.Zero)
+            LinuxCaptureBridge.aes_linux_capture_set_output_size(_capture, width, height);
+    }
+
+    public void SetShaderPath(string? shaderPath)
+    {
+        if (_capture != IntPtr.Zero)
+            LinuxCaptureBridge.aes_linux_capture_set_shader_path(_capture, shaderPath ?? string.Empty);
+    }
+
+    public void EnablePreview(int maxWidth, double fps)
+    {
+        if (_capture != IntPtr.Zero)
+            LinuxCaptureBridge.aes_linux_capture_enable_preview(_capture, maxWidth, fps);
+    }
+
+    public bool TryCopyFrame(ref byte[]? buffer, out int width, out int height)
+    {
+        width = 0;
+        height = 0;
+        return _capture != IntPtr.Zero &&
+               LinuxCaptureBridge.TryCopyOutput(_capture, ref buffer, ref _outputSequence, out width, out height);
+    }
+
+    public bool TryCopyPreviewFrame(ref byte[]? buffer, out int width, out int height)
+    {
+        width = 0;
+        height = 0;
+        return _capture != IntPtr.Zero &&
+               LinuxCaptureBridge.TryCopyPreview(_capture, ref buffer, ref _previewSequence, out width, out height);
+    }
+
+    internal bool TryGetStats(out LinuxCaptureStats stats) => LinuxCaptureBridge.TryGetStats(_capture, out stats);
+
+    public void Dispose()
+    {
+        if (_capture == IntPtr.Zero)
+            return;
+
+        Screenshots.Dispose();
+        LinuxCaptureBridge.aes_linux_capture_destroy(_capture);
+        _capture = IntPtr.Zero;
+    }
+}
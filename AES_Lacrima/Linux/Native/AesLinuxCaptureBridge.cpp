@@ -2,29 +2,53 @@
 #define GLX_GLXEXT_PROTOTYPES
 
 #include <X11/Xlib.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/Xcomposite.h>
 #include <X11/extensions/Xdamage.h>
 #include <X11/extensions/Xfixes.h>
+#include <X11/extensions/Xrandr.h>
 #include <X11/extensions/shape.h>
+#include <X11/extensions/XTest.h>
+
+#include <xcb/xcb.h>
+#include <xcb/present.h>
 
 #include <GL/gl.h>
 #include <GL/glext.h>
 #include <GL/glx.h>
 #include <GL/glxext.h>
 
+#include <dirent.h>
+#include <errno.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <cmath>
 
 #include <algorithm>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ContentBarDetector.h"
+#include "CpuSelection.h"
+#include "FrameFingerprint.h"
+#include "FrameLayout.h"
+#include "FrameTiming.h"
+#include "ImageEncoders.h"
+#include "NativeLog.h"
+#include "SurfaceProbe.h"
 
 #ifndef GLX_TEXTURE_FORMAT_EXT
 #define GLX_TEXTURE_FORMAT_EXT 0x20D5
@@ -53,6 +77,36 @@
 #ifndef GLX_TEXTURE_2D_BIT_EXT
 #define GLX_TEXTURE_2D_BIT_EXT 0x00000002
 #endif
+#ifndef GLX_BACK_BUFFER_AGE_EXT
+#define GLX_BACK_BUFFER_AGE_EXT 0x20F4
+#endif
+
+// XTest drives the real pointer and reaches every client, XI2 ones
+// included, but only where the target is topmost on screen. Synthetic core
+// events work on a covered or hidden target too, but only for clients that
+// selected core pointer events; Qt selects XI2 instead.
+enum LinuxInputPath
+{
+    InputPathNone = 0,
+    InputPathXTest = 1,
+    InputPathCoreEvents = 2
+};
+
+// The fingerprint is a lossy reduction (see FrameFingerprint.h), so by
+// default it only counts unique frames; dropping matched swaps is opt-in.
+enum LinuxDuplicateDetection
+{
+    DuplicateDetectionOff = 0,
+    DuplicateDetectionStats = 1,
+    DuplicateDetectionSkip = 2
+};
+
+enum LinuxRenderThreadMode
+{
+    RenderThreadNormal = 0,
+    RenderThreadRaised = 1,
+    RenderThreadRealtime = 2
+};
 
 enum LinuxCaptureBackendMode
 {
@@ -61,18 +115,369 @@ enum LinuxCaptureBackendMode
     BackendReparentFallback = 2
 };
 
+enum LinuxCaptureSourceTiming
+{
+    SourceTimingNone = 0,
+    SourceTimingDamage = 1,
+    SourceTimingPresent = 2
+};
+
+// Pointer event kinds for aes_linux_capture_forward_pointer.
+enum LinuxPointerEventKind
+{
+    PointerMove = 0,
+    PointerPress = 1,
+    PointerRelease = 2,
+    PointerLeave = 3
+};
+
+static constexpr int kPresentIntervalHistory = 16;
+static constexpr double kDefaultDisplayRefreshHz = 60.0;
+static constexpr int kSwapIntervalUnset = -2;
+static constexpr int kRedrawHistory = 4;
+// Linear filtering reads one texel past a dirty edge; pad scissor rects so the
+// redrawn area fully covers every output pixel a changed texel contributes to.
+static constexpr int kRedrawPadPx = 2;
+static constexpr int kCopyRingSize = 3;
+static constexpr int kContentBarDetectWidth = 320;
+static constexpr int kContentBarScanInterval = 15;
+static constexpr int kContentBarWarmupFrames = 30;
+static constexpr double kPreviewMaxFps = 30.0;
+// Duplicate-frame fingerprint size.
+static constexpr int kFingerprintWidth = 128;
+static constexpr int kFingerprintHeight = 72;
+// Captures share one display connection and scheduler thread; see
+// LinuxCaptureManager.
+static constexpr int kMaxCaptureSessions = 16;
+// A session handing off to a replacement target holds two sources for a
+// moment.
+static constexpr int kMaxCaptureSources = kMaxCaptureSessions + 1;
+// How often a session whose target went away looks for its replacement.
+static constexpr uint64_t kReacquirePollNs = 16000000;
+// How long an unmapped (not destroyed) target may stay hidden before a
+// replacement is searched for: front-ends hide their render widget while
+// showing the game list and map the same window again later.
+static constexpr uint64_t kUnmapGraceNs = 1000000000ULL;
+// Windows watched by a surface probe, how long it watches at least, and when
+// it gives up if nothing produced frames.
+static constexpr int kMaxProbeSurfaces = 8;
+static constexpr uint64_t kSurfaceProbeNs = 500000000;
+static constexpr uint64_t kSurfaceProbeMaxNs = 5000000000ULL;
+static constexpr int kMaxSchedulerEvents = 512;
+// Render thread tuning: the nice value and SCHED_RR priority asked for, how
+// often an automatic CPU choice looks at the target's threads again, and the
+// window the worst wake-up delay is kept over.
+static constexpr int kRaisedNice = -10;
+static constexpr int kRealtimePriority = 10;
+static constexpr uint64_t kCpuChoiceIntervalNs = 2000000000ULL;
+static constexpr uint64_t kWakeLateWindowNs = 1000000000ULL;
+static constexpr int kMaxTrackedTasks = 256;
+// FBConfig choices remembered per screen and drawable kind.
+static constexpr int kFbConfigCacheSize = 8;
+static constexpr int kScreenshotQueueSize = 4;
+// Finished screenshot ids remembered for status polling.
+static constexpr int kScreenshotResultHistory = 32;
+static constexpr int kScreenshotPending = 0;
+static constexpr int kScreenshotDone = 1;
+static constexpr int kScreenshotFailed = -1;
+static constexpr int kScreenshotUnknown = -2;
+
+typedef void (*LinuxScreenshotCallback)(int id, int status, void* userData);
+typedef void (*LinuxWindowWatchCallback)(int watchId, void* window, int pid, void* userData);
+
+typedef struct
+{
+    int struct_size;
+    int source_timing;
+    double source_fps;
+    double source_frame_time_ms;
+    double present_fps;
+    double present_frame_time_ms;
+    double capture_latency_ms;
+    uint64_t source_frames;
+    uint64_t presented_frames;
+    uint64_t last_source_msc;
+    double display_refresh_hz;
+    // _VARIABLE_REFRESH is set on the host; whether the driver actually runs
+    // the output variable is not visible through X11.
+    int vrr_requested;
+    int swap_interval;
+    uint64_t cropped_damage_skips;
+    uint64_t partial_redraws;
+    int copy_source_active;
+    int copy_ring_size;
+    uint64_t copied_frames;
+    uint64_t copy_fence_waits;
+    int auto_crop_left;
+    int auto_crop_top;
+    int auto_crop_right;
+    int auto_crop_bottom;
+    uint64_t content_bar_scans;
+    uint64_t preview_frames;
+    int preview_width;
+    int preview_height;
+    int headless;
+    uint64_t output_frames;
+    uint64_t screenshots_written;
+    uint64_t screenshots_failed;
+    uint64_t unique_frames;
+    uint64_t duplicate_frames;
+    uint64_t duplicate_skips;
+    double unique_fps;
+    int source_views;
+    // Blocking X replies the session waited for: in total, averaged over
+    // rendered passes, and for the last target search.
+    uint64_t round_trips;
+    double round_trips_per_frame;
+    int search_round_trips;
+    // _NET_WM_BYPASS_COMPOSITOR is set on the fullscreen host.
+    int compositor_bypass_active;
+    uint64_t compositor_bypass_transitions;
+    // The host is minimised, on another workspace or fully covered, and
+    // source frames that arrived meanwhile were not presented.
+    int host_occluded;
+    uint64_t occluded_skips;
+    // From create to the end of background init, and to the first present.
+    double init_ms;
+    double first_frame_ms;
+    // Targets replaced after the client destroyed or unmapped them, and how
+    // long the last one took from the loss to the switch.
+    uint64_t reacquisitions;
+    double last_reacquire_ms;
+    // A surface probe is running, and how often one moved the capture into
+    // a child of the window set_target found.
+    int surface_probe_active;
+    uint64_t surface_switches;
+    // Pointer events delivered to the target, those outside the picture,
+    // and the host event to delivery latency (smoothed and worst).
+    uint64_t input_events;
+    uint64_t input_outside;
+    double input_latency_ms;
+    double input_latency_max_ms;
+    // How the last pointer event would reach the target (a LinuxInputPath);
+    // None before the first one and while forwarding would reach nobody.
+    int input_path;
+    // The shared render thread: the scheduling it got (a
+    // LinuxRenderThreadMode), the first 64 CPUs it is pinned to as a mask (0
+    // when not pinned), and how late it woke from its sleeps, smoothed and
+    // worst over the last second.
+    int render_thread_mode;
+    uint64_t render_thread_cpus;
+    double wake_late_ms;
+    double wake_late_max_ms;
+} LinuxCaptureStats;
+
+typedef struct
+{
+    GLuint texture;
+    int width;
+    int height;
+    GLenum internal_format;
+    GLsync fence;
+} LinuxCaptureCopySlot;
+
+// GPU -> CPU copy through a pixel pack buffer, polled instead of waited on.
+typedef struct
+{
+    GLuint pbo;
+    GLsync fence;
+    int width;
+    int height;
+    size_t size;
+    int pending;
+    uint64_t issued_frame;
+} LinuxCaptureReadback;
+
+typedef struct
+{
+    int id;
+    int format;
+    int post_shader;
+    char path[1024];
+} LinuxScreenshotRequest;
+
+// A read-back frame waiting for the encoder thread. Pixels are bottom-up.
+typedef struct
+{
+    LinuxScreenshotRequest request;
+    uint8_t* pixels;
+    int width;
+    int height;
+} LinuxScreenshotJob;
+
+// The composite redirect and named pixmap of one captured window, shared by
+// every session targeting it: a client can redirect a window only once, and
+// one GLX pixmap can feed any number of views.
+typedef struct
+{
+    Window target;
+    Pixmap pixmap;
+    GLXPixmap glx_pixmap;
+    int rgba;
+    int refs;
+    // The window is gone: the server dropped the redirect with it, and the
+    // named pixmap keeps its last contents.
+    int destroyed;
+} LinuxCaptureSource;
+
+// A window watched by a surface probe.
+typedef struct
+{
+    Window window;
+    Damage damage;
+    aes_native::SurfaceProbeSample sample;
+} LinuxSurfaceProbe;
+
+// A small copy of the source, box filtered: drawn straight into fbo when the
+// reduction is at most 2:1, otherwise through mip_fbo's mip chain.
+typedef struct
+{
+    GLuint mip_fbo;
+    GLuint mip_texture;
+    int mip_w;
+    int mip_h;
+    GLuint fbo;
+    GLuint texture;
+    int w;
+    int h;
+} LinuxCaptureReduceTarget;
+
+// Top-down BGRA frames handed to readers on other threads. The render thread
+// fills the back buffer and swaps it in under the mutex; readers copy the front.
+typedef struct
+{
+    pthread_mutex_t mutex;
+    uint8_t* buffers[2];
+    size_t capacity[2];
+    int front;
+    int width;
+    int height;
+    uint64_t sequence;
+} LinuxCaptureFrameExchange;
+
+// Everything that decides which host pixel shows which source texel. A frame
+// may only redraw its damaged rect if this is unchanged since the last frame.
+typedef struct
+{
+    int host_w;
+    int host_h;
+    int target_w;
+    int target_h;
+    int viewport[4];
+    float uv[4];
+    GLuint program;
+    float brightness;
+    float saturation;
+    float tint[4];
+} LinuxCaptureRenderState;
+
 typedef struct
 {
     Display* display;
     int screen;
+    // view is the window handed to the embedder; window is the GL (or
+    // fallback) window inside it.
+    Window view;
     Window window;
     Colormap colormap;
 
+    // Set while the init thread builds the GL objects. A target set
+    // meanwhile is kept here and applied when it clears.
+    int init_pending;
+    pthread_t init_thread;
+    int init_thread_started;
+    int pending_target_set;
+    int pending_target_pid;
+    char pending_target_hint[256];
+    uint64_t create_ns;
+    double init_ms;
+    double first_frame_ms;
+
+    // Headless captures have no window: the context is current on a 1x1
+    // pbuffer and frames are composed into output_fbo for readback only.
+    int headless;
+    GLXPbuffer pbuffer;
+    int headless_w;
+    int headless_h;
+    GLuint output_fbo;
+    GLuint output_texture;
+    int output_w;
+    int output_h;
+    int output_readback_enabled;
+    int output_dirty;
+    LinuxCaptureReadback output_readback;
+    LinuxCaptureFrameExchange output_exchange;
+    uint64_t output_frames;
+
     Window target;
     int active;
     int initializing;
     int use_pipewire;
 
+    // How target was found, so its replacement can be: emulators recreate
+    // their render window when switching renderer or going fullscreen.
+    // Only windows indexed after target_order qualify, and only those
+    // matching the title hint, or target_class and at least half the lost
+    // target's size. While target_lost the last frame stays up; once the
+    // target is destroyed nothing is rendered from it.
+    int auto_reacquire;
+    int target_pid;
+    char target_hint[256];
+    char target_class[128];
+    uint64_t target_order;
+    int target_lost;
+    int target_destroyed;
+    int lost_w;
+    int lost_h;
+    // A target replaced while it was only unmapped. As long as it exists
+    // the capture goes back to it when it maps again.
+    Window original_target;
+    uint64_t original_order;
+    int original_remapped;
+    uint64_t reacquire_start_ns;
+    uint64_t reacquire_checked_ns;
+    uint64_t reacquisitions;
+    double last_reacquire_ms;
+
+    // Damage on probe_root (the top-level set_target found) and its large
+    // descendants for a short while, to move the capture to whichever one
+    // draws the frames. probe_root is also where a lost child target
+    // falls back to.
+    Window probe_root;
+    LinuxSurfaceProbe probes[kMaxProbeSurfaces];
+    int probe_count;
+    uint64_t probe_start_ns;
+    uint64_t surface_switches;
+
+    // Pointer input sent to the target: buttons held, whether the pointer
+    // is over the picture, the view position last forwarded, and the
+    // target's root position for the events' root coordinates, looked up
+    // again after it moves.
+    unsigned int input_buttons;
+    int input_inside;
+    int input_view_x;
+    int input_view_y;
+    int input_origin_valid;
+    int target_root_x;
+    int target_root_y;
+    uint32_t target_event_masks;
+    int has_xtest;
+    int input_path;
+    uint64_t input_events;
+    uint64_t input_outside;
+    uint64_t input_latency_checked_ns;
+    double input_latency_ms;
+    double input_latency_max_ms;
+
+    // Scheduling this session asks for the shared render thread, and what
+    // the thread got, copied in by the scheduler every pass.
+    int render_thread_request;
+    char render_thread_cpus_request[128];
+    int render_thread_mode;
+    uint64_t render_thread_cpus;
+    double wake_late_ms;
+    double wake_late_max_ms;
+
     float brightness;
     float saturation;
     float tint[4];
@@ -95,6 +500,50 @@ typedef struct
     int damage_event_base;
     int damage_error_base;
     Damage damage;
+    int damage_frame_seen;
+    int damage_frame_visible;
+    int render_dirty[4];
+    int render_dirty_valid;
+    int render_dirty_full;
+    int visible_source[4];
+    int visible_source_valid;
+
+    xcb_connection_t* xcb;
+    int present_supported;
+    xcb_present_event_t present_eid;
+    xcb_special_event_t* present_special;
+    Window present_window;
+    uint64_t present_last_ust;
+    uint64_t present_last_msc;
+    uint64_t present_last_event_ns;
+    uint64_t present_intervals_us[kPresentIntervalHistory];
+    int present_interval_count;
+    int present_interval_next;
+
+    // Present completions of our own swaps. A vsynced glXSwapBuffers waits
+    // while the previous swap is still queued, which on the shared scheduler
+    // thread holds up every other session, so a frame is only rendered once
+    // the previous one has reached the screen.
+    xcb_present_event_t host_present_eid;
+    xcb_special_event_t* host_present_special;
+    uint64_t host_swaps_sent;
+    uint64_t host_swaps_completed;
+    uint64_t host_swap_ns;
+
+    int randr_supported;
+    int randr_event_base;
+    int randr_error_base;
+    int display_refresh_dirty;
+    uint64_t display_refresh_checked_ns;
+    double display_refresh_hz;
+    RRCrtc display_crtc;
+    Window host_toplevel;
+    int host_obscured;
+    int toplevel_obscured;
+    int toplevel_hidden;
+    int toplevel_state_dirty;
+    int host_occluded;
+    uint64_t occluded_skips;
 
     double fps;
     double frame_time_ms;
@@ -129,11 +578,14 @@ typedef struct
     int gl_supported;
     GLXFBConfig fb_config;
     GLXContext glx_context;
+    LinuxCaptureSource* source;
     Pixmap composite_pixmap;
     GLXPixmap glx_pixmap;
+    int glx_pixmap_rgba;
     GLuint gl_texture;
     GLuint shader_program;
     int shader_dirty;
+    int shader_pointwise;
     GLint shader_u_tex;
     GLint shader_u_brightness;
     GLint shader_u_saturation;
@@ -149,11 +601,22 @@ typedef struct
     PFNGLXSWAPINTERVALSGIPROC glx_swap_interval_sgi;
     int has_swap_control;
     int has_swap_control_tear;
-    int applied_disable_vsync;
+    int has_buffer_age;
+    int gl_caps_checked;
+    int has_copy_image;
+    int has_fbo_blit;
+    int has_sync;
+    int applied_swap_interval;
+    int vrr_enabled;
+    int vrr_active;
+    Window vrr_window;
+    Window vrr_toplevel;
+    int compositor_bypass_enabled;
+    int compositor_bypass_active;
+    int host_covers_output;
+    Window bypass_toplevel;
+    uint64_t bypass_transitions;
 
-    pthread_t render_thread;
-    int render_thread_started;
-    int stop_render_thread;
     pthread_mutex_t mutex;
 
     uint64_t fps_window_start_ns;
@@ -162,42 +625,326 @@ typedef struct
     uint64_t last_present_sample_ns;
     uint64_t last_render_ns;
     int gpu_frame_pending;
+
+    int source_timing;
+    uint64_t source_frame_ns;
+    uint64_t source_frame_count;
+    uint64_t rendered_source_frame;
+    uint64_t presented_frames;
+    double capture_latency_ms;
+
+    LinuxCaptureRenderState last_render_state;
+    int last_render_state_valid;
+    int redraw_history[kRedrawHistory][4];
+    int redraw_history_count;
+    uint64_t cropped_damage_skips;
+    uint64_t partial_redraws;
+
+    int copy_source_enabled;
+    LinuxCaptureCopySlot copy_ring[kCopyRingSize];
+    int copy_ring_next;
+    GLuint copy_read_fbo;
+    GLuint copy_draw_fbo;
+    uint64_t copied_frames;
+    uint64_t copy_fence_waits;
+
+    int auto_crop_enabled;
+    int auto_crop[4];
+    int auto_crop_threshold;
+    aes_native::ContentBarTracker auto_crop_tracker;
+    uint64_t auto_crop_scan_frame;
+    uint64_t content_bar_scans;
+    GLuint detect_fbo;
+    GLuint detect_texture;
+    int detect_w;
+    int detect_h;
+    LinuxCaptureReadback detect_readback;
+    int detect_readback_region[4];
+    uint32_t detect_readback_generation;
+    uint32_t detect_generation;
+
+    pthread_t detect_thread;
+    int detect_thread_started;
+    pthread_mutex_t detect_mutex;
+    pthread_cond_t detect_cond;
+    int detect_stop;
+    int detect_job_ready;
+    uint8_t* detect_job_pixels;
+    size_t detect_job_capacity;
+    int detect_job_w;
+    int detect_job_h;
+    int detect_job_region[4];
+    uint32_t detect_job_generation;
+    int detect_job_threshold;
+
+    int preview_max_width;
+    double preview_fps;
+    uint64_t preview_last_ns;
+    uint64_t preview_source_frame;
+    uint64_t preview_frames;
+    LinuxCaptureReduceTarget preview_target;
+    LinuxCaptureReadback preview_readback;
+    LinuxCaptureFrameExchange preview_exchange;
+
+    // Requests are queued under mutex and taken one at a time by the render
+    // thread; encoding and file IO happen on screenshot_thread.
+    int screenshot_next_id;
+    LinuxScreenshotRequest screenshot_queue[kScreenshotQueueSize];
+    int screenshot_queue_count;
+    LinuxScreenshotRequest screenshot_inflight;
+    LinuxCaptureReadback screenshot_readback;
+    GLuint screenshot_fbo;
+    GLuint screenshot_texture;
+    int screenshot_w;
+    int screenshot_h;
+
+    pthread_t screenshot_thread;
+    int screenshot_thread_started;
+    pthread_mutex_t screenshot_mutex;
+    pthread_cond_t screenshot_cond;
+    int screenshot_stop;
+    LinuxScreenshotJob screenshot_jobs[kScreenshotQueueSize];
+    int screenshot_job_count;
+    int screenshot_results[kScreenshotResultHistory][2];
+    int screenshot_result_next;
+    LinuxScreenshotCallback screenshot_callback;
+    void* screenshot_callback_user;
+    uint64_t screenshots_written;
+    uint64_t screenshots_failed;
+    int duplicate_detection;
+    LinuxCaptureReduceTarget fingerprint_target;
+    LinuxCaptureReadback fingerprint_readback;
+    uint64_t fingerprint_source_frame;
+    uint64_t fingerprint_frame_ns;
+    uint64_t fingerprint_hash;
+    int fingerprint_valid;
+    uint64_t unique_frames;
+    uint64_t duplicate_frames;
+    uint64_t duplicate_skips;
+    aes_native::FrameRateWindow unique_rate;
+    uint64_t round_trips;
+    uint64_t render_passes;
+    int search_round_trips;
 } LinuxCapture;
 
+// Atoms the bridge uses, interned in one batch when the shared connection
+// opens.
+typedef struct
+{
+    xcb_atom_t net_wm_pid;
+    xcb_atom_t net_wm_name;
+    xcb_atom_t net_client_list;
+    xcb_atom_t net_wm_window_opacity;
+    xcb_atom_t net_wm_state;
+    xcb_atom_t net_wm_state_skip_taskbar;
+    xcb_atom_t net_wm_state_skip_pager;
+    xcb_atom_t net_wm_state_hidden;
+    xcb_atom_t variable_refresh;
+    xcb_atom_t net_wm_bypass_compositor;
+} LinuxAtoms;
+
+// A window the index listens to. Windows enter the index before they have
+// set a PID, title or class, so fields may still be empty.
+typedef struct
+{
+    uint64_t order;
+    pid_t pid;
+    std::string title;
+    std::string wm_instance;
+    std::string wm_class;
+} LinuxIndexedWindow;
+
+typedef struct
+{
+    int id;
+    pid_t pid;
+    std::string title_hint;
+    LinuxWindowWatchCallback callback;
+    void* user_data;
+} LinuxWindowWatch;
+
+typedef struct
+{
+    int watch_id;
+    Window window;
+    pid_t pid;
+} LinuxWindowMatch;
+
+// Client windows of the shared connection keyed by PID and WM_CLASS. Built
+// once from _NET_CLIENT_LIST and a tree walk, then kept current from the
+// events the scheduler reads: CreateNotify on the root adds a window,
+// DestroyNotify drops it and PropertyNotify refreshes its PID, title and
+// class. Lookups never talk to the server; title hints are substrings, so
+// they scan the cached titles.
+//
+// mutex is taken after the manager's and a session's mutex. delivery_mutex
+// is held while watch callbacks run, so removing a watch waits for them.
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_mutex_t delivery_mutex;
+    int ready;
+    Window root;
+    uint64_t next_order;
+    std::unordered_map<Window, LinuxIndexedWindow> windows;
+    std::unordered_multimap<pid_t, Window> by_pid;
+    std::unordered_multimap<std::string, Window> by_class;
+    std::vector<LinuxWindowWatch> watches;
+    std::vector<LinuxWindowMatch> pending;
+    int next_watch_id;
+} LinuxWindowIndex;
+
+typedef struct
+{
+    int screen;
+    int headless;
+    GLXFBConfig config;
+} LinuxFbConfigCacheEntry;
+
+typedef struct
+{
+    pid_t tid;
+    uint64_t ticks;
+} LinuxTaskTicks;
+
+// _NET_WM_BYPASS_COMPOSITOR on a host top-level, held by every session on
+// it that wants bypass. The value the host had is put back when the last one
+// lets go.
+typedef struct
+{
+    Window toplevel;
+    int refs;
+    int saved_valid;
+    uint32_t saved_value;
+} LinuxBypassClaim;
+
+// Scheduling the scheduler thread applied to itself, what it started with so
+// it can go back, and its wake-up delays. Lives on that thread's stack: a
+// restarted scheduler starts untuned.
+typedef struct
+{
+    int mode_request;
+    int mode;
+    int realtime;
+    int nice_raised;
+    int base_nice;
+    cpu_set_t base_cpus;
+    char cpus_request[128];
+    uint64_t cpu_mask;
+    uint64_t cpus_checked_ns;
+    // The target's threads' CPU time at the last automatic choice.
+    pid_t tasks_pid;
+    LinuxTaskTicks tasks[kMaxTrackedTasks];
+    int task_count;
+    double wake_late_ms;
+    double wake_late_max_ms;
+    double wake_window_max_ms;
+    uint64_t wake_window_start_ns;
+} LinuxRenderThreadTuning;
+
+// Process-wide owner of what captures share: the X connection, the root of
+// the GL share group, the composite sources and a single scheduler thread
+// that dispatches X events to every session and renders each in turn.
+// Sessions are registered views; creating one no longer opens a display or
+// starts a render thread of its own. The one-shot helper exports use the same
+// connection and pin it open once they have been called.
+//
+// Lock order: mutex, then a session's mutex, then sources_mutex, which also
+// guards the bypass claims.
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_mutex_t sources_mutex;
+    pthread_cond_t cond;
+    Display* display;
+    LinuxAtoms atoms;
+    int refs;
+    int helpers_pinned;
+    GLXContext share_context;
+    LinuxCapture* sessions[kMaxCaptureSessions];
+    int session_count;
+    // The session whose context is current on the scheduler thread, and one
+    // being destroyed that needs it released.
+    LinuxCapture* current_session;
+    LinuxCapture* release_session;
+    pthread_t scheduler_thread;
+    int scheduler_started;
+    uint64_t scheduler_generation;
+    XEvent events[kMaxSchedulerEvents];
+    LinuxCaptureSource sources[kMaxCaptureSources];
+    LinuxBypassClaim bypass_claims[kMaxCaptureSessions];
+    // Allocated once and never freed, so the scheduler can outlive static
+    // destructors at exit.
+    LinuxWindowIndex* window_index;
+    LinuxFbConfigCacheEntry fb_configs[kFbConfigCacheSize];
+    int fb_config_count;
+} LinuxCaptureManager;
+
+static LinuxCaptureManager g_capture_manager;
+
 extern "C" {
 
 static pthread_once_t g_x11_threads_once = PTHREAD_ONCE_INIT;
 
+static pthread_once_t g_capture_manager_once = PTHREAD_ONCE_INIT;
+
 static void InitX11ThreadsOnce()
 {
     XInitThreads();
 }
 
-static void LogNative(const char* fmt, ...)
+static void InitCaptureManagerOnce()
 {
-    if (!fmt)
-        return;
+    pthread_mutex_init(&g_capture_manager.mutex, nullptr);
+    pthread_mutex_init(&g_capture_manager.sources_mutex, nullptr);
+    pthread_cond_init(&g_capture_manager.cond, nullptr);
+
+    LinuxWindowIndex* index = new LinuxWindowIndex();
+    pthread_mutex_init(&index->mutex, nullptr);
+    pthread_mutexattr_t recursive;
+    pthread_mutexattr_init(&recursive);
+    pthread_mutexattr_settype(&recursive, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&index->delivery_mutex, &recursive);
+    pthread_mutexattr_destroy(&recursive);
+    g_capture_manager.window_index = index;
+}
 
-    char message[1024];
-    va_list args;
-    va_start(args, fmt);
-    vsnprintf(message, sizeof(message), fmt, args);
-    va_end(args);
+// Queries go through XCB: a batch of requests is sent before the first reply
+// is read, waiting on a cookie does not take Xlib's display lock, and errors
+// come back with the reply instead of reaching Xlib's default handler, which
+// exits. Replies the bridge blocked on are counted per thread, so a frame's
+// count does not mix with a search on a control thread; a batch counts once.
+static thread_local uint64_t t_round_trips;
 
-    timespec ts{};
-    clock_gettime(CLOCK_REALTIME, &ts);
-    tm localTm{};
-    localtime_r(&ts.tv_sec, &localTm);
+static void CountRoundTrip()
+{
+    t_round_trips++;
+}
 
-    char stamp[64];
-    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &localTm);
+// Kept for the life of the process, so no exit path waits on its writer.
+static aes_native::NativeLog& BridgeLog()
+{
+    static aes_native::NativeLog* log =
+        new aes_native::NativeLog(aes_native::LogConfig::FromEnvironment("/tmp/aes_linux_capture_bridge.log"));
+    return *log;
+}
 
-    FILE* f = fopen("/tmp/aes_linux_capture_bridge.log", "a");
-    if (!f)
-        return;
+static void LogNativeAt(aes_native::LogLevel level, const char* category, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    BridgeLog().WriteV(level, category, fmt, args);
+    va_end(args);
+}
 
-    fprintf(f, "[%s.%03ld] %s\n", stamp, ts.tv_nsec / 1000000L, message);
-    fclose(f);
+// Formats into the logger's ring and returns; the file is written by the
+// logger's own thread.
+static void LogNative(const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    BridgeLog().WriteV(aes_native::LogLevel::Info, "capture", fmt, args);
+    va_end(args);
 }
 
 static uint64_t MonotonicNowNs()
@@ -207,22 +954,6 @@ static uint64_t MonotonicNowNs()
     return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
 }
 
-static double StabilizeReportedFps(double fps)
-{
-    if (fps <= 0.0)
-        return 0.0;
-
-    const double candidates[] = { 30.0, 60.0, 120.0 };
-    for (double candidate : candidates)
-    {
-        // Snap to common emulator rates when very close.
-        if (fabs(fps - candidate) <= candidate * 0.04)
-            return candidate;
-    }
-
-    return fps;
-}
-
 static void SamplePresentMetrics(LinuxCapture* cap, uint64_t now)
 {
     if (!cap || now == 0)
@@ -233,11 +964,7 @@ static void SamplePresentMetrics(LinuxCapture* cap, uint64_t now)
         const double dt = static_cast<double>(now - cap->last_present_sample_ns) / 1000000000.0;
         if (dt > 0.0)
         {
-            const double instantFps = std::clamp(1.0 / dt, 1.0, 240.0);
-            const double alpha = dt >= 0.025 ? 0.22 : 0.14;
-            cap->present_fps = cap->present_fps > 0.0
-                ? (cap->present_fps * (1.0 - alpha)) + (instantFps * alpha)
-                : instantFps;
+            cap->present_fps = aes_native::SmoothFrameRate(cap->present_fps, dt);
             cap->present_frame_time_ms = cap->present_fps > 0.0 ? 1000.0 / cap->present_fps : 0.0;
         }
     }
@@ -247,6 +974,148 @@ static void SamplePresentMetrics(LinuxCapture* cap, uint64_t now)
     cap->frame_time_ms = cap->present_frame_time_ms;
 }
 
+static uint64_t UstToMonotonicNs(uint64_t ust, uint64_t nowNs)
+{
+    // The X server reports UST in microseconds of CLOCK_MONOTONIC. Fall back to
+    // the arrival time if the server clock domain does not line up with ours.
+    const uint64_t ustNs = ust * 1000ULL;
+    if (ust == 0 || ustNs > nowNs + 5000000ULL || nowNs - ustNs > 1000000000ULL)
+        return nowNs;
+    return ustNs;
+}
+
+static void RecordSourceFrame(LinuxCapture* cap, uint64_t frameNs, int timing)
+{
+    if (!cap)
+        return;
+
+    cap->source_timing = timing;
+    cap->source_frame_ns = frameNs;
+    cap->source_frame_count++;
+
+    // A frame whose damage landed entirely in cropped-away pixels (OSD in the
+    // letterbox, an emulator status bar) changes nothing we show.
+    if (cap->damage != 0 && cap->damage_frame_seen && !cap->damage_frame_visible)
+    {
+        cap->cropped_damage_skips++;
+    }
+    else
+    {
+        if (!cap->damage_frame_visible)
+            cap->render_dirty_full = 1;
+        cap->gpu_frame_pending = 1;
+    }
+
+    cap->damage_frame_seen = 0;
+    cap->damage_frame_visible = 0;
+}
+
+static void UnionRect(int* rect, int* valid, int x0, int y0, int x1, int y1)
+{
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    if (!*valid)
+    {
+        rect[0] = x0;
+        rect[1] = y0;
+        rect[2] = x1;
+        rect[3] = y1;
+        *valid = 1;
+        return;
+    }
+
+    rect[0] = std::min(rect[0], x0);
+    rect[1] = std::min(rect[1], y0);
+    rect[2] = std::max(rect[2], x1);
+    rect[3] = std::max(rect[3], y1);
+}
+
+static bool DamageTouchesVisibleSource(const LinuxCapture* cap, int x0, int y0, int x1, int y1)
+{
+    // Until a frame has been rendered we do not know the mapping; assume visible.
+    if (!cap->visible_source_valid)
+        return true;
+
+    return x0 < cap->visible_source[2] && x1 > cap->visible_source[0] &&
+           y0 < cap->visible_source[3] && y1 > cap->visible_source[1];
+}
+
+static bool HandleDamageAreaLocked(LinuxCapture* cap, const XRectangle& area)
+{
+    const int x0 = area.x;
+    const int y0 = area.y;
+    const int x1 = area.x + static_cast<int>(area.width);
+    const int y1 = area.y + static_cast<int>(area.height);
+
+    cap->damage_frame_seen = 1;
+    if (!DamageTouchesVisibleSource(cap, x0, y0, x1, y1))
+        return false;
+
+    cap->damage_frame_visible = 1;
+    UnionRect(cap->render_dirty, &cap->render_dirty_valid, x0, y0, x1, y1);
+    cap->gpu_frame_pending = 1;
+    return true;
+}
+
+static void ResetDamageTrackingLocked(LinuxCapture* cap)
+{
+    cap->damage_frame_seen = 0;
+    cap->damage_frame_visible = 0;
+    cap->render_dirty_valid = 0;
+    cap->render_dirty_full = 1;
+    cap->visible_source_valid = 0;
+    cap->last_render_state_valid = 0;
+    cap->redraw_history_count = 0;
+    cap->cropped_damage_skips = 0;
+    cap->partial_redraws = 0;
+    cap->occluded_skips = 0;
+    cap->copied_frames = 0;
+    cap->copy_fence_waits = 0;
+    cap->fingerprint_source_frame = 0;
+    cap->fingerprint_valid = 0;
+    cap->unique_frames = 0;
+    cap->duplicate_frames = 0;
+    cap->duplicate_skips = 0;
+    cap->unique_rate.Reset();
+}
+
+static void SampleCaptureLatency(LinuxCapture* cap, uint64_t now)
+{
+    if (!cap || cap->source_frame_ns == 0 || cap->rendered_source_frame == cap->source_frame_count)
+        return;
+
+    cap->rendered_source_frame = cap->source_frame_count;
+    if (now <= cap->source_frame_ns)
+        return;
+
+    const double latencyMs = static_cast<double>(now - cap->source_frame_ns) / 1000000.0;
+    if (latencyMs > 250.0)
+        return;
+
+    cap->capture_latency_ms = cap->capture_latency_ms > 0.0
+        ? (cap->capture_latency_ms * 0.9) + (latencyMs * 0.1)
+        : latencyMs;
+}
+
+// The frame time pacing works from: the source rate, snapped to a divisor
+// of the host monitor's refresh when it is within a few percent of one, so
+// jitter in the estimate does not move due times and duplicate windows.
+static void UpdateSourceFrameTimeLocked(LinuxCapture* cap)
+{
+    const double fps = aes_native::SnapFrameRateToRefresh(cap->source_fps, cap->display_refresh_hz);
+    cap->source_frame_time_ms = fps > 0.0 ? 1000.0 / fps : 0.0;
+}
+
+static double SourceFpsDecaySeconds(LinuxCapture* cap)
+{
+    // Only start decaying once two expected source frames have been missed,
+    // otherwise slow but steady sources (20-25 fps) would flicker towards zero.
+    if (!cap || cap->source_frame_time_ms <= 0.0)
+        return 0.05;
+    return std::max(0.05, (cap->source_frame_time_ms * 2.0) / 1000.0);
+}
+
 static void SetStatusText(LinuxCapture* cap, const char* text)
 {
     if (!cap)
@@ -291,31 +1160,48 @@ static Window GetParentWindow(Display* display, void* parentHandle)
     return reinterpret_cast<Window>(parentHandle);
 }
 
+// Errors come back in the reply here, so a window that is already gone
+// costs one round trip and no X error.
+static bool WindowExists(Display* display, Window window)
+{
+    if (!display || window == 0)
+        return false;
+
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    CountRoundTrip();
+    xcb_generic_error_t* error = nullptr;
+    xcb_get_window_attributes_reply_t* reply =
+        xcb_get_window_attributes_reply(conn, xcb_get_window_attributes(conn, static_cast<xcb_window_t>(window)), &error);
+    const bool exists = reply != nullptr;
+    free(reply);
+    free(error);
+    return exists;
+}
+
 static Window GetTopLevelWindow(Display* display, Window window)
 {
     if (!display || window == 0)
         return window;
 
+    xcb_connection_t* conn = XGetXCBConnection(display);
     Window root = DefaultRootWindow(display);
     Window current = window;
 
+    // Each step needs the previous parent, so this is one round trip per
+    // level; callers cache the result.
     for (int depth = 0; depth < 64; depth++)
     {
-        Window rootReturn = 0;
-        Window parentReturn = 0;
-        Window* children = nullptr;
-        unsigned int childCount = 0;
-
-        if (XQueryTree(display, current, &rootReturn, &parentReturn, &children, &childCount) == 0)
+        CountRoundTrip();
+        xcb_query_tree_reply_t* reply = xcb_query_tree_reply(conn, xcb_query_tree(conn, static_cast<xcb_window_t>(current)), nullptr);
+        if (!reply)
             break;
 
-        if (children)
-            XFree(children);
-
-        if (parentReturn == 0 || parentReturn == root || parentReturn == current)
+        const Window parent = reply->parent;
+        free(reply);
+        if (parent == 0 || parent == root || parent == current)
             break;
 
-        current = parentReturn;
+        current = parent;
     }
 
     return current;
@@ -326,43 +1212,19 @@ static bool TryGetWindowOpacity(Display* display, Window window, unsigned long*
     if (!display || window == 0 || !outOpacity)
         return false;
 
-    Atom opacityAtom = XInternAtom(display, "_NET_WM_WINDOW_OPACITY", True);
-    if (opacityAtom == None)
-        return false;
-
-    Atom actualType = None;
-    int actualFormat = 0;
-    unsigned long nitems = 0;
-    unsigned long bytesAfter = 0;
-    unsigned char* prop = nullptr;
-
-    if (XGetWindowProperty(
-            display,
-            window,
-            opacityAtom,
-            0,
-            1,
-            False,
-            XA_CARDINAL,
-            &actualType,
-            &actualFormat,
-            &nitems,
-            &bytesAfter,
-            &prop) != Success)
-    {
-        return false;
-    }
-
-    if (!prop || nitems < 1)
-    {
-        if (prop)
-            XFree(prop);
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    CountRoundTrip();
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(conn,
+        xcb_get_property(conn, 0, static_cast<xcb_window_t>(window), g_capture_manager.atoms.net_wm_window_opacity, XCB_ATOM_CARDINAL, 0, 1),
+        nullptr);
+    if (!reply)
         return false;
-    }
 
-    *outOpacity = *reinterpret_cast<unsigned long*>(prop);
-    XFree(prop);
-    return true;
+    const bool found = reply->format == 32 && xcb_get_property_value_length(reply) >= 4;
+    if (found)
+        *outOpacity = *static_cast<const uint32_t*>(xcb_get_property_value(reply));
+    free(reply);
+    return found;
 }
 
 static bool SetWindowOpacity(Display* display, Window window, unsigned long opacity)
@@ -370,7 +1232,7 @@ static bool SetWindowOpacity(Display* display, Window window, unsigned long opac
     if (!display || window == 0)
         return false;
 
-    Atom opacityAtom = XInternAtom(display, "_NET_WM_WINDOW_OPACITY", False);
+    const Atom opacityAtom = g_capture_manager.atoms.net_wm_window_opacity;
     if (opacityAtom == None)
         return false;
 
@@ -392,7 +1254,7 @@ static void ClearWindowOpacity(Display* display, Window window)
     if (!display || window == 0)
         return;
 
-    Atom opacityAtom = XInternAtom(display, "_NET_WM_WINDOW_OPACITY", True);
+    const Atom opacityAtom = g_capture_manager.atoms.net_wm_window_opacity;
     if (opacityAtom == None)
         return;
 
@@ -443,9 +1305,9 @@ static void SetWindowSkipTaskbar(Display* display, Window window, bool skip)
     if (!display || window == 0)
         return;
 
-    Atom netWmState = XInternAtom(display, "_NET_WM_STATE", False);
-    Atom skipTaskbar = XInternAtom(display, "_NET_WM_STATE_SKIP_TASKBAR", False);
-    Atom skipPager = XInternAtom(display, "_NET_WM_STATE_SKIP_PAGER", False);
+    const Atom netWmState = g_capture_manager.atoms.net_wm_state;
+    const Atom skipTaskbar = g_capture_manager.atoms.net_wm_state_skip_taskbar;
+    const Atom skipPager = g_capture_manager.atoms.net_wm_state_skip_pager;
     if (netWmState == None || skipTaskbar == None || skipPager == None)
         return;
 
@@ -465,72 +1327,58 @@ static void SetWindowSkipTaskbar(Display* display, Window window, bool skip)
     XFlush(display);
 }
 
+static std::string PropertyString(const xcb_get_property_reply_t* reply)
+{
+    if (!reply || reply->format != 8)
+        return std::string();
+    const char* value = static_cast<const char*>(xcb_get_property_value(reply));
+    const int length = xcb_get_property_value_length(reply);
+    return std::string(value, strnlen(value, static_cast<size_t>(length)));
+}
+
 static bool GetWindowTitle(Display* display, Window window, char* buffer, int size)
 {
     if (!display || !buffer || size <= 0)
         return false;
 
-    Atom atoms[] = { XInternAtom(display, "_NET_WM_NAME", True), XA_WM_NAME };
-    for (int i = 0; i < 2; i++)
+    // _NET_WM_NAME is UTF-8; WM_NAME is used as stored, which covers the
+    // Latin-1 and ASCII titles that lack the EWMH name.
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    const xcb_window_t w = static_cast<xcb_window_t>(window);
+    xcb_get_property_cookie_t cookies[] = {
+        xcb_get_property(conn, 0, w, g_capture_manager.atoms.net_wm_name, XCB_GET_PROPERTY_TYPE_ANY, 0, 256),
+        xcb_get_property(conn, 0, w, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 256),
+    };
+    CountRoundTrip();
+    std::string title;
+    for (xcb_get_property_cookie_t cookie : cookies)
     {
-        Atom atom = atoms[i];
-        if (atom == None)
-            continue;
-
-        XTextProperty prop;
-        if (XGetTextProperty(display, window, &prop, atom) && prop.value)
-        {
-            bool success = false;
-
-            if (prop.encoding == XA_STRING)
-            {
-                strncpy(buffer, reinterpret_cast<char*>(prop.value), size - 1);
-                buffer[size - 1] = '\0';
-                success = true;
-            }
-            else
-            {
-                char** list = nullptr;
-                int count = 0;
-                if (XmbTextPropertyToTextList(display, &prop, &list, &count) >= Success && list && count > 0 && list[0])
-                {
-                    strncpy(buffer, list[0], size - 1);
-                    buffer[size - 1] = '\0';
-                    XFreeStringList(list);
-                    success = true;
-                }
-            }
-
-            XFree(prop.value);
-            if (success)
-                return true;
-        }
+        xcb_get_property_reply_t* reply = xcb_get_property_reply(conn, cookie, nullptr);
+        if (title.empty())
+            title = PropertyString(reply);
+        free(reply);
     }
 
-    buffer[0] = '\0';
-    return false;
+    strncpy(buffer, title.c_str(), size - 1);
+    buffer[size - 1] = '\0';
+    return !title.empty();
 }
 
 static pid_t GetWindowPid(Display* display, Window window)
 {
-    Atom pidAtom = XInternAtom(display, "_NET_WM_PID", True);
-    if (pidAtom == None)
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    CountRoundTrip();
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(conn,
+        xcb_get_property(conn, 0, static_cast<xcb_window_t>(window), g_capture_manager.atoms.net_wm_pid, XCB_ATOM_CARDINAL, 0, 1),
+        nullptr);
+    if (!reply)
         return 0;
 
-    Atom actualType;
-    int actualFormat;
-    unsigned long nitems, bytesAfter;
-    unsigned char* prop = nullptr;
-
-    if (XGetWindowProperty(display, window, pidAtom, 0, 1, False, XA_CARDINAL,
-                           &actualType, &actualFormat, &nitems, &bytesAfter, &prop) == Success && prop)
-    {
-        uint32_t pidValue = *reinterpret_cast<uint32_t*>(prop);
-        XFree(prop);
-        return static_cast<pid_t>(pidValue);
-    }
-
-    return 0;
+    pid_t pid = 0;
+    if (reply->format == 32 && xcb_get_property_value_length(reply) >= 4)
+        pid = static_cast<pid_t>(*static_cast<const uint32_t*>(xcb_get_property_value(reply)));
+    free(reply);
+    return pid;
 }
 
 static bool TitleMatches(const char* windowTitle, const char* titleHint)
@@ -552,6 +1400,7 @@ static Window FindWindowByTitle(Display* display, Window root, const char* title
     if (!display)
         return 0;
 
+    CountRoundTrip();
     if (XQueryTree(display, root, &rootReturn, &parentReturn, &children, &childCount) == 0)
         return 0;
 
@@ -595,6 +1444,7 @@ static Window FindWindowByPid(Display* display, Window root, pid_t pid, const ch
     if (!display)
         return 0;
 
+    CountRoundTrip();
     if (XQueryTree(display, root, &rootReturn, &parentReturn, &children, &childCount) == 0)
         return 0;
 
@@ -636,34 +1486,583 @@ static Window FindWindowByPid(Display* display, Window root, pid_t pid, const ch
     return 0;
 }
 
-static bool LoadTextFile(const char* path, char** outText)
-{
-    if (!outText)
-        return false;
-
-    *outText = nullptr;
-    if (!path || path[0] == '\0')
-        return false;
-
-    FILE* f = fopen(path, "rb");
-    if (!f)
-        return false;
+static constexpr uint32_t kIndexRootEvents = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
+static constexpr uint32_t kIndexWindowEvents = XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE;
 
-    if (fseek(f, 0, SEEK_END) != 0)
+typedef struct
+{
+    Window window;
+    int exists;
+    pid_t pid;
+    std::string title;
+    std::string wm_instance;
+    std::string wm_class;
+} LinuxWindowProperties;
+
+static void FetchWindowProperties(xcb_connection_t* conn, std::vector<LinuxWindowProperties>& windows)
+{
+    // Four requests per window, all sent before the first reply is read.
+    std::vector<xcb_get_property_cookie_t> cookies(windows.size() * 4);
+    for (size_t i = 0; i < windows.size(); i++)
     {
-        fclose(f);
-        return false;
+        const xcb_window_t w = static_cast<xcb_window_t>(windows[i].window);
+        cookies[i * 4 + 0] = xcb_get_property(conn, 0, w, g_capture_manager.atoms.net_wm_pid, XCB_ATOM_CARDINAL, 0, 1);
+        cookies[i * 4 + 1] = xcb_get_property(conn, 0, w, g_capture_manager.atoms.net_wm_name, XCB_GET_PROPERTY_TYPE_ANY, 0, 256);
+        cookies[i * 4 + 2] = xcb_get_property(conn, 0, w, XCB_ATOM_WM_NAME, XCB_GET_PROPERTY_TYPE_ANY, 0, 256);
+        cookies[i * 4 + 3] = xcb_get_property(conn, 0, w, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 0, 256);
     }
 
-    long len = ftell(f);
-    if (len <= 0)
+    if (!windows.empty())
+        CountRoundTrip();
+    for (size_t i = 0; i < windows.size(); i++)
     {
-        fclose(f);
-        return false;
+        LinuxWindowProperties& props = windows[i];
+        props.exists = 1;
+        for (int p = 0; p < 4; p++)
+        {
+            xcb_generic_error_t* error = nullptr;
+            xcb_get_property_reply_t* reply = xcb_get_property_reply(conn, cookies[i * 4 + p], &error);
+            if (error)
+            {
+                props.exists = 0;
+                free(error);
+            }
+            if (!reply)
+                continue;
+
+            if (p == 0 && reply->format == 32 && xcb_get_property_value_length(reply) >= 4)
+                props.pid = static_cast<pid_t>(*static_cast<const uint32_t*>(xcb_get_property_value(reply)));
+            else if (p == 1 || (p == 2 && props.title.empty()))
+                props.title = PropertyString(reply);
+            else if (p == 3 && reply->format == 8)
+            {
+                // WM_CLASS is two NUL-terminated strings: instance, then class.
+                const char* value = static_cast<const char*>(xcb_get_property_value(reply));
+                const size_t length = static_cast<size_t>(xcb_get_property_value_length(reply));
+                const size_t first = strnlen(value, length);
+                props.wm_instance.assign(value, first);
+                if (first + 1 < length)
+                    props.wm_class.assign(value + first + 1, strnlen(value + first + 1, length - first - 1));
+            }
+            free(reply);
+        }
     }
+}
 
-    rewind(f);
-    char* buf = static_cast<char*>(malloc(static_cast<size_t>(len) + 1));
+// Adds mask to this connection's selection on each window. A selection
+// replaces the previous one, so the current mask is read back first.
+static void AddWindowEventMasks(xcb_connection_t* conn, const std::vector<Window>& windows, uint32_t mask)
+{
+    if (windows.empty())
+        return;
+
+    std::vector<xcb_get_window_attributes_cookie_t> cookies(windows.size());
+    for (size_t i = 0; i < windows.size(); i++)
+        cookies[i] = xcb_get_window_attributes(conn, static_cast<xcb_window_t>(windows[i]));
+
+    std::vector<xcb_void_cookie_t> changes;
+    changes.reserve(windows.size());
+    CountRoundTrip();
+    for (size_t i = 0; i < windows.size(); i++)
+    {
+        xcb_generic_error_t* error = nullptr;
+        xcb_get_window_attributes_reply_t* reply = xcb_get_window_attributes_reply(conn, cookies[i], &error);
+        free(error);
+        if (!reply)
+            continue;
+        const uint32_t value = reply->your_event_mask | mask;
+        if (value != reply->your_event_mask)
+            changes.push_back(xcb_change_window_attributes_checked(conn, static_cast<xcb_window_t>(windows[i]), XCB_CW_EVENT_MASK, &value));
+        free(reply);
+    }
+    if (!changes.empty())
+        CountRoundTrip();
+    for (const xcb_void_cookie_t& change : changes)
+        free(xcb_request_check(conn, change));
+}
+
+static std::vector<Window> FetchClientList(const LinuxWindowIndex* index, xcb_connection_t* conn)
+{
+    std::vector<Window> clients;
+    CountRoundTrip();
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(conn,
+        xcb_get_property(conn, 0, static_cast<xcb_window_t>(index->root), g_capture_manager.atoms.net_client_list, XCB_ATOM_WINDOW, 0, 4096), nullptr);
+    if (!reply)
+        return clients;
+    if (reply->format == 32)
+    {
+        const xcb_window_t* ids = static_cast<const xcb_window_t*>(xcb_get_property_value(reply));
+        const int count = xcb_get_property_value_length(reply) / 4;
+        clients.assign(ids, ids + count);
+    }
+    free(reply);
+    return clients;
+}
+
+static bool IndexedWindowMatches(const LinuxIndexedWindow& entry, pid_t pid, const char* titleHint)
+{
+    if (pid > 0 && entry.pid != pid)
+        return false;
+    if (pid <= 0 && (!titleHint || titleHint[0] == '\0'))
+        return false;
+    return TitleMatches(entry.title.c_str(), titleHint);
+}
+
+static void EraseIndexedPid(LinuxWindowIndex* index, pid_t pid, Window window)
+{
+    auto range = index->by_pid.equal_range(pid);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == window)
+        {
+            index->by_pid.erase(it);
+            return;
+        }
+    }
+}
+
+static void EraseIndexedClass(LinuxWindowIndex* index, const std::string& name, Window window)
+{
+    auto range = index->by_class.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == window)
+        {
+            index->by_class.erase(it);
+            return;
+        }
+    }
+}
+
+static void UnlinkIndexedWindowLocked(LinuxWindowIndex* index, Window window, const LinuxIndexedWindow& entry)
+{
+    if (entry.pid > 0)
+        EraseIndexedPid(index, entry.pid, window);
+    if (!entry.wm_instance.empty())
+        EraseIndexedClass(index, entry.wm_instance, window);
+    if (!entry.wm_class.empty() && entry.wm_class != entry.wm_instance)
+        EraseIndexedClass(index, entry.wm_class, window);
+}
+
+static void RemoveIndexedWindowLocked(LinuxWindowIndex* index, Window window)
+{
+    auto it = index->windows.find(window);
+    if (it == index->windows.end())
+        return;
+    UnlinkIndexedWindowLocked(index, window, it->second);
+    index->windows.erase(it);
+}
+
+// Stores fresh properties and queues a callback for every watch the window
+// starts to match.
+static void StoreIndexedWindowLocked(LinuxWindowIndex* index, const LinuxWindowProperties& props)
+{
+    if (!props.exists)
+    {
+        RemoveIndexedWindowLocked(index, props.window);
+        return;
+    }
+
+    std::vector<bool> matched(index->watches.size(), false);
+    auto it = index->windows.find(props.window);
+    if (it != index->windows.end())
+    {
+        for (size_t i = 0; i < index->watches.size(); i++)
+            matched[i] = IndexedWindowMatches(it->second, index->watches[i].pid, index->watches[i].title_hint.c_str());
+        UnlinkIndexedWindowLocked(index, props.window, it->second);
+    }
+    else
+    {
+        it = index->windows.emplace(props.window, LinuxIndexedWindow()).first;
+        it->second.order = index->next_order++;
+    }
+
+    LinuxIndexedWindow& entry = it->second;
+    entry.pid = props.pid;
+    entry.title = props.title;
+    entry.wm_instance = props.wm_instance;
+    entry.wm_class = props.wm_class;
+    if (entry.pid > 0)
+        index->by_pid.emplace(entry.pid, props.window);
+    if (!entry.wm_instance.empty())
+        index->by_class.emplace(entry.wm_instance, props.window);
+    if (!entry.wm_class.empty() && entry.wm_class != entry.wm_instance)
+        index->by_class.emplace(entry.wm_class, props.window);
+
+    for (size_t i = 0; i < index->watches.size(); i++)
+    {
+        const LinuxWindowWatch& watch = index->watches[i];
+        if (!matched[i] && IndexedWindowMatches(entry, watch.pid, watch.title_hint.c_str()))
+            index->pending.push_back(LinuxWindowMatch{ watch.id, props.window, entry.pid });
+    }
+}
+
+// Fetches and stores windows; with track set, every window is kept and
+// selected for events, otherwise only ones that already carry a PID, title
+// or class.
+static void AddIndexedWindowsLocked(LinuxWindowIndex* index, xcb_connection_t* conn, const std::vector<Window>& windows, bool track)
+{
+    if (windows.empty())
+        return;
+
+    // Select before querying on new windows, so a property set in between
+    // still arrives as PropertyNotify.
+    if (track)
+        AddWindowEventMasks(conn, windows, kIndexWindowEvents);
+
+    std::vector<LinuxWindowProperties> props(windows.size());
+    for (size_t i = 0; i < windows.size(); i++)
+        props[i].window = windows[i];
+    FetchWindowProperties(conn, props);
+
+    std::vector<Window> selected;
+    for (const LinuxWindowProperties& p : props)
+    {
+        if (!track && (!p.exists || (p.pid <= 0 && p.title.empty() && p.wm_instance.empty() && p.wm_class.empty())))
+            continue;
+        StoreIndexedWindowLocked(index, p);
+        if (!track && p.exists)
+            selected.push_back(p.window);
+    }
+    if (!selected.empty())
+        AddWindowEventMasks(conn, selected, kIndexWindowEvents);
+}
+
+static void BuildWindowIndexLocked(LinuxWindowIndex* index, Display* display)
+{
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    index->root = DefaultRootWindow(display);
+
+    AddWindowEventMasks(conn, std::vector<Window>(1, index->root), kIndexRootEvents);
+
+    // Managed clients first so they order by mapping age, then whatever else
+    // carries a PID or title anywhere in the tree, one level per round trip.
+    // Clients and top-levels are all tracked, as they are when created later,
+    // so one that only gets its PID or title after this still arrives through
+    // PropertyNotify.
+    AddIndexedWindowsLocked(index, conn, FetchClientList(index, conn), true);
+
+    std::vector<Window> level(1, index->root);
+    bool topLevels = true;
+    while (!level.empty())
+    {
+        std::vector<xcb_query_tree_cookie_t> cookies(level.size());
+        for (size_t i = 0; i < level.size(); i++)
+            cookies[i] = xcb_query_tree(conn, static_cast<xcb_window_t>(level[i]));
+
+        std::vector<Window> next;
+        CountRoundTrip();
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            xcb_query_tree_reply_t* reply = xcb_query_tree_reply(conn, cookies[i], nullptr);
+            if (!reply)
+                continue;
+            const xcb_window_t* children = xcb_query_tree_children(reply);
+            next.insert(next.end(), children, children + xcb_query_tree_children_length(reply));
+            free(reply);
+        }
+
+        std::vector<Window> unknown;
+        for (Window w : next)
+        {
+            if (index->windows.find(w) == index->windows.end())
+                unknown.push_back(w);
+        }
+        AddIndexedWindowsLocked(index, conn, unknown, topLevels);
+        topLevels = false;
+        level.swap(next);
+    }
+
+    index->ready = 1;
+    LogNativeAt(aes_native::LogLevel::Info, "window", "window index built: windows=%zu", index->windows.size());
+}
+
+static bool EnsureWindowIndex(Display* display)
+{
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    if (!display || !index)
+        return false;
+
+    pthread_mutex_lock(&index->mutex);
+    if (!index->ready)
+        BuildWindowIndexLocked(index, display);
+    pthread_mutex_unlock(&index->mutex);
+    return true;
+}
+
+// Applies a batch of scheduler events. Runs on the scheduler thread; the
+// round trips for new windows happen only when windows appear.
+static void UpdateWindowIndex(Display* display, const XEvent* events, int count)
+{
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    if (!index || count == 0)
+        return;
+
+    pthread_mutex_lock(&index->mutex);
+    if (!index->ready)
+    {
+        pthread_mutex_unlock(&index->mutex);
+        return;
+    }
+
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    const LinuxAtoms& atoms = g_capture_manager.atoms;
+    std::vector<Window> created;
+    std::vector<Window> changed;
+    bool clientListChanged = false;
+    for (int i = 0; i < count; i++)
+    {
+        const XEvent& ev = events[i];
+        if (ev.type == CreateNotify && ev.xcreatewindow.parent == index->root && !ev.xcreatewindow.override_redirect)
+            created.push_back(ev.xcreatewindow.window);
+        else if (ev.type == DestroyNotify)
+            RemoveIndexedWindowLocked(index, ev.xdestroywindow.window);
+        else if (ev.type == PropertyNotify)
+        {
+            const Atom atom = ev.xproperty.atom;
+            if (ev.xproperty.window == index->root)
+                clientListChanged = clientListChanged || atom == atoms.net_client_list;
+            else if ((atom == atoms.net_wm_pid || atom == atoms.net_wm_name || atom == XA_WM_NAME || atom == XA_WM_CLASS) &&
+                     index->windows.find(ev.xproperty.window) != index->windows.end() &&
+                     std::find(changed.begin(), changed.end(), ev.xproperty.window) == changed.end())
+                changed.push_back(ev.xproperty.window);
+        }
+    }
+
+    if (clientListChanged)
+    {
+        // Clients created below another parent only show up here.
+        for (Window w : FetchClientList(index, conn))
+        {
+            if (index->windows.find(w) == index->windows.end() &&
+                std::find(created.begin(), created.end(), w) == created.end())
+                created.push_back(w);
+        }
+    }
+
+    AddIndexedWindowsLocked(index, conn, created, true);
+    if (!changed.empty())
+    {
+        std::vector<LinuxWindowProperties> props(changed.size());
+        for (size_t i = 0; i < changed.size(); i++)
+            props[i].window = changed[i];
+        FetchWindowProperties(conn, props);
+        for (const LinuxWindowProperties& p : props)
+            StoreIndexedWindowLocked(index, p);
+    }
+    pthread_mutex_unlock(&index->mutex);
+}
+
+// Forgets everything when the connection closes; windows and atoms belong to
+// it.
+static void ResetWindowIndex()
+{
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    index->ready = 0;
+    index->windows.clear();
+    index->by_pid.clear();
+    index->by_class.clear();
+    index->pending.clear();
+    pthread_mutex_unlock(&index->mutex);
+}
+
+// Oldest indexed window for pid (any when pid <= 0) whose title contains
+// titleHint (any when empty).
+static Window LookupIndexedWindowLocked(const LinuxWindowIndex* index, pid_t pid, const char* titleHint)
+{
+    Window best = 0;
+    uint64_t bestOrder = UINT64_MAX;
+    auto consider = [&](Window w, const LinuxIndexedWindow& entry) {
+        if (entry.order < bestOrder && IndexedWindowMatches(entry, pid, titleHint))
+        {
+            best = w;
+            bestOrder = entry.order;
+        }
+    };
+
+    if (pid > 0)
+    {
+        auto range = index->by_pid.equal_range(pid);
+        for (auto it = range.first; it != range.second; ++it)
+            consider(it->second, index->windows.at(it->second));
+    }
+    else
+    {
+        for (const auto& item : index->windows)
+            consider(item.first, item.second);
+    }
+    return best;
+}
+
+// Same order of preference as ResolveTargetWindow's tree walks: PID and
+// title, then PID, then title. False when the index could not be built; once
+// it is, a miss is authoritative.
+static bool FindIndexedWindow(Display* display, pid_t pid, const char* titleHint, Window* found)
+{
+    if (!EnsureWindowIndex(display))
+        return false;
+
+    const bool hasHint = titleHint && titleHint[0] != '\0';
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    if (!index->ready)
+    {
+        pthread_mutex_unlock(&index->mutex);
+        return false;
+    }
+    Window target = 0;
+    if (pid > 0 && hasHint)
+        target = LookupIndexedWindowLocked(index, pid, titleHint);
+    if (target == 0 && pid > 0)
+        target = LookupIndexedWindowLocked(index, pid, nullptr);
+    if (target == 0 && hasHint)
+        target = LookupIndexedWindowLocked(index, 0, titleHint);
+    pthread_mutex_unlock(&index->mutex);
+
+    *found = target;
+    return true;
+}
+
+// Index order of window, 0 when it is not indexed.
+static uint64_t IndexedWindowOrder(Window window)
+{
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    uint64_t order = 0;
+    if (index->ready)
+    {
+        auto it = index->windows.find(window);
+        if (it != index->windows.end())
+            order = it->second.order;
+    }
+    pthread_mutex_unlock(&index->mutex);
+    return order;
+}
+
+// WM_CLASS of an indexed window, empty when it is not indexed or has none.
+static std::string IndexedWindowClass(Window window)
+{
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    std::string wmClass;
+    auto it = index->windows.find(window);
+    if (index->ready && it != index->windows.end())
+        wmClass = it->second.wm_class;
+    pthread_mutex_unlock(&index->mutex);
+    return wmClass;
+}
+
+typedef struct
+{
+    Window window;
+    uint64_t order;
+    bool titled;
+} LinuxReplacementCandidate;
+
+// Windows indexed after afterOrder that could replace a lost target: those
+// of pid (matching titleHint when pid <= 0) whose title matches titleHint
+// or whose class is wmClass, title matches first, newest first within each
+// group. A dialog of the same client matches neither.
+static std::vector<LinuxReplacementCandidate> FindReplacementCandidates(pid_t pid, const char* titleHint, const char* wmClass,
+                                                                        uint64_t afterOrder, Window exclude)
+{
+    std::vector<LinuxReplacementCandidate> candidates;
+    const bool hasHint = titleHint && titleHint[0] != '\0';
+    const bool hasClass = wmClass && wmClass[0] != '\0';
+
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    auto consider = [&](Window w, const LinuxIndexedWindow& entry) {
+        if (w == exclude || entry.order <= afterOrder)
+            return;
+        const bool titled = hasHint && IndexedWindowMatches(entry, pid, titleHint);
+        const bool sameClass = hasClass && pid > 0 && entry.pid == pid && entry.wm_class == wmClass;
+        if (titled || sameClass)
+            candidates.push_back({ w, entry.order, titled });
+    };
+    if (index->ready && pid > 0)
+    {
+        auto range = index->by_pid.equal_range(pid);
+        for (auto it = range.first; it != range.second; ++it)
+            consider(it->second, index->windows.at(it->second));
+    }
+    else if (index->ready && hasHint)
+    {
+        for (const auto& item : index->windows)
+            consider(item.first, item.second);
+    }
+    pthread_mutex_unlock(&index->mutex);
+
+    std::sort(candidates.begin(), candidates.end(), [](const LinuxReplacementCandidate& a, const LinuxReplacementCandidate& b) {
+        return a.titled != b.titled ? a.titled : a.order > b.order;
+    });
+    return candidates;
+}
+
+// Runs the callbacks queued by index updates and new watches. Called by the
+// scheduler without the manager lock, so callbacks may use any export.
+static void DeliverWindowWatches()
+{
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->delivery_mutex);
+    for (;;)
+    {
+        pthread_mutex_lock(&index->mutex);
+        if (index->pending.empty())
+        {
+            pthread_mutex_unlock(&index->mutex);
+            break;
+        }
+        const LinuxWindowMatch match = index->pending.front();
+        index->pending.erase(index->pending.begin());
+        LinuxWindowWatchCallback callback = nullptr;
+        void* userData = nullptr;
+        for (const LinuxWindowWatch& watch : index->watches)
+        {
+            if (watch.id == match.watch_id)
+            {
+                callback = watch.callback;
+                userData = watch.user_data;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&index->mutex);
+
+        if (callback)
+            callback(match.watch_id, reinterpret_cast<void*>(match.window), static_cast<int>(match.pid), userData);
+    }
+    pthread_mutex_unlock(&index->delivery_mutex);
+}
+
+static bool LoadTextFile(const char* path, char** outText)
+{
+    if (!outText)
+        return false;
+
+    *outText = nullptr;
+    if (!path || path[0] == '\0')
+        return false;
+
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    if (fseek(f, 0, SEEK_END) != 0)
+    {
+        fclose(f);
+        return false;
+    }
+
+    long len = ftell(f);
+    if (len <= 0)
+    {
+        fclose(f);
+        return false;
+    }
+
+    rewind(f);
+    char* buf = static_cast<char*>(malloc(static_cast<size_t>(len) + 1));
     if (!buf)
     {
         fclose(f);
@@ -696,7 +2095,7 @@ static GLuint CompileShader(GLenum type, const char* source)
     return 0;
 }
 
-static GLuint BuildShaderProgram(const char* fragmentSource)
+static GLuint BuildShaderProgram(const char* fragmentSource, bool* usedDefaultFragment)
 {
     const char* vertexSource =
         "#version 120\n"
@@ -725,6 +2124,7 @@ static GLuint BuildShaderProgram(const char* fragmentSource)
         "}\n";
 
     const char* frag = fragmentSource && fragmentSource[0] != '\0' ? fragmentSource : defaultFragment;
+    bool usingDefault = frag == defaultFragment;
 
     GLuint vs = CompileShader(GL_VERTEX_SHADER, vertexSource);
     if (!vs)
@@ -735,7 +2135,10 @@ static GLuint BuildShaderProgram(const char* fragmentSource)
     {
         glDeleteShader(vs);
         if (frag != defaultFragment)
+        {
             fs = CompileShader(GL_FRAGMENT_SHADER, defaultFragment);
+            usingDefault = true;
+        }
 
         if (!fs)
             return 0;
@@ -756,6 +2159,12 @@ static GLuint BuildShaderProgram(const char* fragmentSource)
         return 0;
     }
 
+    // The default shader only looks at the texel under each pixel, which is
+    // what lets a frame redraw just its damaged rect. Custom shaders may sample
+    // neighbours or vary over time, so they always get a full redraw.
+    if (usedDefaultFragment)
+        *usedDefaultFragment = usingDefault;
+
     glAttachShader(program, vs);
     glAttachShader(program, fs);
     glLinkProgram(program);
@@ -786,7 +2195,8 @@ static bool EnsureShaderProgram(LinuxCapture* cap)
     char* customFragment = nullptr;
     LoadTextFile(cap->shader_path, &customFragment);
 
-    GLuint program = BuildShaderProgram(customFragment);
+    bool pointwise = false;
+    GLuint program = BuildShaderProgram(customFragment, &pointwise);
     if (customFragment)
         free(customFragment);
 
@@ -800,6 +2210,7 @@ static bool EnsureShaderProgram(LinuxCapture* cap)
         glDeleteProgram(cap->shader_program);
 
     cap->shader_program = program;
+    cap->shader_pointwise = pointwise ? 1 : 0;
     cap->shader_u_tex = glGetUniformLocation(program, "uTex");
     cap->shader_u_brightness = glGetUniformLocation(program, "uBrightness");
     cap->shader_u_saturation = glGetUniformLocation(program, "uSaturation");
@@ -810,6 +2221,26 @@ static bool EnsureShaderProgram(LinuxCapture* cap)
     return true;
 }
 
+// Drops one reference to source, unredirecting its window with the last.
+static void ReleaseCaptureSource(LinuxCapture* cap, LinuxCaptureSource* source)
+{
+    if (!source)
+        return;
+
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.sources_mutex);
+    if (--source->refs == 0)
+    {
+        glXDestroyPixmap(cap->display, source->glx_pixmap);
+        XFreePixmap(cap->display, source->pixmap);
+        if (!source->destroyed)
+            XCompositeUnredirectWindow(cap->display, source->target, CompositeRedirectAutomatic);
+        LogNative("composite source released: target=0x%lx", source->target);
+        memset(source, 0, sizeof(*source));
+    }
+    pthread_mutex_unlock(&manager.sources_mutex);
+}
+
 static void DestroyCompositeResources(LinuxCapture* cap)
 {
     if (!cap || !cap->display)
@@ -818,22 +2249,88 @@ static void DestroyCompositeResources(LinuxCapture* cap)
     if (cap->glx_context)
         glXMakeCurrent(cap->display, None, nullptr);
 
-    if (cap->glx_pixmap)
+    LinuxCaptureSource* source = cap->source;
+    cap->source = nullptr;
+    cap->glx_pixmap = 0;
+    cap->composite_pixmap = 0;
+    ReleaseCaptureSource(cap, source);
+}
+
+// Returns the shared source for target, redirecting and naming it if no
+// other session captures it yet.
+static LinuxCaptureSource* AcquireCaptureSource(LinuxCapture* cap, Window target)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.sources_mutex);
+
+    LinuxCaptureSource* slot = nullptr;
+    for (LinuxCaptureSource& source : manager.sources)
     {
-        glXDestroyPixmap(cap->display, cap->glx_pixmap);
-        cap->glx_pixmap = 0;
+        if (source.refs > 0 && source.target == target && !source.destroyed)
+        {
+            source.refs++;
+            pthread_mutex_unlock(&manager.sources_mutex);
+            LogNative("composite source shared: target=0x%lx refs=%d", target, source.refs);
+            return &source;
+        }
+        if (source.refs == 0 && !slot)
+            slot = &source;
     }
 
-    if (cap->composite_pixmap)
+    // A session holds one source, two while handing off, so a slot is
+    // always free.
+    if (!slot)
     {
-        XFreePixmap(cap->display, cap->composite_pixmap);
-        cap->composite_pixmap = 0;
+        SetBackendDetail(cap, "No free composite source slot");
+        pthread_mutex_unlock(&manager.sources_mutex);
+        return nullptr;
     }
 
-    if (cap->target != 0)
+    XCompositeRedirectWindow(cap->display, target, CompositeRedirectAutomatic);
+    XSync(cap->display, False);
+
+    slot->pixmap = XCompositeNameWindowPixmap(cap->display, target);
+    if (slot->pixmap == 0)
+    {
+        SetBackendDetail(cap, "XCompositeNameWindowPixmap failed");
+        XCompositeUnredirectWindow(cap->display, target, CompositeRedirectAutomatic);
+        pthread_mutex_unlock(&manager.sources_mutex);
+        return nullptr;
+    }
+
+    int attrsRgba[] = {
+        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+        GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGBA_EXT,
+        None
+    };
+    int attrsRgb[] = {
+        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
+        GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGB_EXT,
+        None
+    };
+
+    slot->glx_pixmap = glXCreatePixmap(cap->display, cap->fb_config, slot->pixmap, attrsRgba);
+    slot->rgba = slot->glx_pixmap != 0 ? 1 : 0;
+    if (slot->glx_pixmap == 0)
+    {
+        LogNative("glXCreatePixmap RGBA failed for target=0x%lx, retrying RGB", target);
+        slot->glx_pixmap = glXCreatePixmap(cap->display, cap->fb_config, slot->pixmap, attrsRgb);
+    }
+
+    if (slot->glx_pixmap == 0)
     {
-        XCompositeUnredirectWindow(cap->display, cap->target, CompositeRedirectAutomatic);
+        SetBackendDetail(cap, "glXCreatePixmap failed (RGBA/RGB unsupported by target visual)");
+        XFreePixmap(cap->display, slot->pixmap);
+        XCompositeUnredirectWindow(cap->display, target, CompositeRedirectAutomatic);
+        memset(slot, 0, sizeof(*slot));
+        pthread_mutex_unlock(&manager.sources_mutex);
+        return nullptr;
     }
+
+    slot->target = target;
+    slot->refs = 1;
+    pthread_mutex_unlock(&manager.sources_mutex);
+    return slot;
 }
 
 static void HideTargetOffscreenIfRequested(LinuxCapture* cap)
@@ -881,12 +2378,19 @@ static void RestoreTargetFromOffscreenIfNeeded(LinuxCapture* cap)
         return;
 
     Window restoreWindow = cap->hidden_window;
-    if (restoreWindow == 0 && cap->target != 0)
+    if (restoreWindow == 0 && cap->target != 0 && !cap->target_destroyed)
         restoreWindow = GetTopLevelWindow(cap->display, cap->target);
+    // The frame of a destroyed target goes away with it, or soon after.
+    if (cap->target_destroyed && !WindowExists(cap->display, restoreWindow))
+        restoreWindow = 0;
     if (restoreWindow == 0)
     {
         cap->target_hidden_offscreen = 0;
         cap->target_saved_geometry_valid = 0;
+        cap->target_saved_opacity_valid = 0;
+        cap->target_skip_taskbar_applied = 0;
+        cap->target_input_passthrough_applied = 0;
+        cap->hidden_window = 0;
         return;
     }
 
@@ -975,41 +2479,15 @@ static bool SetupCompositeTarget(LinuxCapture* cap, Window target)
 
     DestroyCompositeResources(cap);
 
-    XCompositeRedirectWindow(cap->display, target, CompositeRedirectAutomatic);
-    XSync(cap->display, False);
-    XSelectInput(cap->display, target, StructureNotifyMask);
-
-    cap->composite_pixmap = XCompositeNameWindowPixmap(cap->display, target);
-    if (cap->composite_pixmap == 0)
-    {
-        SetBackendDetail(cap, "XCompositeNameWindowPixmap failed");
+    LinuxCaptureSource* source = AcquireCaptureSource(cap, target);
+    if (!source)
         return false;
-    }
+    AddWindowEventMasks(XGetXCBConnection(cap->display), std::vector<Window>(1, target), XCB_EVENT_MASK_STRUCTURE_NOTIFY);
 
-    int attrsRgba[] = {
-        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
-        GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGBA_EXT,
-        None
-    };
-    int attrsRgb[] = {
-        GLX_TEXTURE_TARGET_EXT, GLX_TEXTURE_2D_EXT,
-        GLX_TEXTURE_FORMAT_EXT, GLX_TEXTURE_FORMAT_RGB_EXT,
-        None
-    };
-
-    cap->glx_pixmap = glXCreatePixmap(cap->display, cap->fb_config, cap->composite_pixmap, attrsRgba);
-    if (cap->glx_pixmap == 0)
-    {
-        LogNative("glXCreatePixmap RGBA failed for target=0x%lx, retrying RGB", target);
-        cap->glx_pixmap = glXCreatePixmap(cap->display, cap->fb_config, cap->composite_pixmap, attrsRgb);
-    }
-
-    if (cap->glx_pixmap == 0)
-    {
-        SetBackendDetail(cap, "glXCreatePixmap failed (RGBA/RGB unsupported by target visual)");
-        DestroyCompositeResources(cap);
-        return false;
-    }
+    cap->source = source;
+    cap->composite_pixmap = source->pixmap;
+    cap->glx_pixmap = source->glx_pixmap;
+    cap->glx_pixmap_rgba = source->rgba;
 
     cap->target = target;
     cap->backend_mode = BackendGpuComposite;
@@ -1030,165 +2508,219 @@ static bool SetupCompositeTarget(LinuxCapture* cap, Window target)
     return true;
 }
 
-static void SetSwapInterval(LinuxCapture* cap, int disableVsync)
+static void SetWindowVariableRefresh(Display* display, Window window, bool enabled)
 {
-    if (!cap || !cap->display)
+    if (!display || window == 0)
         return;
 
-    // Prefer stable VSync=1 over adaptive -1 to avoid half-rate fallback jitter.
-    int interval = disableVsync ? 0 : 1;
-    if (cap->applied_disable_vsync == disableVsync)
+    const Atom vrrAtom = g_capture_manager.atoms.variable_refresh;
+    if (vrrAtom == None)
         return;
 
-    if (cap->glx_swap_interval_ext)
-    {
-        cap->glx_swap_interval_ext(cap->display, cap->window, interval);
-    }
-    else if (cap->glx_swap_interval_mesa)
+    if (enabled)
     {
-        const int res = cap->glx_swap_interval_mesa(interval);
-        if (res != 0 && interval < 0)
-            cap->glx_swap_interval_mesa(1);
+        unsigned long value = 1;
+        XChangeProperty(display, window, vrrAtom, XA_CARDINAL, 32, PropModeReplace, reinterpret_cast<unsigned char*>(&value), 1);
     }
-    else if (cap->glx_swap_interval_sgi && interval > 0)
+    else
     {
-        cap->glx_swap_interval_sgi(interval);
+        XDeleteProperty(display, window, vrrAtom);
     }
-
-    cap->applied_disable_vsync = disableVsync;
 }
 
-static void RenderCompositeFrame(LinuxCapture* cap)
+static void ApplyVrrStateLocked(LinuxCapture* cap)
 {
-    if (!cap || !cap->display || cap->backend_mode != BackendGpuComposite || cap->target == 0)
+    if (!cap || !cap->display || cap->init_pending || cap->window == 0)
         return;
 
-    if (!cap->glx_bind_tex_image_ext || !cap->glx_release_tex_image_ext)
+    const int wantActive = cap->vrr_enabled && cap->gl_supported ? 1 : 0;
+    const Window topLevel = cap->host_toplevel != 0 ? cap->host_toplevel : cap->window;
+    if (wantActive == cap->vrr_active && (!wantActive || (cap->vrr_window == cap->window && cap->vrr_toplevel == topLevel)))
         return;
 
-    if (glXMakeCurrent(cap->display, cap->window, cap->glx_context) != True)
-        return;
+    // Drivers look at the property on the flipped window, which is the
+    // top-level once the compositor unredirects it, so mark both.
+    if (cap->vrr_window != 0)
+        SetWindowVariableRefresh(cap->display, cap->vrr_window, false);
+    if (cap->vrr_toplevel != 0 && cap->vrr_toplevel != cap->vrr_window)
+        SetWindowVariableRefresh(cap->display, cap->vrr_toplevel, false);
+    cap->vrr_window = 0;
+    cap->vrr_toplevel = 0;
 
-    if (!EnsureShaderProgram(cap))
-        return;
+    if (wantActive)
+    {
+        SetWindowVariableRefresh(cap->display, cap->window, true);
+        if (topLevel != cap->window)
+            SetWindowVariableRefresh(cap->display, topLevel, true);
+        cap->vrr_window = cap->window;
+        cap->vrr_toplevel = topLevel;
+    }
 
-    SetSwapInterval(cap, cap->disable_vsync);
+    XFlush(cap->display);
+    cap->vrr_active = wantActive;
+    LogNative("VRR %s (tear=%d)", wantActive ? "enabled" : "disabled", cap->has_swap_control_tear);
+}
 
-    if (cap->host_geometry_dirty || cap->cached_host_w <= 0 || cap->cached_host_h <= 0)
+// Joins the claim on topLevel, or starts one: saves the host's own value and
+// sets bypass.
+static void ClaimCompositorBypass(LinuxCapture* cap, Window topLevel)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    const Atom bypassAtom = manager.atoms.net_wm_bypass_compositor;
+    pthread_mutex_lock(&manager.sources_mutex);
+    LinuxBypassClaim* freeClaim = nullptr;
+    for (LinuxBypassClaim& claim : manager.bypass_claims)
     {
-        XWindowAttributes hostAttr{};
-        if (XGetWindowAttributes(cap->display, cap->window, &hostAttr) == 0)
+        if (claim.refs > 0 && claim.toplevel == topLevel)
+        {
+            claim.refs++;
+            pthread_mutex_unlock(&manager.sources_mutex);
+            cap->bypass_toplevel = topLevel;
             return;
-
-        cap->cached_host_w = std::max(1, hostAttr.width);
-        cap->cached_host_h = std::max(1, hostAttr.height);
-        cap->host_geometry_dirty = 0;
+        }
+        if (claim.refs == 0 && !freeClaim)
+            freeClaim = &claim;
     }
-
-    if (cap->target_geometry_dirty || cap->cached_target_w <= 0 || cap->cached_target_h <= 0)
+    if (!freeClaim)
     {
-        XWindowAttributes targetAttr{};
-        if (XGetWindowAttributes(cap->display, cap->target, &targetAttr) == 0)
-            return;
+        pthread_mutex_unlock(&manager.sources_mutex);
+        return;
+    }
 
-        cap->cached_target_w = std::max(1, targetAttr.width);
-        cap->cached_target_h = std::max(1, targetAttr.height);
-        cap->target_viewable = targetAttr.map_state == IsViewable ? 1 : 0;
-        cap->target_geometry_dirty = 0;
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    const xcb_get_property_cookie_t cookie =
+        xcb_get_property(conn, 0, static_cast<xcb_window_t>(topLevel), bypassAtom, XCB_ATOM_CARDINAL, 0, 1);
+    CountRoundTrip();
+    xcb_get_property_reply_t* reply = xcb_get_property_reply(conn, cookie, nullptr);
+    freeClaim->saved_valid = 0;
+    if (reply && reply->format == 32 && xcb_get_property_value_length(reply) >= 4)
+    {
+        freeClaim->saved_value = *static_cast<const uint32_t*>(xcb_get_property_value(reply));
+        freeClaim->saved_valid = 1;
     }
+    free(reply);
+
+    unsigned long value = 1;
+    XChangeProperty(cap->display, topLevel, bypassAtom, XA_CARDINAL, 32, PropModeReplace,
+                    reinterpret_cast<unsigned char*>(&value), 1);
+    freeClaim->toplevel = topLevel;
+    freeClaim->refs = 1;
+    pthread_mutex_unlock(&manager.sources_mutex);
+    cap->bypass_toplevel = topLevel;
+}
 
-    if (!cap->target_viewable && cap->hide_target)
+static void RestoreCompositorBypass(LinuxCapture* cap)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    const Atom bypassAtom = manager.atoms.net_wm_bypass_compositor;
+    if (cap->bypass_toplevel == 0 || bypassAtom == None)
+        return;
+
+    pthread_mutex_lock(&manager.sources_mutex);
+    for (LinuxBypassClaim& claim : manager.bypass_claims)
     {
-        Window restoreWindow = cap->hidden_window ? cap->hidden_window : cap->target;
-        XMapRaised(cap->display, restoreWindow);
-        if (cap->target_hidden_offscreen)
+        if (claim.refs == 0 || claim.toplevel != cap->bypass_toplevel || --claim.refs > 0)
+            continue;
+
+        if (claim.saved_valid)
         {
-            const unsigned long fullyTransparent = 0x00000000UL;
-            SetWindowOpacity(cap->display, restoreWindow, fullyTransparent);
-            if (cap->target_skip_taskbar_applied)
-                SetWindowSkipTaskbar(cap->display, restoreWindow, true);
+            unsigned long value = claim.saved_value;
+            XChangeProperty(cap->display, claim.toplevel, bypassAtom, XA_CARDINAL, 32, PropModeReplace,
+                            reinterpret_cast<unsigned char*>(&value), 1);
         }
-        XFlush(cap->display);
+        else
+        {
+            XDeleteProperty(cap->display, claim.toplevel, bypassAtom);
+        }
+        claim.toplevel = 0;
     }
+    pthread_mutex_unlock(&manager.sources_mutex);
+    cap->bypass_toplevel = 0;
+}
 
-    int hostW = std::max(1, cap->cached_host_w);
-    int hostH = std::max(1, cap->cached_host_h);
+// While the host covers its whole output, _NET_WM_BYPASS_COMPOSITOR asks the
+// window manager to unredirect it, so our swaps reach the output without a
+// compositor copy (and can flip when the GL window covers the output too).
+// Sessions sharing a top-level share the property through a claim, and a
+// value the host had set itself is put back once the last of them is done.
+static void ApplyCompositorBypassLocked(LinuxCapture* cap)
+{
+    if (!cap || !cap->display || cap->init_pending || cap->window == 0)
+        return;
+
+    const Atom bypassAtom = g_capture_manager.atoms.net_wm_bypass_compositor;
+    const Window topLevel = cap->host_toplevel != 0 ? cap->host_toplevel : cap->window;
+    const int wantActive = cap->compositor_bypass_enabled && cap->host_covers_output && cap->active &&
+                           cap->gl_supported && !cap->headless && bypassAtom != None ? 1 : 0;
+    if (wantActive == cap->compositor_bypass_active && (!wantActive || cap->bypass_toplevel == topLevel))
+        return;
 
-    int srcW = std::max(1, cap->cached_target_w - cap->crop[0] - cap->crop[2]);
-    int srcH = std::max(1, cap->cached_target_h - cap->crop[1] - cap->crop[3]);
+    RestoreCompositorBypass(cap);
+
+    if (wantActive)
+        ClaimCompositorBypass(cap, topLevel);
+
+    XFlush(cap->display);
+    if (wantActive != cap->compositor_bypass_active)
+        cap->bypass_transitions++;
+    cap->compositor_bypass_active = wantActive;
+
+    // Unredirecting swaps the window's buffers for scanout ones (and back), so
+    // the redraw history no longer describes them.
+    cap->render_dirty_full = 1;
+    cap->redraw_history_count = 0;
+    LogNative("compositor bypass %s (toplevel=0x%lx)", wantActive ? "enabled" : "disabled", topLevel);
+}
 
-    float u0 = static_cast<float>(std::max(0, cap->crop[0])) / static_cast<float>(std::max(1, cap->cached_target_w));
-    float v0 = static_cast<float>(std::max(0, cap->crop[1])) / static_cast<float>(std::max(1, cap->cached_target_h));
-    float u1 = 1.0f - static_cast<float>(std::max(0, cap->crop[2])) / static_cast<float>(std::max(1, cap->cached_target_w));
-    float v1 = 1.0f - static_cast<float>(std::max(0, cap->crop[3])) / static_cast<float>(std::max(1, cap->cached_target_h));
+static int DesiredSwapInterval(LinuxCapture* cap)
+{
+    if (!cap)
+        return 1;
 
-    u0 = std::clamp(u0, 0.0f, 1.0f);
-    v0 = std::clamp(v0, 0.0f, 1.0f);
-    u1 = std::clamp(u1, 0.0f, 1.0f);
-    v1 = std::clamp(v1, 0.0f, 1.0f);
+    // DisableVSync wins over VRR. Otherwise prefer stable VSync=1 over
+    // adaptive -1 to avoid half-rate fallback jitter outside VRR; in VRR mode
+    // the display follows our presents, so late frames should tear instead
+    // of waiting a whole refresh.
+    if (cap->disable_vsync)
+        return 0;
+    if (cap->vrr_active && cap->has_swap_control_tear)
+        return -1;
+    return 1;
+}
 
-    int vpX = 0;
-    int vpY = 0;
-    int vpW = hostW;
-    int vpH = hostH;
+static void SetSwapInterval(LinuxCapture* cap, int interval)
+{
+    if (!cap || !cap->display)
+        return;
 
-    const double srcAspect = static_cast<double>(srcW) / static_cast<double>(srcH);
-    const double dstAspect = static_cast<double>(hostW) / static_cast<double>(hostH);
+    if (cap->applied_swap_interval == interval)
+        return;
 
-    if (cap->stretch == 0) // None (pixel-size where possible, centered)
+    if (cap->glx_swap_interval_ext)
     {
-        vpW = std::min(hostW, srcW);
-        vpH = std::min(hostH, srcH);
-        vpX = (hostW - vpW) / 2;
-        vpY = (hostH - vpH) / 2;
+        cap->glx_swap_interval_ext(cap->display, cap->window, interval);
     }
-    else if (cap->stretch == 2) // Uniform
+    else if (cap->glx_swap_interval_mesa)
     {
-        if (srcAspect > dstAspect)
-        {
-            vpW = hostW;
-            vpH = std::max(1, static_cast<int>(hostW / srcAspect));
-        }
-        else
-        {
-            vpH = hostH;
-            vpW = std::max(1, static_cast<int>(hostH * srcAspect));
-        }
-        vpX = (hostW - vpW) / 2;
-        vpY = (hostH - vpH) / 2;
+        const int res = cap->glx_swap_interval_mesa(interval);
+        if (res != 0 && interval < 0)
+            cap->glx_swap_interval_mesa(1);
     }
-    else if (cap->stretch == 3) // UniformToFill (center crop)
+    else if (cap->glx_swap_interval_sgi && interval > 0)
     {
-        if (srcAspect > dstAspect)
-        {
-            const double desiredSrcW = static_cast<double>(srcH) * dstAspect;
-            const double trim = std::max(0.0, (static_cast<double>(srcW) - desiredSrcW) * 0.5);
-            const float du = static_cast<float>(trim / static_cast<double>(std::max(1, cap->cached_target_w)));
-            u0 += du;
-            u1 -= du;
-        }
-        else
-        {
-            const double desiredSrcH = static_cast<double>(srcW) / dstAspect;
-            const double trim = std::max(0.0, (static_cast<double>(srcH) - desiredSrcH) * 0.5);
-            const float dv = static_cast<float>(trim / static_cast<double>(std::max(1, cap->cached_target_h)));
-            v0 += dv;
-            v1 -= dv;
-        }
+        cap->glx_swap_interval_sgi(interval);
     }
 
-    u0 = std::clamp(u0, 0.0f, 1.0f);
-    v0 = std::clamp(v0, 0.0f, 1.0f);
-    u1 = std::clamp(u1, 0.0f, 1.0f);
-    v1 = std::clamp(v1, 0.0f, 1.0f);
-
-    glViewport(vpX, vpY, std::max(1, vpW), std::max(1, vpH));
-    glDisable(GL_DEPTH_TEST);
-    glClearColor(0.f, 0.f, 0.f, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    cap->applied_swap_interval = interval;
+}
 
-    glActiveTexture(GL_TEXTURE0);
+static GLXDrawable RenderDrawable(const LinuxCapture* cap)
+{
+    return cap->headless ? cap->pbuffer : cap->window;
+}
 
+static bool EnsureSourceTexture(LinuxCapture* cap)
+{
     if (!cap->gl_texture)
     {
         glGenTextures(1, &cap->gl_texture);
@@ -1200,10 +2732,15 @@ static void RenderCompositeFrame(LinuxCapture* cap)
             SetBackendDetail(cap, detail);
             SetStatusText(cap, "Capturing degraded: GPU texture allocation failed");
             LogNative("%s", detail);
-            return;
+            return false;
         }
     }
 
+    return true;
+}
+
+static void BindSourcePixmap(LinuxCapture* cap)
+{
     glBindTexture(GL_TEXTURE_2D, cap->gl_texture);
     cap->glx_bind_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT, nullptr);
 
@@ -1215,6 +2752,34 @@ static void RenderCompositeFrame(LinuxCapture* cap)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         cap->texture_params_initialized = 1;
     }
+}
+
+// texW x texH is the size of the texture sampled (the pixmap or the owned
+// copy), which is what uSourceSize gives shaders for texel steps.
+static bool DrawCompositeTexture(LinuxCapture* cap, const LinuxCaptureRenderState& state, const float* uv, int texW, int texH, GLuint ownedTexture)
+{
+    glViewport(state.viewport[0], state.viewport[1], state.viewport[2], state.viewport[3]);
+    glDisable(GL_DEPTH_TEST);
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // An unredirected window is scanned out as is; keep the cleared alpha so
+    // a tint or custom shader cannot leave it translucent.
+    if (cap->compositor_bypass_active)
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_FALSE);
+
+    glActiveTexture(GL_TEXTURE0);
+
+    if (ownedTexture != 0)
+    {
+        glBindTexture(GL_TEXTURE_2D, ownedTexture);
+    }
+    else
+    {
+        if (!EnsureSourceTexture(cap))
+            return false;
+        BindSourcePixmap(cap);
+    }
 
     glUseProgram(cap->shader_program);
 
@@ -1227,252 +2792,2939 @@ static void RenderCompositeFrame(LinuxCapture* cap)
     if (cap->shader_u_tint >= 0)
         glUniform4f(cap->shader_u_tint, cap->tint[0], cap->tint[1], cap->tint[2], cap->tint[3]);
     if (cap->shader_u_source_size >= 0)
-        glUniform2f(cap->shader_u_source_size, static_cast<float>(srcW), static_cast<float>(srcH));
+        glUniform2f(cap->shader_u_source_size, static_cast<float>(texW), static_cast<float>(texH));
     if (cap->shader_u_output_size >= 0)
-        glUniform2f(cap->shader_u_output_size, static_cast<float>(std::max(1, vpW)), static_cast<float>(std::max(1, vpH)));
+        glUniform2f(cap->shader_u_output_size, static_cast<float>(state.viewport[2]), static_cast<float>(state.viewport[3]));
 
     glBegin(GL_TRIANGLE_STRIP);
-    glTexCoord2f(u0, v1); glVertex2f(-1.0f, -1.0f);
-    glTexCoord2f(u1, v1); glVertex2f( 1.0f, -1.0f);
-    glTexCoord2f(u0, v0); glVertex2f(-1.0f,  1.0f);
-    glTexCoord2f(u1, v0); glVertex2f( 1.0f,  1.0f);
+    glTexCoord2f(uv[0], uv[3]); glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(uv[2], uv[3]); glVertex2f( 1.0f, -1.0f);
+    glTexCoord2f(uv[0], uv[1]); glVertex2f(-1.0f,  1.0f);
+    glTexCoord2f(uv[2], uv[1]); glVertex2f( 1.0f,  1.0f);
     glEnd();
 
     glUseProgram(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 
-    cap->glx_release_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT);
-
-    glXSwapBuffers(cap->display, cap->window);
+    if (ownedTexture == 0)
+        cap->glx_release_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT);
 
-    cap->last_render_ns = MonotonicNowNs();
-    SamplePresentMetrics(cap, cap->last_render_ns);
+    return true;
 }
 
-static void PumpXEventsLocked(LinuxCapture* cap)
+static bool HasGlExtension(const char* name)
 {
-    if (!cap || !cap->display)
-        return;
+    const char* ext = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if (!ext || !name)
+        return false;
 
-    int processed = 0;
-    constexpr int maxEventsPerTick = 512;
-    while (XPending(cap->display) > 0 && processed < maxEventsPerTick)
+    const size_t len = strlen(name);
+    for (const char* p = strstr(ext, name); p; p = strstr(p + len, name))
     {
-        XEvent ev{};
-        XNextEvent(cap->display, &ev);
-        processed++;
-
-        if (cap->backend_mode == BackendReparentFallback &&
-            ev.type == ConfigureNotify &&
-            ev.xconfigure.window == cap->window)
-        {
-            UpdateFallbackTargetGeometry(cap);
-            continue;
-        }
+        if ((p == ext || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0'))
+            return true;
+    }
+    return false;
+}
 
-        if (cap->backend_mode == BackendGpuComposite)
-        {
-            if (ev.type == ConfigureNotify && ev.xconfigure.window == cap->window)
-                cap->host_geometry_dirty = 1;
-            else if (ev.type == ConfigureNotify && ev.xconfigure.window == cap->target)
-                cap->target_geometry_dirty = 1;
-            else if (ev.type == MapNotify && ev.xmap.window == cap->target)
-            {
-                cap->target_viewable = 1;
-                cap->target_geometry_dirty = 1;
-            }
-            else if (ev.type == UnmapNotify && ev.xunmap.window == cap->target)
-            {
-                cap->target_viewable = 0;
-                cap->target_geometry_dirty = 1;
-            }
-        }
+static void DetectGlCapabilities(LinuxCapture* cap)
+{
+    if (cap->gl_caps_checked)
+        return;
 
-        if (cap->damage != 0 && cap->damage_event_base >= 0 && ev.type == cap->damage_event_base + XDamageNotify)
-        {
-            XDamageNotifyEvent* damageEv = reinterpret_cast<XDamageNotifyEvent*>(&ev);
-            if (damageEv->damage != cap->damage)
-                continue;
+    int major = 0;
+    int minor = 0;
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    if (version)
+        sscanf(version, "%d.%d", &major, &minor);
+    const int glVersion = major * 10 + minor;
 
-            XDamageSubtract(cap->display, cap->damage, None, None);
+    cap->has_copy_image = (glVersion >= 43 || HasGlExtension("GL_ARB_copy_image")) ? 1 : 0;
+    cap->has_fbo_blit = (glVersion >= 30 || HasGlExtension("GL_ARB_framebuffer_object")) ? 1 : 0;
+    cap->has_sync = (glVersion >= 32 || HasGlExtension("GL_ARB_sync")) ? 1 : 0;
+    cap->gl_caps_checked = 1;
 
-            const uint64_t nowEvent = MonotonicNowNs();
-            if (cap->source_last_event_ns != 0 && nowEvent > cap->source_last_event_ns)
-            {
-                const uint64_t dtNs = nowEvent - cap->source_last_event_ns;
+    LogNative("GL %d.%d caps: copy_image=%d fbo_blit=%d sync=%d buffer_age=%d",
+              major, minor, cap->has_copy_image, cap->has_fbo_blit, cap->has_sync, cap->has_buffer_age);
+}
 
-                // XDamage can emit duplicate notifies for a single source frame.
-                // Ignore deltas that are implausibly short relative to current cadence.
-                double minAcceptedNs = 8000000.0; // 8 ms baseline duplicate filter
-                if (cap->source_frame_time_ms > 0.0)
-                {
-                    const double expectedNs = cap->source_frame_time_ms * 1000000.0;
-                    minAcceptedNs = std::max(5000000.0, expectedNs * 0.55);
-                }
+static bool CanCopySource(const LinuxCapture* cap)
+{
+    return cap->copy_source_enabled && (cap->has_copy_image || cap->has_fbo_blit);
+}
 
-                if (static_cast<double>(dtNs) >= minAcceptedNs)
-                {
-                    const double dt = static_cast<double>(dtNs) / 1000000000.0;
-                    const double instantFps = std::clamp(1.0 / dt, 1.0, 240.0);
-                    const double alpha = dt >= 0.025 ? 0.22 : 0.14;
-                    cap->source_fps = cap->source_fps > 0.0
-                        ? (cap->source_fps * (1.0 - alpha)) + (instantFps * alpha)
-                        : instantFps;
-                    cap->source_frame_time_ms = cap->source_fps > 0.0 ? 1000.0 / cap->source_fps : 0.0;
-                    cap->source_last_event_ns = nowEvent;
-                }
-            }
-            else
-            {
-                cap->source_last_event_ns = nowEvent;
-            }
-            cap->gpu_frame_pending = 1;
-        }
+static void DestroySourceCopyRing(LinuxCapture* cap)
+{
+    for (int i = 0; i < kCopyRingSize; i++)
+    {
+        LinuxCaptureCopySlot& slot = cap->copy_ring[i];
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        if (slot.texture)
+            glDeleteTextures(1, &slot.texture);
+        slot = LinuxCaptureCopySlot{};
     }
+    cap->copy_ring_next = 0;
+
+    if (cap->copy_read_fbo)
+        glDeleteFramebuffers(1, &cap->copy_read_fbo);
+    if (cap->copy_draw_fbo)
+        glDeleteFramebuffers(1, &cap->copy_draw_fbo);
+    cap->copy_read_fbo = 0;
+    cap->copy_draw_fbo = 0;
 }
 
-static void* RenderThreadMain(void* arg)
+static bool BlitSourceToSlot(LinuxCapture* cap, const int* rect, const LinuxCaptureCopySlot& slot)
 {
-    LinuxCapture* cap = static_cast<LinuxCapture*>(arg);
-    if (!cap)
-        return nullptr;
+    if (!cap->copy_read_fbo)
+        glGenFramebuffers(1, &cap->copy_read_fbo);
+    if (!cap->copy_draw_fbo)
+        glGenFramebuffers(1, &cap->copy_draw_fbo);
+    if (!cap->copy_read_fbo || !cap->copy_draw_fbo)
+        return false;
 
-    while (!cap->stop_render_thread)
-    {
-        pthread_mutex_lock(&cap->mutex);
-        PumpXEventsLocked(cap);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, cap->copy_read_fbo);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, cap->gl_texture, 0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cap->copy_draw_fbo);
+    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, slot.texture, 0);
 
-        bool shouldRender = cap->active && cap->backend_mode == BackendGpuComposite && cap->target != 0;
-        bool disableVsync = cap->disable_vsync != 0;
-        bool hasSwapControl = cap->has_swap_control != 0;
-        bool pendingFrame = cap->gpu_frame_pending != 0;
+    const bool complete = glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE &&
+                          glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete)
+        glBlitFramebuffer(rect[0], rect[1], rect[2], rect[3], 0, 0, slot.width, slot.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
 
-        const uint64_t now = MonotonicNowNs();
-        if (cap->source_last_event_ns != 0)
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+// Copies the shown part of the window pixmap into a texture we own and
+// releases the pixmap straight away, so the X server and emulator are not
+// held up by our shader pass. Returns the slot index or -1 to draw from the
+// pixmap directly.
+static int CopySourceToRing(LinuxCapture* cap, const int* rect)
+{
+    const int w = rect[2] - rect[0];
+    const int h = rect[3] - rect[1];
+    if (w <= 0 || h <= 0 || !EnsureSourceTexture(cap))
+        return -1;
+
+    // The draw that last sampled a slot has to finish before we overwrite
+    // it. Waiting would hold up every session on the scheduler thread, so a
+    // busy slot is skipped for the next one, and only a ring that is busy
+    // throughout sends this frame through the pixmap.
+    int index = -1;
+    for (int i = 0; i < kCopyRingSize && index < 0; i++)
+    {
+        const int candidate = (cap->copy_ring_next + i) % kCopyRingSize;
+        LinuxCaptureCopySlot& busy = cap->copy_ring[candidate];
+        if (busy.fence)
         {
-            const double elapsed = static_cast<double>(now - cap->source_last_event_ns) / 1000000000.0;
-            if (elapsed >= 0.05)
+            if (glClientWaitSync(busy.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
             {
-                cap->source_fps *= 0.94;
-                if (cap->source_fps < 0.1)
-                    cap->source_fps = 0.0;
-                cap->source_frame_time_ms = cap->source_fps > 0.0 ? 1000.0 / cap->source_fps : 0.0;
-                cap->source_last_event_ns = now;
+                cap->copy_fence_waits++;
+                continue;
             }
+            glDeleteSync(busy.fence);
+            busy.fence = nullptr;
         }
+        index = candidate;
+    }
+    if (index < 0)
+        return -1;
 
-        cap->fps = StabilizeReportedFps(cap->source_fps);
-        cap->frame_time_ms = cap->fps > 0.0 ? 1000.0 / cap->fps : 0.0;
+    LinuxCaptureCopySlot& slot = cap->copy_ring[index];
 
-        // Keep periodic presents for compositor pacing.
-        // Do not fall back to 33ms pacing while active: that feels like forced 30fps.
-        const uint64_t periodicNs = disableVsync ? 8333333ULL : 16666666ULL;
-        bool forcePeriodic = shouldRender && cap->source_fps > 0.0 && (cap->last_render_ns == 0 || (now - cap->last_render_ns) > periodicNs);
-        bool renderNow = shouldRender && (pendingFrame || forcePeriodic);
-        if (renderNow)
-            cap->gpu_frame_pending = 0;
-        pthread_mutex_unlock(&cap->mutex);
+    // glCopyImageSubData needs matching internal formats on both ends.
+    const GLenum internalFormat = cap->glx_pixmap_rgba ? GL_RGBA8 : GL_RGB8;
+    if (!slot.texture)
+        glGenTextures(1, &slot.texture);
+    if (!slot.texture)
+        return -1;
 
-        if (renderNow)
-        {
-            pthread_mutex_lock(&cap->mutex);
-            RenderCompositeFrame(cap);
-            pthread_mutex_unlock(&cap->mutex);
+    glBindTexture(GL_TEXTURE_2D, slot.texture);
+    if (slot.width != w || slot.height != h || slot.internal_format != internalFormat)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormat), w, h, 0,
+                     cap->glx_pixmap_rgba ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        slot.width = w;
+        slot.height = h;
+        slot.internal_format = internalFormat;
+    }
 
-            if (disableVsync)
-                usleep(1000);
-            else if (!hasSwapControl)
-                usleep(2000);
-            else
-                usleep(500);
+    BindSourcePixmap(cap);
+
+    bool copied = false;
+    if (cap->has_copy_image)
+    {
+        while (glGetError() != GL_NO_ERROR)
+        {
         }
-        else
+
+        glCopyImageSubData(cap->gl_texture, GL_TEXTURE_2D, 0, rect[0], rect[1], 0,
+                           slot.texture, GL_TEXTURE_2D, 0, 0, 0, 0, w, h, 1);
+        copied = glGetError() == GL_NO_ERROR;
+        if (!copied)
         {
-            usleep(1000);
+            // Some drivers reject pixmap-backed textures as copy sources.
+            cap->has_copy_image = 0;
+            LogNative("glCopyImageSubData rejected the pixmap texture; using framebuffer blits");
         }
     }
 
-    return nullptr;
+    if (!copied && cap->has_fbo_blit)
+        copied = BlitSourceToSlot(cap, rect, slot);
+
+    glBindTexture(GL_TEXTURE_2D, cap->gl_texture);
+    cap->glx_release_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT);
+
+    if (!copied)
+        return -1;
+
+    cap->copy_ring_next = (index + 1) % kCopyRingSize;
+    cap->copied_frames++;
+    return index;
 }
 
-static bool InitGlObjects(LinuxCapture* cap, Window parent)
+static void MapSourceRectToHost(const LinuxCaptureRenderState& state, const int* sourceRect, int* hostRect)
 {
-    if (!cap || !cap->display)
-        return false;
+    hostRect[0] = hostRect[1] = hostRect[2] = hostRect[3] = 0;
 
-    int fbAttribsTextureStrict[] = {
-        GLX_X_RENDERABLE, True,
-        GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT | GLX_PIXMAP_BIT,
-        GLX_RENDER_TYPE, GLX_RGBA_BIT,
-        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
-        GLX_RED_SIZE, 8,
-        GLX_GREEN_SIZE, 8,
-        GLX_BLUE_SIZE, 8,
-        GLX_ALPHA_SIZE, 8,
-        GLX_DOUBLEBUFFER, True,
-        GLX_BIND_TO_TEXTURE_RGB_EXT, True,
-        GLX_BIND_TO_TEXTURE_RGBA_EXT, True,
-        GLX_BIND_TO_TEXTURE_TARGETS_EXT, GLX_TEXTURE_2D_BIT_EXT,
-        None
-    };
-    int fbAttribsAlpha[] = {
-        GLX_X_RENDERABLE, True,
-        GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT | GLX_PIXMAP_BIT,
-        GLX_RENDER_TYPE, GLX_RGBA_BIT,
-        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
-        GLX_RED_SIZE, 8,
-        GLX_GREEN_SIZE, 8,
-        GLX_BLUE_SIZE, 8,
-        GLX_ALPHA_SIZE, 8,
-        GLX_DOUBLEBUFFER, True,
-        None
-    };
-    int fbAttribsNoAlpha[] = {
-        GLX_X_RENDERABLE, True,
-        GLX_DRAWABLE_TYPE, GLX_WINDOW_BIT | GLX_PIXMAP_BIT,
-        GLX_RENDER_TYPE, GLX_RGBA_BIT,
-        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
-        GLX_RED_SIZE, 8,
-        GLX_GREEN_SIZE, 8,
-        GLX_BLUE_SIZE, 8,
-        GLX_DOUBLEBUFFER, True,
-        None
-    };
+    const float du = state.uv[2] - state.uv[0];
+    const float dv = state.uv[3] - state.uv[1];
+    if (du <= 0.0f || dv <= 0.0f || state.target_w <= 0 || state.target_h <= 0)
+        return;
 
-    int fbCount = 0;
-    GLXFBConfig* fbc = glXChooseFBConfig(cap->display, cap->screen, fbAttribsTextureStrict, &fbCount);
-    if ((!fbc || fbCount == 0) && fbc)
-    {
-        XFree(fbc);
-        fbc = nullptr;
+    const float fx0 = std::clamp((static_cast<float>(sourceRect[0]) / state.target_w - state.uv[0]) / du, 0.0f, 1.0f);
+    const float fx1 = std::clamp((static_cast<float>(sourceRect[2]) / state.target_w - state.uv[0]) / du, 0.0f, 1.0f);
+    const float fy0 = std::clamp((static_cast<float>(sourceRect[1]) / state.target_h - state.uv[1]) / dv, 0.0f, 1.0f);
+    const float fy1 = std::clamp((static_cast<float>(sourceRect[3]) / state.target_h - state.uv[1]) / dv, 0.0f, 1.0f);
+
+    const int vpX = state.viewport[0];
+    const int vpY = state.viewport[1];
+    const int vpW = state.viewport[2];
+    const int vpH = state.viewport[3];
+
+    // Source rows run top-down, GL window rows bottom-up.
+    const int x0 = vpX + static_cast<int>(std::floor(fx0 * vpW)) - kRedrawPadPx;
+    const int x1 = vpX + static_cast<int>(std::ceil(fx1 * vpW)) + kRedrawPadPx;
+    const int y0 = vpY + vpH - static_cast<int>(std::ceil(fy1 * vpH)) - kRedrawPadPx;
+    const int y1 = vpY + vpH - static_cast<int>(std::floor(fy0 * vpH)) + kRedrawPadPx;
+
+    hostRect[0] = std::max(vpX, x0);
+    hostRect[1] = std::max(vpY, y0);
+    hostRect[2] = std::min(vpX + vpW, x1);
+    hostRect[3] = std::min(vpY + vpH, y1);
+    if (hostRect[2] <= hostRect[0] || hostRect[3] <= hostRect[1])
+        hostRect[0] = hostRect[1] = hostRect[2] = hostRect[3] = 0;
+}
+
+static void PushRedrawHistory(LinuxCapture* cap, const int* rect)
+{
+    for (int i = kRedrawHistory - 1; i > 0; i--)
+        memcpy(cap->redraw_history[i], cap->redraw_history[i - 1], sizeof(cap->redraw_history[i]));
+
+    memcpy(cap->redraw_history[0], rect, sizeof(cap->redraw_history[0]));
+    cap->redraw_history_count = std::min(cap->redraw_history_count + 1, kRedrawHistory);
+}
+
+static bool ComputeRedrawScissor(LinuxCapture* cap, int* scissor)
+{
+    // The back buffer holds the frame from `age` presents ago, so it is stale
+    // by the union of everything redrawn since then (this frame included).
+    // Age 0 means undefined contents and forces a full redraw.
+    // The headless output FBO is never swapped, so it always holds the last frame.
+    unsigned int age = cap->headless ? 1 : 0;
+    if (!cap->headless)
+    {
+        if (!cap->has_buffer_age)
+            return false;
+        glXQueryDrawable(cap->display, cap->window, GLX_BACK_BUFFER_AGE_EXT, &age);
+    }
+    if (age == 0 || static_cast<int>(age) > cap->redraw_history_count)
+        return false;
+
+    int valid = 0;
+    for (unsigned int i = 0; i < age; i++)
+    {
+        const int* r = cap->redraw_history[i];
+        UnionRect(scissor, &valid, r[0], r[1], r[2], r[3]);
+    }
+
+    if (!valid)
+        scissor[0] = scissor[1] = scissor[2] = scissor[3] = 0;
+    return true;
+}
+
+static bool BeginAsyncReadbackRegion(LinuxCapture* cap, LinuxCaptureReadback* rb, int x, int y, int width, int height)
+{
+    // Reads the currently bound read framebuffer; the caller polls for it later.
+    const size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+    if (!rb->pbo)
+        glGenBuffers(1, &rb->pbo);
+    if (!rb->pbo)
+        return false;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+    if (rb->size != size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+        rb->size = size;
+    }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(x, y, width, height, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (rb->fence)
+        glDeleteSync(rb->fence);
+    rb->fence = cap->has_sync ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : nullptr;
+    rb->width = width;
+    rb->height = height;
+    rb->pending = 1;
+    rb->issued_frame = cap->presented_frames;
+    return true;
+}
+
+static bool BeginAsyncReadback(LinuxCapture* cap, LinuxCaptureReadback* rb, int width, int height)
+{
+    return BeginAsyncReadbackRegion(cap, rb, 0, 0, width, height);
+}
+
+// Returns the mapped pixels (bottom-up BGRA rows) once the GPU has finished
+// the copy, or null while it is still in flight. Pair with UnmapReadback.
+static const uint8_t* MapCompletedReadback(LinuxCapture* cap, LinuxCaptureReadback* rb)
+{
+    if (!rb->pending || !rb->pbo)
+        return nullptr;
+
+    if (rb->fence)
+    {
+        if (glClientWaitSync(rb->fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return nullptr;
+        glDeleteSync(rb->fence);
+        rb->fence = nullptr;
+    }
+    else if (cap->presented_frames < rb->issued_frame + 2)
+    {
+        // Without fences, give the copy two presents before mapping.
+        return nullptr;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb->pbo);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(rb->size), GL_MAP_READ_BIT);
+    if (!data)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        rb->pending = 0;
+        return nullptr;
+    }
+
+    return static_cast<const uint8_t*>(data);
+}
+
+static void UnmapReadback(LinuxCaptureReadback* rb)
+{
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    rb->pending = 0;
+}
+
+static void DestroyReadback(LinuxCaptureReadback* rb)
+{
+    if (rb->fence)
+        glDeleteSync(rb->fence);
+    if (rb->pbo)
+        glDeleteBuffers(1, &rb->pbo);
+    *rb = LinuxCaptureReadback{};
+}
+
+// (Re)allocates a BGRA texture and the FBO that renders into it. A mipmapped
+// target samples with trilinear filtering once glGenerateMipmap has run.
+static bool EnsureColorTarget(GLuint* fbo, GLuint* texture, int* curW, int* curH, int width, int height, bool mipmapped)
+{
+    if (*fbo && *curW == width && *curH == height)
+        return true;
+
+    if (!*texture)
+        glGenTextures(1, texture);
+    if (!*fbo)
+        glGenFramebuffers(1, fbo);
+    if (!*texture || !*fbo)
+        return false;
+
+    glBindTexture(GL_TEXTURE_2D, *texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, *fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *texture, 0);
+    const bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    *curW = complete ? width : 0;
+    *curH = complete ? height : 0;
+    return complete;
+}
+
+static void DestroyColorTarget(GLuint* fbo, GLuint* texture, int* curW, int* curH)
+{
+    if (*fbo)
+        glDeleteFramebuffers(1, fbo);
+    if (*texture)
+        glDeleteTextures(1, texture);
+    *fbo = 0;
+    *texture = 0;
+    *curW = 0;
+    *curH = 0;
+}
+
+// Fixed-function quad over the bound framebuffer's viewport, sampling the
+// bound texture. v0 is the top of the region in source (top-down) texels.
+static void DrawTexturedQuad(float u0, float v0, float u1, float v1)
+{
+    glUseProgram(0);
+    glEnable(GL_TEXTURE_2D);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+
+    glBegin(GL_TRIANGLE_STRIP);
+    glTexCoord2f(u0, v1); glVertex2f(-1.0f, -1.0f);
+    glTexCoord2f(u1, v1); glVertex2f( 1.0f, -1.0f);
+    glTexCoord2f(u0, v0); glVertex2f(-1.0f,  1.0f);
+    glTexCoord2f(u1, v0); glVertex2f( 1.0f,  1.0f);
+    glEnd();
+
+    glDisable(GL_TEXTURE_2D);
+}
+
+static void InitFrameExchange(LinuxCaptureFrameExchange* ex)
+{
+    pthread_mutex_init(&ex->mutex, nullptr);
+}
+
+static void DestroyFrameExchange(LinuxCaptureFrameExchange* ex)
+{
+    pthread_mutex_destroy(&ex->mutex);
+    free(ex->buffers[0]);
+    free(ex->buffers[1]);
+}
+
+// Flips a bottom-up readback into the back buffer and makes it the front.
+static bool PublishFrame(LinuxCaptureFrameExchange* ex, const uint8_t* pixels, int width, int height)
+{
+    const int back = 1 - ex->front;
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    const size_t size = rowBytes * static_cast<size_t>(height);
+    if (ex->capacity[back] < size)
+    {
+        uint8_t* grown = static_cast<uint8_t*>(realloc(ex->buffers[back], size));
+        if (!grown)
+            return false;
+        ex->buffers[back] = grown;
+        ex->capacity[back] = size;
+    }
+
+    for (int y = 0; y < height; y++)
+        memcpy(ex->buffers[back] + static_cast<size_t>(y) * rowBytes,
+               pixels + static_cast<size_t>(height - 1 - y) * rowBytes, rowBytes);
+
+    pthread_mutex_lock(&ex->mutex);
+    ex->front = back;
+    ex->width = width;
+    ex->height = height;
+    ex->sequence++;
+    pthread_mutex_unlock(&ex->mutex);
+    return true;
+}
+
+static void ClearFrameExchange(LinuxCaptureFrameExchange* ex)
+{
+    pthread_mutex_lock(&ex->mutex);
+    ex->width = 0;
+    ex->height = 0;
+    pthread_mutex_unlock(&ex->mutex);
+}
+
+static void GetFrameExchangeSize(LinuxCaptureFrameExchange* ex, int* width, int* height)
+{
+    pthread_mutex_lock(&ex->mutex);
+    *width = ex->width;
+    *height = ex->height;
+    pthread_mutex_unlock(&ex->mutex);
+}
+
+// Copies the front frame (stride width * 4) if it is newer than *sequence.
+// width/height are always set so a caller can size its buffer; returns 1
+// only when pixels were copied.
+static int CopyFrame(LinuxCaptureFrameExchange* ex, void* buffer, int bufferSize, int* width, int* height, uint64_t* sequence)
+{
+    pthread_mutex_lock(&ex->mutex);
+    const size_t size = static_cast<size_t>(ex->width) * static_cast<size_t>(ex->height) * 4;
+    *width = ex->width;
+    *height = ex->height;
+
+    int copied = 0;
+    if (size > 0 && ex->sequence != *sequence && buffer && bufferSize >= 0 && static_cast<size_t>(bufferSize) >= size)
+    {
+        memcpy(buffer, ex->buffers[ex->front], size);
+        *sequence = ex->sequence;
+        copied = 1;
+    }
+    pthread_mutex_unlock(&ex->mutex);
+    return copied;
+}
+
+static void ApplyContentBarScanLocked(LinuxCapture* cap, const aes_native::ContentBarScan& scan,
+                                      int scanW, int scanH, const int* region)
+{
+    if (!aes_native::UpdateContentBarTracker(cap->auto_crop_tracker, scan))
+        return;
+
+    // The tracker works in scan pixels; scale back to target pixels.
+    const aes_native::ContentBarInsets& applied = cap->auto_crop_tracker.applied;
+    cap->auto_crop[0] = (applied.left * region[2]) / scanW;
+    cap->auto_crop[1] = (applied.top * region[3]) / scanH;
+    cap->auto_crop[2] = (applied.right * region[2]) / scanW;
+    cap->auto_crop[3] = (applied.bottom * region[3]) / scanH;
+    LogNative("auto crop: left=%d top=%d right=%d bottom=%d",
+              cap->auto_crop[0], cap->auto_crop[1], cap->auto_crop[2], cap->auto_crop[3]);
+    cap->gpu_frame_pending = 1;
+}
+
+static void ResetContentBarCropLocked(LinuxCapture* cap)
+{
+    memset(cap->auto_crop, 0, sizeof(cap->auto_crop));
+    aes_native::ResetContentBarTracker(cap->auto_crop_tracker);
+    cap->auto_crop_scan_frame = 0;
+    cap->content_bar_scans = 0;
+    // Drops readbacks and jobs that were issued for the previous target.
+    cap->detect_generation++;
+}
+
+static void* ContentBarWorkerMain(void* arg)
+{
+    LinuxCapture* cap = static_cast<LinuxCapture*>(arg);
+    uint8_t* pixels = nullptr;
+    size_t capacity = 0;
+    aes_native::ContentBarStats stats;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&cap->detect_mutex);
+        while (!cap->detect_job_ready && !cap->detect_stop)
+            pthread_cond_wait(&cap->detect_cond, &cap->detect_mutex);
+
+        if (cap->detect_stop)
+        {
+            pthread_mutex_unlock(&cap->detect_mutex);
+            break;
+        }
+
+        std::swap(pixels, cap->detect_job_pixels);
+        std::swap(capacity, cap->detect_job_capacity);
+        const int width = cap->detect_job_w;
+        const int height = cap->detect_job_h;
+        int region[4];
+        memcpy(region, cap->detect_job_region, sizeof(region));
+        const uint32_t generation = cap->detect_job_generation;
+        aes_native::ContentBarDetectorOptions options;
+        options.luma_threshold = cap->detect_job_threshold;
+        cap->detect_job_ready = 0;
+        pthread_mutex_unlock(&cap->detect_mutex);
+
+        // PBO rows are bottom-up; walk them top-down with a negative stride.
+        const ptrdiff_t stride = static_cast<ptrdiff_t>(width) * 4;
+        aes_native::ComputeContentBarStats(pixels + (height - 1) * stride, -stride, width, height, stats);
+        const aes_native::ContentBarScan scan = aes_native::ClassifyContentBars(stats, options);
+
+        pthread_mutex_lock(&cap->mutex);
+        if (cap->auto_crop_enabled && generation == cap->detect_generation)
+            ApplyContentBarScanLocked(cap, scan, width, height, region);
+        pthread_mutex_unlock(&cap->mutex);
+    }
+
+    free(pixels);
+    return nullptr;
+}
+
+static void PostContentBarJob(LinuxCapture* cap, const uint8_t* pixels, int width, int height)
+{
+    const size_t size = static_cast<size_t>(width) * static_cast<size_t>(height) * 4;
+
+    pthread_mutex_lock(&cap->detect_mutex);
+    if (cap->detect_job_capacity < size)
+    {
+        uint8_t* grown = static_cast<uint8_t*>(realloc(cap->detect_job_pixels, size));
+        if (!grown)
+        {
+            pthread_mutex_unlock(&cap->detect_mutex);
+            return;
+        }
+        cap->detect_job_pixels = grown;
+        cap->detect_job_capacity = size;
+    }
+
+    memcpy(cap->detect_job_pixels, pixels, size);
+    cap->detect_job_w = width;
+    cap->detect_job_h = height;
+    memcpy(cap->detect_job_region, cap->detect_readback_region, sizeof(cap->detect_job_region));
+    cap->detect_job_generation = cap->detect_readback_generation;
+    cap->detect_job_threshold = cap->auto_crop_threshold;
+    cap->detect_job_ready = 1;
+    pthread_cond_signal(&cap->detect_cond);
+    pthread_mutex_unlock(&cap->detect_mutex);
+}
+
+static bool EnsureContentBarTarget(LinuxCapture* cap, int width, int height)
+{
+    return EnsureColorTarget(&cap->detect_fbo, &cap->detect_texture, &cap->detect_w, &cap->detect_h, width, height, false);
+}
+
+static void DestroyContentBarResources(LinuxCapture* cap)
+{
+    DestroyReadback(&cap->detect_readback);
+    DestroyColorTarget(&cap->detect_fbo, &cap->detect_texture, &cap->detect_w, &cap->detect_h);
+}
+
+// Every kContentBarScanInterval source frames, downscales the manually
+// cropped region to kContentBarDetectWidth and reads it back through a PBO.
+// The result is picked up on a later frame and scanned on the worker, so the
+// render thread never waits for the GPU or the detector.
+static void UpdateContentBarScan(LinuxCapture* cap)
+{
+    if (!cap->auto_crop_enabled || !cap->has_fbo_blit || !cap->detect_thread_started)
+        return;
+
+    if (cap->detect_readback.pending)
+    {
+        const uint8_t* pixels = MapCompletedReadback(cap, &cap->detect_readback);
+        if (!pixels)
+            return;
+
+        if (cap->detect_readback_generation == cap->detect_generation)
+            PostContentBarJob(cap, pixels, cap->detect_readback.width, cap->detect_readback.height);
+        UnmapReadback(&cap->detect_readback);
+        return;
+    }
+
+    if (cap->presented_frames < kContentBarWarmupFrames ||
+        cap->source_frame_count < cap->auto_crop_scan_frame + kContentBarScanInterval)
+        return;
+
+    const int regionX = std::max(0, cap->crop[0]);
+    const int regionY = std::max(0, cap->crop[1]);
+    const int regionW = cap->cached_target_w - regionX - std::max(0, cap->crop[2]);
+    const int regionH = cap->cached_target_h - regionY - std::max(0, cap->crop[3]);
+    if (regionW < 100 || regionH < 100)
+        return;
+
+    const int detectW = kContentBarDetectWidth;
+    const int detectH = std::max(1, (regionH * detectW) / regionW);
+    if (!EnsureSourceTexture(cap) || !EnsureContentBarTarget(cap, detectW, detectH))
+        return;
+
+    const float tw = static_cast<float>(cap->cached_target_w);
+    const float th = static_cast<float>(cap->cached_target_h);
+    const float u0 = regionX / tw;
+    const float v0 = regionY / th;
+    const float u1 = (regionX + regionW) / tw;
+    const float v1 = (regionY + regionH) / th;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, cap->detect_fbo);
+    glViewport(0, 0, detectW, detectH);
+    glActiveTexture(GL_TEXTURE0);
+    BindSourcePixmap(cap);
+    DrawTexturedQuad(u0, v0, u1, v1);
+    cap->glx_release_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT);
+
+    if (BeginAsyncReadback(cap, &cap->detect_readback, detectW, detectH))
+    {
+        cap->detect_readback_region[0] = regionX;
+        cap->detect_readback_region[1] = regionY;
+        cap->detect_readback_region[2] = regionW;
+        cap->detect_readback_region[3] = regionH;
+        cap->detect_readback_generation = cap->detect_generation;
+        cap->content_bar_scans++;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    cap->auto_crop_scan_frame = cap->source_frame_count;
+}
+
+static void DestroyReduceTarget(LinuxCaptureReduceTarget* target)
+{
+    DestroyColorTarget(&target->mip_fbo, &target->mip_texture, &target->mip_w, &target->mip_h);
+    DestroyColorTarget(&target->fbo, &target->texture, &target->w, &target->h);
+}
+
+// Shrinks the source region (x, y, w, h in top-down source pixels) into
+// target at dstW x dstH and leaves target->fbo bound for the readback. Large
+// reductions are drawn at the largest power-of-two multiple of the output and
+// finished by mipmaps, so every source pixel contributes.
+static bool DrawReducedSource(LinuxCapture* cap, LinuxCaptureReduceTarget* target, const int* region, int dstW, int dstH)
+{
+    // A linear tap is a fair box filter up to 2:1.
+    int levels = 0;
+    while ((dstW << (levels + 1)) <= region[2] && (dstH << (levels + 1)) <= region[3])
+        levels++;
+
+    if (!EnsureSourceTexture(cap) ||
+        !EnsureColorTarget(&target->fbo, &target->texture, &target->w, &target->h, dstW, dstH, false))
+        return false;
+    if (levels > 0 && !EnsureColorTarget(&target->mip_fbo, &target->mip_texture, &target->mip_w, &target->mip_h,
+                                         dstW << levels, dstH << levels, true))
+        return false;
+
+    const float tw = static_cast<float>(cap->cached_target_w);
+    const float th = static_cast<float>(cap->cached_target_h);
+    const float u0 = region[0] / tw;
+    const float v0 = region[1] / th;
+    const float u1 = (region[0] + region[2]) / tw;
+    const float v1 = (region[1] + region[3]) / th;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindFramebuffer(GL_FRAMEBUFFER, levels > 0 ? target->mip_fbo : target->fbo);
+    glViewport(0, 0, levels > 0 ? target->mip_w : dstW, levels > 0 ? target->mip_h : dstH);
+    BindSourcePixmap(cap);
+    DrawTexturedQuad(u0, v0, u1, v1);
+    cap->glx_release_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT);
+
+    if (levels > 0)
+    {
+        // The mip texture is already upright in framebuffer terms, so sample
+        // it with v running bottom to top.
+        glBindTexture(GL_TEXTURE_2D, target->mip_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+        glViewport(0, 0, dstW, dstH);
+        DrawTexturedQuad(0.0f, 1.0f, 1.0f, 0.0f);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    return true;
+}
+
+static void DestroyPreviewResources(LinuxCapture* cap)
+{
+    DestroyReadback(&cap->preview_readback);
+    DestroyReduceTarget(&cap->preview_target);
+}
+
+// At most preview_fps times a second, and only for new source frames, shrinks
+// the cropped source to preview_max_width and reads it back through a PBO.
+// The readback is always preview sized and the main present path is
+// untouched.
+static void UpdatePreview(LinuxCapture* cap, const int* crop)
+{
+    if (cap->preview_max_width <= 0)
+    {
+        if (cap->preview_target.fbo || cap->preview_readback.pbo)
+            DestroyPreviewResources(cap);
+        return;
+    }
+
+    if (!cap->has_fbo_blit)
+        return;
+
+    if (cap->preview_readback.pending)
+    {
+        const uint8_t* pixels = MapCompletedReadback(cap, &cap->preview_readback);
+        if (!pixels)
+            return;
+
+        if (PublishFrame(&cap->preview_exchange, pixels, cap->preview_readback.width, cap->preview_readback.height))
+            cap->preview_frames++;
+        UnmapReadback(&cap->preview_readback);
+        return;
+    }
+
+    const uint64_t now = MonotonicNowNs();
+    const uint64_t periodNs = static_cast<uint64_t>(1000000000.0 / cap->preview_fps);
+    if (cap->source_frame_count == cap->preview_source_frame ||
+        (cap->preview_last_ns != 0 && now - cap->preview_last_ns < periodNs))
+        return;
+
+    const int region[4] = {
+        crop[0],
+        crop[1],
+        cap->cached_target_w - crop[0] - crop[2],
+        cap->cached_target_h - crop[1] - crop[3]
+    };
+    if (region[2] < 1 || region[3] < 1)
+        return;
+
+    const int previewW = std::min(cap->preview_max_width, region[2]);
+    const int previewH = std::max(1, (region[3] * previewW) / region[2]);
+    if (DrawReducedSource(cap, &cap->preview_target, region, previewW, previewH))
+        BeginAsyncReadback(cap, &cap->preview_readback, previewW, previewH);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    cap->preview_last_ns = now;
+    cap->preview_source_frame = cap->source_frame_count;
+}
+
+static void DestroyOutputResources(LinuxCapture* cap)
+{
+    DestroyReadback(&cap->output_readback);
+    DestroyColorTarget(&cap->output_fbo, &cap->output_texture, &cap->output_w, &cap->output_h);
+}
+
+// Headless only: publishes a finished readback of the output FBO, then reads
+// back again if a newer frame was drawn meanwhile. One readback is in flight
+// at a time, so readers always get the latest finished frame.
+static void UpdateOutputReadback(LinuxCapture* cap, bool drawn)
+{
+    if (drawn)
+        cap->output_dirty = 1;
+
+    if (cap->output_readback.pending)
+    {
+        const uint8_t* pixels = MapCompletedReadback(cap, &cap->output_readback);
+        if (!pixels)
+            return;
+
+        if (PublishFrame(&cap->output_exchange, pixels, cap->output_readback.width, cap->output_readback.height))
+            cap->output_frames++;
+        UnmapReadback(&cap->output_readback);
+    }
+
+    if (!cap->output_dirty || !cap->output_readback_enabled || !cap->output_fbo)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, cap->output_fbo);
+    BeginAsyncReadback(cap, &cap->output_readback, cap->output_w, cap->output_h);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    cap->output_dirty = 0;
+}
+
+static void PostScreenshotJob(LinuxCapture* cap, const LinuxScreenshotRequest& request, uint8_t* pixels, int width, int height)
+{
+    // Outstanding requests are capped at kScreenshotQueueSize, so a slot is free.
+    pthread_mutex_lock(&cap->screenshot_mutex);
+    LinuxScreenshotJob& job = cap->screenshot_jobs[cap->screenshot_job_count++];
+    job.request = request;
+    job.pixels = pixels;
+    job.width = width;
+    job.height = height;
+    pthread_cond_signal(&cap->screenshot_cond);
+    pthread_mutex_unlock(&cap->screenshot_mutex);
+}
+
+// Fails every request that has not been read back yet (target stopped).
+static void FailQueuedScreenshotsLocked(LinuxCapture* cap)
+{
+    for (int i = 0; i < cap->screenshot_queue_count; i++)
+        PostScreenshotJob(cap, cap->screenshot_queue[i], nullptr, 0, 0);
+    cap->screenshot_queue_count = 0;
+}
+
+static bool WriteFileReplacing(const char* path, const std::vector<uint8_t>& data)
+{
+    // Write next to the target and rename, so readers never see a partial file.
+    char partPath[1040];
+    snprintf(partPath, sizeof(partPath), "%s.part", path);
+    FILE* file = fopen(partPath, "wb");
+    if (!file)
+        return false;
+
+    const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    if (fclose(file) != 0 || !written || rename(partPath, path) != 0)
+    {
+        unlink(partPath);
+        return false;
+    }
+    return true;
+}
+
+static void* ScreenshotWorkerMain(void* arg)
+{
+    LinuxCapture* cap = static_cast<LinuxCapture*>(arg);
+    std::vector<uint8_t> encoded;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&cap->screenshot_mutex);
+        while (cap->screenshot_job_count == 0 && !cap->screenshot_stop)
+            pthread_cond_wait(&cap->screenshot_cond, &cap->screenshot_mutex);
+
+        // Drain queued jobs before stopping so every id gets a result.
+        if (cap->screenshot_job_count == 0)
+        {
+            pthread_mutex_unlock(&cap->screenshot_mutex);
+            break;
+        }
+
+        const LinuxScreenshotJob job = cap->screenshot_jobs[0];
+        cap->screenshot_job_count--;
+        memmove(cap->screenshot_jobs, cap->screenshot_jobs + 1, sizeof(LinuxScreenshotJob) * cap->screenshot_job_count);
+        pthread_mutex_unlock(&cap->screenshot_mutex);
+
+        int status = kScreenshotFailed;
+        if (job.pixels)
+        {
+            const ptrdiff_t stride = static_cast<ptrdiff_t>(job.width) * 4;
+            const aes_native::ImageFormat format = job.request.format == static_cast<int>(aes_native::ImageFormat::Qoi)
+                ? aes_native::ImageFormat::Qoi
+                : aes_native::ImageFormat::Png;
+            if (aes_native::EncodeImage(format, job.pixels + (job.height - 1) * stride, -stride, job.width, job.height, encoded) &&
+                WriteFileReplacing(job.request.path, encoded))
+                status = kScreenshotDone;
+        }
+        free(job.pixels);
+        LogNative("screenshot %d: %s %dx%d '%s'", job.request.id, status == kScreenshotDone ? "written" : "failed",
+                  job.width, job.height, job.request.path);
+
+        pthread_mutex_lock(&cap->screenshot_mutex);
+        int* result = cap->screenshot_results[cap->screenshot_result_next];
+        result[0] = job.request.id;
+        result[1] = status;
+        cap->screenshot_result_next = (cap->screenshot_result_next + 1) % kScreenshotResultHistory;
+        if (status == kScreenshotDone)
+            cap->screenshots_written++;
+        else
+            cap->screenshots_failed++;
+        const LinuxScreenshotCallback callback = cap->screenshot_callback;
+        void* userData = cap->screenshot_callback_user;
+        pthread_mutex_unlock(&cap->screenshot_mutex);
+
+        if (callback)
+            callback(job.request.id, status, userData);
+    }
+
+    return nullptr;
+}
+
+static void DestroyScreenshotResources(LinuxCapture* cap)
+{
+    DestroyReadback(&cap->screenshot_readback);
+    DestroyColorTarget(&cap->screenshot_fbo, &cap->screenshot_texture, &cap->screenshot_w, &cap->screenshot_h);
+}
+
+// Runs after the frame is drawn and before it is presented. Takes the oldest
+// request, reads back either the presented viewport (post-shader) or the
+// cropped source at native size (pre-shader), and hands the pixels to the
+// encoder thread once the fenced readback has landed.
+static void UpdateScreenshot(LinuxCapture* cap, const int* crop, const LinuxCaptureRenderState& state)
+{
+    if (cap->screenshot_readback.pending)
+    {
+        const uint8_t* pixels = MapCompletedReadback(cap, &cap->screenshot_readback);
+        if (!pixels)
+            return;
+
+        uint8_t* copy = static_cast<uint8_t*>(malloc(cap->screenshot_readback.size));
+        if (copy)
+            memcpy(copy, pixels, cap->screenshot_readback.size);
+        UnmapReadback(&cap->screenshot_readback);
+        PostScreenshotJob(cap, cap->screenshot_inflight, copy, cap->screenshot_readback.width, cap->screenshot_readback.height);
+
+        // Full-size buffers are only kept while screenshots are queued.
+        if (cap->screenshot_queue_count == 0)
+            DestroyScreenshotResources(cap);
+        return;
+    }
+
+    if (cap->screenshot_queue_count == 0)
+        return;
+
+    cap->screenshot_inflight = cap->screenshot_queue[0];
+    cap->screenshot_queue_count--;
+    memmove(cap->screenshot_queue, cap->screenshot_queue + 1, sizeof(LinuxScreenshotRequest) * cap->screenshot_queue_count);
+
+    bool started = false;
+    if (cap->has_fbo_blit && cap->screenshot_inflight.post_shader)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, cap->headless ? cap->output_fbo : 0);
+        started = BeginAsyncReadbackRegion(cap, &cap->screenshot_readback, state.viewport[0], state.viewport[1],
+                                           state.viewport[2], state.viewport[3]);
+    }
+    else if (cap->has_fbo_blit)
+    {
+        const int regionW = cap->cached_target_w - crop[0] - crop[2];
+        const int regionH = cap->cached_target_h - crop[1] - crop[3];
+        if (regionW > 0 && regionH > 0 && EnsureSourceTexture(cap) &&
+            EnsureColorTarget(&cap->screenshot_fbo, &cap->screenshot_texture, &cap->screenshot_w, &cap->screenshot_h,
+                              regionW, regionH, false))
+        {
+            const float tw = static_cast<float>(cap->cached_target_w);
+            const float th = static_cast<float>(cap->cached_target_h);
+            glBindFramebuffer(GL_FRAMEBUFFER, cap->screenshot_fbo);
+            glViewport(0, 0, regionW, regionH);
+            glActiveTexture(GL_TEXTURE0);
+            BindSourcePixmap(cap);
+            DrawTexturedQuad(crop[0] / tw, crop[1] / th, (crop[0] + regionW) / tw, (crop[1] + regionH) / th);
+            cap->glx_release_tex_image_ext(cap->display, cap->glx_pixmap, GLX_FRONT_LEFT_EXT);
+            started = BeginAsyncReadback(cap, &cap->screenshot_readback, regionW, regionH);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (!started)
+        PostScreenshotJob(cap, cap->screenshot_inflight, nullptr, 0, 0);
+}
+
+static void DestroyFingerprintResources(LinuxCapture* cap)
+{
+    DestroyReadback(&cap->fingerprint_readback);
+    DestroyReduceTarget(&cap->fingerprint_target);
+}
+
+static bool RecordFingerprint(LinuxCapture* cap, const uint8_t* pixels)
+{
+    const int width = cap->fingerprint_readback.width;
+    const uint64_t hash = aes_native::HashFingerprint(pixels, static_cast<ptrdiff_t>(width) * 4, width,
+                                                      cap->fingerprint_readback.height);
+    const bool duplicate = cap->fingerprint_valid && hash == cap->fingerprint_hash;
+    cap->fingerprint_hash = hash;
+    cap->fingerprint_valid = 1;
+    if (duplicate)
+    {
+        cap->duplicate_frames++;
+    }
+    else
+    {
+        cap->unique_frames++;
+        cap->unique_rate.Record(cap->fingerprint_frame_ns);
+    }
+    return duplicate;
+}
+
+// Fingerprints each new source frame and returns true when it matches the
+// previous one. The readback is only polled: every session renders on the
+// scheduler thread, so a result that has not landed by now is collected on a
+// later frame and only feeds the stats.
+static bool FingerprintSourceFrame(LinuxCapture* cap, const int* crop)
+{
+    if (cap->fingerprint_readback.pending)
+    {
+        const uint8_t* pixels = MapCompletedReadback(cap, &cap->fingerprint_readback);
+        if (!pixels)
+        {
+            // Still in flight: this frame goes unchecked and must not be
+            // compared against a hash it never replaced.
+            if (cap->fingerprint_readback.pending)
+                cap->fingerprint_valid = 0;
+            return false;
+        }
+        RecordFingerprint(cap, pixels);
+        UnmapReadback(&cap->fingerprint_readback);
+    }
+
+    if (!cap->duplicate_detection)
+    {
+        if (cap->fingerprint_target.fbo)
+            DestroyFingerprintResources(cap);
+        cap->fingerprint_valid = 0;
+        return false;
+    }
+
+    if (!cap->has_fbo_blit || cap->source_frame_count == cap->fingerprint_source_frame)
+        return false;
+
+    cap->fingerprint_source_frame = cap->source_frame_count;
+    cap->fingerprint_frame_ns = cap->source_frame_ns;
+    const int region[4] = {
+        crop[0],
+        crop[1],
+        cap->cached_target_w - crop[0] - crop[2],
+        cap->cached_target_h - crop[1] - crop[3]
+    };
+    const bool started = region[2] > 0 && region[3] > 0 &&
+                         DrawReducedSource(cap, &cap->fingerprint_target, region, kFingerprintWidth, kFingerprintHeight) &&
+                         BeginAsyncReadback(cap, &cap->fingerprint_readback, kFingerprintWidth, kFingerprintHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!started)
+    {
+        cap->fingerprint_valid = 0;
+        return false;
+    }
+
+    const uint8_t* pixels = MapCompletedReadback(cap, &cap->fingerprint_readback);
+    if (!pixels)
+        return false;
+    const bool duplicate = RecordFingerprint(cap, pixels);
+    UnmapReadback(&cap->fingerprint_readback);
+    return duplicate;
+}
+
+// Host and target sizes for the render path. ConfigureNotify and map
+// events keep them current, so this queries only after setup invalidated
+// them, and then both windows in one round trip.
+static bool RefreshCachedGeometry(LinuxCapture* cap)
+{
+    const bool queryHost = !cap->headless && (cap->host_geometry_dirty || cap->cached_host_w <= 0 || cap->cached_host_h <= 0);
+    const bool queryTarget = cap->target_geometry_dirty || cap->cached_target_w <= 0 || cap->cached_target_h <= 0;
+    if (!queryHost && !queryTarget)
+        return true;
+
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    xcb_get_geometry_cookie_t hostCookie{};
+    xcb_get_geometry_cookie_t targetCookie{};
+    xcb_get_window_attributes_cookie_t mapCookie{};
+    if (queryHost)
+        hostCookie = xcb_get_geometry(conn, static_cast<xcb_window_t>(cap->window));
+    if (queryTarget)
+    {
+        targetCookie = xcb_get_geometry(conn, static_cast<xcb_window_t>(cap->target));
+        mapCookie = xcb_get_window_attributes(conn, static_cast<xcb_window_t>(cap->target));
+    }
+    CountRoundTrip();
+
+    bool ok = true;
+    if (queryHost)
+    {
+        xcb_get_geometry_reply_t* host = xcb_get_geometry_reply(conn, hostCookie, nullptr);
+        if (host)
+        {
+            cap->cached_host_w = std::max(1, static_cast<int>(host->width));
+            cap->cached_host_h = std::max(1, static_cast<int>(host->height));
+            cap->host_geometry_dirty = 0;
+        }
+        ok = host != nullptr;
+        free(host);
+    }
+    if (queryTarget)
+    {
+        xcb_get_geometry_reply_t* target = xcb_get_geometry_reply(conn, targetCookie, nullptr);
+        xcb_get_window_attributes_reply_t* attrs = xcb_get_window_attributes_reply(conn, mapCookie, nullptr);
+        if (target && attrs)
+        {
+            cap->cached_target_w = std::max(1, static_cast<int>(target->width));
+            cap->cached_target_h = std::max(1, static_cast<int>(target->height));
+            cap->target_viewable = attrs->map_state == XCB_MAP_STATE_VIEWABLE ? 1 : 0;
+            cap->target_geometry_dirty = 0;
+        }
+        ok = ok && target && attrs;
+        free(target);
+        free(attrs);
+    }
+    return ok;
+}
+
+static void RenderCompositeFrame(LinuxCapture* cap)
+{
+    if (!cap || !cap->display || cap->backend_mode != BackendGpuComposite || cap->target == 0)
+        return;
+
+    if (!cap->glx_bind_tex_image_ext || !cap->glx_release_tex_image_ext)
+        return;
+
+    if (glXMakeCurrent(cap->display, RenderDrawable(cap), cap->glx_context) != True)
+        return;
+
+    if (!EnsureShaderProgram(cap))
+        return;
+
+    DetectGlCapabilities(cap);
+    if (cap->headless && !cap->has_fbo_blit)
+        return;
+
+    if (!cap->headless)
+    {
+        ApplyVrrStateLocked(cap);
+        ApplyCompositorBypassLocked(cap);
+        SetSwapInterval(cap, DesiredSwapInterval(cap));
+    }
+
+    if (!RefreshCachedGeometry(cap))
+        return;
+
+    if (!cap->target_viewable && cap->hide_target)
+    {
+        Window restoreWindow = cap->hidden_window ? cap->hidden_window : cap->target;
+        XMapRaised(cap->display, restoreWindow);
+        if (cap->target_hidden_offscreen)
+        {
+            const unsigned long fullyTransparent = 0x00000000UL;
+            SetWindowOpacity(cap->display, restoreWindow, fullyTransparent);
+            if (cap->target_skip_taskbar_applied)
+                SetWindowSkipTaskbar(cap->display, restoreWindow, true);
+        }
+        XFlush(cap->display);
+    }
+
+    // Detected content bars trim on top of the manual insets.
+    int crop[4];
+    for (int i = 0; i < 4; i++)
+        crop[i] = std::max(0, cap->crop[i]) + (cap->auto_crop_enabled ? cap->auto_crop[i] : 0);
+
+    const int srcW = std::max(1, cap->cached_target_w - crop[0] - crop[2]);
+    const int srcH = std::max(1, cap->cached_target_h - crop[1] - crop[3]);
+
+    if (cap->headless)
+    {
+        // No window to fill: the output has a fixed size or follows the source.
+        cap->cached_host_w = cap->headless_w > 0 ? cap->headless_w : srcW;
+        cap->cached_host_h = cap->headless_h > 0 ? cap->headless_h : srcH;
+    }
+
+    const int hostW = std::max(1, cap->cached_host_w);
+    const int hostH = std::max(1, cap->cached_host_h);
+    const aes_native::ViewportLayout layout =
+        aes_native::ComputeViewportLayout(cap->cached_target_w, cap->cached_target_h, crop, hostW, hostH, cap->stretch);
+    const float u0 = layout.uv[0];
+    const float v0 = layout.uv[1];
+    const float u1 = layout.uv[2];
+    const float v1 = layout.uv[3];
+
+    LinuxCaptureRenderState state{};
+    state.host_w = hostW;
+    state.host_h = hostH;
+    state.target_w = cap->cached_target_w;
+    state.target_h = cap->cached_target_h;
+    memcpy(state.viewport, layout.viewport, sizeof(state.viewport));
+    memcpy(state.uv, layout.uv, sizeof(state.uv));
+    state.program = cap->shader_program;
+    state.brightness = cap->brightness;
+    state.saturation = cap->saturation;
+    memcpy(state.tint, cap->tint, sizeof(state.tint));
+
+    const bool stateChanged = !cap->last_render_state_valid || memcmp(&state, &cap->last_render_state, sizeof(state)) != 0;
+    cap->last_render_state = state;
+    cap->last_render_state_valid = 1;
+
+    cap->visible_source[0] = static_cast<int>(std::floor(u0 * cap->cached_target_w));
+    cap->visible_source[1] = static_cast<int>(std::floor(v0 * cap->cached_target_h));
+    cap->visible_source[2] = static_cast<int>(std::ceil(u1 * cap->cached_target_w));
+    cap->visible_source[3] = static_cast<int>(std::ceil(v1 * cap->cached_target_h));
+    cap->visible_source_valid = 1;
+
+    // With skipping enabled, a swap that repeats the previous picture (lag
+    // frame, 30 fps game on a 60 Hz swap) is not presented again. Only swaps
+    // that damaged everything shown are trusted to the fingerprint; see
+    // FrameFingerprint.h.
+    const bool fullDamage = cap->render_dirty_full ||
+                            (cap->render_dirty_valid && cap->render_dirty[0] <= cap->visible_source[0] &&
+                             cap->render_dirty[1] <= cap->visible_source[1] && cap->render_dirty[2] >= cap->visible_source[2] &&
+                             cap->render_dirty[3] >= cap->visible_source[3]);
+    const bool screenshotPending = cap->screenshot_queue_count > 0 || cap->screenshot_readback.pending;
+    const bool duplicate = FingerprintSourceFrame(cap, crop) && cap->duplicate_detection == DuplicateDetectionSkip;
+    if (aes_native::CanSkipDuplicateFrame(duplicate, fullDamage, stateChanged, screenshotPending))
+    {
+        cap->render_dirty_valid = 0;
+        cap->render_dirty_full = 0;
+        cap->duplicate_skips++;
+        // Readbacks of earlier frames still finish and get published.
+        if (cap->detect_readback.pending)
+            UpdateContentBarScan(cap);
+        if (cap->preview_readback.pending)
+            UpdatePreview(cap, crop);
+        if (cap->headless)
+            UpdateOutputReadback(cap, false);
+        return;
+    }
+
+    const bool fullRedraw = stateChanged || cap->render_dirty_full || !cap->shader_pointwise || cap->damage == 0;
+    int frameRect[4] = { 0, 0, 0, 0 };
+    if (fullRedraw)
+    {
+        frameRect[2] = hostW;
+        frameRect[3] = hostH;
+    }
+    else if (cap->render_dirty_valid)
+    {
+        MapSourceRectToHost(state, cap->render_dirty, frameRect);
+    }
+    cap->render_dirty_valid = 0;
+    cap->render_dirty_full = 0;
+    PushRedrawHistory(cap, frameRect);
+
+    UpdateContentBarScan(cap);
+    UpdatePreview(cap, crop);
+
+    if (cap->headless)
+    {
+        if (!EnsureColorTarget(&cap->output_fbo, &cap->output_texture, &cap->output_w, &cap->output_h, hostW, hostH, false))
+            return;
+        glBindFramebuffer(GL_FRAMEBUFFER, cap->output_fbo);
+    }
+
+    int scissor[4] = { 0, 0, hostW, hostH };
+    const bool partial = !fullRedraw && ComputeRedrawScissor(cap, scissor);
+    const bool drawNeeded = !partial || (scissor[2] > scissor[0] && scissor[3] > scissor[1]);
+
+    if (partial && drawNeeded)
+    {
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(scissor[0], scissor[1], scissor[2] - scissor[0], scissor[3] - scissor[1]);
+        cap->partial_redraws++;
+    }
+
+    // Nothing visible changed since the back buffer was last drawn (periodic
+    // pacing presents, cropped damage): present it as is.
+    bool drawn = true;
+    if (drawNeeded)
+    {
+        const int slotIndex = CanCopySource(cap) ? CopySourceToRing(cap, cap->visible_source) : -1;
+        if (slotIndex >= 0)
+        {
+            LinuxCaptureCopySlot& slot = cap->copy_ring[slotIndex];
+            const float copyUv[4] = {
+                (u0 * cap->cached_target_w - cap->visible_source[0]) / static_cast<float>(slot.width),
+                (v0 * cap->cached_target_h - cap->visible_source[1]) / static_cast<float>(slot.height),
+                (u1 * cap->cached_target_w - cap->visible_source[0]) / static_cast<float>(slot.width),
+                (v1 * cap->cached_target_h - cap->visible_source[1]) / static_cast<float>(slot.height)
+            };
+            drawn = DrawCompositeTexture(cap, state, copyUv, slot.width, slot.height, slot.texture);
+            if (cap->has_sync)
+                slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+        else
+        {
+            drawn = DrawCompositeTexture(cap, state, state.uv, cap->cached_target_w, cap->cached_target_h, 0);
+        }
+    }
+
+    if (partial)
+        glDisable(GL_SCISSOR_TEST);
+
+    if (drawn)
+        UpdateScreenshot(cap, crop, state);
+
+    if (cap->headless)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glFlush();
+        UpdateOutputReadback(cap, drawNeeded && drawn);
+        // Without a swap there is nothing to pace, so only drawn frames count.
+        if (!drawNeeded || !drawn)
+            return;
+    }
+    else
+    {
+        if (!drawn)
+            return;
+        glXSwapBuffers(cap->display, cap->window);
+        cap->host_swaps_sent++;
+        cap->host_swap_ns = MonotonicNowNs();
+    }
+
+    cap->last_render_ns = MonotonicNowNs();
+    cap->presented_frames++;
+    if (cap->first_frame_ms <= 0.0)
+    {
+        cap->first_frame_ms = static_cast<double>(cap->last_render_ns - cap->create_ns) / 1000000.0;
+        LogNative("first frame %.1f ms after create", cap->first_frame_ms);
+    }
+    SamplePresentMetrics(cap, cap->last_render_ns);
+    SampleCaptureLatency(cap, cap->last_render_ns);
+}
+
+static void InitPresentTiming(LinuxCapture* cap)
+{
+    if (!cap || !cap->display)
+        return;
+
+    cap->xcb = XGetXCBConnection(cap->display);
+    cap->present_supported = 0;
+    if (!cap->xcb)
+        return;
+
+    const xcb_query_extension_reply_t* ext = xcb_get_extension_data(cap->xcb, &xcb_present_id);
+    if (!ext || !ext->present)
+    {
+        LogNative("Present extension unavailable; source timing uses XDamage");
+        return;
+    }
+
+    xcb_present_query_version_cookie_t cookie = xcb_present_query_version(cap->xcb, 1, 0);
+    xcb_present_query_version_reply_t* reply = xcb_present_query_version_reply(cap->xcb, cookie, nullptr);
+    if (!reply)
+        return;
+
+    LogNative("Present extension %u.%u available", reply->major_version, reply->minor_version);
+    free(reply);
+    cap->present_supported = 1;
+}
+
+static void StopPresentTiming(LinuxCapture* cap)
+{
+    if (!cap || !cap->xcb)
+        return;
+
+    if (cap->present_special)
+    {
+        if (cap->present_window != 0 && !cap->target_destroyed)
+            xcb_present_select_input(cap->xcb, cap->present_eid, static_cast<xcb_window_t>(cap->present_window), XCB_PRESENT_EVENT_MASK_NO_EVENT);
+        xcb_unregister_for_special_event(cap->xcb, cap->present_special);
+        xcb_flush(cap->xcb);
+    }
+
+    cap->present_special = nullptr;
+    cap->present_eid = 0;
+    cap->present_window = 0;
+    cap->present_last_ust = 0;
+    cap->present_last_msc = 0;
+    cap->present_last_event_ns = 0;
+    cap->present_interval_count = 0;
+    cap->present_interval_next = 0;
+}
+
+static void StartPresentTiming(LinuxCapture* cap, Window target)
+{
+    if (!cap || !cap->xcb || !cap->present_supported || target == 0)
+        return;
+
+    StopPresentTiming(cap);
+
+    cap->present_eid = xcb_generate_id(cap->xcb);
+    xcb_void_cookie_t cookie = xcb_present_select_input_checked(
+        cap->xcb,
+        cap->present_eid,
+        static_cast<xcb_window_t>(target),
+        XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    xcb_generic_error_t* error = xcb_request_check(cap->xcb, cookie);
+    if (error)
+    {
+        LogNative("PresentSelectInput failed for target=0x%lx (error=%u); using XDamage timing", target, error->error_code);
+        free(error);
+        cap->present_eid = 0;
+        return;
+    }
+
+    cap->present_special = xcb_register_for_special_xge(cap->xcb, &xcb_present_id, cap->present_eid, nullptr);
+    cap->present_window = target;
+    LogNative("Present CompleteNotify timing enabled for target=0x%lx", target);
+}
+
+static bool HasRecentPresentTiming(LinuxCapture* cap, uint64_t now)
+{
+    return cap && cap->present_last_event_ns != 0 && now - cap->present_last_event_ns < 250000000ULL;
+}
+
+static void HandlePresentComplete(LinuxCapture* cap, const xcb_present_complete_notify_event_t* ev)
+{
+    if (!cap || !ev || ev->kind != XCB_PRESENT_COMPLETE_KIND_PIXMAP)
+        return;
+
+    const uint64_t now = MonotonicNowNs();
+    if (cap->present_last_ust != 0 && ev->ust > cap->present_last_ust && ev->msc >= cap->present_last_msc)
+    {
+        const uint64_t intervalUs = ev->ust - cap->present_last_ust;
+        if (intervalUs < 1000000ULL)
+        {
+            cap->present_intervals_us[cap->present_interval_next] = intervalUs;
+            cap->present_interval_next = (cap->present_interval_next + 1) % kPresentIntervalHistory;
+            cap->present_interval_count = std::min(cap->present_interval_count + 1, kPresentIntervalHistory);
+        }
+        else
+        {
+            // Long stall (pause menu, loading): restart the window so the
+            // average reflects the cadence after the gap.
+            cap->present_interval_count = 0;
+            cap->present_interval_next = 0;
+        }
+
+        if (cap->present_interval_count > 0)
+        {
+            uint64_t totalUs = 0;
+            for (int i = 0; i < cap->present_interval_count; i++)
+                totalUs += cap->present_intervals_us[i];
+
+            const double meanUs = static_cast<double>(totalUs) / static_cast<double>(cap->present_interval_count);
+            cap->source_fps = meanUs > 0.0 ? 1000000.0 / meanUs : 0.0;
+            UpdateSourceFrameTimeLocked(cap);
+        }
+    }
+
+    cap->present_last_ust = ev->ust;
+    cap->present_last_msc = ev->msc;
+    cap->present_last_event_ns = now;
+    cap->source_last_event_ns = now;
+    RecordSourceFrame(cap, UstToMonotonicNs(ev->ust, now), SourceTimingPresent);
+}
+
+static void PumpPresentEventsLocked(LinuxCapture* cap)
+{
+    if (!cap || !cap->xcb || !cap->present_special)
+        return;
+
+    xcb_generic_event_t* ev = nullptr;
+    while ((ev = xcb_poll_for_special_event(cap->xcb, cap->present_special)) != nullptr)
+    {
+        const xcb_ge_generic_event_t* ge = reinterpret_cast<const xcb_ge_generic_event_t*>(ev);
+        if (ge->event_type == XCB_PRESENT_COMPLETE_NOTIFY)
+            HandlePresentComplete(cap, reinterpret_cast<const xcb_present_complete_notify_event_t*>(ev));
+        free(ev);
+    }
+}
+
+static void StartHostPresentEventsLocked(LinuxCapture* cap)
+{
+    if (!cap->xcb || !cap->present_supported || cap->headless || cap->window == 0)
+        return;
+
+    cap->host_present_eid = xcb_generate_id(cap->xcb);
+    xcb_void_cookie_t cookie = xcb_present_select_input_checked(
+        cap->xcb, cap->host_present_eid, static_cast<xcb_window_t>(cap->window), XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    xcb_generic_error_t* error = xcb_request_check(cap->xcb, cookie);
+    if (error)
+    {
+        LogNative("PresentSelectInput failed for host=0x%lx (error=%u); swaps are not paced", cap->window, error->error_code);
+        free(error);
+        cap->host_present_eid = 0;
+        return;
+    }
+    cap->host_present_special = xcb_register_for_special_xge(cap->xcb, &xcb_present_id, cap->host_present_eid, nullptr);
+}
+
+static void StopHostPresentEvents(LinuxCapture* cap)
+{
+    if (!cap->host_present_special)
+        return;
+
+    xcb_present_select_input(cap->xcb, cap->host_present_eid, static_cast<xcb_window_t>(cap->window), XCB_PRESENT_EVENT_MASK_NO_EVENT);
+    xcb_unregister_for_special_event(cap->xcb, cap->host_present_special);
+    xcb_flush(cap->xcb);
+    cap->host_present_special = nullptr;
+    cap->host_present_eid = 0;
+}
+
+static void PumpHostPresentEventsLocked(LinuxCapture* cap)
+{
+    if (!cap->host_present_special)
+        return;
+
+    xcb_generic_event_t* ev = nullptr;
+    while ((ev = xcb_poll_for_special_event(cap->xcb, cap->host_present_special)) != nullptr)
+    {
+        const xcb_ge_generic_event_t* ge = reinterpret_cast<const xcb_ge_generic_event_t*>(ev);
+        if (ge->event_type == XCB_PRESENT_COMPLETE_NOTIFY &&
+            reinterpret_cast<const xcb_present_complete_notify_event_t*>(ev)->kind == XCB_PRESENT_COMPLETE_KIND_PIXMAP)
+            cap->host_swaps_completed++;
+        free(ev);
+    }
+}
+
+// Whether a vsynced swap issued now would wait for the previous one. Only
+// trusted once completions have been seen (GLX drivers that do not present
+// through the Present extension send none) and for two refreshes after the
+// swap, so a lost event cannot stall the view.
+static bool HostSwapPendingLocked(LinuxCapture* cap, uint64_t now, uint64_t refreshNs)
+{
+    return cap->host_present_special && cap->applied_swap_interval != 0 && cap->host_swaps_completed > 0 &&
+           cap->host_swaps_sent > cap->host_swaps_completed && now - cap->host_swap_ns < 2 * refreshNs;
+}
+
+static double ComputeModeRefreshHz(const XRRModeInfo* mode)
+{
+    if (!mode || mode->dotClock == 0 || mode->hTotal == 0 || mode->vTotal == 0)
+        return 0.0;
+
+    double vTotal = static_cast<double>(mode->vTotal);
+    if (mode->modeFlags & RR_DoubleScan)
+        vTotal *= 2.0;
+    if (mode->modeFlags & RR_Interlace)
+        vTotal /= 2.0;
+
+    return static_cast<double>(mode->dotClock) / (static_cast<double>(mode->hTotal) * vTotal);
+}
+
+static void InitDisplayRefresh(LinuxCapture* cap)
+{
+    if (!cap || !cap->display)
+        return;
+
+    cap->display_refresh_hz = kDefaultDisplayRefreshHz;
+    cap->display_refresh_dirty = 1;
+    cap->randr_event_base = -1;
+    cap->randr_error_base = -1;
+
+    if (!XRRQueryExtension(cap->display, &cap->randr_event_base, &cap->randr_error_base))
+    {
+        LogNative("XRandR unavailable; assuming %.0f Hz display", kDefaultDisplayRefreshHz);
+        return;
+    }
+
+    cap->randr_supported = 1;
+    XRRSelectInput(cap->display, DefaultRootWindow(cap->display), RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask);
+}
+
+static void TrackHostTopLevelLocked(LinuxCapture* cap)
+{
+    if (!cap || !cap->display || cap->window == 0)
+        return;
+
+    // Monitor changes happen when the top-level (or its WM frame) moves; the
+    // host child window itself never sees a ConfigureNotify for that.
+    Window topLevel = GetTopLevelWindow(cap->display, cap->window);
+    if (topLevel == 0 || topLevel == cap->window || topLevel == cap->host_toplevel)
+        return;
+
+    cap->host_toplevel = topLevel;
+    cap->toplevel_obscured = 0;
+    cap->toplevel_state_dirty = 1;
+    AddWindowEventMasks(XGetXCBConnection(cap->display), std::vector<Window>(1, topLevel),
+                        XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_VISIBILITY_CHANGE | XCB_EVENT_MASK_PROPERTY_CHANGE);
+}
+
+// Composited desktops report every redirected window as unobscured, so
+// minimising and workspace switches are read from _NET_WM_STATE_HIDDEN and
+// the top-level's map state; VisibilityNotify covers uncomposited sessions.
+static void UpdateHostVisibilityLocked(LinuxCapture* cap)
+{
+    if (!cap || !cap->display || cap->headless)
+        return;
+
+    if (cap->toplevel_state_dirty && cap->host_toplevel != 0)
+    {
+        cap->toplevel_state_dirty = 0;
+        xcb_connection_t* conn = XGetXCBConnection(cap->display);
+        const xcb_window_t topLevel = static_cast<xcb_window_t>(cap->host_toplevel);
+        const xcb_get_property_cookie_t stateCookie =
+            xcb_get_property(conn, 0, topLevel, g_capture_manager.atoms.net_wm_state, XCB_ATOM_ATOM, 0, 32);
+        const xcb_get_window_attributes_cookie_t attributesCookie = xcb_get_window_attributes(conn, topLevel);
+        CountRoundTrip();
+        xcb_get_property_reply_t* state = xcb_get_property_reply(conn, stateCookie, nullptr);
+        xcb_get_window_attributes_reply_t* attributes = xcb_get_window_attributes_reply(conn, attributesCookie, nullptr);
+
+        int hidden = attributes && attributes->map_state != XCB_MAP_STATE_VIEWABLE ? 1 : 0;
+        if (state && state->format == 32 && g_capture_manager.atoms.net_wm_state_hidden != XCB_ATOM_NONE)
+        {
+            const xcb_atom_t* atoms = static_cast<const xcb_atom_t*>(xcb_get_property_value(state));
+            const int count = xcb_get_property_value_length(state) / 4;
+            for (int i = 0; i < count && !hidden; i++)
+                hidden = atoms[i] == g_capture_manager.atoms.net_wm_state_hidden ? 1 : 0;
+        }
+        free(state);
+        free(attributes);
+        cap->toplevel_hidden = hidden;
+    }
+
+    const int occluded = cap->host_obscured || cap->toplevel_obscured || cap->toplevel_hidden ? 1 : 0;
+    if (occluded == cap->host_occluded)
+        return;
+
+    cap->host_occluded = occluded;
+    if (!occluded)
+    {
+        // Nothing was drawn while hidden; the first pass back draws one
+        // complete frame of the current source.
+        cap->gpu_frame_pending = 1;
+        cap->render_dirty_full = 1;
+        cap->redraw_history_count = 0;
+    }
+    LogNative("capture view %s", occluded ? "hidden: presents suspended" : "visible: presents resumed");
+}
+
+static void UpdateDisplayRefreshLocked(LinuxCapture* cap, uint64_t now)
+{
+    if (!cap || !cap->display || !cap->randr_supported || !cap->display_refresh_dirty || cap->window == 0)
+        return;
+
+    // Window drags produce a ConfigureNotify per motion step; re-query at most 4x/s.
+    if (cap->display_refresh_checked_ns != 0 && now - cap->display_refresh_checked_ns < 250000000ULL)
+        return;
+
+    cap->display_refresh_checked_ns = now;
+    cap->display_refresh_dirty = 0;
+    TrackHostTopLevelLocked(cap);
+
+    Window root = DefaultRootWindow(cap->display);
+    const Window topLevel = cap->host_toplevel != 0 ? cap->host_toplevel : cap->window;
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    const xcb_get_geometry_cookie_t geometryCookie = xcb_get_geometry(conn, static_cast<xcb_window_t>(cap->window));
+    const xcb_translate_coordinates_cookie_t originCookie =
+        xcb_translate_coordinates(conn, static_cast<xcb_window_t>(cap->window), static_cast<xcb_window_t>(root), 0, 0);
+    const xcb_get_geometry_cookie_t topGeometryCookie = xcb_get_geometry(conn, static_cast<xcb_window_t>(topLevel));
+    const xcb_translate_coordinates_cookie_t topOriginCookie =
+        xcb_translate_coordinates(conn, static_cast<xcb_window_t>(topLevel), static_cast<xcb_window_t>(root), 0, 0);
+    CountRoundTrip();
+    xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(conn, geometryCookie, nullptr);
+    xcb_translate_coordinates_reply_t* origin = xcb_translate_coordinates_reply(conn, originCookie, nullptr);
+    xcb_get_geometry_reply_t* topGeometry = xcb_get_geometry_reply(conn, topGeometryCookie, nullptr);
+    xcb_translate_coordinates_reply_t* topOrigin = xcb_translate_coordinates_reply(conn, topOriginCookie, nullptr);
+    if (!geometry || !origin || !topGeometry || !topOrigin)
+    {
+        free(geometry);
+        free(origin);
+        free(topGeometry);
+        free(topOrigin);
+        return;
+    }
+
+    const int hostRect[4] = { origin->dst_x, origin->dst_y, origin->dst_x + geometry->width, origin->dst_y + geometry->height };
+    const int topRect[4] = {
+        topOrigin->dst_x, topOrigin->dst_y, topOrigin->dst_x + topGeometry->width, topOrigin->dst_y + topGeometry->height
+    };
+    const int centerX = origin->dst_x + geometry->width / 2;
+    const int centerY = origin->dst_y + geometry->height / 2;
+    free(geometry);
+    free(origin);
+    free(topGeometry);
+    free(topOrigin);
+
+    XRRScreenResources* resources = XRRGetScreenResourcesCurrent(cap->display, root);
+    if (!resources)
+        return;
+
+    const RROutput primary = XRRGetOutputPrimary(cap->display, root);
+    double hostHz = 0.0;
+    RRCrtc hostCrtc = 0;
+    int hostCovers = 0;
+    double primaryHz = 0.0;
+    RRCrtc primaryCrtc = 0;
+
+    for (int i = 0; i < resources->ncrtc && hostCrtc == 0; i++)
+    {
+        XRRCrtcInfo* crtc = XRRGetCrtcInfo(cap->display, resources, resources->crtcs[i]);
+        if (!crtc)
+            continue;
+
+        if (crtc->mode != None && crtc->width > 0 && crtc->height > 0)
+        {
+            double hz = 0.0;
+            for (int m = 0; m < resources->nmode; m++)
+            {
+                if (resources->modes[m].id == crtc->mode)
+                {
+                    hz = ComputeModeRefreshHz(&resources->modes[m]);
+                    break;
+                }
+            }
+
+            const bool containsHost =
+                centerX >= crtc->x && centerX < crtc->x + static_cast<int>(crtc->width) &&
+                centerY >= crtc->y && centerY < crtc->y + static_cast<int>(crtc->height);
+            if (containsHost && hz > 0.0)
+            {
+                hostHz = hz;
+                hostCrtc = resources->crtcs[i];
+                // Fullscreen: both the top-level and the GL window span the output.
+                const int right = crtc->x + static_cast<int>(crtc->width);
+                const int bottom = crtc->y + static_cast<int>(crtc->height);
+                hostCovers = topRect[0] <= crtc->x && topRect[1] <= crtc->y && topRect[2] >= right && topRect[3] >= bottom &&
+                             hostRect[0] <= crtc->x && hostRect[1] <= crtc->y && hostRect[2] >= right && hostRect[3] >= bottom;
+            }
+
+            for (int o = 0; o < crtc->noutput; o++)
+            {
+                if (crtc->outputs[o] == primary)
+                {
+                    primaryHz = hz;
+                    primaryCrtc = resources->crtcs[i];
+                }
+            }
+        }
+
+        XRRFreeCrtcInfo(crtc);
+    }
+
+    XRRFreeScreenResources(resources);
+
+    if (hostCrtc == 0)
+    {
+        hostHz = primaryHz;
+        hostCrtc = primaryCrtc;
+    }
+    if (hostHz < 1.0)
+        hostHz = kDefaultDisplayRefreshHz;
+
+    if (fabs(hostHz - cap->display_refresh_hz) > 0.01 || hostCrtc != cap->display_crtc)
+        LogNative("display refresh %.3f Hz (crtc=0x%lx)", hostHz, hostCrtc);
+
+    cap->display_refresh_hz = hostHz;
+    cap->display_crtc = hostCrtc;
+    cap->host_covers_output = hostCovers;
+}
+
+static uint64_t DisplayRefreshPeriodNs(LinuxCapture* cap)
+{
+    const double hz = cap && cap->display_refresh_hz >= 1.0 ? cap->display_refresh_hz : kDefaultDisplayRefreshHz;
+    return static_cast<uint64_t>(1000000000.0 / hz);
+}
+
+// Viewable InputOutput windows under root covering at least a sixteenth of
+// it, largest first, after root itself. One round trip per tree level.
+static int CollectProbeSurfaces(Display* display, Window root, LinuxSurfaceProbe* probes, int maxProbes)
+{
+    xcb_connection_t* conn = XGetXCBConnection(display);
+    CountRoundTrip();
+    xcb_get_geometry_reply_t* rootGeometry =
+        xcb_get_geometry_reply(conn, xcb_get_geometry(conn, static_cast<xcb_window_t>(root)), nullptr);
+    if (!rootGeometry)
+        return 0;
+    const uint64_t rootArea = static_cast<uint64_t>(rootGeometry->width) * rootGeometry->height;
+    free(rootGeometry);
+
+    std::vector<std::pair<uint64_t, Window>> found;
+    std::vector<Window> level(1, root);
+    for (int depth = 0; depth < 8 && !level.empty() && found.size() < 256; depth++)
+    {
+        std::vector<xcb_query_tree_cookie_t> treeCookies(level.size());
+        for (size_t i = 0; i < level.size(); i++)
+            treeCookies[i] = xcb_query_tree(conn, static_cast<xcb_window_t>(level[i]));
+        CountRoundTrip();
+        std::vector<Window> children;
+        for (const xcb_query_tree_cookie_t& cookie : treeCookies)
+        {
+            xcb_query_tree_reply_t* tree = xcb_query_tree_reply(conn, cookie, nullptr);
+            if (!tree)
+                continue;
+            const xcb_window_t* list = xcb_query_tree_children(tree);
+            children.insert(children.end(), list, list + xcb_query_tree_children_length(tree));
+            free(tree);
+        }
+        if (children.empty())
+            break;
+
+        std::vector<xcb_get_window_attributes_cookie_t> attributeCookies(children.size());
+        std::vector<xcb_get_geometry_cookie_t> geometryCookies(children.size());
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            attributeCookies[i] = xcb_get_window_attributes(conn, static_cast<xcb_window_t>(children[i]));
+            geometryCookies[i] = xcb_get_geometry(conn, static_cast<xcb_window_t>(children[i]));
+        }
+        CountRoundTrip();
+        level.clear();
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            xcb_get_window_attributes_reply_t* attributes = xcb_get_window_attributes_reply(conn, attributeCookies[i], nullptr);
+            xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(conn, geometryCookies[i], nullptr);
+            if (attributes && geometry && attributes->map_state == XCB_MAP_STATE_VIEWABLE &&
+                attributes->_class == XCB_WINDOW_CLASS_INPUT_OUTPUT)
+            {
+                level.push_back(children[i]);
+                const uint64_t area = static_cast<uint64_t>(geometry->width) * geometry->height;
+                if (area * 16 >= rootArea)
+                    found.push_back(std::make_pair(area, children[i]));
+            }
+            free(attributes);
+            free(geometry);
+        }
+    }
+
+    std::stable_sort(found.begin(), found.end(), [](const std::pair<uint64_t, Window>& a, const std::pair<uint64_t, Window>& b) {
+        return a.first > b.first;
+    });
+    int count = 0;
+    probes[count].window = root;
+    probes[count++].sample.window_area = rootArea;
+    for (size_t i = 0; i < found.size() && count < maxProbes; i++)
+    {
+        probes[count].window = found[i].second;
+        probes[count++].sample.window_area = found[i].first;
+    }
+    return count;
+}
+
+static void EndSurfaceProbeLocked(LinuxCapture* cap)
+{
+    for (int i = 0; i < cap->probe_count; i++)
+    {
+        if (cap->probes[i].damage != 0)
+            XDamageDestroy(cap->display, cap->probes[i].damage);
+        cap->probes[i] = LinuxSurfaceProbe{};
+    }
+    cap->probe_count = 0;
+}
+
+// Starts watching the current target, which becomes probe_root, and its
+// large descendants. Nothing to decide when it has none.
+static void StartSurfaceProbeLocked(LinuxCapture* cap, uint64_t now)
+{
+    EndSurfaceProbeLocked(cap);
+    cap->probe_root = cap->target;
+    if (cap->target == 0 || cap->damage_event_base < 0 || cap->backend_mode != BackendGpuComposite)
+        return;
+
+    const int count = CollectProbeSurfaces(cap->display, cap->target, cap->probes, kMaxProbeSurfaces);
+    if (count < 2)
+    {
+        for (int i = 0; i < count; i++)
+            cap->probes[i] = LinuxSurfaceProbe{};
+        return;
+    }
+
+    // Destroyed children take their damage objects with them; the notify
+    // says which ones not to destroy again.
+    std::vector<Window> children;
+    for (int i = 1; i < count; i++)
+        children.push_back(cap->probes[i].window);
+    AddWindowEventMasks(XGetXCBConnection(cap->display), children, XCB_EVENT_MASK_STRUCTURE_NOTIFY);
+
+    for (int i = 0; i < count; i++)
+        cap->probes[i].damage = XDamageCreate(cap->display, cap->probes[i].window, XDamageReportBoundingBox);
+    cap->probe_count = count;
+    cap->probe_start_ns = now;
+    LogNative("surface probe: target 0x%lx and %d descendant(s)", cap->target, count - 1);
+}
+
+// Records where target came from once set_target has settled on it.
+static void RememberTargetOriginLocked(LinuxCapture* cap, int processId, const char* windowTitleHint)
+{
+    cap->target_pid = processId;
+    strncpy(cap->target_hint, windowTitleHint ? windowTitleHint : "", sizeof(cap->target_hint) - 1);
+    cap->target_hint[sizeof(cap->target_hint) - 1] = '\0';
+    cap->target_order = IndexedWindowOrder(cap->target);
+    strncpy(cap->target_class, IndexedWindowClass(cap->target).c_str(), sizeof(cap->target_class) - 1);
+    cap->target_class[sizeof(cap->target_class) - 1] = '\0';
+    cap->target_lost = 0;
+    cap->target_destroyed = 0;
+    cap->original_target = 0;
+    cap->original_remapped = 0;
+}
+
+static void MarkTargetLostLocked(LinuxCapture* cap, bool destroyed)
+{
+    if (destroyed && !cap->target_destroyed)
+    {
+        cap->target_destroyed = 1;
+        // The server freed the damage objects with the window.
+        cap->damage = 0;
+        for (int i = 0; i < cap->probe_count; i++)
+        {
+            if (cap->probes[i].window == cap->target)
+                cap->probes[i].damage = 0;
+        }
+        if (cap->source)
+        {
+            pthread_mutex_lock(&g_capture_manager.sources_mutex);
+            cap->source->destroyed = 1;
+            pthread_mutex_unlock(&g_capture_manager.sources_mutex);
+        }
+    }
+
+    if (cap->target_lost)
+        return;
+
+    EndSurfaceProbeLocked(cap);
+    cap->target_lost = 1;
+    cap->lost_w = cap->cached_target_w;
+    cap->lost_h = cap->cached_target_h;
+    cap->reacquire_start_ns = MonotonicNowNs();
+    cap->reacquire_checked_ns = 0;
+    LogNative("target 0x%lx %s; waiting for a replacement", cap->target, destroyed ? "destroyed" : "unmapped");
+}
+
+// Moves the session to replacement without a gap: its source is built while
+// the old one is still held (and the last frame still shown), then the old
+// one is released and the new target renders in the same tick.
+static bool HandOffTargetLocked(LinuxCapture* cap, Window replacement)
+{
+    LinuxCaptureSource* source = AcquireCaptureSource(cap, replacement);
+    if (!source)
+    {
+        LogNative("handoff to 0x%lx failed: %s", replacement, cap->backend_detail);
+        return false;
+    }
+    AddWindowEventMasks(XGetXCBConnection(cap->display), std::vector<Window>(1, replacement), XCB_EVENT_MASK_STRUCTURE_NOTIFY);
+
+    // Moving into a child of the hidden top-level leaves it hidden rather
+    // than flashing it back for a frame.
+    const bool keepHidden =
+        cap->target_hidden_offscreen && !cap->target_destroyed && GetTopLevelWindow(cap->display, replacement) == cap->hidden_window;
+    LinuxCaptureSource* previousSource = cap->source;
+    if (!keepHidden)
+        RestoreTargetFromOffscreenIfNeeded(cap);
+    if (cap->damage != 0)
+    {
+        XDamageDestroy(cap->display, cap->damage);
+        cap->damage = 0;
+    }
+    StopPresentTiming(cap);
+
+    cap->source = source;
+    cap->composite_pixmap = source->pixmap;
+    cap->glx_pixmap = source->glx_pixmap;
+    cap->glx_pixmap_rgba = source->rgba;
+    cap->target = replacement;
+    ReleaseCaptureSource(cap, previousSource);
+
+    cap->target_lost = 0;
+    cap->target_destroyed = 0;
+    cap->target_geometry_dirty = 1;
+    cap->target_viewable = 1;
+    cap->input_origin_valid = 0;
+    cap->input_buttons = 0;
+    cap->input_inside = 0;
+    cap->cached_target_w = 0;
+    cap->cached_target_h = 0;
+    cap->source_timing = SourceTimingNone;
+    cap->source_frame_ns = 0;
+    cap->damage_frame_seen = 0;
+    cap->damage_frame_visible = 0;
+    cap->render_dirty_valid = 0;
+    cap->render_dirty_full = 1;
+    cap->visible_source_valid = 0;
+    cap->last_render_state_valid = 0;
+    cap->redraw_history_count = 0;
+    cap->fingerprint_valid = 0;
+    ResetContentBarCropLocked(cap);
+    if (cap->damage_event_base >= 0)
+        cap->damage = XDamageCreate(cap->display, replacement, XDamageReportBoundingBox);
+    StartPresentTiming(cap, replacement);
+    HideTargetOffscreenIfRequested(cap);
+    cap->gpu_frame_pending = 1;
+    return true;
+}
+
+// Once the probe has watched long enough and one window clearly produces
+// the frames, moves the capture there.
+static void UpdateSurfaceProbeLocked(LinuxCapture* cap, uint64_t now)
+{
+    if (cap->probe_count == 0 || now - cap->probe_start_ns < kSurfaceProbeNs)
+        return;
+
+    aes_native::SurfaceProbeSample samples[kMaxProbeSurfaces];
+    for (int i = 0; i < cap->probe_count; i++)
+        samples[i] = cap->probes[i].sample;
+    const int pick = aes_native::PickRenderSurface(samples, static_cast<size_t>(cap->probe_count));
+    if (pick < 0 && now - cap->probe_start_ns < kSurfaceProbeMaxNs)
+        return;
+
+    const Window chosen = pick >= 0 ? cap->probes[pick].window : 0;
+    for (int i = 0; i < cap->probe_count; i++)
+    {
+        LogNative("surface probe: 0x%lx area=%llu frames=%u damaged=%llu%s", cap->probes[i].window,
+                  static_cast<unsigned long long>(samples[i].window_area), samples[i].frames,
+                  static_cast<unsigned long long>(samples[i].damaged_pixels), i == pick ? " (picked)" : "");
+    }
+    EndSurfaceProbeLocked(cap);
+
+    const Window previous = cap->target;
+    if (chosen != 0 && chosen != cap->target && HandOffTargetLocked(cap, chosen))
+    {
+        cap->surface_switches++;
+        LogNative("render surface: 0x%lx -> 0x%lx", previous, chosen);
+    }
+}
+
+// Goes back to a replaced target that was only unmapped once it maps again.
+static void ReturnToOriginalTargetLocked(LinuxCapture* cap)
+{
+    if (!cap->original_remapped || cap->original_target == 0 || !cap->active || cap->backend_mode != BackendGpuComposite)
+        return;
+    cap->original_remapped = 0;
+
+    const Window previous = cap->target;
+    const Window original = cap->original_target;
+    if (!HandOffTargetLocked(cap, original))
+        return;
+    cap->original_target = 0;
+    cap->target_order = cap->original_order;
+    LogNative("target 0x%lx mapped again; back from 0x%lx", original, previous);
+}
+
+// Looks for a window the target's client created after it, at most every
+// kReacquirePollNs; an unmapped target first gets kUnmapGraceNs to come
+// back. Only a mapped one is taken, so a window still being set up does not
+// replace the last frame with a blank one.
+static void ReacquireTargetLocked(LinuxCapture* cap, uint64_t now)
+{
+    if (!cap->target_lost || !cap->auto_reacquire || !cap->active || cap->backend_mode != BackendGpuComposite)
+        return;
+    if (!cap->target_destroyed && now - cap->reacquire_start_ns < kUnmapGraceNs)
+        return;
+    if (cap->reacquire_checked_ns != 0 && now - cap->reacquire_checked_ns < kReacquirePollNs)
+        return;
+    cap->reacquire_checked_ns = now;
+
+    std::vector<LinuxReplacementCandidate> candidates = FindReplacementCandidates(
+        static_cast<pid_t>(cap->target_pid), cap->target_hint, cap->target_class, cap->target_order, cap->target);
+    // A lost child falls back to its top-level, where the next probe finds
+    // the new render surface.
+    if (cap->probe_root != 0 && cap->probe_root != cap->target)
+        candidates.push_back({ cap->probe_root, 0, true });
+    if (candidates.empty())
+        return;
+
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    std::vector<xcb_get_window_attributes_cookie_t> cookies(candidates.size());
+    std::vector<xcb_get_geometry_cookie_t> geometryCookies(candidates.size());
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        cookies[i] = xcb_get_window_attributes(conn, static_cast<xcb_window_t>(candidates[i].window));
+        geometryCookies[i] = xcb_get_geometry(conn, static_cast<xcb_drawable_t>(candidates[i].window));
+    }
+    CountRoundTrip();
+    Window replacement = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+        xcb_generic_error_t* error = nullptr;
+        xcb_get_window_attributes_reply_t* reply = xcb_get_window_attributes_reply(conn, cookies[i], &error);
+        free(error);
+        error = nullptr;
+        xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(conn, geometryCookies[i], &error);
+        free(error);
+
+        // A class match alone also fits the client's dialogs; those are
+        // smaller than the picture they would replace. Bigger is fine: the
+        // window may have been recreated fullscreen.
+        const bool sizeFits = candidates[i].titled ||
+                              (geometry && geometry->width * 2 >= cap->lost_w && geometry->height * 2 >= cap->lost_h);
+        if (replacement == 0 && reply && geometry && sizeFits && reply->map_state == XCB_MAP_STATE_VIEWABLE &&
+            reply->_class == XCB_WINDOW_CLASS_INPUT_OUTPUT)
+            replacement = candidates[i].window;
+        free(reply);
+        free(geometry);
+    }
+
+    const Window previous = cap->target;
+    const bool previousDestroyed = cap->target_destroyed != 0;
+    const uint64_t previousOrder = cap->target_order;
+    if (replacement == 0 || !HandOffTargetLocked(cap, replacement))
+        return;
+
+    // The first target replaced while still alive is the one to return to.
+    if (!previousDestroyed && cap->original_target == 0 && previous != cap->probe_root)
+    {
+        cap->original_target = previous;
+        cap->original_order = previousOrder;
+        cap->original_remapped = 0;
+    }
+    if (replacement != cap->probe_root)
+    {
+        cap->target_order = IndexedWindowOrder(replacement);
+        const std::string wmClass = IndexedWindowClass(replacement);
+        if (!wmClass.empty())
+        {
+            strncpy(cap->target_class, wmClass.c_str(), sizeof(cap->target_class) - 1);
+            cap->target_class[sizeof(cap->target_class) - 1] = '\0';
+        }
+    }
+    cap->reacquisitions++;
+    cap->last_reacquire_ms = static_cast<double>(now - cap->reacquire_start_ns) / 1000000.0;
+    SetStatusText(cap, "Capturing (X11/XWayland GPU composite)");
+    LogNative("target reacquired: 0x%lx -> 0x%lx after %.1f ms", previous, replacement, cap->last_reacquire_ms);
+    StartSurfaceProbeLocked(cap, now);
+}
+
+// Scheduler events are broadcast to every session; each picks out what
+// concerns its own windows, damage and outputs.
+static void HandleXEventLocked(LinuxCapture* cap, XEvent& ev)
+{
+    if (cap->randr_supported &&
+        (ev.type == cap->randr_event_base + RRScreenChangeNotify || ev.type == cap->randr_event_base + RRNotify))
+    {
+        if (ev.type == cap->randr_event_base + RRScreenChangeNotify)
+            XRRUpdateConfiguration(&ev);
+        cap->display_refresh_dirty = 1;
+        return;
+    }
+
+    if (ev.type == VisibilityNotify &&
+        (ev.xvisibility.window == cap->window || (cap->host_toplevel != 0 && ev.xvisibility.window == cap->host_toplevel)))
+    {
+        const int obscured = ev.xvisibility.state == VisibilityFullyObscured ? 1 : 0;
+        if (ev.xvisibility.window == cap->window)
+            cap->host_obscured = obscured;
+        else
+            cap->toplevel_obscured = obscured;
+        return;
+    }
+
+    if (cap->host_toplevel != 0 &&
+        ((ev.type == PropertyNotify && ev.xproperty.window == cap->host_toplevel &&
+          ev.xproperty.atom == g_capture_manager.atoms.net_wm_state) ||
+         (ev.type == MapNotify && ev.xmap.window == cap->host_toplevel) ||
+         (ev.type == UnmapNotify && ev.xunmap.window == cap->host_toplevel)))
+    {
+        cap->toplevel_state_dirty = 1;
+        return;
+    }
+
+    if (ev.type == ConfigureNotify && cap->view != 0 && ev.xconfigure.window == cap->view)
+    {
+        if (cap->window != 0)
+            XResizeWindow(cap->display, cap->window, std::max(1, ev.xconfigure.width), std::max(1, ev.xconfigure.height));
+        return;
+    }
+
+    // An unmapped view gets no VisibilityNotify until it is mapped again.
+    if (ev.type == UnmapNotify && (ev.xunmap.window == cap->window || (cap->view != 0 && ev.xunmap.window == cap->view)))
+        cap->host_obscured = 1;
+    else if (ev.type == MapNotify && (ev.xmap.window == cap->window || (cap->view != 0 && ev.xmap.window == cap->view)))
+        cap->host_obscured = 0;
+
+    if (cap->host_toplevel != 0 &&
+        ((ev.type == ConfigureNotify && ev.xconfigure.window == cap->host_toplevel) ||
+         (ev.type == ReparentNotify && ev.xreparent.window == cap->host_toplevel)))
+    {
+        cap->display_refresh_dirty = 1;
+        return;
+    }
+
+    if (ev.type == ConfigureNotify && ev.xconfigure.window == cap->window)
+        cap->display_refresh_dirty = 1;
+
+    if (cap->backend_mode == BackendReparentFallback &&
+        ev.type == ConfigureNotify &&
+        ev.xconfigure.window == cap->window)
+    {
+        UpdateFallbackTargetGeometry(cap);
+        return;
+    }
+
+    if (cap->backend_mode == BackendGpuComposite)
+    {
+        // Resizes and drags send a stream of ConfigureNotify; take the size
+        // from the event instead of querying it back.
+        if (ev.type == ConfigureNotify && ev.xconfigure.window == cap->window)
+        {
+            cap->cached_host_w = std::max(1, ev.xconfigure.width);
+            cap->cached_host_h = std::max(1, ev.xconfigure.height);
+        }
+        else if (ev.type == ConfigureNotify && ev.xconfigure.window == cap->target)
+        {
+            cap->cached_target_w = std::max(1, ev.xconfigure.width);
+            cap->cached_target_h = std::max(1, ev.xconfigure.height);
+            cap->input_origin_valid = 0;
+        }
+        else if (ev.type == MapNotify && ev.xmap.window == cap->target)
+        {
+            cap->target_viewable = 1;
+            cap->target_geometry_dirty = 1;
+            if (cap->target_lost && !cap->target_destroyed)
+            {
+                cap->target_lost = 0;
+                LogNative("target 0x%lx mapped again", cap->target);
+            }
+        }
+        else if (ev.type == MapNotify && cap->original_target != 0 && ev.xmap.window == cap->original_target)
+        {
+            cap->original_remapped = 1;
+        }
+        else if (ev.type == DestroyNotify && cap->original_target != 0 && ev.xdestroywindow.window == cap->original_target)
+        {
+            cap->original_target = 0;
+            cap->original_remapped = 0;
+        }
+        else if ((ev.type == UnmapNotify && ev.xunmap.window == cap->target) ||
+                 (ev.type == DestroyNotify && ev.xdestroywindow.window == cap->target))
+        {
+            cap->target_viewable = 0;
+            cap->target_geometry_dirty = 1;
+            MarkTargetLostLocked(cap, ev.type == DestroyNotify);
+        }
+    }
+
+    if (cap->probe_count > 0 && cap->damage_event_base >= 0 && ev.type == cap->damage_event_base + XDamageNotify)
+    {
+        const XDamageNotifyEvent* damageEv = reinterpret_cast<const XDamageNotifyEvent*>(&ev);
+        for (int i = 0; i < cap->probe_count; i++)
+        {
+            if (cap->probes[i].damage != damageEv->damage)
+                continue;
+            XDamageSubtract(cap->display, cap->probes[i].damage, None, None);
+            cap->probes[i].sample.OnDamage(MonotonicNowNs(), static_cast<uint64_t>(damageEv->area.width) * damageEv->area.height);
+            return;
+        }
+    }
+    else if (cap->probe_count > 0 && ev.type == DestroyNotify)
+    {
+        for (int i = 0; i < cap->probe_count; i++)
+        {
+            if (cap->probes[i].window == ev.xdestroywindow.window)
+                cap->probes[i].damage = 0;
+        }
+    }
+
+    if (cap->damage != 0 && cap->damage_event_base >= 0 && ev.type == cap->damage_event_base + XDamageNotify)
+    {
+        const XDamageNotifyEvent* damageEv = reinterpret_cast<const XDamageNotifyEvent*>(&ev);
+        if (damageEv->damage != cap->damage)
+            return;
+
+        XDamageSubtract(cap->display, cap->damage, None, None);
+        const bool damageVisible = HandleDamageAreaLocked(cap, damageEv->area);
+
+        const uint64_t nowEvent = MonotonicNowNs();
+        if (HasRecentPresentTiming(cap, nowEvent))
+        {
+            // Present CompleteNotify times this frame; damage only decides
+            // which part of it needs redrawing.
+            return;
+        }
+
+        if (!damageVisible)
+        {
+            // Damage outside the shown region must not feed the cadence
+            // estimate either, or a blinking OSD would read as source fps.
+            cap->cropped_damage_skips++;
+            return;
+        }
+
+        if (cap->source_last_event_ns != 0 && nowEvent > cap->source_last_event_ns)
+        {
+            const uint64_t dtNs = nowEvent - cap->source_last_event_ns;
+
+            // XDamage can emit duplicate notifies for a single source frame.
+            if (dtNs >= aes_native::MinFrameEventIntervalNs(cap->source_frame_time_ms, cap->display_refresh_hz))
+            {
+                const double dt = static_cast<double>(dtNs) / 1000000000.0;
+                cap->source_fps = aes_native::SmoothFrameRate(cap->source_fps, dt);
+                UpdateSourceFrameTimeLocked(cap);
+                cap->source_last_event_ns = nowEvent;
+                RecordSourceFrame(cap, nowEvent, SourceTimingDamage);
+            }
+        }
+        else
+        {
+            cap->source_last_event_ns = nowEvent;
+            RecordSourceFrame(cap, nowEvent, SourceTimingDamage);
+        }
+        cap->gpu_frame_pending = 1;
+    }
+}
+
+// One scheduler pass for a session: collects Present events, decides whether
+// a frame is due and renders it. Returns how long the session can wait
+// before its next pass.
+static useconds_t TickCaptureLocked(LinuxCapture* cap, bool* rendered)
+{
+    PumpPresentEventsLocked(cap);
+    PumpHostPresentEventsLocked(cap);
+
+    const uint64_t now = MonotonicNowNs();
+    UpdateDisplayRefreshLocked(cap, now);
+    UpdateHostVisibilityLocked(cap);
+    ReturnToOriginalTargetLocked(cap);
+    ReacquireTargetLocked(cap, now);
+    UpdateSurfaceProbeLocked(cap, now);
+
+    // A destroyed target has nothing left to bind; the view keeps its last
+    // frame until a replacement turns up.
+    bool shouldRender = cap->active && cap->backend_mode == BackendGpuComposite && cap->target != 0 && !cap->target_destroyed;
+    bool disableVsync = cap->disable_vsync != 0;
+    bool hasSwapControl = cap->has_swap_control != 0;
+    bool pendingFrame = cap->gpu_frame_pending != 0;
+
+    if (cap->source_last_event_ns != 0)
+    {
+        const double elapsed = static_cast<double>(now - cap->source_last_event_ns) / 1000000000.0;
+        if (elapsed >= SourceFpsDecaySeconds(cap))
+        {
+            cap->source_fps *= 0.94;
+            if (cap->source_fps < 0.1)
+                cap->source_fps = 0.0;
+            cap->source_frame_time_ms = cap->source_fps > 0.0 ? 1000.0 / cap->source_fps : 0.0;
+            cap->source_last_event_ns = now;
+        }
+    }
+
+    // Present timestamps are exact; only the damage estimate needs snapping.
+    cap->fps = cap->source_timing == SourceTimingPresent
+        ? cap->source_fps
+        : aes_native::StabilizeReportedFps(aes_native::SnapFrameRateToRefresh(cap->source_fps, cap->display_refresh_hz));
+    cap->frame_time_ms = cap->fps > 0.0 ? 1000.0 / cap->fps : 0.0;
+
+    // Keep periodic presents for compositor pacing at the refresh of the
+    // monitor the host is on (twice that with VSync off).
+    // Do not fall back to 33ms pacing while active: that feels like forced 30fps.
+    const uint64_t refreshNs = DisplayRefreshPeriodNs(cap);
+    const uint64_t periodicNs = disableVsync ? refreshNs / 2 : refreshNs;
+    // In VRR mode the display refreshes when we present, so presents follow
+    // source frames only; a periodic present would insert an odd-length refresh.
+    // A pending screenshot still forces one, VRR or not: it needs a frame to
+    // start and a later one to collect its readback, and a paused emulator
+    // sends neither.
+    const bool screenshotPending = cap->screenshot_readback.pending || cap->screenshot_queue_count > 0;
+    bool forcePeriodic = shouldRender && ((!cap->vrr_active && cap->source_fps > 0.0) || screenshotPending) &&
+                         (cap->last_render_ns == 0 || (now - cap->last_render_ns) > periodicNs);
+    // Headless output is never shown, so only wake to collect readbacks.
+    if (cap->headless)
+        forcePeriodic = shouldRender && (cap->output_readback.pending || cap->preview_readback.pending || screenshotPending);
+    bool renderNow = shouldRender && (pendingFrame || forcePeriodic);
+
+    // Nobody can see the view: no binds, shader passes or presents until it
+    // is exposed again (source fps above keeps updating). Screenshots still
+    // render.
+    if (renderNow && cap->host_occluded && !screenshotPending)
+    {
+        if (pendingFrame)
+            cap->occluded_skips++;
+        cap->gpu_frame_pending = 0;
+        *rendered = false;
+        return 4000;
+    }
+
+    // The previous swap has not reached the screen yet; the frame stays
+    // pending for a later pass instead of waiting inside the swap.
+    if (renderNow && !cap->headless && HostSwapPendingLocked(cap, now, refreshNs))
+    {
+        *rendered = false;
+        return 500;
+    }
+
+    if (renderNow)
+        cap->gpu_frame_pending = 0;
+
+    // With exact Present timing we know when the next source frame is due,
+    // so idle polling can sleep until shortly before it instead of every 1 ms.
+    useconds_t idleSleepUs = 1000;
+    if (!renderNow && cap->source_timing == SourceTimingPresent && HasRecentPresentTiming(cap, now) &&
+        cap->source_frame_time_ms > 0.0 && cap->source_frame_ns != 0)
+    {
+        const uint64_t intervalNs = static_cast<uint64_t>(cap->source_frame_time_ms * 1000000.0);
+        const uint64_t dueNs = cap->source_frame_ns + intervalNs;
+        if (dueNs > now + 1500000ULL)
+            idleSleepUs = static_cast<useconds_t>(std::min<uint64_t>((dueNs - now - 1000000ULL) / 1000ULL, 4000ULL));
+        else
+            idleSleepUs = 250;
+    }
+    *rendered = renderNow;
+    if (!renderNow)
+        return idleSleepUs;
+
+    RenderCompositeFrame(cap);
+    if (disableVsync)
+        return 1000;
+    if (!hasSwapControl)
+        return 2000;
+    return 500;
+}
+
+static const char* RenderThreadModeName(int mode)
+{
+    switch (mode)
+    {
+    case RenderThreadRaised:
+        return "raised";
+    case RenderThreadRealtime:
+        return "realtime";
+    default:
+        return "normal";
+    }
+}
+
+static pid_t CurrentThreadId()
+{
+    return static_cast<pid_t>(syscall(SYS_gettid));
+}
+
+static void InitRenderThreadTuning(LinuxRenderThreadTuning* tuning)
+{
+    memset(tuning, 0, sizeof(*tuning));
+    errno = 0;
+    const int nice = getpriority(PRIO_PROCESS, static_cast<id_t>(CurrentThreadId()));
+    tuning->base_nice = errno == 0 ? nice : 0;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(tuning->base_cpus), &tuning->base_cpus) != 0)
+    {
+        CPU_ZERO(&tuning->base_cpus);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            CPU_SET(cpu, &tuning->base_cpus);
+    }
+}
+
+// Moves the calling (scheduler) thread to the mode asked for, or as close as
+// its limits allow. Unprivileged threads get SCHED_RR up to RLIMIT_RTPRIO and
+// nice values down to 20 - RLIMIT_NICE, which is what limits.conf, gamemode
+// and rtkit-style setups hand out; without either the thread stays normal.
+static void ApplyRenderThreadMode(LinuxRenderThreadTuning* tuning, int request)
+{
+    const id_t tid = static_cast<id_t>(CurrentThreadId());
+    int mode = RenderThreadNormal;
+
+    if (request == RenderThreadRealtime)
+    {
+        int priority = kRealtimePriority;
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur > 0)
+            priority = std::min(priority, static_cast<int>(limit.rlim_cur));
+        priority = std::max(std::min(priority, sched_get_priority_max(SCHED_RR)), sched_get_priority_min(SCHED_RR));
+
+        sched_param param = {};
+        param.sched_priority = priority;
+        const int err = pthread_setschedparam(pthread_self(), SCHED_RR, &param);
+        if (err == 0)
+        {
+            mode = RenderThreadRealtime;
+            tuning->realtime = 1;
+            LogNative("render thread: SCHED_RR priority %d", priority);
+        }
+        else
+        {
+            LogNative("render thread: SCHED_RR refused (%s), trying nice", strerror(err));
+        }
+    }
+    if (mode != RenderThreadRealtime && tuning->realtime)
+    {
+        sched_param param = {};
+        pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+        tuning->realtime = 0;
     }
 
-    if (!fbc || fbCount == 0)
-        fbc = glXChooseFBConfig(cap->display, cap->screen, fbAttribsAlpha, &fbCount);
-    if ((!fbc || fbCount == 0) && fbc)
+    if (mode == RenderThreadNormal && request != RenderThreadNormal)
     {
-        XFree(fbc);
-        fbc = nullptr;
+        int nice = std::min(kRaisedNice, tuning->base_nice);
+        bool raised = setpriority(PRIO_PROCESS, tid, nice) == 0;
+        struct rlimit limit;
+        if (!raised && getrlimit(RLIMIT_NICE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+        {
+            nice = 20 - static_cast<int>(limit.rlim_cur);
+            raised = nice < tuning->base_nice && setpriority(PRIO_PROCESS, tid, nice) == 0;
+        }
+        if (raised)
+        {
+            mode = RenderThreadRaised;
+            tuning->nice_raised = 1;
+            LogNative("render thread: nice %d", nice);
+        }
+        else
+        {
+            LogNative("render thread: no higher priority allowed (%s)", strerror(errno));
+        }
+    }
+    if (mode != RenderThreadRaised && tuning->nice_raised)
+    {
+        setpriority(PRIO_PROCESS, tid, tuning->base_nice);
+        tuning->nice_raised = 0;
     }
 
-    if (!fbc || fbCount == 0)
-        fbc = glXChooseFBConfig(cap->display, cap->screen, fbAttribsNoAlpha, &fbCount);
+    tuning->mode_request = request;
+    tuning->mode = mode;
+    LogNative("render thread: %s (asked %s)", RenderThreadModeName(mode), RenderThreadModeName(request));
+}
 
-    if (!fbc || fbCount == 0)
+static void PinRenderThread(LinuxRenderThreadTuning* tuning, const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    uint64_t mask = 0;
+    std::string list;
+    for (int cpu : cpus)
     {
-        if (fbc)
-            XFree(fbc);
-        SetBackendDetail(cap, "glXChooseFBConfig failed");
-        LogNative("glXChooseFBConfig failed on screen=%d", cap->screen);
+        CPU_SET(cpu, &set);
+        if (cpu < 64)
+            mask |= 1ULL << cpu;
+        list += (list.empty() ? "" : ",") + std::to_string(cpu);
+    }
+
+    const int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+    {
+        LogNative("render thread: pinning to %s failed (%s)", list.c_str(), strerror(err));
+        return;
+    }
+    tuning->cpu_mask = mask;
+    LogNative("render thread: pinned to CPU %s", list.c_str());
+}
+
+static void UnpinRenderThread(LinuxRenderThreadTuning* tuning)
+{
+    if (tuning->cpu_mask == 0)
+        return;
+    pthread_setaffinity_np(pthread_self(), sizeof(tuning->base_cpus), &tuning->base_cpus);
+    tuning->cpu_mask = 0;
+    LogNative("render thread: unpinned");
+}
+
+// CPU time the target's threads spent since the last call, charged to the
+// CPU each last ran on. False on the first call for a process, which only
+// records the baseline, and when it cannot be read.
+static bool SampleTargetCpuLoad(LinuxRenderThreadTuning* tuning, pid_t pid, std::vector<uint64_t>* busy)
+{
+    if (pid != tuning->tasks_pid)
+    {
+        tuning->tasks_pid = pid;
+        tuning->task_count = 0;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/task", static_cast<int>(pid));
+    DIR* dir = opendir(path);
+    if (!dir)
         return false;
+
+    const bool haveBaseline = tuning->task_count > 0;
+    LinuxTaskTicks seen[kMaxTrackedTasks];
+    int seenCount = 0;
+    busy->clear();
+    while (seenCount < kMaxTrackedTasks)
+    {
+        const dirent* entry = readdir(dir);
+        if (!entry)
+            break;
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            continue;
+
+        char statPath[96];
+        snprintf(statPath, sizeof(statPath), "/proc/%d/task/%s/stat", static_cast<int>(pid), entry->d_name);
+        FILE* file = fopen(statPath, "r");
+        if (!file)
+            continue;
+        char line[1024];
+        const bool read = fgets(line, sizeof(line), file) != nullptr;
+        fclose(file);
+
+        int processor = -1;
+        uint64_t ticks = 0;
+        if (!read || !aes_native::ParseTaskStat(line, &processor, &ticks) || processor < 0)
+            continue;
+
+        const pid_t tid = static_cast<pid_t>(atoi(entry->d_name));
+        for (int i = 0; i < tuning->task_count; i++)
+        {
+            if (tuning->tasks[i].tid != tid || ticks < tuning->tasks[i].ticks)
+                continue;
+            if (busy->size() <= static_cast<size_t>(processor))
+                busy->resize(processor + 1, 0);
+            (*busy)[processor] += ticks - tuning->tasks[i].ticks;
+            break;
+        }
+        seen[seenCount++] = { tid, ticks };
     }
+    closedir(dir);
 
-    cap->fb_config = fbc[0];
-    XFree(fbc);
+    memcpy(tuning->tasks, seen, sizeof(seen[0]) * seenCount);
+    tuning->task_count = seenCount;
+    return haveBaseline;
+}
+
+// Pins the scheduler thread to the CPUs asked for: an explicit list, "auto"
+// for the cores the target's threads used least over the last interval, or
+// none. An automatic choice is revisited every kCpuChoiceIntervalNs.
+static void UpdateRenderThreadCpus(LinuxRenderThreadTuning* tuning, const char* request, pid_t targetPid, uint64_t now)
+{
+    const bool changed = strcmp(tuning->cpus_request, request) != 0;
+    if (changed)
+    {
+        strncpy(tuning->cpus_request, request, sizeof(tuning->cpus_request) - 1);
+        tuning->cpus_request[sizeof(tuning->cpus_request) - 1] = '\0';
+        tuning->cpus_checked_ns = 0;
+    }
+
+    if (request[0] == '\0')
+    {
+        UnpinRenderThread(tuning);
+        return;
+    }
+
+    const bool automatic = strcmp(request, "auto") == 0;
+    if (automatic ? tuning->cpus_checked_ns != 0 && now - tuning->cpus_checked_ns < kCpuChoiceIntervalNs : !changed)
+        return;
+    tuning->cpus_checked_ns = now;
+
+    std::vector<int> allowed;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &tuning->base_cpus))
+            allowed.push_back(cpu);
+    }
+
+    if (!automatic)
+    {
+        std::vector<int> listed;
+        std::vector<int> cpus;
+        aes_native::ParseCpuList(request, CPU_SETSIZE, &listed);
+        std::set_intersection(listed.begin(), listed.end(), allowed.begin(), allowed.end(), std::back_inserter(cpus));
+        if (cpus.empty())
+        {
+            LogNative("render thread: none of CPU %s is available", request);
+            UnpinRenderThread(tuning);
+            return;
+        }
+        PinRenderThread(tuning, cpus);
+        return;
+    }
+
+    std::vector<uint64_t> busy;
+    if (targetPid <= 0 || allowed.size() < 2 || !SampleTargetCpuLoad(tuning, targetPid, &busy))
+        return;
+
+    // A quarter of the CPUs, at least two once there are four, leaves the
+    // thread room to move when one of them gets busy.
+    const size_t count = allowed.size() >= 4 ? std::max<size_t>(2, allowed.size() / 4) : 1;
+    const std::vector<int> cpus = aes_native::PickQuietCpus(allowed, busy, count);
+    uint64_t mask = 0;
+    for (int cpu : cpus)
+    {
+        if (cpu < 64)
+            mask |= 1ULL << cpu;
+    }
+    if (mask != tuning->cpu_mask)
+        PinRenderThread(tuning, cpus);
+}
+
+static void RecordWakeLateness(LinuxRenderThreadTuning* tuning, uint64_t now, uint64_t lateNs)
+{
+    const double lateMs = static_cast<double>(lateNs) / 1000000.0;
+    tuning->wake_late_ms = tuning->wake_late_ms > 0.0 ? tuning->wake_late_ms * 0.95 + lateMs * 0.05 : lateMs;
+    tuning->wake_window_max_ms = std::max(tuning->wake_window_max_ms, lateMs);
+    if (now - tuning->wake_window_start_ns >= kWakeLateWindowNs)
+    {
+        tuning->wake_late_max_ms = tuning->wake_window_max_ms;
+        tuning->wake_window_max_ms = 0.0;
+        tuning->wake_window_start_ns = now;
+    }
+}
+
+static void* CaptureSchedulerMain(void* arg)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    const uint64_t generation = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(arg));
+    pthread_setname_np(pthread_self(), "aes-capture");
+    LinuxRenderThreadTuning tuning;
+    InitRenderThreadTuning(&tuning);
+
+    pthread_mutex_lock(&manager.mutex);
+    while (manager.scheduler_generation == generation)
+    {
+        if (manager.release_session)
+        {
+            // A session is being destroyed on another thread, which needs its
+            // context to be current nowhere.
+            glXMakeCurrent(manager.display, None, nullptr);
+            manager.current_session = nullptr;
+            manager.release_session = nullptr;
+            pthread_cond_broadcast(&manager.cond);
+        }
+
+        int eventCount = 0;
+        while (eventCount < kMaxSchedulerEvents && XPending(manager.display) > 0)
+            XNextEvent(manager.display, &manager.events[eventCount++]);
+        UpdateWindowIndex(manager.display, manager.events, eventCount);
+
+        useconds_t sleepUs = manager.session_count > 0 ? 4000 : 10000;
+        // The thread takes the highest mode any session asks for and the
+        // first CPU choice.
+        int modeRequest = RenderThreadNormal;
+        char cpusRequest[sizeof(tuning.cpus_request)] = "";
+        pid_t targetPid = 0;
+        for (int i = 0; i < manager.session_count; i++)
+        {
+            LinuxCapture* cap = manager.sessions[i];
+            pthread_mutex_lock(&cap->mutex);
+            modeRequest = std::max(modeRequest, cap->render_thread_request);
+            if (cpusRequest[0] == '\0' && cap->render_thread_cpus_request[0] != '\0')
+                memcpy(cpusRequest, cap->render_thread_cpus_request, sizeof(cpusRequest));
+            if (targetPid <= 0 && cap->target_pid > 0)
+                targetPid = cap->target_pid;
+            cap->render_thread_mode = tuning.mode;
+            cap->render_thread_cpus = tuning.cpu_mask;
+            cap->wake_late_ms = tuning.wake_late_ms;
+            cap->wake_late_max_ms = tuning.wake_late_max_ms;
+            for (int e = 0; e < eventCount; e++)
+                HandleXEventLocked(cap, manager.events[e]);
+
+            bool rendered = false;
+            const uint64_t roundTrips = t_round_trips;
+            sleepUs = std::min(sleepUs, TickCaptureLocked(cap, &rendered));
+            cap->round_trips += t_round_trips - roundTrips;
+            if (rendered)
+            {
+                manager.current_session = cap;
+                cap->render_passes++;
+            }
+            pthread_mutex_unlock(&cap->mutex);
+        }
+
+        pthread_mutex_unlock(&manager.mutex);
+        if (modeRequest != tuning.mode_request)
+            ApplyRenderThreadMode(&tuning, modeRequest);
+        UpdateRenderThreadCpus(&tuning, cpusRequest, targetPid, MonotonicNowNs());
+        DeliverWindowWatches();
+        const uint64_t sleepStartNs = MonotonicNowNs();
+        usleep(sleepUs);
+        const uint64_t wokeNs = MonotonicNowNs();
+        const uint64_t sleptNs = wokeNs - sleepStartNs;
+        RecordWakeLateness(&tuning, wokeNs, sleptNs > sleepUs * 1000ULL ? sleptNs - sleepUs * 1000ULL : 0);
+        pthread_mutex_lock(&manager.mutex);
+    }
+    pthread_mutex_unlock(&manager.mutex);
+    return nullptr;
+}
+
+static void StartSchedulerLocked(LinuxCaptureManager& manager)
+{
+    if (manager.scheduler_started)
+        return;
+
+    void* generation = reinterpret_cast<void*>(static_cast<uintptr_t>(manager.scheduler_generation));
+    manager.scheduler_started = pthread_create(&manager.scheduler_thread, nullptr, CaptureSchedulerMain, generation) == 0 ? 1 : 0;
+    LogNative("capture scheduler %s", manager.scheduler_started ? "started" : "failed to start");
+}
+
+static void InternAtoms(xcb_connection_t* conn, LinuxAtoms* atoms)
+{
+    struct
+    {
+        const char* name;
+        xcb_atom_t* atom;
+    } table[] = {
+        { "_NET_WM_PID", &atoms->net_wm_pid },
+        { "_NET_WM_NAME", &atoms->net_wm_name },
+        { "_NET_CLIENT_LIST", &atoms->net_client_list },
+        { "_NET_WM_WINDOW_OPACITY", &atoms->net_wm_window_opacity },
+        { "_NET_WM_STATE", &atoms->net_wm_state },
+        { "_NET_WM_STATE_SKIP_TASKBAR", &atoms->net_wm_state_skip_taskbar },
+        { "_NET_WM_STATE_SKIP_PAGER", &atoms->net_wm_state_skip_pager },
+        { "_NET_WM_STATE_HIDDEN", &atoms->net_wm_state_hidden },
+        { "_VARIABLE_REFRESH", &atoms->variable_refresh },
+        { "_NET_WM_BYPASS_COMPOSITOR", &atoms->net_wm_bypass_compositor },
+    };
+    const size_t count = sizeof(table) / sizeof(table[0]);
+
+    xcb_intern_atom_cookie_t cookies[sizeof(table) / sizeof(table[0])];
+    for (size_t i = 0; i < count; i++)
+        cookies[i] = xcb_intern_atom(conn, 0, static_cast<uint16_t>(strlen(table[i].name)), table[i].name);
+    CountRoundTrip();
+    for (size_t i = 0; i < count; i++)
+    {
+        xcb_intern_atom_reply_t* reply = xcb_intern_atom_reply(conn, cookies[i], nullptr);
+        *table[i].atom = reply ? reply->atom : static_cast<xcb_atom_t>(XCB_ATOM_NONE);
+        free(reply);
+    }
+}
+
+static bool OpenSharedDisplayLocked(LinuxCaptureManager& manager)
+{
+    if (manager.display)
+        return true;
+
+    manager.display = XOpenDisplay(nullptr);
+    if (!manager.display)
+        return false;
+    InternAtoms(XGetXCBConnection(manager.display), &manager.atoms);
+    LogNativeAt(aes_native::LogLevel::Info, "x11", "capture manager: display opened");
+    return true;
+}
+
+// Opens the shared display for the first capture. Returns null when X is
+// unavailable or kMaxCaptureSessions captures already exist.
+static Display* AcquireCaptureManager()
+{
+    pthread_once(&g_x11_threads_once, InitX11ThreadsOnce);
+    pthread_once(&g_capture_manager_once, InitCaptureManagerOnce);
 
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.mutex);
+    if (manager.refs >= kMaxCaptureSessions)
+    {
+        pthread_mutex_unlock(&manager.mutex);
+        LogNative("capture manager: session limit (%d) reached", kMaxCaptureSessions);
+        return nullptr;
+    }
+
+    if (!OpenSharedDisplayLocked(manager))
+    {
+        pthread_mutex_unlock(&manager.mutex);
+        return nullptr;
+    }
+    manager.refs++;
+    Display* display = manager.display;
+    pthread_mutex_unlock(&manager.mutex);
+    return display;
+}
+
+// Stops the scheduler and closes the display after the last capture, unless
+// the helpers have pinned them.
+static void ReleaseCaptureManager()
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.mutex);
+    if (--manager.refs > 0 || manager.helpers_pinned)
+    {
+        pthread_mutex_unlock(&manager.mutex);
+        return;
+    }
+
+    manager.scheduler_generation++;
+    const bool started = manager.scheduler_started != 0;
+    const pthread_t thread = manager.scheduler_thread;
+    manager.scheduler_started = 0;
+    pthread_mutex_unlock(&manager.mutex);
+
+    if (started)
+        pthread_join(thread, nullptr);
+
+    pthread_mutex_lock(&manager.mutex);
+    // A capture created meanwhile keeps using the connection.
+    if (manager.refs == 0 && !manager.helpers_pinned && manager.display)
+    {
+        if (manager.share_context)
+            glXDestroyContext(manager.display, manager.share_context);
+        manager.share_context = nullptr;
+        manager.fb_config_count = 0;
+        manager.current_session = nullptr;
+        ResetWindowIndex();
+        XCloseDisplay(manager.display);
+        manager.display = nullptr;
+        LogNativeAt(aes_native::LogLevel::Info, "x11", "capture manager: display closed");
+    }
+    pthread_mutex_unlock(&manager.mutex);
+}
+
+// Root of the share group every capture context joins, so GL objects made by
+// one view are usable from the others. Created from the first capture's
+// FBConfig and never made current.
+static GLXContext GetShareContext(LinuxCapture* cap)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.mutex);
+    if (!manager.share_context)
+        manager.share_context = glXCreateNewContext(manager.display, cap->fb_config, GLX_RGBA_TYPE, nullptr, True);
+    GLXContext shareContext = manager.share_context;
+    pthread_mutex_unlock(&manager.mutex);
+    return shareContext;
+}
+
+static void RegisterCaptureSession(LinuxCapture* cap)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.mutex);
+    // AcquireCaptureManager bounds the sessions, so there is room.
+    manager.sessions[manager.session_count++] = cap;
+    StartSchedulerLocked(manager);
+    LogNative("capture session registered: sessions=%d", manager.session_count);
+    pthread_mutex_unlock(&manager.mutex);
+}
+
+// After this returns the scheduler no longer touches cap and its GL context
+// is free to be made current by the caller.
+static void UnregisterCaptureSession(LinuxCapture* cap)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.mutex);
+    for (int i = 0; i < manager.session_count; i++)
+    {
+        if (manager.sessions[i] != cap)
+            continue;
+        manager.sessions[i] = manager.sessions[--manager.session_count];
+        manager.sessions[manager.session_count] = nullptr;
+        break;
+    }
+
+    if (manager.current_session == cap && manager.scheduler_started)
+    {
+        manager.release_session = cap;
+        while (manager.current_session == cap)
+            pthread_cond_wait(&manager.cond, &manager.mutex);
+    }
+    LogNative("capture session unregistered: sessions=%d", manager.session_count);
+    pthread_mutex_unlock(&manager.mutex);
+}
+
+// What creation found out about GL support. The init thread fills it without
+// the session lock, and FinishCaptureInit publishes it under the lock.
+typedef struct
+{
+    int gl_supported;
+    int has_swap_control;
+    int has_swap_control_tear;
+    int has_buffer_age;
+    char detail[256];
+} LinuxCaptureInitResult;
+
+static void SetInitDetail(LinuxCaptureInitResult* result, const char* detail)
+{
+    strncpy(result->detail, detail, sizeof(result->detail) - 1);
+    result->detail[sizeof(result->detail) - 1] = '\0';
+}
+
+static bool CreateHostWindow(LinuxCapture* cap, Window parent, LinuxCaptureInitResult* result)
+{
     XVisualInfo* vi = glXGetVisualFromFBConfig(cap->display, cap->fb_config);
     if (!vi)
     {
-        SetBackendDetail(cap, "glXGetVisualFromFBConfig failed");
+        SetInitDetail(result, "glXGetVisualFromFBConfig failed");
         LogNative("glXGetVisualFromFBConfig failed");
         return false;
     }
@@ -1480,7 +5732,7 @@ static bool InitGlObjects(LinuxCapture* cap, Window parent)
     XSetWindowAttributes swa{};
     swa.colormap = XCreateColormap(cap->display, parent, vi->visual, AllocNone);
     swa.border_pixel = 0;
-    swa.event_mask = StructureNotifyMask;
+    swa.event_mask = StructureNotifyMask | VisibilityChangeMask;
     cap->colormap = swa.colormap;
 
     cap->window = XCreateWindow(cap->display, parent,
@@ -1492,22 +5744,172 @@ static bool InitGlObjects(LinuxCapture* cap, Window parent)
         CWBorderPixel | CWColormap | CWEventMask,
         &swa);
 
-    XFree(vi);
+    XFree(vi);
+
+    if (cap->window == 0)
+    {
+        SetInitDetail(result, "XCreateWindow for capture host failed");
+        LogNative("XCreateWindow for capture host failed");
+        return false;
+    }
+
+    XMapWindow(cap->display, cap->window);
+    XFlush(cap->display);
+    return true;
+}
+
+// Up to three glXChooseFBConfig attempts, strictest first. Returns the
+// server's list (to XFree) or null.
+static GLXFBConfig* ChooseFbConfigs(Display* display, int screen, bool headless, int* count)
+{
+    // Headless captures need a pbuffer instead of a window and never swap.
+    const int drawableType = (headless ? GLX_PBUFFER_BIT : GLX_WINDOW_BIT) | GLX_PIXMAP_BIT;
+    const int doubleBuffer = headless ? static_cast<int>(GLX_DONT_CARE) : True;
+
+    int fbAttribsTextureStrict[] = {
+        GLX_X_RENDERABLE, True,
+        GLX_DRAWABLE_TYPE, drawableType,
+        GLX_RENDER_TYPE, GLX_RGBA_BIT,
+        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+        GLX_RED_SIZE, 8,
+        GLX_GREEN_SIZE, 8,
+        GLX_BLUE_SIZE, 8,
+        GLX_ALPHA_SIZE, 8,
+        GLX_DOUBLEBUFFER, doubleBuffer,
+        GLX_BIND_TO_TEXTURE_RGB_EXT, True,
+        GLX_BIND_TO_TEXTURE_RGBA_EXT, True,
+        GLX_BIND_TO_TEXTURE_TARGETS_EXT, GLX_TEXTURE_2D_BIT_EXT,
+        None
+    };
+    int fbAttribsAlpha[] = {
+        GLX_X_RENDERABLE, True,
+        GLX_DRAWABLE_TYPE, drawableType,
+        GLX_RENDER_TYPE, GLX_RGBA_BIT,
+        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+        GLX_RED_SIZE, 8,
+        GLX_GREEN_SIZE, 8,
+        GLX_BLUE_SIZE, 8,
+        GLX_ALPHA_SIZE, 8,
+        GLX_DOUBLEBUFFER, doubleBuffer,
+        None
+    };
+    int fbAttribsNoAlpha[] = {
+        GLX_X_RENDERABLE, True,
+        GLX_DRAWABLE_TYPE, drawableType,
+        GLX_RENDER_TYPE, GLX_RGBA_BIT,
+        GLX_X_VISUAL_TYPE, GLX_TRUE_COLOR,
+        GLX_RED_SIZE, 8,
+        GLX_GREEN_SIZE, 8,
+        GLX_BLUE_SIZE, 8,
+        GLX_DOUBLEBUFFER, doubleBuffer,
+        None
+    };
+
+    int fbCount = 0;
+    GLXFBConfig* fbc = glXChooseFBConfig(display, screen, fbAttribsTextureStrict, &fbCount);
+    if ((!fbc || fbCount == 0) && fbc)
+    {
+        XFree(fbc);
+        fbc = nullptr;
+    }
+
+    if (!fbc || fbCount == 0)
+        fbc = glXChooseFBConfig(display, screen, fbAttribsAlpha, &fbCount);
+    if ((!fbc || fbCount == 0) && fbc)
+    {
+        XFree(fbc);
+        fbc = nullptr;
+    }
+
+    if (!fbc || fbCount == 0)
+        fbc = glXChooseFBConfig(display, screen, fbAttribsNoAlpha, &fbCount);
+
+    if (fbc && fbCount == 0)
+    {
+        XFree(fbc);
+        fbc = nullptr;
+    }
+    *count = fbCount;
+    return fbc;
+}
+
+// The choice only depends on the screen and on whether a window or pbuffer
+// is drawn to, so it is made once per display.
+static bool GetCachedFbConfig(LinuxCapture* cap, GLXFBConfig* config, LinuxCaptureInitResult* result)
+{
+    LinuxCaptureManager& manager = g_capture_manager;
+    const int slot = cap->headless ? 1 : 0;
+    pthread_mutex_lock(&manager.mutex);
+    for (int i = 0; i < manager.fb_config_count; i++)
+    {
+        const LinuxFbConfigCacheEntry& entry = manager.fb_configs[i];
+        if (entry.screen == cap->screen && entry.headless == slot)
+        {
+            *config = entry.config;
+            pthread_mutex_unlock(&manager.mutex);
+            return true;
+        }
+    }
+    pthread_mutex_unlock(&manager.mutex);
+
+    int fbCount = 0;
+    GLXFBConfig* fbc = ChooseFbConfigs(cap->display, cap->screen, cap->headless != 0, &fbCount);
+    if (!fbc)
+    {
+        SetInitDetail(result, "glXChooseFBConfig failed");
+        LogNative("glXChooseFBConfig failed on screen=%d", cap->screen);
+        return false;
+    }
+    *config = fbc[0];
+    XFree(fbc);
+
+    pthread_mutex_lock(&manager.mutex);
+    if (manager.fb_config_count < kFbConfigCacheSize)
+    {
+        LinuxFbConfigCacheEntry& entry = manager.fb_configs[manager.fb_config_count++];
+        entry.screen = cap->screen;
+        entry.headless = slot;
+        entry.config = *config;
+    }
+    pthread_mutex_unlock(&manager.mutex);
+    return true;
+}
 
-    if (cap->window == 0)
+static bool InitGlObjects(LinuxCapture* cap, Window parent, LinuxCaptureInitResult* result)
+{
+    if (!cap || !cap->display)
+        return false;
+
+    if (!GetCachedFbConfig(cap, &cap->fb_config, result))
+        return false;
+
+    if (cap->headless)
+    {
+        // Only keeps the context current; frames go to an FBO of their own size.
+        const int pbufferAttribs[] = { GLX_PBUFFER_WIDTH, 1, GLX_PBUFFER_HEIGHT, 1, None };
+        cap->pbuffer = glXCreatePbuffer(cap->display, cap->fb_config, pbufferAttribs);
+        if (cap->pbuffer == 0)
+        {
+            SetInitDetail(result, "glXCreatePbuffer for headless capture failed");
+            LogNative("glXCreatePbuffer for headless capture failed");
+            return false;
+        }
+    }
+    else if (!CreateHostWindow(cap, parent, result))
     {
-        SetBackendDetail(cap, "XCreateWindow for capture host failed");
-        LogNative("XCreateWindow for capture host failed");
         return false;
     }
 
-    XMapWindow(cap->display, cap->window);
-    XFlush(cap->display);
-
-    cap->glx_context = glXCreateNewContext(cap->display, cap->fb_config, GLX_RGBA_TYPE, nullptr, True);
+    GLXContext shareContext = GetShareContext(cap);
+    cap->glx_context = glXCreateNewContext(cap->display, cap->fb_config, GLX_RGBA_TYPE, shareContext, True);
+    if (!cap->glx_context && shareContext)
+    {
+        LogNative("glXCreateNewContext refused the share group; using an unshared context");
+        cap->glx_context = glXCreateNewContext(cap->display, cap->fb_config, GLX_RGBA_TYPE, nullptr, True);
+    }
     if (!cap->glx_context)
     {
-        SetBackendDetail(cap, "glXCreateNewContext failed");
+        SetInitDetail(result, "glXCreateNewContext failed");
         LogNative("glXCreateNewContext failed");
         return false;
     }
@@ -1518,20 +5920,21 @@ static bool InitGlObjects(LinuxCapture* cap, Window parent)
     cap->glx_swap_interval_mesa = reinterpret_cast<PFNGLXSWAPINTERVALMESAPROC>(glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalMESA"));
     cap->glx_swap_interval_sgi = reinterpret_cast<PFNGLXSWAPINTERVALSGIPROC>(glXGetProcAddressARB((const GLubyte*)"glXSwapIntervalSGI"));
     const char* ext = glXQueryExtensionsString(cap->display, cap->screen);
-    cap->has_swap_control_tear = (ext && strstr(ext, "GLX_EXT_swap_control_tear")) ? 1 : 0;
+    result->has_swap_control_tear = (ext && strstr(ext, "GLX_EXT_swap_control_tear")) ? 1 : 0;
+    result->has_buffer_age = (ext && strstr(ext, "GLX_EXT_buffer_age")) ? 1 : 0;
 
     if (!cap->glx_bind_tex_image_ext || !cap->glx_release_tex_image_ext)
     {
-        SetBackendDetail(cap, "GLX_EXT_texture_from_pixmap unavailable");
+        SetInitDetail(result, "GLX_EXT_texture_from_pixmap unavailable");
         LogNative("GLX_EXT_texture_from_pixmap unavailable");
         return false;
     }
 
-    cap->gl_supported = 1;
-    cap->has_swap_control = (cap->glx_swap_interval_ext || cap->glx_swap_interval_mesa || cap->glx_swap_interval_sgi) ? 1 : 0;
-    LogNative("swap control: has=%d tear=%d", cap->has_swap_control, cap->has_swap_control_tear);
-    cap->applied_disable_vsync = -1;
-    SetBackendDetail(cap, "OpenGL composite initialized");
+    result->gl_supported = 1;
+    result->has_swap_control = (cap->glx_swap_interval_ext || cap->glx_swap_interval_mesa || cap->glx_swap_interval_sgi) ? 1 : 0;
+    LogNative("swap control: has=%d tear=%d", result->has_swap_control, result->has_swap_control_tear);
+    cap->applied_swap_interval = kSwapIntervalUnset;
+    SetInitDetail(result, "OpenGL composite initialized");
     LogNative("OpenGL composite initialized");
     return true;
 }
@@ -1541,6 +5944,16 @@ static void CleanupGlObjects(LinuxCapture* cap)
     if (!cap || !cap->display)
         return;
 
+    if (cap->glx_context && RenderDrawable(cap) && glXMakeCurrent(cap->display, RenderDrawable(cap), cap->glx_context) == True)
+    {
+        DestroySourceCopyRing(cap);
+        DestroyContentBarResources(cap);
+        DestroyPreviewResources(cap);
+        DestroyFingerprintResources(cap);
+        DestroyOutputResources(cap);
+        DestroyScreenshotResources(cap);
+    }
+
     DestroyCompositeResources(cap);
 
     if (cap->shader_program)
@@ -1565,12 +5978,20 @@ static void CleanupGlObjects(LinuxCapture* cap)
 
     if (cap->glx_context)
     {
+        glXMakeCurrent(cap->display, None, nullptr);
         glXDestroyContext(cap->display, cap->glx_context);
         cap->glx_context = nullptr;
     }
 
+    if (cap->pbuffer)
+    {
+        glXDestroyPbuffer(cap->display, cap->pbuffer);
+        cap->pbuffer = 0;
+    }
+
     if (cap->window)
     {
+        StopHostPresentEvents(cap);
         XDestroyWindow(cap->display, cap->window);
         cap->window = 0;
     }
@@ -1584,51 +6005,216 @@ static void CleanupGlObjects(LinuxCapture* cap)
     cap->gl_supported = 0;
 }
 
-LinuxCapture* aes_linux_capture_create(void* parentHandle)
+// The handle Avalonia embeds. It takes the parent's visual, so no FBConfig
+// is needed to create it; the GL window is put inside it once init is done.
+static bool CreateViewWindow(LinuxCapture* cap, Window parent)
 {
-    pthread_once(&g_x11_threads_once, InitX11ThreadsOnce);
+    XSetWindowAttributes swa{};
+    swa.background_pixel = BlackPixel(cap->display, cap->screen);
+    swa.event_mask = StructureNotifyMask;
+    cap->view = XCreateWindow(cap->display, parent,
+        0, 0, 1, 1,
+        0,
+        CopyFromParent,
+        InputOutput,
+        CopyFromParent,
+        CWBackPixel | CWEventMask,
+        &swa);
+    if (cap->view == 0)
+    {
+        LogNative("XCreateWindow for capture view failed");
+        return false;
+    }
+
+    XMapWindow(cap->display, cap->view);
+    XFlush(cap->display);
+    return true;
+}
+
+// The GL (or fallback) window fills the view; after this it follows the
+// view's ConfigureNotify.
+static void FitHostWindowToView(LinuxCapture* cap)
+{
+    if (cap->view == 0 || cap->window == 0)
+        return;
+
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    const xcb_get_geometry_cookie_t cookie = xcb_get_geometry(conn, static_cast<xcb_window_t>(cap->view));
+    CountRoundTrip();
+    xcb_get_geometry_reply_t* geometry = xcb_get_geometry_reply(conn, cookie, nullptr);
+    if (geometry)
+        XResizeWindow(cap->display, cap->window, std::max<int>(1, geometry->width), std::max<int>(1, geometry->height));
+    free(geometry);
+    XFlush(cap->display);
+}
+
+// Compiles the configured fragment shader (the default one when none is set)
+// and draws once with it, so drivers that finish compiling on first use do
+// it now instead of on the first captured frame.
+static void PrewarmShaderProgram(LinuxCapture* cap)
+{
+    if (!cap->glx_context || glXMakeCurrent(cap->display, RenderDrawable(cap), cap->glx_context) != True)
+        return;
+
+    const uint64_t start = MonotonicNowNs();
+    if (EnsureShaderProgram(cap))
+    {
+        glViewport(0, 0, 1, 1);
+        glUseProgram(cap->shader_program);
+        glBegin(GL_TRIANGLE_STRIP);
+        glTexCoord2f(0.0f, 1.0f); glVertex2f(-1.0f, -1.0f);
+        glTexCoord2f(1.0f, 1.0f); glVertex2f( 1.0f, -1.0f);
+        glTexCoord2f(0.0f, 0.0f); glVertex2f(-1.0f,  1.0f);
+        glTexCoord2f(1.0f, 0.0f); glVertex2f( 1.0f,  1.0f);
+        glEnd();
+        glUseProgram(0);
+        glFinish();
+    }
+    glXMakeCurrent(cap->display, None, nullptr);
+    LogNative("shader prewarm: %.1f ms", static_cast<double>(MonotonicNowNs() - start) / 1000000.0);
+}
+
+// The slow part of creation: FBConfig, GL window and context, extensions and
+// the shader. Runs without the session lock: the GL objects are not touched
+// by anything else before the session is registered, and what the getters
+// read goes into result for FinishCaptureInit to publish.
+static bool InitCaptureBackend(LinuxCapture* cap, LinuxCaptureInitResult* result)
+{
+    const Window parent = cap->headless ? DefaultRootWindow(cap->display) : cap->view;
+    if (InitGlObjects(cap, parent, result))
+    {
+        pthread_mutex_lock(&cap->mutex);
+        PrewarmShaderProgram(cap);
+        // Headless frames only exist in the output FBO, so without FBO blit
+        // there would be a session that never produces one.
+        bool composes = true;
+        if (cap->headless && glXMakeCurrent(cap->display, RenderDrawable(cap), cap->glx_context) == True)
+        {
+            DetectGlCapabilities(cap);
+            composes = cap->has_fbo_blit != 0;
+            glXMakeCurrent(cap->display, None, nullptr);
+        }
+        pthread_mutex_unlock(&cap->mutex);
+        if (composes)
+            return true;
+
+        result->gl_supported = 0;
+        SetInitDetail(result, "framebuffer blit unavailable for headless capture");
+        LogNative("framebuffer blit unavailable for headless capture");
+        return false;
+    }
+
+    // There is no fallback without a window to reparent into.
+    if (cap->headless)
+        return false;
+
+    // fallback host window when GLX composite isn't available
+    if (cap->window == 0)
+    {
+        cap->window = XCreateSimpleWindow(cap->display, parent,
+            0, 0, 1, 1, 0,
+            BlackPixel(cap->display, cap->screen),
+            BlackPixel(cap->display, cap->screen));
+        XSelectInput(cap->display, cap->window, StructureNotifyMask);
+        XMapWindow(cap->display, cap->window);
+        XFlush(cap->display);
+    }
+    result->gl_supported = 0;
+    return true;
+}
+
+static void SetTargetLocked(LinuxCapture* cap, int processId, const char* windowTitleHint);
+
+static void FinishCaptureInit(LinuxCapture* cap, const LinuxCaptureInitResult& result)
+{
+    RegisterCaptureSession(cap);
+
+    pthread_mutex_lock(&cap->mutex);
+    cap->gl_supported = result.gl_supported;
+    cap->has_swap_control = result.has_swap_control;
+    cap->has_swap_control_tear = result.has_swap_control_tear;
+    cap->has_buffer_age = result.has_buffer_age;
+    SetBackendDetail(cap, result.detail);
+    FitHostWindowToView(cap);
+    if (cap->gl_supported)
+        StartHostPresentEventsLocked(cap);
+    if (cap->gl_supported)
+    {
+        SetBackendDetail(cap, cap->headless ? "X11/XWayland GPU composite (headless)" : "X11/XWayland GPU composite");
+        SetGpuInfo(cap, "OpenGL (GLX) composite", "Linux/X11");
+        SetStatusText(cap, "Linux capture idle");
+    }
+    else
+    {
+        SetGpuInfo(cap, "X11 Reparent (fallback)", "Linux");
+        SetStatusText(cap, "GPU composite unavailable, using fallback pipeline");
+        LogNative("fallback host created: GPU composite unavailable");
+    }
+    cap->init_ms = static_cast<double>(MonotonicNowNs() - cap->create_ns) / 1000000.0;
+    cap->init_pending = 0;
+    LogNative("capture init done: %.1f ms", cap->init_ms);
+    if (cap->pending_target_set)
+    {
+        cap->pending_target_set = 0;
+        SetTargetLocked(cap, cap->pending_target_pid, cap->pending_target_hint);
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+static void* CaptureInitMain(void* arg)
+{
+    LinuxCapture* cap = static_cast<LinuxCapture*>(arg);
+    LinuxCaptureInitResult result{};
+    InitCaptureBackend(cap, &result);
+    FinishCaptureInit(cap, result);
+    return nullptr;
+}
 
+// Returns once the handle and its view exist. Windowed captures build the
+// rest on an init thread (is_initializing reports it, and a target set
+// meanwhile is applied when it is done); headless ones have no view to show
+// meanwhile and do it inline.
+static LinuxCapture* CreateCapture(void* parentHandle, bool headless, int outputWidth, int outputHeight)
+{
     LinuxCapture* cap = static_cast<LinuxCapture*>(calloc(1, sizeof(LinuxCapture)));
     if (!cap)
         return nullptr;
 
-    cap->display = XOpenDisplay(nullptr);
+    cap->create_ns = MonotonicNowNs();
+    cap->display = AcquireCaptureManager();
     if (!cap->display)
     {
         free(cap);
         return nullptr;
     }
-    LogNative("capture create: display opened");
+    LogNative("capture create: using shared display");
 
     cap->screen = DefaultScreen(cap->display);
     pthread_mutex_init(&cap->mutex, nullptr);
+    cap->headless = headless ? 1 : 0;
+    cap->headless_w = std::max(0, outputWidth);
+    cap->headless_h = std::max(0, outputHeight);
 
-    Window parent = GetParentWindow(cap->display, parentHandle);
-
-    if (!InitGlObjects(cap, parent))
+    LinuxCaptureInitResult result{};
+    if (headless)
     {
-        // fallback host window when GLX composite isn't available
-        if (cap->window == 0)
+        if (!InitCaptureBackend(cap, &result))
         {
-            cap->window = XCreateSimpleWindow(cap->display, parent,
-                0, 0, 1, 1, 0,
-                BlackPixel(cap->display, cap->screen),
-                BlackPixel(cap->display, cap->screen));
-            XSelectInput(cap->display, cap->window, StructureNotifyMask);
-            XMapWindow(cap->display, cap->window);
+            LogNative("headless capture unavailable: %s", result.detail);
+            CleanupGlObjects(cap);
             XFlush(cap->display);
+            pthread_mutex_destroy(&cap->mutex);
+            free(cap);
+            ReleaseCaptureManager();
+            return nullptr;
         }
-
-        cap->gl_supported = 0;
-        SetGpuInfo(cap, "X11 Reparent (fallback)", "Linux");
-        SetStatusText(cap, "GPU composite unavailable, using fallback pipeline");
-        LogNative("fallback host created: GPU composite unavailable");
     }
-    else
+    else if (!CreateViewWindow(cap, GetParentWindow(cap->display, parentHandle)))
     {
-        SetBackendDetail(cap, "X11/XWayland GPU composite");
-        SetGpuInfo(cap, "OpenGL (GLX) composite", "Linux/X11");
-        SetStatusText(cap, "Linux capture idle");
+        pthread_mutex_destroy(&cap->mutex);
+        free(cap);
+        ReleaseCaptureManager();
+        return nullptr;
     }
 
     cap->use_pipewire = 0; // X11/XWayland implementation
@@ -1639,6 +6225,10 @@ LinuxCapture* aes_linux_capture_create(void* parentHandle)
     cap->tint[2] = 1.0f;
     cap->tint[3] = 1.0f;
     cap->stretch = 3;
+    cap->auto_crop_threshold = aes_native::ContentBarDetectorOptions{}.luma_threshold;
+    cap->duplicate_detection = DuplicateDetectionStats;
+    cap->compositor_bypass_enabled = 1;
+    cap->auto_reacquire = 1;
     cap->disable_vsync = 0;
     cap->shader_dirty = 1;
     cap->shader_u_tex = -1;
@@ -1653,91 +6243,463 @@ LinuxCapture* aes_linux_capture_create(void* parentHandle)
     cap->damage_error_base = -1;
     cap->damage = 0;
     XDamageQueryExtension(cap->display, &cap->damage_event_base, &cap->damage_error_base);
+    int xtestEventBase = 0;
+    int xtestErrorBase = 0;
+    int xtestMajor = 0;
+    int xtestMinor = 0;
+    cap->has_xtest = XTestQueryExtension(cap->display, &xtestEventBase, &xtestErrorBase, &xtestMajor, &xtestMinor) ? 1 : 0;
+    InitPresentTiming(cap);
+    InitDisplayRefresh(cap);
 
     cap->last_sample_time_ns = MonotonicNowNs();
 
-    cap->stop_render_thread = 0;
-    cap->render_thread_started = 1;
-    pthread_create(&cap->render_thread, nullptr, RenderThreadMain, cap);
-    LogNative("render thread started");
+    InitFrameExchange(&cap->preview_exchange);
+    InitFrameExchange(&cap->output_exchange);
+    pthread_mutex_init(&cap->screenshot_mutex, nullptr);
+    pthread_cond_init(&cap->screenshot_cond, nullptr);
+    pthread_mutex_init(&cap->detect_mutex, nullptr);
+    pthread_cond_init(&cap->detect_cond, nullptr);
+    cap->detect_stop = 0;
+    cap->detect_thread_started = pthread_create(&cap->detect_thread, nullptr, ContentBarWorkerMain, cap) == 0 ? 1 : 0;
+
+    if (headless)
+    {
+        FinishCaptureInit(cap, result);
+        return cap;
+    }
 
+    SetStatusText(cap, "Initializing Linux capture");
+    SetGpuInfo(cap, nullptr, nullptr);
+    cap->init_pending = 1;
+    cap->init_thread_started = pthread_create(&cap->init_thread, nullptr, CaptureInitMain, cap) == 0 ? 1 : 0;
+    if (!cap->init_thread_started)
+    {
+        InitCaptureBackend(cap, &result);
+        FinishCaptureInit(cap, result);
+    }
     return cap;
 }
 
-void aes_linux_capture_destroy(LinuxCapture* cap)
+LinuxCapture* aes_linux_capture_create(void* parentHandle)
+{
+    return CreateCapture(parentHandle, false, 0, 0);
+}
+
+// Captures without a host window. Frames are composed at outputWidth x
+// outputHeight (0 follows the cropped source) and only reach readers through
+// aes_linux_capture_copy_output and the preview stream. Returns null when GL
+// composite or framebuffer blit is unavailable.
+LinuxCapture* aes_linux_capture_create_headless(int outputWidth, int outputHeight)
+{
+    return CreateCapture(nullptr, true, outputWidth, outputHeight);
+}
+
+void aes_linux_capture_destroy(LinuxCapture* cap)
+{
+    if (!cap)
+        return;
+
+    // The session is registered when init finishes, so wait for that first.
+    if (cap->init_thread_started)
+        pthread_join(cap->init_thread, nullptr);
+    UnregisterCaptureSession(cap);
+
+    pthread_mutex_lock(&cap->detect_mutex);
+    cap->detect_stop = 1;
+    pthread_cond_signal(&cap->detect_cond);
+    pthread_mutex_unlock(&cap->detect_mutex);
+    if (cap->detect_thread_started)
+        pthread_join(cap->detect_thread, nullptr);
+
+    // The scheduler no longer renders it: fail what it will never read back, then let
+    // the encoder finish the rest.
+    FailQueuedScreenshotsLocked(cap);
+    if (cap->screenshot_readback.pending)
+        PostScreenshotJob(cap, cap->screenshot_inflight, nullptr, 0, 0);
+    pthread_mutex_lock(&cap->screenshot_mutex);
+    cap->screenshot_stop = 1;
+    pthread_cond_signal(&cap->screenshot_cond);
+    pthread_mutex_unlock(&cap->screenshot_mutex);
+    if (cap->screenshot_thread_started)
+        pthread_join(cap->screenshot_thread, nullptr);
+
+    if (cap->display)
+    {
+        pthread_mutex_lock(&cap->mutex);
+
+        if (cap->backend_mode == BackendReparentFallback && cap->target != 0)
+        {
+            Window root = DefaultRootWindow(cap->display);
+            XReparentWindow(cap->display, cap->target, root, 0, 0);
+            XMapWindow(cap->display, cap->target);
+            XFlush(cap->display);
+        }
+
+        RestoreTargetFromOffscreenIfNeeded(cap);
+        StopPresentTiming(cap);
+
+        cap->vrr_enabled = 0;
+        ApplyVrrStateLocked(cap);
+        cap->compositor_bypass_enabled = 0;
+        ApplyCompositorBypassLocked(cap);
+
+        if (cap->damage != 0)
+        {
+            XDamageDestroy(cap->display, cap->damage);
+            cap->damage = 0;
+        }
+        EndSurfaceProbeLocked(cap);
+
+        CleanupGlObjects(cap);
+        if (cap->view)
+        {
+            XDestroyWindow(cap->display, cap->view);
+            cap->view = 0;
+        }
+
+        // The connection is shared; only this capture's resources go.
+        XFlush(cap->display);
+        cap->display = nullptr;
+
+        pthread_mutex_unlock(&cap->mutex);
+    }
+
+    pthread_cond_destroy(&cap->detect_cond);
+    pthread_mutex_destroy(&cap->detect_mutex);
+    free(cap->detect_job_pixels);
+    DestroyFrameExchange(&cap->preview_exchange);
+    DestroyFrameExchange(&cap->output_exchange);
+    pthread_cond_destroy(&cap->screenshot_cond);
+    pthread_mutex_destroy(&cap->screenshot_mutex);
+    pthread_mutex_destroy(&cap->mutex);
+    free(cap);
+    ReleaseCaptureManager();
+}
+
+void* aes_linux_capture_get_view(LinuxCapture* cap)
+{
+    return cap ? reinterpret_cast<void*>(cap->view) : nullptr;
+}
+
+void aes_linux_capture_set_use_pipewire(LinuxCapture* cap, int usePipeWire)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = usePipeWire ? 1 : 0;
+    if (cap->use_pipewire != normalized)
+        cap->use_pipewire = normalized;
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+void aes_linux_capture_set_disable_vsync(LinuxCapture* cap, int disableVsync)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = disableVsync ? 1 : 0;
+    if (cap->disable_vsync != normalized)
+    {
+        cap->disable_vsync = normalized;
+        LogNative("set_disable_vsync: %d (swap_control=%d)", cap->disable_vsync, cap->has_swap_control);
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+void aes_linux_capture_set_vrr_enabled(LinuxCapture* cap, int enabled)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = enabled ? 1 : 0;
+    if (cap->vrr_enabled != normalized)
+    {
+        cap->vrr_enabled = normalized;
+        LogNative("set_vrr_enabled: %d (swap_control_tear=%d)", cap->vrr_enabled, cap->has_swap_control_tear);
+        ApplyVrrStateLocked(cap);
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+void aes_linux_capture_set_compositor_bypass(LinuxCapture* cap, int enabled)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = enabled ? 1 : 0;
+    if (cap->compositor_bypass_enabled != normalized)
+    {
+        cap->compositor_bypass_enabled = normalized;
+        LogNative("set_compositor_bypass: %d (covers_output=%d)", cap->compositor_bypass_enabled, cap->host_covers_output);
+        ApplyCompositorBypassLocked(cap);
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+void aes_linux_capture_set_auto_reacquire(LinuxCapture* cap, int enabled)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = enabled ? 1 : 0;
+    if (cap->auto_reacquire != normalized)
+    {
+        cap->auto_reacquire = normalized;
+        cap->reacquire_checked_ns = 0;
+        LogNative("set_auto_reacquire: %d (target_lost=%d)", cap->auto_reacquire, cap->target_lost);
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+// Scheduling for the render thread all captures share. mode is a
+// LinuxRenderThreadMode; cpus is a CPU list ("2-3,6"), "auto" for the cores
+// the target's threads use least, or null/empty to leave affinity alone.
+// The thread takes the highest mode any session asks for, as far as its
+// limits allow, and the first session's CPU choice.
+void aes_linux_capture_set_render_thread(LinuxCapture* cap, int mode, const char* cpus)
+{
+    if (!cap)
+        return;
+
+    std::vector<int> listed;
+    if (!cpus)
+        cpus = "";
+    if (cpus[0] != '\0' && strcmp(cpus, "auto") != 0 && !aes_native::ParseCpuList(cpus, CPU_SETSIZE, &listed))
+    {
+        LogNative("set_render_thread: ignoring malformed CPU list '%s'", cpus);
+        cpus = "";
+    }
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = std::max(static_cast<int>(RenderThreadNormal), std::min(mode, static_cast<int>(RenderThreadRealtime)));
+    if (cap->render_thread_request != normalized ||
+        strncmp(cap->render_thread_cpus_request, cpus, sizeof(cap->render_thread_cpus_request) - 1) != 0)
+    {
+        cap->render_thread_request = normalized;
+        strncpy(cap->render_thread_cpus_request, cpus, sizeof(cap->render_thread_cpus_request) - 1);
+        cap->render_thread_cpus_request[sizeof(cap->render_thread_cpus_request) - 1] = '\0';
+        LogNative("set_render_thread: %s cpus='%s'", RenderThreadModeName(normalized), cap->render_thread_cpus_request);
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+void aes_linux_capture_set_copy_source(LinuxCapture* cap, int enabled)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = enabled ? 1 : 0;
+    if (cap->copy_source_enabled != normalized)
+    {
+        cap->copy_source_enabled = normalized;
+        LogNative("set_copy_source: %d (copy_image=%d fbo_blit=%d)", cap->copy_source_enabled, cap->has_copy_image, cap->has_fbo_blit);
+        cap->render_dirty_full = 1;
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
+
+// LinuxDuplicateDetection: fingerprint source frames to report unique frames
+// separately from swaps (the default), and optionally skip presenting swaps
+// whose fingerprint repeats the previous one. The fingerprint is a small
+// reduction, so a frame that changes only a few pixels can be skipped.
+void aes_linux_capture_set_duplicate_detection(LinuxCapture* cap, int mode)
 {
     if (!cap)
         return;
 
-    cap->stop_render_thread = 1;
-    if (cap->render_thread_started)
-        pthread_join(cap->render_thread, nullptr);
-
-    if (cap->display)
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = mode < DuplicateDetectionOff ? DuplicateDetectionOff : (mode > DuplicateDetectionSkip ? DuplicateDetectionSkip : mode);
+    if (cap->duplicate_detection != normalized)
     {
-        pthread_mutex_lock(&cap->mutex);
-
-        if (cap->backend_mode == BackendReparentFallback && cap->target != 0)
-        {
-            Window root = DefaultRootWindow(cap->display);
-            XReparentWindow(cap->display, cap->target, root, 0, 0);
-            XMapWindow(cap->display, cap->target);
-            XFlush(cap->display);
-        }
-
-        RestoreTargetFromOffscreenIfNeeded(cap);
+        cap->duplicate_detection = normalized;
+        LogNative("set_duplicate_detection: %d", cap->duplicate_detection);
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
 
-        if (cap->damage != 0)
-        {
-            XDamageDestroy(cap->display, cap->damage);
-            cap->damage = 0;
-        }
+void aes_linux_capture_set_auto_crop_enabled(LinuxCapture* cap, int enabled)
+{
+    if (!cap)
+        return;
 
-        CleanupGlObjects(cap);
+    pthread_mutex_lock(&cap->mutex);
+    const int normalized = enabled ? 1 : 0;
+    if (cap->auto_crop_enabled != normalized)
+    {
+        cap->auto_crop_enabled = normalized;
+        ResetContentBarCropLocked(cap);
+        LogNative("set_auto_crop_enabled: %d", cap->auto_crop_enabled);
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->mutex);
+}
 
-        XCloseDisplay(cap->display);
-        cap->display = nullptr;
+void aes_linux_capture_set_auto_crop_threshold(LinuxCapture* cap, int lumaThreshold)
+{
+    if (!cap)
+        return;
 
-        pthread_mutex_unlock(&cap->mutex);
+    pthread_mutex_lock(&cap->mutex);
+    const int clamped = std::clamp(lumaThreshold, 0, 128);
+    if (cap->auto_crop_threshold != clamped)
+    {
+        cap->auto_crop_threshold = clamped;
+        LogNative("set_auto_crop_threshold: %d", cap->auto_crop_threshold);
     }
+    pthread_mutex_unlock(&cap->mutex);
+}
 
-    pthread_mutex_destroy(&cap->mutex);
-    free(cap);
+void aes_linux_capture_enable_preview(LinuxCapture* cap, int maxWidth, double fps)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->mutex);
+    const int width = fps > 0.0 ? std::max(0, maxWidth) : 0;
+    cap->preview_max_width = width;
+    cap->preview_fps = width > 0 ? std::min(fps, kPreviewMaxFps) : 0.0;
+    cap->preview_last_ns = 0;
+    if (width == 0)
+        ClearFrameExchange(&cap->preview_exchange);
+    LogNative("enable_preview: max_width=%d fps=%.2f", cap->preview_max_width, cap->preview_fps);
+    pthread_mutex_unlock(&cap->mutex);
 }
 
-void* aes_linux_capture_get_view(LinuxCapture* cap)
+// Copies the latest preview frame (top-down BGRA, stride width * 4) if it is
+// newer than *sequence. width/height are always set so a caller can size its
+// buffer; returns 1 only when pixels were copied.
+int aes_linux_capture_copy_preview(LinuxCapture* cap, void* buffer, int bufferSize, int* width, int* height, uint64_t* sequence)
 {
-    return cap ? reinterpret_cast<void*>(cap->window) : nullptr;
+    if (!cap || !width || !height || !sequence)
+        return 0;
+
+    return CopyFrame(&cap->preview_exchange, buffer, bufferSize, width, height, sequence);
 }
 
-void aes_linux_capture_set_use_pipewire(LinuxCapture* cap, int usePipeWire)
+void aes_linux_capture_set_output_size(LinuxCapture* cap, int width, int height)
 {
     if (!cap)
         return;
 
     pthread_mutex_lock(&cap->mutex);
-    const int normalized = usePipeWire ? 1 : 0;
-    if (cap->use_pipewire != normalized)
-        cap->use_pipewire = normalized;
+    cap->headless_w = std::max(0, width);
+    cap->headless_h = std::max(0, height);
+    cap->gpu_frame_pending = 1;
     pthread_mutex_unlock(&cap->mutex);
 }
 
-void aes_linux_capture_set_disable_vsync(LinuxCapture* cap, int disableVsync)
+void aes_linux_capture_set_output_readback(LinuxCapture* cap, int enabled)
 {
     if (!cap)
         return;
 
     pthread_mutex_lock(&cap->mutex);
-    const int normalized = disableVsync ? 1 : 0;
-    if (cap->disable_vsync != normalized)
+    const int normalized = enabled ? 1 : 0;
+    if (cap->output_readback_enabled != normalized)
     {
-        cap->disable_vsync = normalized;
-        LogNative("set_disable_vsync: %d (swap_control=%d)", cap->disable_vsync, cap->has_swap_control);
+        cap->output_readback_enabled = normalized;
+        cap->output_dirty = normalized;
+        if (!normalized)
+            ClearFrameExchange(&cap->output_exchange);
+        LogNative("set_output_readback: %d (headless=%d)", cap->output_readback_enabled, cap->headless);
         cap->gpu_frame_pending = 1;
     }
     pthread_mutex_unlock(&cap->mutex);
 }
 
+// Same contract as aes_linux_capture_copy_preview, for the full composed
+// output of a headless capture.
+int aes_linux_capture_copy_output(LinuxCapture* cap, void* buffer, int bufferSize, int* width, int* height, uint64_t* sequence)
+{
+    if (!cap || !width || !height || !sequence)
+        return 0;
+
+    return CopyFrame(&cap->output_exchange, buffer, bufferSize, width, height, sequence);
+}
+
+// Queues a screenshot of the next presented frame. format is 0 (PNG) or 1
+// (QOI); postShader picks the presented viewport over the cropped source at
+// native resolution. Returns an id for aes_linux_capture_get_screenshot_status
+// and the callback, or 0 if the request was rejected.
+int aes_linux_capture_screenshot(LinuxCapture* cap, const char* path, int format, int postShader)
+{
+    if (!cap || !path || path[0] == '\0' || strlen(path) >= sizeof(LinuxScreenshotRequest{}.path))
+        return 0;
+
+    pthread_mutex_lock(&cap->mutex);
+    if (!cap->screenshot_thread_started)
+        cap->screenshot_thread_started = pthread_create(&cap->screenshot_thread, nullptr, ScreenshotWorkerMain, cap) == 0 ? 1 : 0;
+
+    int id = 0;
+    pthread_mutex_lock(&cap->screenshot_mutex);
+    const int outstanding = cap->screenshot_queue_count + cap->screenshot_job_count + (cap->screenshot_readback.pending ? 1 : 0);
+    if (cap->screenshot_thread_started && cap->active && cap->backend_mode == BackendGpuComposite &&
+        outstanding < kScreenshotQueueSize)
+    {
+        id = ++cap->screenshot_next_id;
+        LinuxScreenshotRequest& request = cap->screenshot_queue[cap->screenshot_queue_count++];
+        request.id = id;
+        request.format = format;
+        request.post_shader = postShader ? 1 : 0;
+        strncpy(request.path, path, sizeof(request.path) - 1);
+        request.path[sizeof(request.path) - 1] = '\0';
+        cap->gpu_frame_pending = 1;
+    }
+    pthread_mutex_unlock(&cap->screenshot_mutex);
+    pthread_mutex_unlock(&cap->mutex);
+
+    LogNative("screenshot requested: id=%d format=%d post_shader=%d", id, format, postShader ? 1 : 0);
+    return id;
+}
+
+// 0 while pending, 1 when written, -1 on failure, -2 for ids that are unknown
+// or older than the last kScreenshotResultHistory results.
+int aes_linux_capture_get_screenshot_status(LinuxCapture* cap, int id)
+{
+    if (!cap || id <= 0)
+        return kScreenshotUnknown;
+
+    pthread_mutex_lock(&cap->screenshot_mutex);
+    int status = kScreenshotUnknown;
+    if (id <= cap->screenshot_next_id && id > cap->screenshot_next_id - kScreenshotResultHistory)
+    {
+        status = kScreenshotPending;
+        for (int i = 0; i < kScreenshotResultHistory; i++)
+        {
+            if (cap->screenshot_results[i][0] == id)
+            {
+                status = cap->screenshot_results[i][1];
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&cap->screenshot_mutex);
+    return status;
+}
+
+// The callback runs on the encoder thread once per id.
+void aes_linux_capture_set_screenshot_callback(LinuxCapture* cap, LinuxScreenshotCallback callback, void* userData)
+{
+    if (!cap)
+        return;
+
+    pthread_mutex_lock(&cap->screenshot_mutex);
+    cap->screenshot_callback = callback;
+    cap->screenshot_callback_user = userData;
+    pthread_mutex_unlock(&cap->screenshot_mutex);
+}
+
 void aes_linux_capture_set_shader_path(LinuxCapture* cap, const char* shaderPath)
 {
     if (!cap)
@@ -1762,9 +6724,12 @@ static Window ResolveTargetWindow(LinuxCapture* cap, int processId, const char*
     if (!cap || !cap->display)
         return 0;
 
-    Window root = DefaultRootWindow(cap->display);
-
     Window target = 0;
+    if (FindIndexedWindow(cap->display, processId, windowTitleHint, &target))
+        return target;
+
+    // Tree walks for when the index cannot be built.
+    Window root = DefaultRootWindow(cap->display);
     if (windowTitleHint && windowTitleHint[0] != '\0')
         target = FindWindowByPid(cap->display, root, processId, windowTitleHint, true);
 
@@ -1777,13 +6742,8 @@ static Window ResolveTargetWindow(LinuxCapture* cap, int processId, const char*
     return target;
 }
 
-void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char* windowTitleHint)
+static void SetTargetLocked(LinuxCapture* cap, int processId, const char* windowTitleHint)
 {
-    if (!cap || !cap->display)
-        return;
-
-    pthread_mutex_lock(&cap->mutex);
-
     Window root = DefaultRootWindow(cap->display);
 
     if (cap->backend_mode == BackendReparentFallback && cap->target != 0)
@@ -1810,17 +6770,28 @@ void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char*
         cap->hidden_window = 0;
     }
 
+    StopPresentTiming(cap);
+    EndSurfaceProbeLocked(cap);
+    cap->probe_root = 0;
+    cap->target_lost = 0;
+    cap->target_destroyed = 0;
+    cap->original_target = 0;
+    cap->original_remapped = 0;
+    cap->input_origin_valid = 0;
+    cap->input_buttons = 0;
+    cap->input_inside = 0;
     cap->active = 0;
     cap->initializing = 1;
     cap->backend_mode = BackendNone;
 
+    const uint64_t roundTrips = t_round_trips;
     Window target = ResolveTargetWindow(cap, processId, windowTitleHint);
+    cap->search_round_trips = static_cast<int>(t_round_trips - roundTrips);
     if (target == 0)
     {
         cap->initializing = 0;
         SetStatusText(cap, "No X11/XWayland target window found");
         LogNative("set_target failed: no target for pid=%d hint='%s'", processId, windowTitleHint ? windowTitleHint : "");
-        pthread_mutex_unlock(&cap->mutex);
         return;
     }
     LogNative("set_target resolved target=0x%lx for pid=%d hint='%s'", target, processId, windowTitleHint ? windowTitleHint : "");
@@ -1846,17 +6817,35 @@ void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char*
         cap->last_present_sample_ns = 0;
         cap->last_render_ns = 0;
         cap->gpu_frame_pending = 1;
+        cap->source_timing = SourceTimingNone;
+        cap->source_frame_ns = 0;
+        cap->source_frame_count = 0;
+        cap->rendered_source_frame = 0;
+        cap->presented_frames = 0;
+        cap->capture_latency_ms = 0.0;
+        ResetDamageTrackingLocked(cap);
+        ResetContentBarCropLocked(cap);
         if (cap->damage != 0)
         {
             XDamageDestroy(cap->display, cap->damage);
             cap->damage = 0;
         }
         if (cap->damage_event_base >= 0)
-            cap->damage = XDamageCreate(cap->display, target, XDamageReportNonEmpty);
+            cap->damage = XDamageCreate(cap->display, target, XDamageReportBoundingBox);
+        StartPresentTiming(cap, target);
         HideTargetOffscreenIfRequested(cap);
+        RememberTargetOriginLocked(cap, processId, windowTitleHint);
+        StartSurfaceProbeLocked(cap, MonotonicNowNs());
         SetStatusText(cap, "Capturing (X11/XWayland GPU composite)");
         LogNative("set_target success: GPU composite target=0x%lx", target);
-        pthread_mutex_unlock(&cap->mutex);
+        return;
+    }
+
+    if (cap->headless)
+    {
+        cap->initializing = 0;
+        SetStatusText(cap, "Headless capture needs the GPU composite path");
+        LogNative("set_target failed: headless capture cannot reparent target=0x%lx", target);
         return;
     }
 
@@ -1876,6 +6865,14 @@ void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char*
     cap->last_present_sample_ns = 0;
     cap->last_render_ns = 0;
     cap->gpu_frame_pending = 1;
+    cap->source_timing = SourceTimingNone;
+    cap->source_frame_ns = 0;
+    cap->source_frame_count = 0;
+    cap->rendered_source_frame = 0;
+    cap->presented_frames = 0;
+    cap->capture_latency_ms = 0.0;
+    ResetDamageTrackingLocked(cap);
+    ResetContentBarCropLocked(cap);
     cap->has_target_geometry = 0;
     cap->target_hidden_offscreen = 0;
     cap->hidden_window = 0;
@@ -1890,14 +6887,35 @@ void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char*
     XFlush(cap->display);
 
     if (cap->damage_event_base >= 0)
-        cap->damage = XDamageCreate(cap->display, target, XDamageReportNonEmpty);
+        cap->damage = XDamageCreate(cap->display, target, XDamageReportBoundingBox);
+    StartPresentTiming(cap, target);
 
     cap->active = 1;
     cap->initializing = 0;
     SetGpuInfo(cap, "X11 Reparent (fallback)", "Linux");
     SetStatusText(cap, "Capturing (fallback: X11 reparent, render options limited)");
     LogNative("set_target fallback: target=0x%lx reason='%s'", target, cap->backend_detail);
+}
+
+void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char* windowTitleHint)
+{
+    if (!cap || !cap->display)
+        return;
 
+    pthread_mutex_lock(&cap->mutex);
+    if (cap->init_pending)
+    {
+        // A capture created moments ago may still be building its GL
+        // objects; the init thread picks the target up when it is done.
+        cap->pending_target_set = 1;
+        cap->pending_target_pid = processId;
+        strncpy(cap->pending_target_hint, windowTitleHint ? windowTitleHint : "", sizeof(cap->pending_target_hint) - 1);
+        cap->pending_target_hint[sizeof(cap->pending_target_hint) - 1] = '\0';
+        LogNative("set_target deferred until init is done: pid=%d hint='%s'", processId, cap->pending_target_hint);
+        pthread_mutex_unlock(&cap->mutex);
+        return;
+    }
+    SetTargetLocked(cap, processId, windowTitleHint);
     pthread_mutex_unlock(&cap->mutex);
 }
 
@@ -1910,6 +6928,10 @@ void aes_linux_capture_stop(LinuxCapture* cap)
 
     Window root = DefaultRootWindow(cap->display);
 
+    cap->pending_target_set = 0;
+    StopPresentTiming(cap);
+    FailQueuedScreenshotsLocked(cap);
+
     if (cap->backend_mode == BackendGpuComposite)
     {
         RestoreTargetFromOffscreenIfNeeded(cap);
@@ -1932,8 +6954,15 @@ void aes_linux_capture_stop(LinuxCapture* cap)
         XFlush(cap->display);
     }
 
+    EndSurfaceProbeLocked(cap);
+    cap->probe_root = 0;
     cap->target = 0;
+    cap->target_lost = 0;
+    cap->target_destroyed = 0;
+    cap->original_target = 0;
+    cap->original_remapped = 0;
     cap->active = 0;
+    ApplyCompositorBypassLocked(cap);
     cap->initializing = 0;
     cap->backend_mode = BackendNone;
     cap->fps = 0.0;
@@ -1948,6 +6977,11 @@ void aes_linux_capture_stop(LinuxCapture* cap)
     cap->last_present_sample_ns = 0;
     cap->last_render_ns = 0;
     cap->gpu_frame_pending = 0;
+    cap->source_timing = SourceTimingNone;
+    cap->source_frame_ns = 0;
+    cap->capture_latency_ms = 0.0;
+    ResetDamageTrackingLocked(cap);
+    ResetContentBarCropLocked(cap);
     cap->has_target_geometry = 0;
     cap->target_hidden_offscreen = 0;
     cap->hidden_window = 0;
@@ -1976,6 +7010,269 @@ void aes_linux_capture_forward_focus(LinuxCapture* cap)
     pthread_mutex_unlock(&cap->mutex);
 }
 
+// Host event to delivery: the host event's X server time when it is on the
+// monotonic clock (Xorg and Xwayland stamp events with it), otherwise the
+// time since the call.
+static void SampleInputLatencyLocked(LinuxCapture* cap, uint64_t callNs, unsigned int eventTimeMs)
+{
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    XFlush(cap->display);
+    CountRoundTrip();
+    free(xcb_get_input_focus_reply(conn, xcb_get_input_focus(conn), nullptr));
+    const uint64_t deliveredNs = MonotonicNowNs();
+    cap->input_latency_checked_ns = deliveredNs;
+
+    double latencyMs = static_cast<double>(deliveredNs - callNs) / 1000000.0;
+    const uint32_t sinceEventMs = static_cast<uint32_t>(deliveredNs / 1000000) - eventTimeMs;
+    if (eventTimeMs != 0 && sinceEventMs < 1000)
+        latencyMs = std::max(latencyMs, static_cast<double>(sinceEventMs));
+
+    cap->input_latency_ms = cap->input_latency_ms > 0.0 ? cap->input_latency_ms * 0.9 + latencyMs * 0.1 : latencyMs;
+    cap->input_latency_max_ms = std::max(cap->input_latency_max_ms, latencyMs);
+}
+
+// Whether the target is the window the server finds at (rootX, rootY):
+// descends from root through the windows containing the point, one round
+// trip per level, and succeeds once the path reaches the target.
+static bool TargetTopmostAtLocked(LinuxCapture* cap, int rootX, int rootY)
+{
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    const xcb_window_t root = static_cast<xcb_window_t>(DefaultRootWindow(cap->display));
+    xcb_window_t window = root;
+    for (int depth = 0; depth < 8; depth++)
+    {
+        CountRoundTrip();
+        xcb_translate_coordinates_reply_t* reply = xcb_translate_coordinates_reply(
+            conn, xcb_translate_coordinates(conn, root, window, static_cast<int16_t>(rootX), static_cast<int16_t>(rootY)), nullptr);
+        const xcb_window_t child = reply ? reply->child : static_cast<xcb_window_t>(XCB_WINDOW_NONE);
+        free(reply);
+        if (child == static_cast<xcb_window_t>(cap->target))
+            return true;
+        if (child == XCB_WINDOW_NONE)
+            return false;
+        window = child;
+    }
+    return false;
+}
+
+// XTest moves the real pointer, so it is only used where the target is
+// topmost; anywhere else the click would land on whatever covers it, usually
+// the host showing the capture.
+static int ChooseInputPathLocked(LinuxCapture* cap, bool inside, int rootX, int rootY)
+{
+    if (cap->has_xtest && inside && !(cap->target_hidden_offscreen && cap->target_input_passthrough_applied) &&
+        TargetTopmostAtLocked(cap, rootX, rootY))
+        return InputPathXTest;
+    const uint32_t pointerMasks = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION;
+    return (cap->target_event_masks & pointerMasks) != 0 ? InputPathCoreEvents : InputPathNone;
+}
+
+// Moves the real pointer onto the target for the event and back to where the
+// user left it. Moving back reports the view position again, which the
+// caller drops as a repeat instead of forwarding it in a loop.
+static void SendXTestPointerLocked(LinuxCapture* cap, int kind, int button, int rootX, int rootY)
+{
+    xcb_connection_t* conn = XGetXCBConnection(cap->display);
+    CountRoundTrip();
+    xcb_query_pointer_reply_t* pointer = xcb_query_pointer_reply(
+        conn, xcb_query_pointer(conn, static_cast<xcb_window_t>(DefaultRootWindow(cap->display))), nullptr);
+
+    XTestFakeMotionEvent(cap->display, -1, rootX, rootY, CurrentTime);
+    if (kind == PointerPress || kind == PointerRelease)
+        XTestFakeButtonEvent(cap->display, static_cast<unsigned int>(std::max(1, button)), kind == PointerPress ? True : False, CurrentTime);
+    if (pointer && pointer->same_screen)
+        XTestFakeMotionEvent(cap->display, -1, pointer->root_x, pointer->root_y, CurrentTime);
+    free(pointer);
+}
+
+static void SendCorePointerLocked(LinuxCapture* cap, int kind, int button, int targetX, int targetY, bool inside, Time eventTime)
+{
+    Window root = DefaultRootWindow(cap->display);
+    XEvent xe;
+    memset(&xe, 0, sizeof(xe));
+    long mask = 0;
+    auto fillCrossing = [&](int type) {
+        memset(&xe, 0, sizeof(xe));
+        xe.xcrossing.type = type;
+        xe.xcrossing.display = cap->display;
+        xe.xcrossing.window = cap->target;
+        xe.xcrossing.root = root;
+        xe.xcrossing.time = eventTime;
+        xe.xcrossing.x = targetX;
+        xe.xcrossing.y = targetY;
+        xe.xcrossing.x_root = cap->target_root_x + targetX;
+        xe.xcrossing.y_root = cap->target_root_y + targetY;
+        xe.xcrossing.mode = NotifyNormal;
+        xe.xcrossing.detail = NotifyAncestor;
+        xe.xcrossing.same_screen = True;
+        xe.xcrossing.state = cap->input_buttons;
+        mask = type == EnterNotify ? EnterWindowMask : LeaveWindowMask;
+    };
+
+    if (!inside)
+    {
+        fillCrossing(LeaveNotify);
+        XSendEvent(cap->display, cap->target, True, mask, &xe);
+        return;
+    }
+
+    if (!cap->input_inside)
+    {
+        fillCrossing(EnterNotify);
+        XSendEvent(cap->display, cap->target, True, mask, &xe);
+    }
+
+    // Button and motion events share their leading fields.
+    memset(&xe, 0, sizeof(xe));
+    xe.xbutton.display = cap->display;
+    xe.xbutton.window = cap->target;
+    xe.xbutton.root = root;
+    xe.xbutton.time = eventTime;
+    xe.xbutton.x = targetX;
+    xe.xbutton.y = targetY;
+    xe.xbutton.x_root = cap->target_root_x + targetX;
+    xe.xbutton.y_root = cap->target_root_y + targetY;
+    xe.xbutton.state = cap->input_buttons;
+    xe.xbutton.same_screen = True;
+    if (kind == PointerPress || kind == PointerRelease)
+    {
+        xe.xbutton.type = kind == PointerPress ? ButtonPress : ButtonRelease;
+        xe.xbutton.button = static_cast<unsigned int>(std::max(1, button));
+        mask = kind == PointerPress ? ButtonPressMask : ButtonReleaseMask;
+    }
+    else
+    {
+        xe.xmotion.type = MotionNotify;
+        xe.xmotion.is_hint = NotifyNormal;
+        // ButtonNMotionMask shares its bit with ButtonNMask.
+        mask = PointerMotionMask | (cap->input_buttons != 0 ? ButtonMotionMask | static_cast<long>(cap->input_buttons) : 0);
+    }
+    XSendEvent(cap->display, cap->target, True, mask, &xe);
+}
+
+// Sends a pointer event from the capture view into the target. (x, y) are
+// view pixels and go through the layout of the last presented frame, so the
+// event lands on the source pixel shown under the pointer. XTest is used
+// where the target is topmost at that point; elsewhere only clients that
+// selected core pointer events on it can be reached (see LinuxInputPath).
+// kind is a LinuxPointerEventKind, button an X button (4 to 7 for the wheel)
+// and eventTimeMs the host event's X server time, 0 if unknown. Returns 1 if
+// an event was sent.
+int aes_linux_capture_forward_pointer(LinuxCapture* cap, int kind, int x, int y, int button, unsigned int eventTimeMs)
+{
+    if (!cap || !cap->display)
+        return 0;
+
+    const uint64_t callNs = MonotonicNowNs();
+    pthread_mutex_lock(&cap->mutex);
+    if (!cap->active || cap->backend_mode != BackendGpuComposite || cap->target == 0 || cap->target_destroyed ||
+        !cap->last_render_state_valid)
+    {
+        pthread_mutex_unlock(&cap->mutex);
+        return 0;
+    }
+
+    const LinuxCaptureRenderState& state = cap->last_render_state;
+    aes_native::ViewportLayout layout;
+    memcpy(layout.viewport, state.viewport, sizeof(layout.viewport));
+    memcpy(layout.uv, state.uv, sizeof(layout.uv));
+    double hostX = x + 0.5;
+    double hostY = y + 0.5;
+    if (cap->input_buttons != 0 || kind == PointerRelease)
+    {
+        // A drag that leaves the picture stays pinned to its edge, and the
+        // release always arrives.
+        const int top = state.host_h - state.viewport[1] - state.viewport[3];
+        hostX = std::clamp(hostX, state.viewport[0] + 0.5, state.viewport[0] + state.viewport[2] - 0.5);
+        hostY = std::clamp(hostY, top + 0.5, top + state.viewport[3] - 0.5);
+    }
+
+    int targetX = 0;
+    int targetY = 0;
+    const bool inside = kind != PointerLeave &&
+                        aes_native::MapOutputToSource(layout, state.host_h, state.target_w, state.target_h, hostX, hostY, &targetX, &targetY);
+    if (!inside)
+        cap->input_outside += kind == PointerLeave ? 0 : 1;
+    if ((!inside && !cap->input_inside) ||
+        (kind == PointerMove && inside && cap->input_inside && x == cap->input_view_x && y == cap->input_view_y))
+    {
+        pthread_mutex_unlock(&cap->mutex);
+        return 0;
+    }
+
+    if (!cap->input_origin_valid)
+    {
+        // The root position and the event masks clients selected on the
+        // target, in one round trip.
+        xcb_connection_t* conn = XGetXCBConnection(cap->display);
+        const xcb_window_t target = static_cast<xcb_window_t>(cap->target);
+        xcb_translate_coordinates_cookie_t originCookie =
+            xcb_translate_coordinates(conn, target, static_cast<xcb_window_t>(DefaultRootWindow(cap->display)), 0, 0);
+        xcb_get_window_attributes_cookie_t attributesCookie = xcb_get_window_attributes(conn, target);
+        CountRoundTrip();
+        xcb_translate_coordinates_reply_t* origin = xcb_translate_coordinates_reply(conn, originCookie, nullptr);
+        xcb_get_window_attributes_reply_t* attributes = xcb_get_window_attributes_reply(conn, attributesCookie, nullptr);
+        if (origin && attributes)
+        {
+            cap->target_root_x = origin->dst_x;
+            cap->target_root_y = origin->dst_y;
+            cap->target_event_masks = attributes->all_event_masks;
+            cap->input_origin_valid = 1;
+        }
+        free(origin);
+        free(attributes);
+    }
+
+    const int rootX = cap->target_root_x + targetX;
+    const int rootY = cap->target_root_y + targetY;
+    const int path = ChooseInputPathLocked(cap, inside, rootX, rootY);
+    if (inside && path != cap->input_path)
+    {
+        LogNative("pointer forwarding: %s", path == InputPathXTest        ? "XTest"
+                                            : path == InputPathCoreEvents ? "core events"
+                                                                          : "inactive, the target is not topmost and selects no core pointer events");
+        cap->input_path = path;
+    }
+    if (path == InputPathNone)
+    {
+        cap->input_inside = inside ? 1 : 0;
+        pthread_mutex_unlock(&cap->mutex);
+        return 0;
+    }
+
+    const unsigned int buttonMask = button >= 1 && button <= 5 ? (Button1Mask << (button - 1)) : 0;
+    if (path == InputPathXTest)
+        SendXTestPointerLocked(cap, kind, button, rootX, rootY);
+    else
+        SendCorePointerLocked(cap, kind, button, targetX, targetY, inside,
+                              eventTimeMs != 0 ? static_cast<Time>(eventTimeMs) : CurrentTime);
+    cap->input_inside = inside ? 1 : 0;
+    cap->input_view_x = x;
+    cap->input_view_y = y;
+    if (!inside)
+    {
+        XFlush(cap->display);
+        pthread_mutex_unlock(&cap->mutex);
+        return 1;
+    }
+
+    if (kind == PointerPress)
+        cap->input_buttons |= buttonMask;
+    else if (kind == PointerRelease)
+        cap->input_buttons &= ~buttonMask;
+    cap->input_events++;
+
+    // Buttons are always timed; motion at most ten times a second, since
+    // timing costs a round trip.
+    if (kind != PointerMove || callNs - cap->input_latency_checked_ns >= 100000000ULL)
+        SampleInputLatencyLocked(cap, callNs, eventTimeMs);
+    else
+        XFlush(cap->display);
+
+    pthread_mutex_unlock(&cap->mutex);
+    return 1;
+}
+
 void aes_linux_capture_set_stretch(LinuxCapture* cap, int stretch)
 {
     if (!cap)
@@ -2051,43 +7348,152 @@ void aes_linux_capture_set_capture_behavior(LinuxCapture* cap, int hide)
     pthread_mutex_unlock(&cap->mutex);
 }
 
-void aes_linux_capture_reveal_window(void* handle)
+// The capture manager's connection, opened on first use and kept for the
+// life of the process so helper calls skip the connect and auth handshake.
+// The scheduler keeps running as its event reader even with no captures.
+static Display* AcquireHelperDisplay()
 {
-    Display* d = XOpenDisplay(nullptr);
-    if (!d)
-        return;
+    pthread_once(&g_x11_threads_once, InitX11ThreadsOnce);
+    pthread_once(&g_capture_manager_once, InitCaptureManagerOnce);
+
+    LinuxCaptureManager& manager = g_capture_manager;
+    pthread_mutex_lock(&manager.mutex);
+    Display* display = nullptr;
+    if (OpenSharedDisplayLocked(manager))
+    {
+        manager.helpers_pinned = 1;
+        StartSchedulerLocked(manager);
+        display = manager.display;
+    }
+    pthread_mutex_unlock(&manager.mutex);
+    return display;
+}
+
+// Runs request against the shared connection from any thread. Xlib is in
+// threaded mode, and the display lock keeps a short multi-request sequence
+// (map and raise) from interleaving with other threads' requests. Nothing
+// long may run under it: the scheduler's event pump waits for the lock.
+static bool RunHelperRequest(void (*request)(Display* display, void* context), void* context)
+{
+    Display* display = AcquireHelperDisplay();
+    if (!display)
+        return false;
+
+    XLockDisplay(display);
+    request(display, context);
+    XFlush(display);
+    XUnlockDisplay(display);
+    return true;
+}
 
-    Window w = reinterpret_cast<Window>(handle);
-    XMapWindow(d, w);
-    XRaiseWindow(d, w);
-    XFlush(d);
-    XCloseDisplay(d);
+void aes_linux_capture_reveal_window(void* handle)
+{
+    RunHelperRequest([](Display* d, void* context) {
+        const Window w = reinterpret_cast<Window>(context);
+        XMapWindow(d, w);
+        XRaiseWindow(d, w);
+    }, handle);
 }
 
 void aes_linux_capture_hide_window(void* handle)
 {
-    Display* d = XOpenDisplay(nullptr);
-    if (!d)
-        return;
-
-    Window w = reinterpret_cast<Window>(handle);
-    XUnmapWindow(d, w);
-    XFlush(d);
-    XCloseDisplay(d);
+    RunHelperRequest([](Display* d, void* context) {
+        XUnmapWindow(d, reinterpret_cast<Window>(context));
+    }, handle);
 }
 
+// The index answers once it is built, misses included, so a launcher
+// polling for a window that has not appeared yet costs no round trips. Only
+// without it is the tree walked, outside the display lock: every request
+// locks on its own, and a walk held under it would stall every capture.
 void* aes_linux_capture_find_window_by_pid(int pid, const char* titleHint)
 {
-    Display* d = XOpenDisplay(nullptr);
-    if (!d)
+    if (pid <= 0)
+        return nullptr;
+
+    Display* display = AcquireHelperDisplay();
+    Window found = 0;
+    if (!display || FindIndexedWindow(display, static_cast<pid_t>(pid), nullptr, &found))
+        return reinterpret_cast<void*>(found);
+
+    found = FindWindowByPid(display, RootWindow(display, DefaultScreen(display)), static_cast<pid_t>(pid), titleHint, false);
+    return reinterpret_cast<void*>(found);
+}
+
+// Oldest window whose WM_CLASS instance or class name equals wmClass.
+void* aes_linux_capture_find_window_by_class(const char* wmClass)
+{
+    if (!wmClass || wmClass[0] == '\0' || !EnsureWindowIndex(AcquireHelperDisplay()))
         return nullptr;
 
-    Window root = RootWindow(d, DefaultScreen(d));
-    Window found = FindWindowByPid(d, root, pid, titleHint, false);
-    XCloseDisplay(d);
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    Window found = 0;
+    uint64_t foundOrder = UINT64_MAX;
+    auto range = index->by_class.equal_range(wmClass);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        const uint64_t order = index->windows.at(it->second).order;
+        if (order < foundOrder)
+        {
+            found = it->second;
+            foundOrder = order;
+        }
+    }
+    pthread_mutex_unlock(&index->mutex);
     return reinterpret_cast<void*>(found);
 }
 
+// Calls callback on the scheduler thread for every window that appears with
+// pid (any when <= 0) and a title containing titleHint (any when empty), and
+// for matching windows that already exist. Returns 0 on failure, otherwise
+// an id for aes_linux_capture_unwatch_window.
+int aes_linux_capture_watch_window(int pid, const char* titleHint, LinuxWindowWatchCallback callback, void* userData)
+{
+    if (!callback || (pid <= 0 && (!titleHint || titleHint[0] == '\0')))
+        return 0;
+    if (!EnsureWindowIndex(AcquireHelperDisplay()))
+        return 0;
+
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->mutex);
+    LinuxWindowWatch watch;
+    watch.id = ++index->next_watch_id;
+    watch.pid = static_cast<pid_t>(pid);
+    watch.title_hint = titleHint ? titleHint : "";
+    watch.callback = callback;
+    watch.user_data = userData;
+    index->watches.push_back(watch);
+
+    std::vector<std::pair<uint64_t, Window>> existing;
+    for (const auto& item : index->windows)
+    {
+        if (IndexedWindowMatches(item.second, watch.pid, watch.title_hint.c_str()))
+            existing.emplace_back(item.second.order, item.first);
+    }
+    std::sort(existing.begin(), existing.end());
+    for (const auto& item : existing)
+        index->pending.push_back(LinuxWindowMatch{ watch.id, item.second, index->windows.at(item.second).pid });
+    pthread_mutex_unlock(&index->mutex);
+    return watch.id;
+}
+
+// After this returns the watch's callback is not running and will not run
+// again, unless this is called from that callback.
+void aes_linux_capture_unwatch_window(int watchId)
+{
+    pthread_once(&g_capture_manager_once, InitCaptureManagerOnce);
+    LinuxWindowIndex* index = g_capture_manager.window_index;
+    pthread_mutex_lock(&index->delivery_mutex);
+    pthread_mutex_lock(&index->mutex);
+    index->watches.erase(std::remove_if(index->watches.begin(), index->watches.end(),
+        [watchId](const LinuxWindowWatch& watch) { return watch.id == watchId; }), index->watches.end());
+    index->pending.erase(std::remove_if(index->pending.begin(), index->pending.end(),
+        [watchId](const LinuxWindowMatch& match) { return match.watch_id == watchId; }), index->pending.end());
+    pthread_mutex_unlock(&index->mutex);
+    pthread_mutex_unlock(&index->delivery_mutex);
+}
+
 static void RefreshStatusForMode(LinuxCapture* cap)
 {
     if (!cap)
@@ -2113,16 +7519,19 @@ static void RefreshStatusForMode(LinuxCapture* cap)
                     "Capturing (X11/XWayland GPU composite, VSync control unavailable) - %.1f fps",
                     cap->fps);
         }
-        else if (!cap->disable_vsync && cap->has_swap_control_tear)
+        else if (cap->vrr_active)
         {
+            const char* vrrMode = cap->disable_vsync ? "VRR, VSync off" : cap->has_swap_control_tear ? "VRR, adaptive VSync" : "VRR";
             if (cap->source_fps > 0.0)
                 snprintf(status, sizeof(status),
-                    "Capturing (X11/XWayland GPU composite, adaptive VSync/VRR) - %.1f fps (source %.1f)",
+                    "Capturing (X11/XWayland GPU composite, %s) - %.1f fps (source %.1f)",
+                    vrrMode,
                     cap->fps,
                     cap->source_fps);
             else
                 snprintf(status, sizeof(status),
-                    "Capturing (X11/XWayland GPU composite, adaptive VSync/VRR) - %.1f fps",
+                    "Capturing (X11/XWayland GPU composite, %s) - %.1f fps",
+                    vrrMode,
                     cap->fps);
         }
         else
@@ -2183,14 +7592,12 @@ static void UpdateMetrics(LinuxCapture* cap)
 
     if (cap->backend_mode == BackendReparentFallback || cap->backend_mode == BackendGpuComposite)
     {
-        if (cap->backend_mode == BackendReparentFallback)
-            PumpXEventsLocked(cap);
-
+        // Events for fallback captures are dispatched by the scheduler too.
         const uint64_t now = MonotonicNowNs();
         if (cap->source_last_event_ns != 0)
         {
             const double elapsed = static_cast<double>(now - cap->source_last_event_ns) / 1000000000.0;
-            if (elapsed >= 0.05)
+            if (elapsed >= SourceFpsDecaySeconds(cap))
             {
                 cap->source_fps *= 0.94;
                 if (cap->source_fps < 0.1)
@@ -2229,7 +7636,7 @@ int aes_linux_capture_is_active(LinuxCapture* cap)
 
 int aes_linux_capture_is_initializing(LinuxCapture* cap)
 {
-    return cap ? cap->initializing : 0;
+    return cap ? (cap->initializing || cap->init_pending ? 1 : 0) : 0;
 }
 
 double aes_linux_capture_get_fps(LinuxCapture* cap)
@@ -2298,4 +7705,84 @@ int aes_linux_capture_get_gpu_vendor(LinuxCapture* cap, char* buffer, int size)
     return static_cast<int>(strlen(buffer));
 }
 
+int aes_linux_capture_get_stats(LinuxCapture* cap, LinuxCaptureStats* stats)
+{
+    if (!cap || !stats || stats->struct_size <= 0)
+        return 0;
+
+    LinuxCaptureStats snapshot{};
+    snapshot.struct_size = static_cast<int>(sizeof(LinuxCaptureStats));
+
+    pthread_mutex_lock(&cap->mutex);
+    snapshot.source_timing = cap->source_timing;
+    snapshot.source_fps = cap->source_fps;
+    snapshot.source_frame_time_ms = cap->source_frame_time_ms;
+    snapshot.present_fps = cap->present_fps;
+    snapshot.present_frame_time_ms = cap->present_frame_time_ms;
+    snapshot.capture_latency_ms = cap->capture_latency_ms;
+    snapshot.source_frames = cap->source_frame_count;
+    snapshot.presented_frames = cap->presented_frames;
+    snapshot.last_source_msc = cap->present_last_msc;
+    snapshot.display_refresh_hz = cap->display_refresh_hz;
+    snapshot.vrr_requested = cap->vrr_active;
+    snapshot.swap_interval = cap->init_pending ? kSwapIntervalUnset : cap->applied_swap_interval;
+    snapshot.cropped_damage_skips = cap->cropped_damage_skips;
+    snapshot.partial_redraws = cap->partial_redraws;
+    snapshot.copy_source_active = CanCopySource(cap) ? 1 : 0;
+    snapshot.copy_ring_size = kCopyRingSize;
+    snapshot.copied_frames = cap->copied_frames;
+    snapshot.copy_fence_waits = cap->copy_fence_waits;
+    snapshot.auto_crop_left = cap->auto_crop[0];
+    snapshot.auto_crop_top = cap->auto_crop[1];
+    snapshot.auto_crop_right = cap->auto_crop[2];
+    snapshot.auto_crop_bottom = cap->auto_crop[3];
+    snapshot.content_bar_scans = cap->content_bar_scans;
+    snapshot.preview_frames = cap->preview_frames;
+    GetFrameExchangeSize(&cap->preview_exchange, &snapshot.preview_width, &snapshot.preview_height);
+    snapshot.headless = cap->headless;
+    snapshot.output_frames = cap->output_frames;
+    snapshot.unique_frames = cap->unique_frames;
+    snapshot.duplicate_frames = cap->duplicate_frames;
+    snapshot.duplicate_skips = cap->duplicate_skips;
+    snapshot.unique_fps = cap->unique_rate.Rate(MonotonicNowNs());
+    snapshot.round_trips = cap->round_trips;
+    snapshot.round_trips_per_frame = cap->render_passes > 0
+        ? static_cast<double>(cap->round_trips) / static_cast<double>(cap->render_passes)
+        : 0.0;
+    snapshot.search_round_trips = cap->search_round_trips;
+    snapshot.compositor_bypass_active = cap->compositor_bypass_active;
+    snapshot.compositor_bypass_transitions = cap->bypass_transitions;
+    snapshot.host_occluded = cap->host_occluded;
+    snapshot.occluded_skips = cap->occluded_skips;
+    snapshot.init_ms = cap->init_ms;
+    snapshot.first_frame_ms = cap->first_frame_ms;
+    snapshot.reacquisitions = cap->reacquisitions;
+    snapshot.last_reacquire_ms = cap->last_reacquire_ms;
+    snapshot.surface_probe_active = cap->probe_count > 0 ? 1 : 0;
+    snapshot.surface_switches = cap->surface_switches;
+    snapshot.input_events = cap->input_events;
+    snapshot.input_outside = cap->input_outside;
+    snapshot.input_latency_ms = cap->input_latency_ms;
+    snapshot.input_latency_max_ms = cap->input_latency_max_ms;
+    snapshot.input_path = cap->input_path;
+    snapshot.render_thread_mode = cap->render_thread_mode;
+    snapshot.render_thread_cpus = cap->render_thread_cpus;
+    snapshot.wake_late_ms = cap->wake_late_ms;
+    snapshot.wake_late_max_ms = cap->wake_late_max_ms;
+    pthread_mutex_lock(&g_capture_manager.sources_mutex);
+    snapshot.source_views = cap->source ? cap->source->refs : 0;
+    pthread_mutex_unlock(&g_capture_manager.sources_mutex);
+    pthread_mutex_lock(&cap->screenshot_mutex);
+    snapshot.screenshots_written = cap->screenshots_written;
+    snapshot.screenshots_failed = cap->screenshots_failed;
+    pthread_mutex_unlock(&cap->screenshot_mutex);
+    pthread_mutex_unlock(&cap->mutex);
+
+    // Callers built against an older layout get the prefix they know about.
+    const size_t copySize = std::min(static_cast<size_t>(stats->struct_size), sizeof(LinuxCaptureStats));
+    memcpy(stats, &snapshot, copySize);
+    stats->struct_size = static_cast<int>(copySize);
+    return 1;
+}
+
 }
@@ -0,0 +1,876 @@
+// End-to-end benchmark for the Linux capture bridge. Forks a synthetic
+// "emulator" (a GLX window that draws its frame counter and swap time into its
+// pixels at a fixed rate), captures it through the bridge's C API and prints
+// one JSON object: achieved fps, duplicated and dropped frames decoded from
+// the counter, emulator-to-readback latency, bridge CPU time per frame and
+// bridge wakeups per second.
+//
+//   CaptureBench [--mode headless|windowed] [--size WxH] [--rate FPS]
+//                [--output WxH] [--seconds N] [--warmup N] [--vsync 0|1]
+//                [--vrr 0|1] [--copy-source 0|1] [--dedupe 0|1|2]
+//                [--stretch 0-3] [--crop L,T,R,B] [--shader PATH]
+//                [--render-thread 0-2] [--render-cpus LIST|auto]
+//                [--label NAME]
+//
+// Headless captures are read back every frame, so every counter step is seen.
+// Windowed captures present into a host window and are sampled through the
+// preview stream (at most 30 fps), so their duplicate/drop counts come from
+// the bridge's own stats. Needs an X server with GLX and Composite;
+// run-capture-bench.sh starts Xvfb with llvmpipe so runs compare without a GPU.
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <GL/gl.h>
+#include <GL/glx.h>
+
+#include <dirent.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+extern "C" {
+
+struct LinuxCapture;
+
+// Copy of the bridge's stats struct. The bridge fills at most struct_size
+// bytes, so this copy stays valid as fields are appended there.
+typedef struct
+{
+    int struct_size;
+    int source_timing;
+    double source_fps;
+    double source_frame_time_ms;
+    double present_fps;
+    double present_frame_time_ms;
+    double capture_latency_ms;
+    uint64_t source_frames;
+    uint64_t presented_frames;
+    uint64_t last_source_msc;
+    double display_refresh_hz;
+    int vrr_requested;
+    int swap_interval;
+    uint64_t cropped_damage_skips;
+    uint64_t partial_redraws;
+    int copy_source_active;
+    int copy_ring_size;
+    uint64_t copied_frames;
+    uint64_t copy_fence_waits;
+    int auto_crop_left;
+    int auto_crop_top;
+    int auto_crop_right;
+    int auto_crop_bottom;
+    uint64_t content_bar_scans;
+    uint64_t preview_frames;
+    int preview_width;
+    int preview_height;
+    int headless;
+    uint64_t output_frames;
+    uint64_t screenshots_written;
+    uint64_t screenshots_failed;
+    uint64_t unique_frames;
+    uint64_t duplicate_frames;
+    uint64_t duplicate_skips;
+    double unique_fps;
+    int source_views;
+    uint64_t round_trips;
+    double round_trips_per_frame;
+    int search_round_trips;
+    int compositor_bypass_active;
+    uint64_t compositor_bypass_transitions;
+    int host_occluded;
+    uint64_t occluded_skips;
+    double init_ms;
+    double first_frame_ms;
+    uint64_t reacquisitions;
+    double last_reacquire_ms;
+    int surface_probe_active;
+    uint64_t surface_switches;
+    uint64_t input_events;
+    uint64_t input_outside;
+    double input_latency_ms;
+    double input_latency_max_ms;
+    int input_path;
+    int render_thread_mode;
+    uint64_t render_thread_cpus;
+    double wake_late_ms;
+    double wake_late_max_ms;
+} LinuxCaptureStats;
+
+LinuxCapture* aes_linux_capture_create(void* parentHandle);
+LinuxCapture* aes_linux_capture_create_headless(int outputWidth, int outputHeight);
+void aes_linux_capture_destroy(LinuxCapture* cap);
+void aes_linux_capture_set_disable_vsync(LinuxCapture* cap, int disableVsync);
+void aes_linux_capture_set_vrr_enabled(LinuxCapture* cap, int enabled);
+void aes_linux_capture_set_copy_source(LinuxCapture* cap, int enabled);
+void aes_linux_capture_set_render_thread(LinuxCapture* cap, int mode, const char* cpus);
+void aes_linux_capture_set_duplicate_detection(LinuxCapture* cap, int mode);
+void aes_linux_capture_enable_preview(LinuxCapture* cap, int maxWidth, double fps);
+int aes_linux_capture_copy_preview(LinuxCapture* cap, void* buffer, int bufferSize, int* width, int* height, uint64_t* sequence);
+void aes_linux_capture_set_output_readback(LinuxCapture* cap, int enabled);
+int aes_linux_capture_copy_output(LinuxCapture* cap, void* buffer, int bufferSize, int* width, int* height, uint64_t* sequence);
+void aes_linux_capture_set_shader_path(LinuxCapture* cap, const char* shaderPath);
+void aes_linux_capture_set_target(LinuxCapture* cap, int processId, const char* windowTitleHint);
+void aes_linux_capture_stop(LinuxCapture* cap);
+void aes_linux_capture_set_stretch(LinuxCapture* cap, int stretch);
+void aes_linux_capture_set_crop_insets(LinuxCapture* cap, int left, int top, int right, int bottom);
+void* aes_linux_capture_find_window_by_pid(int pid, const char* titleHint);
+int aes_linux_capture_get_status_text(LinuxCapture* cap, char* buffer, int size);
+int aes_linux_capture_get_gpu_renderer(LinuxCapture* cap, char* buffer, int size);
+int aes_linux_capture_get_stats(LinuxCapture* cap, LinuxCaptureStats* stats);
+
+}
+
+namespace {
+
+const char* const kEmulatorTitle = "AES Capture Bench Emulator";
+
+// The emulator draws an 8x8 grid of black/white bit cells in the centre of the
+// frame, ringed by one cell of marker green. The decoder walks out from the
+// centre of the captured frame to the ring, so the code survives any crop that
+// keeps the centre, every stretch mode and the output scale.
+constexpr int kCodeCells = 8;
+constexpr int kCounterBits = 24;
+constexpr uint32_t kCounterMask = (1u << kCounterBits) - 1;
+// Swap times are CLOCK_MONOTONIC in 10 us units, modulo 2^32 (about 11.9 h).
+constexpr uint64_t kTimeUnitNs = 10000;
+
+volatile sig_atomic_t g_emulator_stop = 0;
+
+struct Options
+{
+    bool headless = true;
+    int source_w = 640;
+    int source_h = 480;
+    double rate = 60.0;
+    int output_w = 1280;
+    int output_h = 720;
+    double seconds = 10.0;
+    double warmup = 1.0;
+    int vsync = 1;
+    int vrr = 0;
+    int copy_source = 1;
+    int dedupe = 1;
+    int stretch = 2;
+    int crop[4] = { 0, 0, 0, 0 };
+    std::string shader;
+    int render_thread = 0;
+    std::string render_cpus;
+    std::string label;
+};
+
+uint64_t MonotonicNowNs()
+{
+    timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+void SleepUntilNs(uint64_t deadline)
+{
+    timespec ts{};
+    ts.tv_sec = static_cast<time_t>(deadline / 1000000000ULL);
+    ts.tv_nsec = static_cast<long>(deadline % 1000000000ULL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR && !g_emulator_stop)
+    {
+    }
+}
+
+uint8_t CodeChecksum(uint64_t payload)
+{
+    uint8_t sum = 0x5a;
+    for (int i = 0; i < 7; i++)
+        sum = static_cast<uint8_t>((sum * 31) ^ static_cast<uint8_t>(payload >> (i * 8)));
+    return sum;
+}
+
+uint64_t PackCode(uint32_t counter, uint32_t timeUnits)
+{
+    const uint64_t payload = (counter & kCounterMask) | (static_cast<uint64_t>(timeUnits) << kCounterBits);
+    return payload | (static_cast<uint64_t>(CodeChecksum(payload)) << 56);
+}
+
+bool UnpackCode(uint64_t code, uint32_t* counter, uint32_t* timeUnits)
+{
+    const uint64_t payload = code & ((1ULL << 56) - 1);
+    if (CodeChecksum(payload) != static_cast<uint8_t>(code >> 56))
+        return false;
+
+    *counter = static_cast<uint32_t>(payload) & kCounterMask;
+    *timeUnits = static_cast<uint32_t>(payload >> kCounterBits);
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Emulator process
+
+void OnEmulatorSignal(int)
+{
+    g_emulator_stop = 1;
+}
+
+void FillRect(int x, int y, int w, int h, float r, float g, float b)
+{
+    glScissor(x, y, w, h);
+    glClearColor(r, g, b, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void DrawEmulatorFrame(int width, int height, uint32_t counter, uint32_t timeUnits)
+{
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(static_cast<float>(counter % 64) / 128.0f, 0.08f, 0.35f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_SCISSOR_TEST);
+
+    // A bar sweeping the top strip, so frames also damage outside the code.
+    const int barW = std::max(1, width / 16);
+    const int barH = std::max(1, height / 10);
+    FillRect(static_cast<int>((counter * 8u) % static_cast<uint32_t>(width)), height - barH, barW, barH, 0.9f, 0.3f, 0.2f);
+
+    const int cell = std::max(2, std::min(width, height) / 2 / (kCodeCells + 2));
+    const int side = cell * (kCodeCells + 2);
+    const int x0 = (width - side) / 2;
+    const int y0 = (height - side) / 2;
+    FillRect(x0, y0, side, side, 0.0f, 1.0f, 0.0f);
+
+    const uint64_t code = PackCode(counter, timeUnits);
+    for (int bit = 0; bit < kCodeCells * kCodeCells; bit++)
+    {
+        // Bit rows run top-down; GL rows run bottom-up.
+        const int row = bit / kCodeCells;
+        const int column = bit % kCodeCells;
+        const float value = ((code >> bit) & 1) ? 1.0f : 0.0f;
+        FillRect(x0 + (column + 1) * cell, y0 + side - (row + 2) * cell, cell, cell, value, value, value);
+    }
+}
+
+int RunEmulator(const Options& options)
+{
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    signal(SIGTERM, OnEmulatorSignal);
+    signal(SIGINT, OnEmulatorSignal);
+
+    Display* display = XOpenDisplay(nullptr);
+    if (!display)
+        return 1;
+
+    int attributes[] = { GLX_RGBA, GLX_DOUBLEBUFFER, GLX_RED_SIZE, 8, GLX_GREEN_SIZE, 8, GLX_BLUE_SIZE, 8, None };
+    XVisualInfo* visual = glXChooseVisual(display, DefaultScreen(display), attributes);
+    if (!visual)
+        return 1;
+
+    const Window root = DefaultRootWindow(display);
+    XSetWindowAttributes windowAttributes{};
+    windowAttributes.colormap = XCreateColormap(display, root, visual->visual, AllocNone);
+    windowAttributes.border_pixel = 0;
+    const Window window = XCreateWindow(display, root, 0, 0, options.source_w, options.source_h, 0, visual->depth, InputOutput,
+        visual->visual, CWColormap | CWBorderPixel, &windowAttributes);
+    XStoreName(display, window, kEmulatorTitle);
+    // No window manager under Xvfb sets _NET_WM_PID, which set_target matches on.
+    const long pid = static_cast<long>(getpid());
+    XChangeProperty(display, window, XInternAtom(display, "_NET_WM_PID", False), XA_CARDINAL, 32, PropModeReplace,
+        reinterpret_cast<const unsigned char*>(&pid), 1);
+    XMapWindow(display, window);
+
+    GLXContext context = glXCreateContext(display, visual, nullptr, True);
+    if (!context || !glXMakeCurrent(display, window, context))
+        return 1;
+
+    // Paced by the clock below, not by vblank.
+    typedef void (*SwapIntervalExt)(Display*, GLXDrawable, int);
+    typedef int (*SwapIntervalMesa)(unsigned int);
+    if (auto swapExt = reinterpret_cast<SwapIntervalExt>(glXGetProcAddress(reinterpret_cast<const GLubyte*>("glXSwapIntervalEXT"))))
+        swapExt(display, window, 0);
+    else if (auto swapMesa = reinterpret_cast<SwapIntervalMesa>(glXGetProcAddress(reinterpret_cast<const GLubyte*>("glXSwapIntervalMESA"))))
+        swapMesa(0);
+
+    const uint64_t period = options.rate > 0.0 ? static_cast<uint64_t>(1e9 / options.rate) : 0;
+    uint64_t deadline = MonotonicNowNs();
+    uint32_t counter = 0;
+    while (!g_emulator_stop)
+    {
+        while (XPending(display) > 0)
+        {
+            XEvent event;
+            XNextEvent(display, &event);
+        }
+
+        const uint32_t timeUnits = static_cast<uint32_t>(MonotonicNowNs() / kTimeUnitNs);
+        DrawEmulatorFrame(options.source_w, options.source_h, counter, timeUnits);
+        glXSwapBuffers(display, window);
+        counter = (counter + 1) & kCounterMask;
+
+        if (period == 0)
+            continue;
+
+        deadline += period;
+        const uint64_t now = MonotonicNowNs();
+        // A late emulator restarts its cadence instead of bursting to catch up.
+        if (now > deadline + period)
+            deadline = now;
+        SleepUntilNs(deadline);
+    }
+
+    glXMakeCurrent(display, None, nullptr);
+    glXDestroyContext(display, context);
+    XDestroyWindow(display, window);
+    XFree(visual);
+    XCloseDisplay(display);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Frame decoding
+
+// Relative rather than absolute, so shaders that dim rows still find the ring.
+bool IsMarker(const uint8_t* bgra)
+{
+    return bgra[1] > bgra[0] + 64 && bgra[1] > bgra[2] + 64;
+}
+
+// Decodes the emulator code from a top-down BGRA frame (stride width * 4).
+bool DecodeFrame(const uint8_t* bgra, int width, int height, uint64_t* code)
+{
+    if (width < 16 || height < 16)
+        return false;
+
+    auto pixel = [&](int x, int y) { return bgra + (static_cast<size_t>(y) * width + x) * 4; };
+    const int cx = width / 2;
+    const int cy = height / 2;
+    int left = cx;
+    while (left > 0 && !IsMarker(pixel(left - 1, cy)))
+        left--;
+    int right = cx;
+    while (right < width - 1 && !IsMarker(pixel(right + 1, cy)))
+        right++;
+    int top = cy;
+    while (top > 0 && !IsMarker(pixel(cx, top - 1)))
+        top--;
+    int bottom = cy;
+    while (bottom < height - 1 && !IsMarker(pixel(cx, bottom + 1)))
+        bottom++;
+    if (left == 0 || top == 0 || right == width - 1 || bottom == height - 1)
+        return false;
+
+    const double cellW = static_cast<double>(right - left + 1) / kCodeCells;
+    const double cellH = static_cast<double>(bottom - top + 1) / kCodeCells;
+    uint64_t value = 0;
+    for (int bit = 0; bit < kCodeCells * kCodeCells; bit++)
+    {
+        const int x = left + static_cast<int>((bit % kCodeCells + 0.5) * cellW);
+        const int y = top + static_cast<int>((bit / kCodeCells + 0.5) * cellH);
+        const uint8_t* p = pixel(std::min(x, width - 1), std::min(y, height - 1));
+        if (p[0] + p[1] + p[2] > 3 * 127)
+            value |= 1ULL << bit;
+    }
+    *code = value;
+    return true;
+}
+
+struct DecodeStats
+{
+    uint64_t frames = 0;
+    uint64_t undecodable = 0;
+    uint64_t unique = 0;
+    uint64_t duplicated = 0;
+    uint64_t dropped = 0;
+    // Frames the bridge published that the poller missed (sequence gaps).
+    uint64_t unobserved = 0;
+    uint32_t first_counter = 0;
+    uint32_t last_counter = 0;
+    bool have_counter = false;
+    std::vector<double> latencies_ms;
+};
+
+typedef int (*CopyFrameFn)(LinuxCapture*, void*, int, int*, int*, uint64_t*);
+
+struct FramePoller
+{
+    LinuxCapture* cap = nullptr;
+    CopyFrameFn copy = nullptr;
+    std::vector<uint8_t> buffer;
+    uint64_t sequence = 0;
+
+    // Takes the newest published frame, if any, into stats.
+    void Poll(DecodeStats& stats)
+    {
+        int width = 0;
+        int height = 0;
+        uint64_t next = sequence;
+        if (!copy(cap, buffer.data(), static_cast<int>(buffer.size()), &width, &height, &next))
+        {
+            const size_t needed = static_cast<size_t>(std::max(0, width)) * std::max(0, height) * 4;
+            if (needed > buffer.size())
+                buffer.resize(needed);
+            return;
+        }
+
+        const uint64_t now = MonotonicNowNs();
+        const uint64_t skipped = sequence != 0 && next > sequence + 1 ? next - sequence - 1 : 0;
+        sequence = next;
+        stats.frames++;
+        stats.unobserved += skipped;
+
+        uint64_t code = 0;
+        uint32_t counter = 0;
+        uint32_t timeUnits = 0;
+        if (!DecodeFrame(buffer.data(), width, height, &code) || !UnpackCode(code, &counter, &timeUnits))
+        {
+            stats.undecodable++;
+            return;
+        }
+
+        const uint32_t elapsedUnits = static_cast<uint32_t>(now / kTimeUnitNs) - timeUnits;
+        stats.latencies_ms.push_back(static_cast<double>(elapsedUnits) * kTimeUnitNs / 1e6);
+
+        if (!stats.have_counter)
+        {
+            stats.first_counter = counter;
+            stats.unique++;
+        }
+        else if (counter == stats.last_counter)
+        {
+            stats.duplicated++;
+        }
+        else
+        {
+            const uint32_t step = (counter - stats.last_counter) & kCounterMask;
+            // Counters missing from a sequence gap are the poller's misses, not drops.
+            stats.dropped += step > 1 + skipped ? step - 1 - skipped : 0;
+            stats.unique++;
+        }
+        stats.last_counter = counter;
+        stats.have_counter = true;
+    }
+};
+
+// ---------------------------------------------------------------------------
+// Bridge thread usage
+
+struct ThreadUsage
+{
+    uint64_t cpu_ns = 0;
+    uint64_t wakeups = 0;
+};
+
+bool ReadFile(const char* path, char* buffer, size_t size)
+{
+    FILE* file = fopen(path, "r");
+    if (!file)
+        return false;
+    const size_t length = fread(buffer, 1, size - 1, file);
+    buffer[length] = '\0';
+    fclose(file);
+    return length > 0;
+}
+
+uint64_t StatusField(const char* status, const char* name)
+{
+    const char* field = strstr(status, name);
+    return field ? strtoull(field + strlen(name), nullptr, 10) : 0;
+}
+
+// CPU time and voluntary context switches (blocking waits that were woken)
+// of every thread in the process except the poller.
+ThreadUsage SampleBridgeThreads(long pollerTid)
+{
+    ThreadUsage usage;
+    DIR* tasks = opendir("/proc/self/task");
+    if (!tasks)
+        return usage;
+
+    const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    char path[128];
+    char text[4096];
+    while (dirent* entry = readdir(tasks))
+    {
+        const long tid = strtol(entry->d_name, nullptr, 10);
+        if (tid <= 0 || tid == pollerTid)
+            continue;
+
+        snprintf(path, sizeof(path), "/proc/self/task/%ld/schedstat", tid);
+        if (ReadFile(path, text, sizeof(text)))
+        {
+            usage.cpu_ns += strtoull(text, nullptr, 10);
+        }
+        else
+        {
+            // Kernels without schedstats: utime and stime in clock ticks.
+            snprintf(path, sizeof(path), "/proc/self/task/%ld/stat", tid);
+            const char* fields = ReadFile(path, text, sizeof(text)) ? strrchr(text, ')') : nullptr;
+            unsigned long utime = 0;
+            unsigned long stime = 0;
+            if (fields && sscanf(fields, ") %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2 && ticksPerSecond > 0)
+                usage.cpu_ns += static_cast<uint64_t>(utime + stime) * 1000000000ULL / static_cast<uint64_t>(ticksPerSecond);
+        }
+
+        snprintf(path, sizeof(path), "/proc/self/task/%ld/status", tid);
+        if (ReadFile(path, text, sizeof(text)))
+            usage.wakeups += StatusField(text, "voluntary_ctxt_switches:");
+    }
+    closedir(tasks);
+    return usage;
+}
+
+uint64_t ProcessCpuNs()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return (static_cast<uint64_t>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ULL +
+            static_cast<uint64_t>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec)) * 1000ULL;
+}
+
+// ---------------------------------------------------------------------------
+// Options and report
+
+bool ParseSize(const char* text, int* width, int* height)
+{
+    return sscanf(text, "%dx%d", width, height) == 2 && *width > 0 && *height > 0;
+}
+
+bool ParseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* name = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (!value)
+            return false;
+        i++;
+
+        bool ok = true;
+        if (strcmp(name, "--mode") == 0)
+        {
+            ok = strcmp(value, "headless") == 0 || strcmp(value, "windowed") == 0;
+            options.headless = strcmp(value, "headless") == 0;
+        }
+        else if (strcmp(name, "--size") == 0)
+            ok = ParseSize(value, &options.source_w, &options.source_h);
+        else if (strcmp(name, "--output") == 0)
+            ok = ParseSize(value, &options.output_w, &options.output_h);
+        else if (strcmp(name, "--rate") == 0)
+            options.rate = std::max(0.0, atof(value));
+        else if (strcmp(name, "--seconds") == 0)
+            options.seconds = std::max(0.5, atof(value));
+        else if (strcmp(name, "--warmup") == 0)
+            options.warmup = std::max(0.0, atof(value));
+        else if (strcmp(name, "--vsync") == 0)
+            options.vsync = atoi(value) != 0;
+        else if (strcmp(name, "--vrr") == 0)
+            options.vrr = atoi(value) != 0;
+        else if (strcmp(name, "--copy-source") == 0)
+            options.copy_source = atoi(value) != 0;
+        else if (strcmp(name, "--dedupe") == 0)
+            options.dedupe = atoi(value);
+        else if (strcmp(name, "--stretch") == 0)
+            options.stretch = std::clamp(atoi(value), 0, 3);
+        else if (strcmp(name, "--crop") == 0)
+            ok = sscanf(value, "%d,%d,%d,%d", &options.crop[0], &options.crop[1], &options.crop[2], &options.crop[3]) == 4;
+        else if (strcmp(name, "--shader") == 0)
+            options.shader = value;
+        else if (strcmp(name, "--render-thread") == 0)
+            options.render_thread = std::clamp(atoi(value), 0, 2);
+        else if (strcmp(name, "--render-cpus") == 0)
+            options.render_cpus = value;
+        else if (strcmp(name, "--label") == 0)
+            options.label = value;
+        else
+            ok = false;
+
+        if (!ok)
+        {
+            fprintf(stderr, "invalid option: %s %s\n", name, value);
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string JsonString(const std::string& text)
+{
+    std::string out = "\"";
+    for (const char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+double Percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty())
+        return 0.0;
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5));
+    return sorted[index];
+}
+
+double PerFrame(double total, uint64_t frames)
+{
+    return frames > 0 ? total / static_cast<double>(frames) : 0.0;
+}
+
+struct Report
+{
+    std::string renderer;
+    double seconds = 0.0;
+    DecodeStats decoded;
+    LinuxCaptureStats before{};
+    LinuxCaptureStats after{};
+    ThreadUsage threads_before;
+    ThreadUsage threads_after;
+    uint64_t process_cpu_ns = 0;
+};
+
+void PrintReport(const Options& options, Report& report)
+{
+    const DecodeStats& decoded = report.decoded;
+    const LinuxCaptureStats& before = report.before;
+    const LinuxCaptureStats& after = report.after;
+    const uint64_t presented = after.presented_frames - before.presented_frames;
+    const uint64_t bridgeUnique = after.unique_frames - before.unique_frames;
+    const uint64_t emulated = decoded.have_counter ? ((decoded.last_counter - decoded.first_counter) & kCounterMask) + 1 : 0;
+    // Sampled (windowed) runs see a fraction of the frames: take duplicates
+    // from the bridge and count drops as emulator frames never presented.
+    const uint64_t duplicated = options.headless ? decoded.duplicated : after.duplicate_frames - before.duplicate_frames;
+    const uint64_t dropped = options.headless ? decoded.dropped : (emulated > bridgeUnique ? emulated - bridgeUnique : 0);
+    const uint64_t frames = presented > 0 ? presented : decoded.unique;
+    const double cpuMs = static_cast<double>(report.threads_after.cpu_ns - report.threads_before.cpu_ns) / 1e6;
+    const double wakeups = static_cast<double>(report.threads_after.wakeups - report.threads_before.wakeups);
+
+    std::vector<double> latencies = decoded.latencies_ms;
+    std::sort(latencies.begin(), latencies.end());
+    double latencySum = 0.0;
+    for (const double latency : latencies)
+        latencySum += latency;
+
+    printf("{\"label\":%s,", JsonString(options.label).c_str());
+    printf("\"config\":{\"mode\":\"%s\",\"source\":\"%dx%d\",\"rate\":%.2f,\"output\":\"%dx%d\",\"vsync\":%d,\"vrr\":%d,"
+           "\"copy_source\":%d,\"dedupe\":%d,\"stretch\":%d,\"crop\":[%d,%d,%d,%d],\"shader\":%s,"
+           "\"render_thread\":%d,\"render_cpus\":%s},",
+        options.headless ? "headless" : "windowed", options.source_w, options.source_h, options.rate,
+        options.output_w, options.output_h, options.vsync, options.vrr, options.copy_source, options.dedupe,
+        options.stretch, options.crop[0], options.crop[1], options.crop[2], options.crop[3], JsonString(options.shader).c_str(),
+        options.render_thread, JsonString(options.render_cpus).c_str());
+    printf("\"renderer\":%s,\"seconds\":%.3f,", JsonString(report.renderer).c_str(), report.seconds);
+    printf("\"fps\":%.2f,\"present_fps\":%.2f,\"unique_fps\":%.2f,",
+        options.headless ? decoded.unique / report.seconds : bridgeUnique / report.seconds,
+        presented / report.seconds, after.unique_fps);
+    printf("\"frames\":{\"emulated\":%llu,\"read\":%llu,\"decoded_unique\":%llu,\"duplicated\":%llu,\"dropped\":%llu,"
+           "\"unobserved\":%llu,\"undecodable\":%llu,\"presented\":%llu,\"sampled\":%s},",
+        static_cast<unsigned long long>(emulated), static_cast<unsigned long long>(decoded.frames),
+        static_cast<unsigned long long>(decoded.unique), static_cast<unsigned long long>(duplicated),
+        static_cast<unsigned long long>(dropped), static_cast<unsigned long long>(decoded.unobserved),
+        static_cast<unsigned long long>(decoded.undecodable), static_cast<unsigned long long>(presented),
+        options.headless ? "false" : "true");
+    printf("\"latency_ms\":{\"mean\":%.3f,\"p50\":%.3f,\"p95\":%.3f,\"max\":%.3f,\"bridge_capture\":%.3f},",
+        latencies.empty() ? 0.0 : latencySum / latencies.size(), Percentile(latencies, 0.5), Percentile(latencies, 0.95),
+        latencies.empty() ? 0.0 : latencies.back(), after.capture_latency_ms);
+    printf("\"cpu_ms_per_frame\":%.3f,\"process_cpu_ms_per_frame\":%.3f,\"wakeups_per_second\":%.1f,",
+        PerFrame(cpuMs, frames), PerFrame(static_cast<double>(report.process_cpu_ns) / 1e6, frames), wakeups / report.seconds);
+    printf("\"bridge\":{\"source_timing\":%d,\"swap_interval\":%d,\"copy_source_active\":%d,\"partial_redraws\":%llu,"
+           "\"duplicate_skips\":%llu,\"round_trips_per_frame\":%.3f,\"init_ms\":%.1f,\"first_frame_ms\":%.1f,"
+           "\"render_thread_mode\":%d,\"render_thread_cpus\":%llu,\"wake_late_ms\":%.3f,\"wake_late_max_ms\":%.3f}}\n",
+        after.source_timing, after.swap_interval, after.copy_source_active,
+        static_cast<unsigned long long>(after.partial_redraws - before.partial_redraws),
+        static_cast<unsigned long long>(after.duplicate_skips - before.duplicate_skips), after.round_trips_per_frame,
+        after.init_ms, after.first_frame_ms, after.render_thread_mode,
+        static_cast<unsigned long long>(after.render_thread_cpus), after.wake_late_ms, after.wake_late_max_ms);
+    fflush(stdout);
+}
+
+LinuxCaptureStats ReadStats(LinuxCapture* cap)
+{
+    LinuxCaptureStats stats{};
+    stats.struct_size = static_cast<int>(sizeof(stats));
+    aes_linux_capture_get_stats(cap, &stats);
+    return stats;
+}
+
+void StopEmulator(pid_t emulator)
+{
+    kill(emulator, SIGTERM);
+    waitpid(emulator, nullptr, 0);
+}
+
+int RunBench(const Options& options, pid_t emulator)
+{
+    // The emulator maps its window asynchronously; wait for it to show up.
+    const uint64_t searchDeadline = MonotonicNowNs() + 10000000000ULL;
+    while (!aes_linux_capture_find_window_by_pid(emulator, kEmulatorTitle))
+    {
+        if (MonotonicNowNs() > searchDeadline || waitpid(emulator, nullptr, WNOHANG) == emulator)
+        {
+            fprintf(stderr, "emulator window did not appear\n");
+            return 1;
+        }
+        usleep(20000);
+    }
+
+    Display* hostDisplay = nullptr;
+    Window host = 0;
+    LinuxCapture* cap = nullptr;
+    if (options.headless)
+    {
+        cap = aes_linux_capture_create_headless(options.output_w, options.output_h);
+    }
+    else
+    {
+        hostDisplay = XOpenDisplay(nullptr);
+        if (!hostDisplay)
+        {
+            fprintf(stderr, "cannot open display for the host window\n");
+            return 1;
+        }
+        host = XCreateSimpleWindow(hostDisplay, DefaultRootWindow(hostDisplay), 0, 0, options.output_w, options.output_h, 0, 0, 0);
+        XStoreName(hostDisplay, host, "AES Capture Bench Host");
+        XMapWindow(hostDisplay, host);
+        XSync(hostDisplay, False);
+        cap = aes_linux_capture_create(reinterpret_cast<void*>(host));
+    }
+    if (!cap)
+    {
+        fprintf(stderr, "capture creation failed\n");
+        if (hostDisplay)
+            XCloseDisplay(hostDisplay);
+        return 1;
+    }
+
+    aes_linux_capture_set_disable_vsync(cap, options.vsync ? 0 : 1);
+    aes_linux_capture_set_vrr_enabled(cap, options.vrr);
+    aes_linux_capture_set_copy_source(cap, options.copy_source);
+    aes_linux_capture_set_duplicate_detection(cap, options.dedupe);
+    aes_linux_capture_set_stretch(cap, options.stretch);
+    aes_linux_capture_set_crop_insets(cap, options.crop[0], options.crop[1], options.crop[2], options.crop[3]);
+    aes_linux_capture_set_shader_path(cap, options.shader.c_str());
+    aes_linux_capture_set_render_thread(cap, options.render_thread, options.render_cpus.c_str());
+
+    FramePoller poller;
+    poller.cap = cap;
+    if (options.headless)
+    {
+        aes_linux_capture_set_output_readback(cap, 1);
+        poller.copy = aes_linux_capture_copy_output;
+    }
+    else
+    {
+        aes_linux_capture_enable_preview(cap, options.output_w, 30.0);
+        poller.copy = aes_linux_capture_copy_preview;
+    }
+    aes_linux_capture_set_target(cap, emulator, kEmulatorTitle);
+
+    // Warm up until a frame decodes, then for the requested time, so shader
+    // compilation and the first-frame setup stay out of the measurement.
+    DecodeStats warmup;
+    const uint64_t firstDeadline = MonotonicNowNs() + 10000000000ULL;
+    while (!warmup.have_counter && MonotonicNowNs() < firstDeadline)
+    {
+        poller.Poll(warmup);
+        usleep(1000);
+    }
+    if (!warmup.have_counter)
+    {
+        char status[512] = {};
+        aes_linux_capture_get_status_text(cap, status, sizeof(status));
+        fprintf(stderr, "no decodable frame within 10 s (read %llu, undecodable %llu): %s\n",
+            static_cast<unsigned long long>(warmup.frames), static_cast<unsigned long long>(warmup.undecodable), status);
+        aes_linux_capture_destroy(cap);
+        if (hostDisplay)
+            XCloseDisplay(hostDisplay);
+        return 1;
+    }
+    const uint64_t warmupEnd = MonotonicNowNs() + static_cast<uint64_t>(options.warmup * 1e9);
+    while (MonotonicNowNs() < warmupEnd)
+    {
+        poller.Poll(warmup);
+        usleep(1000);
+    }
+
+    Report report;
+    char renderer[256] = {};
+    aes_linux_capture_get_gpu_renderer(cap, renderer, sizeof(renderer));
+    report.renderer = renderer;
+
+    const long pollerTid = static_cast<long>(syscall(SYS_gettid));
+    report.before = ReadStats(cap);
+    report.threads_before = SampleBridgeThreads(pollerTid);
+    const uint64_t processBefore = ProcessCpuNs();
+    const uint64_t start = MonotonicNowNs();
+    const uint64_t end = start + static_cast<uint64_t>(options.seconds * 1e9);
+    while (MonotonicNowNs() < end)
+    {
+        poller.Poll(report.decoded);
+        usleep(1000);
+    }
+    report.seconds = static_cast<double>(MonotonicNowNs() - start) / 1e9;
+    report.after = ReadStats(cap);
+    report.threads_after = SampleBridgeThreads(pollerTid);
+    report.process_cpu_ns = ProcessCpuNs() - processBefore;
+
+    aes_linux_capture_stop(cap);
+    aes_linux_capture_destroy(cap);
+    if (hostDisplay)
+    {
+        XDestroyWindow(hostDisplay, host);
+        XCloseDisplay(hostDisplay);
+    }
+
+    PrintReport(options, report);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [--mode headless|windowed] [--size WxH] [--rate FPS] [--output WxH] [--seconds N]\n"
+                        "       [--warmup N] [--vsync 0|1] [--vrr 0|1] [--copy-source 0|1] [--dedupe 0|1|2]\n"
+                        "       [--stretch 0-3] [--crop L,T,R,B] [--shader PATH] [--render-thread 0-2]\n"
+                        "       [--render-cpus LIST|auto] [--label NAME]\n", argv[0]);
+        return 2;
+    }
+
+    // Fork before this process opens X or starts bridge threads.
+    fflush(stdout);
+    const pid_t emulator = fork();
+    if (emulator < 0)
+    {
+        perror("fork");
+        return 1;
+    }
+    if (emulator == 0)
+        _exit(RunEmulator(options));
+
+    const int result = RunBench(options, emulator);
+    StopEmulator(emulator);
+    return result;
+}
@@ -0,0 +1,77 @@
+#!/usr/bin/env bash
+# Builds CaptureBench, starts Xvfb with Mesa's llvmpipe and runs the capture
+# benchmark over each backend and pacing mode. Writes a JSON array with one
+# CaptureBench report per run.
+#
+#   run-capture-bench.sh [output.json] [seconds]
+set -euo pipefail
+
+OUTPUT_FILE="$(realpath -m "${1:-capture-bench.json}")"
+SECONDS_PER_RUN="${2:-10}"
+NATIVE_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="${BUILD_DIR:-$NATIVE_DIR/_bench_build}"
+SHADER_FILE="${SHADER_FILE:-$NATIVE_DIR/../../../AES_Emulation/Windows/shaders/glsl/Scanline_Arcade.glsl}"
+SCREEN_NUMBER="${SCREEN_NUMBER:-99}"
+
+for tool in cmake Xvfb; do
+  if ! command -v "$tool" >/dev/null 2>&1; then
+    echo "required tool not found: $tool" >&2
+    exit 1
+  fi
+done
+
+cmake -S "$NATIVE_DIR" -B "$BUILD_DIR" -DCMAKE_BUILD_TYPE=Release >/dev/null
+cmake --build "$BUILD_DIR" -j"$(nproc)" >/dev/null
+BENCH="$BUILD_DIR/CaptureBench"
+
+Xvfb ":$SCREEN_NUMBER" -screen 0 1920x1080x24 -nolisten tcp +extension GLX +extension Composite >/dev/null 2>&1 &
+XVFB_PID=$!
+trap 'kill "$XVFB_PID" 2>/dev/null || true' EXIT
+
+export DISPLAY=":$SCREEN_NUMBER"
+export LIBGL_ALWAYS_SOFTWARE=1
+export GALLIUM_DRIVER=llvmpipe
+
+for _ in $(seq 1 50); do
+  [[ -e "/tmp/.X11-unix/X$SCREEN_NUMBER" ]] && break
+  sleep 0.1
+done
+
+RUNS=(
+  "headless-vsync        --mode headless --vsync 1"
+  "headless-novsync      --mode headless --vsync 0"
+  "headless-nocopy       --mode headless --copy-source 0"
+  "headless-nodedupe     --mode headless --dedupe 0"
+  "headless-30fps        --mode headless --rate 30"
+  "headless-30fps-skip   --mode headless --rate 30 --dedupe 2"
+  "headless-crop-stretch --mode headless --crop 16,8,16,8 --stretch 1"
+  "headless-raised       --mode headless --render-thread 1 --render-cpus auto"
+  "headless-realtime     --mode headless --render-thread 2 --render-cpus auto"
+  "windowed-vsync        --mode windowed --vsync 1"
+  "windowed-novsync      --mode windowed --vsync 0"
+  "windowed-vrr          --mode windowed --vsync 1 --vrr 1"
+)
+if [[ -f "$SHADER_FILE" ]]; then
+  RUNS+=("headless-shader --mode headless --shader $SHADER_FILE")
+fi
+
+FAILED=0
+{
+  echo "["
+  SEPARATOR=""
+  for run in "${RUNS[@]}"; do
+    read -r label args <<<"$run"
+    # shellcheck disable=SC2086
+    if report="$("$BENCH" --label "$label" --seconds "$SECONDS_PER_RUN" $args)"; then
+      printf '%s%s\n' "$SEPARATOR" "$report"
+      SEPARATOR=","
+    else
+      echo "capture bench run failed: $label" >&2
+      FAILED=1
+    fi
+  done
+  echo "]"
+} >"$OUTPUT_FILE"
+
+echo "capture bench results: $OUTPUT_FILE"
+exit "$FAILED"
@@ -0,0 +1,402 @@
+#pragma once
+
+// Black-bar (pillarbox/letterbox) detection shared by the Windows and Linux
+// capture bridges. Header-only and dependency-free so each bridge can include
+// it from its own build without linking anything extra.
+//
+// Input is a downscaled BGRA8 frame. One pass computes per-column and per-row
+// max luma, mean and variance; a column or row counts as bar when it is black
+// (max luma at or below the threshold) or, for dithered/noisy bars, when it is
+// dark on average and nearly flat. ContentBarTracker then smooths the raw scan
+// results over time before a bridge applies them as crop insets.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AES_CONTENT_BAR_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AES_CONTENT_BAR_NEON 1
+#endif
+
+namespace aes_native {
+
+struct ContentBarInsets
+{
+    int left;
+    int top;
+    int right;
+    int bottom;
+};
+
+struct ContentBarScan
+{
+    // False for frames with no content at all (fades, loading screens);
+    // such frames say nothing about bars and must not move the crop.
+    bool has_content;
+    ContentBarInsets insets;
+};
+
+struct ContentBarDetectorOptions
+{
+    // Luma (BT.601, 0-255) at or below which a pixel is treated as black.
+    // 16 also covers limited-range video black.
+    int luma_threshold = 16;
+    // Maximum luma variance of a dark row/column that is still a bar. Lets
+    // dithered or noisy bars through without mistaking dark scenes for bars.
+    int variance_threshold = 24;
+    // Bars thinner than this are ignored.
+    int min_bar_px = 4;
+    // Each edge is searched over at most 1/max_bar_divisor of the frame; a
+    // run reaching that limit is a dark scene, not a bar.
+    int max_bar_divisor = 4;
+};
+
+// Per-column and per-row luma reductions. Sums stay in 32 bits, which is
+// exact for frames up to 65535 pixels along either axis.
+struct ContentBarStats
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> col_max;
+    std::vector<uint32_t> col_sum;
+    std::vector<uint32_t> col_sum_sq;
+    std::vector<uint32_t> row_max;
+    std::vector<uint32_t> row_sum;
+    std::vector<uint32_t> row_sum_sq;
+};
+
+namespace detail {
+
+inline uint32_t PixelLuma(const uint8_t* p)
+{
+    // BT.601 weights scaled to 256 so that white maps to exactly 255.
+    return (static_cast<uint32_t>(p[0]) * 29u + static_cast<uint32_t>(p[1]) * 150u + static_cast<uint32_t>(p[2]) * 77u) >> 8;
+}
+
+inline void ResetStats(ContentBarStats& stats, int width, int height)
+{
+    stats.width = width;
+    stats.height = height;
+    stats.col_max.assign(static_cast<size_t>(width), 0u);
+    stats.col_sum.assign(static_cast<size_t>(width), 0u);
+    stats.col_sum_sq.assign(static_cast<size_t>(width), 0u);
+    stats.row_max.assign(static_cast<size_t>(height), 0u);
+    stats.row_sum.assign(static_cast<size_t>(height), 0u);
+    stats.row_sum_sq.assign(static_cast<size_t>(height), 0u);
+}
+
+// Accumulates pixels [x, width) of one row; returns nothing, updates row totals.
+inline void AccumulateRowScalar(const uint8_t* row, int x, int width, ContentBarStats& stats,
+                                uint32_t& rowMax, uint32_t& rowSum, uint32_t& rowSumSq)
+{
+    for (; x < width; x++)
+    {
+        const uint32_t luma = PixelLuma(row + static_cast<ptrdiff_t>(x) * 4);
+        const uint32_t sq = luma * luma;
+        stats.col_max[x] = (std::max)(stats.col_max[x], luma);
+        stats.col_sum[x] += luma;
+        stats.col_sum_sq[x] += sq;
+        rowMax = (std::max)(rowMax, luma);
+        rowSum += luma;
+        rowSumSq += sq;
+    }
+}
+
+#if defined(AES_CONTENT_BAR_SSE2)
+inline uint32_t HorizontalSum(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+}
+
+inline uint32_t HorizontalMax(__m128i v)
+{
+    // Lanes hold luma (< 256) with zero upper halves, so a signed 16-bit max is exact.
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epi16(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+}
+
+inline void AccumulateRowSimd(const uint8_t* row, int width, ContentBarStats& stats,
+                              uint32_t& rowMax, uint32_t& rowSum, uint32_t& rowSumSq)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(29, 150, 77, 0, 29, 150, 77, 0);
+    __m128i vRowMax = zero;
+    __m128i vRowSum = zero;
+    __m128i vRowSumSq = zero;
+
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + static_cast<ptrdiff_t>(x) * 4));
+        // Per pixel: (b*29 + g*150) and (r*77 + a*0) as two 32-bit lanes.
+        const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+        const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+        const __m128 loF = _mm_castsi128_ps(lo);
+        const __m128 hiF = _mm_castsi128_ps(hi);
+        const __m128i even = _mm_castps_si128(_mm_shuffle_ps(loF, hiF, _MM_SHUFFLE(2, 0, 2, 0)));
+        const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(loF, hiF, _MM_SHUFFLE(3, 1, 3, 1)));
+        const __m128i luma = _mm_srli_epi32(_mm_add_epi32(even, odd), 8);
+        // Luma < 256 sits in the low 16 bits of each lane, so madd squares it.
+        const __m128i sq = _mm_madd_epi16(luma, luma);
+
+        __m128i* colMax = reinterpret_cast<__m128i*>(stats.col_max.data() + x);
+        __m128i* colSum = reinterpret_cast<__m128i*>(stats.col_sum.data() + x);
+        __m128i* colSumSq = reinterpret_cast<__m128i*>(stats.col_sum_sq.data() + x);
+        _mm_storeu_si128(colMax, _mm_max_epi16(_mm_loadu_si128(colMax), luma));
+        _mm_storeu_si128(colSum, _mm_add_epi32(_mm_loadu_si128(colSum), luma));
+        _mm_storeu_si128(colSumSq, _mm_add_epi32(_mm_loadu_si128(colSumSq), sq));
+
+        vRowMax = _mm_max_epi16(vRowMax, luma);
+        vRowSum = _mm_add_epi32(vRowSum, luma);
+        vRowSumSq = _mm_add_epi32(vRowSumSq, sq);
+    }
+
+    rowMax = (std::max)(rowMax, HorizontalMax(vRowMax));
+    rowSum += HorizontalSum(vRowSum);
+    rowSumSq += HorizontalSum(vRowSumSq);
+    AccumulateRowScalar(row, x, width, stats, rowMax, rowSum, rowSumSq);
+}
+#elif defined(AES_CONTENT_BAR_NEON)
+inline void AccumulateRowSimd(const uint8_t* row, int width, ContentBarStats& stats,
+                              uint32_t& rowMax, uint32_t& rowSum, uint32_t& rowSumSq)
+{
+    uint32x4_t vRowMax = vdupq_n_u32(0);
+    uint32x4_t vRowSum = vdupq_n_u32(0);
+    uint32x4_t vRowSumSq = vdupq_n_u32(0);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        const uint8x8x4_t px = vld4_u8(row + static_cast<ptrdiff_t>(x) * 4);
+        uint16x8_t luma16 = vmull_u8(px.val[0], vdup_n_u8(29));
+        luma16 = vmlal_u8(luma16, px.val[1], vdup_n_u8(150));
+        luma16 = vmlal_u8(luma16, px.val[2], vdup_n_u8(77));
+        luma16 = vshrq_n_u16(luma16, 8);
+
+        const uint16x4_t halves[2] = { vget_low_u16(luma16), vget_high_u16(luma16) };
+        for (int h = 0; h < 2; h++)
+        {
+            const uint32x4_t luma = vmovl_u16(halves[h]);
+            const uint32x4_t sq = vmull_u16(halves[h], halves[h]);
+            uint32_t* colMax = stats.col_max.data() + x + h * 4;
+            uint32_t* colSum = stats.col_sum.data() + x + h * 4;
+            uint32_t* colSumSq = stats.col_sum_sq.data() + x + h * 4;
+            vst1q_u32(colMax, vmaxq_u32(vld1q_u32(colMax), luma));
+            vst1q_u32(colSum, vaddq_u32(vld1q_u32(colSum), luma));
+            vst1q_u32(colSumSq, vaddq_u32(vld1q_u32(colSumSq), sq));
+            vRowMax = vmaxq_u32(vRowMax, luma);
+            vRowSum = vaddq_u32(vRowSum, luma);
+            vRowSumSq = vaddq_u32(vRowSumSq, sq);
+        }
+    }
+
+    rowMax = (std::max)(rowMax, vmaxvq_u32(vRowMax));
+    rowSum += vaddvq_u32(vRowSum);
+    rowSumSq += vaddvq_u32(vRowSumSq);
+    AccumulateRowScalar(row, x, width, stats, rowMax, rowSum, rowSumSq);
+}
+#endif
+
+inline bool IsBar(uint32_t maxLuma, uint32_t sum, uint32_t sumSq, int count, const ContentBarDetectorOptions& options)
+{
+    const uint32_t threshold = static_cast<uint32_t>((std::max)(0, options.luma_threshold));
+    if (maxLuma <= threshold)
+        return true;
+    if (count <= 0)
+        return false;
+
+    const double mean = static_cast<double>(sum) / count;
+    const double variance = static_cast<double>(sumSq) / count - mean * mean;
+    return mean <= threshold && variance <= options.variance_threshold;
+}
+
+// Length of the bar run starting at `first` and stepping by `step`, or 0 when
+// it reaches `limit` without meeting content.
+template <typename IsBarAt>
+inline int MeasureBarRun(int first, int step, int limit, IsBarAt isBarAt)
+{
+    for (int i = 0; i < limit; i++)
+    {
+        if (!isBarAt(first + i * step))
+            return i;
+    }
+    return 0;
+}
+
+} // namespace detail
+
+inline bool ContentBarSimdAvailable()
+{
+#if defined(AES_CONTENT_BAR_SSE2) || defined(AES_CONTENT_BAR_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Fills `stats` from a BGRA8 image. `stride` may be negative to walk
+// bottom-up buffers (GL readbacks) top-down.
+inline void ComputeContentBarStats(const uint8_t* pixels, ptrdiff_t stride, int width, int height,
+                                   ContentBarStats& stats, bool allowSimd = true)
+{
+    detail::ResetStats(stats, (std::max)(0, width), (std::max)(0, height));
+    if (!pixels || width <= 0 || height <= 0)
+        return;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* row = pixels + static_cast<ptrdiff_t>(y) * stride;
+        uint32_t rowMax = 0;
+        uint32_t rowSum = 0;
+        uint32_t rowSumSq = 0;
+#if defined(AES_CONTENT_BAR_SSE2) || defined(AES_CONTENT_BAR_NEON)
+        if (allowSimd)
+            detail::AccumulateRowSimd(row, width, stats, rowMax, rowSum, rowSumSq);
+        else
+            detail::AccumulateRowScalar(row, 0, width, stats, rowMax, rowSum, rowSumSq);
+#else
+        (void)allowSimd;
+        detail::AccumulateRowScalar(row, 0, width, stats, rowMax, rowSum, rowSumSq);
+#endif
+        stats.row_max[y] = rowMax;
+        stats.row_sum[y] = rowSum;
+        stats.row_sum_sq[y] = rowSumSq;
+    }
+}
+
+inline ContentBarScan ClassifyContentBars(const ContentBarStats& stats, const ContentBarDetectorOptions& options = {})
+{
+    ContentBarScan scan{};
+    const int width = stats.width;
+    const int height = stats.height;
+    if (width < 16 || height < 16)
+        return scan;
+
+    auto columnIsBar = [&](int x) {
+        return detail::IsBar(stats.col_max[x], stats.col_sum[x], stats.col_sum_sq[x], height, options);
+    };
+    auto rowIsBar = [&](int y) {
+        return detail::IsBar(stats.row_max[y], stats.row_sum[y], stats.row_sum_sq[y], width, options);
+    };
+
+    for (int x = 0; x < width && !scan.has_content; x++)
+        scan.has_content = !columnIsBar(x);
+    if (!scan.has_content)
+        return scan;
+
+    const int divisor = (std::max)(2, options.max_bar_divisor);
+    const int maxScanX = width / divisor;
+    const int maxScanY = height / divisor;
+    scan.insets.left = detail::MeasureBarRun(0, 1, maxScanX, columnIsBar);
+    scan.insets.right = detail::MeasureBarRun(width - 1, -1, maxScanX, columnIsBar);
+    scan.insets.top = detail::MeasureBarRun(0, 1, maxScanY, rowIsBar);
+    scan.insets.bottom = detail::MeasureBarRun(height - 1, -1, maxScanY, rowIsBar);
+
+    int* sides[4] = { &scan.insets.left, &scan.insets.top, &scan.insets.right, &scan.insets.bottom };
+    for (int* side : sides)
+    {
+        if (*side < options.min_bar_px)
+            *side = 0;
+    }
+    return scan;
+}
+
+inline ContentBarScan DetectContentBars(const uint8_t* pixels, ptrdiff_t stride, int width, int height,
+                                        const ContentBarDetectorOptions& options = {})
+{
+    ContentBarStats stats;
+    ComputeContentBarStats(pixels, stride, width, height, stats);
+    return ClassifyContentBars(stats, options);
+}
+
+struct ContentBarTrackerOptions
+{
+    // Consecutive scans that must agree before bars are allowed to grow.
+    int confirm_scans = 2;
+    // Differences up to this many scan pixels count as the same inset.
+    int tolerance_px = 1;
+};
+
+// Temporal hysteresis for scan results, in scan-image pixels. Zero-initialised
+// state is the reset state, so it can live in calloc'd or atomics-heavy structs.
+//  - Frames without content are ignored.
+//  - A side that shrinks is applied at once: content is never cut off.
+//  - Growth must be confirmed by `confirm_scans` consecutive matching scans,
+//    so a dark scene edge is not mistaken for a new bar.
+struct ContentBarTracker
+{
+    ContentBarInsets applied;
+    ContentBarInsets candidate;
+    int candidate_hits;
+};
+
+// Returns true when tracker.applied changed.
+inline bool UpdateContentBarTracker(ContentBarTracker& tracker, const ContentBarScan& scan,
+                                    const ContentBarTrackerOptions& options = {})
+{
+    if (!scan.has_content)
+    {
+        tracker.candidate_hits = 0;
+        return false;
+    }
+
+    const int tolerance = (std::max)(0, options.tolerance_px);
+    int* applied[4] = { &tracker.applied.left, &tracker.applied.top, &tracker.applied.right, &tracker.applied.bottom };
+    int* candidate[4] = { &tracker.candidate.left, &tracker.candidate.top, &tracker.candidate.right, &tracker.candidate.bottom };
+    const int detected[4] = { scan.insets.left, scan.insets.top, scan.insets.right, scan.insets.bottom };
+
+    bool changed = false;
+    bool grows = false;
+    for (int i = 0; i < 4; i++)
+    {
+        if (detected[i] < *applied[i])
+        {
+            *applied[i] = detected[i];
+            changed = true;
+        }
+        else if (detected[i] > *applied[i] + tolerance)
+        {
+            grows = true;
+        }
+    }
+
+    if (!grows)
+    {
+        tracker.candidate_hits = 0;
+        return changed;
+    }
+
+    bool sameCandidate = tracker.candidate_hits > 0;
+    for (int i = 0; i < 4 && sameCandidate; i++)
+        sameCandidate = std::abs(detected[i] - *candidate[i]) <= tolerance;
+
+    tracker.candidate_hits = sameCandidate ? tracker.candidate_hits + 1 : 1;
+    for (int i = 0; i < 4; i++)
+        *candidate[i] = detected[i];
+
+    if (tracker.candidate_hits >= (std::max)(1, options.confirm_scans))
+    {
+        for (int i = 0; i < 4; i++)
+            *applied[i] = (std::max)(*applied[i], detected[i]);
+        tracker.candidate_hits = 0;
+        changed = true;
+    }
+
+    return changed;
+}
+
+inline void ResetContentBarTracker(ContentBarTracker& tracker)
+{
+    tracker = ContentBarTracker{};
+}
+
+} // namespace aes_native
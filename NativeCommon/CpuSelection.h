@@ -0,0 +1,104 @@
+#pragma once
+
+// CPU choice for pinning a bridge's render thread: parsing the CPU lists
+// users configure ("0-3,6") and picking the cores an emulator leaves quiet,
+// from per-thread /proc stat lines.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace aes_native {
+
+// Parses a comma-separated list of CPUs and ranges into sorted, unique
+// indices below maxCpu. False on malformed input or an empty result.
+inline bool ParseCpuList(const char* text, int maxCpu, std::vector<int>* cpus)
+{
+    cpus->clear();
+    if (!text)
+        return false;
+
+    const char* p = text;
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        if (!*p)
+            break;
+
+        char* end = nullptr;
+        const long first = std::strtol(p, &end, 10);
+        if (end == p || first < 0)
+            return false;
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            p++;
+            last = std::strtol(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+            p = end;
+        }
+        if (*p && *p != ',' && *p != ' ')
+            return false;
+
+        for (long cpu = first; cpu <= last && cpu < maxCpu; cpu++)
+            cpus->push_back(static_cast<int>(cpu));
+    }
+
+    std::sort(cpus->begin(), cpus->end());
+    cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+    return !cpus->empty();
+}
+
+// Reads the CPU a thread last ran on and its user plus system time (clock
+// ticks) from a /proc/<pid>/task/<tid>/stat line. The command name may
+// contain spaces and parentheses, so fields are counted from the last ')'.
+inline bool ParseTaskStat(const char* line, int* processor, uint64_t* cpuTicks)
+{
+    const char* p = line ? std::strrchr(line, ')') : nullptr;
+    if (!p)
+        return false;
+    p++;
+
+    // Field 3 (state) follows the name; utime and stime are 14 and 15,
+    // processor is 39.
+    uint64_t utime = 0;
+    uint64_t stime = 0;
+    for (int field = 3; field <= 39; field++)
+    {
+        while (*p == ' ')
+            p++;
+        if (!*p || *p == '\n')
+            return false;
+        const char* start = p;
+        while (*p && *p != ' ' && *p != '\n')
+            p++;
+        if (field == 14)
+            utime = std::strtoull(start, nullptr, 10);
+        else if (field == 15)
+            stime = std::strtoull(start, nullptr, 10);
+        else if (field == 39)
+            *processor = std::atoi(start);
+    }
+    *cpuTicks = utime + stime;
+    return true;
+}
+
+// The count CPUs of allowed with the least busy time (busy is indexed by
+// CPU; missing entries count as idle), lowest index first on ties, returned
+// in ascending order.
+inline std::vector<int> PickQuietCpus(const std::vector<int>& allowed, const std::vector<uint64_t>& busy, size_t count)
+{
+    std::vector<int> order(allowed);
+    auto busyOf = [&](int cpu) { return cpu >= 0 && static_cast<size_t>(cpu) < busy.size() ? busy[cpu] : 0; };
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return busyOf(a) < busyOf(b); });
+    order.resize((std::min)(count, order.size()));
+    std::sort(order.begin(), order.end());
+    return order;
+}
+
+} // namespace aes_native
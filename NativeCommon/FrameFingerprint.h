@@ -0,0 +1,117 @@
+#pragma once
+
+// Duplicate-frame detection for captured sources. Emulators often swap the
+// same image more than once (lag frames, 30 fps games on a 60 Hz swap), and
+// XDamage reports every swap. A bridge renders a small box-filtered copy of
+// each source frame on the GPU, reads it back asynchronously and hashes it
+// here; equal hashes mean the swap carried no new picture.
+//
+// The fingerprint is a reduction, not the frame: a change small enough to
+// vanish in one averaged cell (a blinking cursor, a score digit) hashes the
+// same, and emulators damage the whole window on every swap, so damage cannot
+// tell the two apart. Bridges therefore count unique frames with it by
+// default and only drop matched swaps when asked to.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace aes_native {
+
+// 64-bit hash of BGRA8 rows; alpha is ignored since captured windows do not
+// carry meaningful alpha. stride may be negative (bottom-up readbacks).
+inline uint64_t HashFingerprint(const uint8_t* pixels, ptrdiff_t stride, int width, int height)
+{
+    const uint64_t kMul = 0x9e3779b97f4a7c15ULL;
+    uint64_t hash = 0xcbf29ce484222325ULL ^ (static_cast<uint64_t>(width) << 32) ^ static_cast<uint64_t>(height);
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* row = pixels + static_cast<ptrdiff_t>(y) * stride;
+        int x = 0;
+        for (; x + 2 <= width; x += 2)
+        {
+            uint64_t word;
+            memcpy(&word, row + x * 4, sizeof(word));
+            word &= 0x00ffffff00ffffffULL;
+            hash = (hash ^ word) * kMul;
+            hash ^= hash >> 29;
+        }
+        if (x < width)
+        {
+            uint32_t word;
+            memcpy(&word, row + x * 4, sizeof(word));
+            hash = (hash ^ (word & 0x00ffffffu)) * kMul;
+            hash ^= hash >> 29;
+        }
+    }
+    return hash;
+}
+
+// Whether a render may drop a swap whose fingerprint matched the previous
+// frame: only swaps that damaged everything shown, with the render state
+// unchanged, and never while a screenshot is queued or reading back. A paused
+// emulator keeps re-presenting one picture, and skipping all of it would
+// leave the screenshot waiting for a frame that never comes.
+inline bool CanSkipDuplicateFrame(bool duplicate, bool fullDamage, bool stateChanged, bool screenshotPending)
+{
+    return duplicate && fullDamage && !stateChanged && !screenshotPending;
+}
+
+// Events per second over a sliding one-second window. Used for the unique
+// frame rate, which must drop to the game's real cadence immediately rather
+// than drift like an average of swap intervals.
+class FrameRateWindow
+{
+public:
+    static constexpr int kCapacity = 256;
+    static constexpr uint64_t kWindowNs = 1000000000ULL;
+
+    void Reset()
+    {
+        count_ = 0;
+        next_ = 0;
+    }
+
+    void Record(uint64_t nowNs)
+    {
+        times_[next_] = nowNs;
+        next_ = (next_ + 1) % kCapacity;
+        if (count_ < kCapacity)
+            count_++;
+    }
+
+    double Rate(uint64_t nowNs) const
+    {
+        int inWindow = 0;
+        uint64_t oldest = 0;
+        for (int i = 0; i < count_; i++)
+        {
+            const uint64_t t = times_[(next_ - 1 - i + kCapacity) % kCapacity];
+            if (t > nowNs || nowNs - t > kWindowNs)
+                break;
+            oldest = t;
+            inWindow++;
+        }
+        if (inWindow < 2)
+            return 0.0;
+
+        // Measure over the span the events cover; once the source has been
+        // quiet for more than two intervals, count the silence too.
+        const uint64_t newest = times_[(next_ - 1 + kCapacity) % kCapacity];
+        const uint64_t span = newest - oldest;
+        const uint64_t idle = nowNs - newest;
+        if (span == 0)
+            return 0.0;
+        const double perEvent = static_cast<double>(span) / (inWindow - 1);
+        if (static_cast<double>(idle) > 2.0 * perEvent)
+            return (inWindow - 1) * 1000000000.0 / static_cast<double>(span + idle);
+        return (inWindow - 1) * 1000000000.0 / static_cast<double>(span);
+    }
+
+private:
+    uint64_t times_[kCapacity] = {};
+    int count_ = 0;
+    int next_ = 0;
+};
+
+} // namespace aes_native
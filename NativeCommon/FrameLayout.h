@@ -0,0 +1,255 @@
+#pragma once
+
+// Viewport and texture-coordinate math for presenting a cropped source into
+// an output of another size, shared by the capture bridges' render paths. Pure
+// functions so the layout can be tested and benchmarked off the GPU.
+
+#include <algorithm>
+#include <cmath>
+
+#include "ContentBarDetector.h"
+
+namespace aes_native {
+
+// Linux bridge output layout: the viewport (x, y, width, height in output
+// pixels, GL origin) and the source texture coordinates (u0, v0, u1, v1)
+// that fill it.
+struct ViewportLayout
+{
+    int viewport[4];
+    float uv[4];
+};
+
+// Lays out a sourceW x sourceH texture, trimmed by crop (left, top, right,
+// bottom, already non-negative), in a hostW x hostH output. stretch is the
+// Linux bridge mode: 0 none (pixel size where possible, centred), 1 fill,
+// 2 uniform (letterbox), 3 uniform to fill (centre crop).
+inline ViewportLayout ComputeViewportLayout(int sourceW, int sourceH, const int crop[4], int hostW, int hostH, int stretch)
+{
+    const int srcW = (std::max)(1, sourceW - crop[0] - crop[2]);
+    const int srcH = (std::max)(1, sourceH - crop[1] - crop[3]);
+    hostW = (std::max)(1, hostW);
+    hostH = (std::max)(1, hostH);
+    const int texW = (std::max)(1, sourceW);
+    const int texH = (std::max)(1, sourceH);
+
+    float u0 = std::clamp(static_cast<float>(crop[0]) / static_cast<float>(texW), 0.0f, 1.0f);
+    float v0 = std::clamp(static_cast<float>(crop[1]) / static_cast<float>(texH), 0.0f, 1.0f);
+    float u1 = std::clamp(1.0f - static_cast<float>(crop[2]) / static_cast<float>(texW), 0.0f, 1.0f);
+    float v1 = std::clamp(1.0f - static_cast<float>(crop[3]) / static_cast<float>(texH), 0.0f, 1.0f);
+
+    int vpX = 0;
+    int vpY = 0;
+    int vpW = hostW;
+    int vpH = hostH;
+
+    const double srcAspect = static_cast<double>(srcW) / static_cast<double>(srcH);
+    const double dstAspect = static_cast<double>(hostW) / static_cast<double>(hostH);
+
+    if (stretch == 0)
+    {
+        vpW = (std::min)(hostW, srcW);
+        vpH = (std::min)(hostH, srcH);
+        vpX = (hostW - vpW) / 2;
+        vpY = (hostH - vpH) / 2;
+    }
+    else if (stretch == 2)
+    {
+        if (srcAspect > dstAspect)
+        {
+            vpW = hostW;
+            vpH = (std::max)(1, static_cast<int>(hostW / srcAspect));
+        }
+        else
+        {
+            vpH = hostH;
+            vpW = (std::max)(1, static_cast<int>(hostH * srcAspect));
+        }
+        vpX = (hostW - vpW) / 2;
+        vpY = (hostH - vpH) / 2;
+    }
+    else if (stretch == 3)
+    {
+        if (srcAspect > dstAspect)
+        {
+            const double desiredSrcW = static_cast<double>(srcH) * dstAspect;
+            const double trim = (std::max)(0.0, (static_cast<double>(srcW) - desiredSrcW) * 0.5);
+            const float du = static_cast<float>(trim / static_cast<double>(texW));
+            u0 += du;
+            u1 -= du;
+        }
+        else
+        {
+            const double desiredSrcH = static_cast<double>(srcW) / dstAspect;
+            const double trim = (std::max)(0.0, (static_cast<double>(srcH) - desiredSrcH) * 0.5);
+            const float dv = static_cast<float>(trim / static_cast<double>(texH));
+            v0 += dv;
+            v1 -= dv;
+        }
+    }
+
+    ViewportLayout layout;
+    layout.viewport[0] = vpX;
+    layout.viewport[1] = vpY;
+    layout.viewport[2] = (std::max)(1, vpW);
+    layout.viewport[3] = (std::max)(1, vpH);
+    layout.uv[0] = std::clamp(u0, 0.0f, 1.0f);
+    layout.uv[1] = std::clamp(v0, 0.0f, 1.0f);
+    layout.uv[2] = std::clamp(u1, 0.0f, 1.0f);
+    layout.uv[3] = std::clamp(v1, 0.0f, 1.0f);
+    return layout;
+}
+
+// The inverse for input: the source pixel shown at output position (x, y),
+// measured from the top-left like window coordinates, for a layout of a
+// sourceW x sourceH texture in an output hostH pixels tall. False outside the
+// picture (letterbox bars, outside the output).
+inline bool MapOutputToSource(const ViewportLayout& layout, int hostH, int sourceW, int sourceH, double x, double y,
+    int* sourceX, int* sourceY)
+{
+    const int vpW = (std::max)(1, layout.viewport[2]);
+    const int vpH = (std::max)(1, layout.viewport[3]);
+    // The viewport has a GL origin; source rows run top-down.
+    const int top = hostH - layout.viewport[1] - vpH;
+    const double fx = (x - layout.viewport[0]) / vpW;
+    const double fy = (y - top) / vpH;
+    if (fx < 0.0 || fx >= 1.0 || fy < 0.0 || fy >= 1.0 || sourceW <= 0 || sourceH <= 0)
+        return false;
+
+    const double u = layout.uv[0] + fx * (layout.uv[2] - layout.uv[0]);
+    const double v = layout.uv[1] + fy * (layout.uv[3] - layout.uv[1]);
+    *sourceX = std::clamp(static_cast<int>(std::floor(u * sourceW)), 0, sourceW - 1);
+    *sourceY = std::clamp(static_cast<int>(std::floor(v * sourceH)), 0, sourceH - 1);
+    return true;
+}
+
+// Pulls texture coordinates half a texel inwards so linear filtering never
+// samples outside the crop.
+inline void ApplyHalfTexelInset(float& u0, float& v0, float& u1, float& v1, int texWidth, int texHeight)
+{
+    if (texWidth <= 1 || texHeight <= 1)
+        return;
+
+    const float du = 0.5f / static_cast<float>(texWidth);
+    const float dv = 0.5f / static_cast<float>(texHeight);
+    u0 = (std::min)(u1 - du, u0 + du);
+    v0 = (std::min)(v1 - dv, v0 + dv);
+    u1 = (std::max)(u0 + du, u1 - du);
+    v1 = (std::max)(v0 + dv, v1 - dv);
+}
+
+// Windows bridge output quad: corners in normalised device coordinates and
+// the texture coordinates at the top-left and bottom-right corners.
+struct QuadLayout
+{
+    float left;
+    float top;
+    float right;
+    float bottom;
+    float u0;
+    float v0;
+    float u1;
+    float v1;
+};
+
+struct QuadLayoutInput
+{
+    // Captured frame and render target sizes.
+    int frame_w = 0;
+    int frame_h = 0;
+    int view_w = 0;
+    int view_h = 0;
+    // Size of the texture sampled and, when crop_in_texture is set, the
+    // frame's rectangle inside it (a crop_w/crop_h of 0 means the whole frame).
+    int texture_w = 0;
+    int texture_h = 0;
+    int crop_x = 0;
+    int crop_y = 0;
+    int crop_w = 0;
+    int crop_h = 0;
+    bool crop_in_texture = false;
+    // 0 fill, 1 uniform (letterbox), 2 uniform to fill (centre crop).
+    int stretch = 0;
+    // Detected content bars in frame pixels; all zero when not applied.
+    ContentBarInsets bars = { 0, 0, 0, 0 };
+};
+
+inline QuadLayout ComputeQuadLayout(const QuadLayoutInput& in)
+{
+    QuadLayout quad = { -1.0f, 1.0f, 1.0f, -1.0f, 0.0f, 0.0f, 1.0f, 1.0f };
+    const float viewAspect = in.view_h > 0 ? static_cast<float>(in.view_w) / static_cast<float>(in.view_h) : 1.0f;
+    const float frameAspect = in.frame_h > 0 ? static_cast<float>(in.frame_w) / static_cast<float>(in.frame_h) : 1.0f;
+    const int fullWidth = in.texture_w > 0 ? in.texture_w : in.frame_w;
+    const int fullHeight = in.texture_h > 0 ? in.texture_h : in.frame_h;
+    if (in.crop_in_texture && in.crop_w > 0 && in.crop_h > 0 && fullWidth > 0 && fullHeight > 0)
+    {
+        quad.u0 = static_cast<float>(in.crop_x) / static_cast<float>(fullWidth);
+        quad.v0 = static_cast<float>(in.crop_y) / static_cast<float>(fullHeight);
+        quad.u1 = static_cast<float>(in.crop_x + in.crop_w) / static_cast<float>(fullWidth);
+        quad.v1 = static_cast<float>(in.crop_y + in.crop_h) / static_cast<float>(fullHeight);
+    }
+
+    const float uSpan = quad.u1 - quad.u0;
+    const float vSpan = quad.v1 - quad.v0;
+    const int contentWidth = in.crop_w > 0 ? in.crop_w : in.frame_w;
+    const int contentHeight = in.crop_h > 0 ? in.crop_h : in.frame_h;
+
+    if (in.stretch == 1)
+    {
+        if (frameAspect > viewAspect)
+        {
+            const float scaleY = viewAspect / frameAspect;
+            quad.top = scaleY;
+            quad.bottom = -scaleY;
+        }
+        else
+        {
+            const float scaleX = frameAspect / viewAspect;
+            quad.left = -scaleX;
+            quad.right = scaleX;
+        }
+    }
+    else if (in.stretch == 2)
+    {
+        if (frameAspect > viewAspect)
+        {
+            const float crop = (1.0f - viewAspect / frameAspect) * 0.5f;
+            quad.u0 += crop * uSpan;
+            quad.u1 -= crop * uSpan;
+        }
+        else
+        {
+            const float crop = (1.0f - frameAspect / viewAspect) * 0.5f;
+            quad.v0 += crop * vSpan;
+            quad.v1 -= crop * vSpan;
+        }
+    }
+
+    const ContentBarInsets& bars = in.bars;
+    if ((bars.left > 0 || bars.right > 0 || bars.top > 0 || bars.bottom > 0) && contentWidth > 0 && contentHeight > 0)
+    {
+        const float insetLeft = (static_cast<float>(bars.left) / static_cast<float>(contentWidth)) * uSpan;
+        const float insetRight = (static_cast<float>(bars.right) / static_cast<float>(contentWidth)) * uSpan;
+        const float insetTop = (static_cast<float>(bars.top) / static_cast<float>(contentHeight)) * vSpan;
+        const float insetBottom = (static_cast<float>(bars.bottom) / static_cast<float>(contentHeight)) * vSpan;
+        quad.u0 = (std::min)(1.0f, (std::max)(0.0f, quad.u0 + insetLeft));
+        quad.u1 = (std::max)(0.0f, (std::min)(1.0f, quad.u1 - insetRight));
+        quad.v0 = (std::min)(1.0f, (std::max)(0.0f, quad.v0 + insetTop));
+        quad.v1 = (std::max)(0.0f, (std::min)(1.0f, quad.v1 - insetBottom));
+        // A usable crop fills the view; bars are already gone from the picture.
+        if (quad.u1 - quad.u0 > 0.02f && quad.v1 - quad.v0 > 0.02f)
+        {
+            quad.left = -1.0f;
+            quad.right = 1.0f;
+            quad.top = 1.0f;
+            quad.bottom = -1.0f;
+        }
+    }
+
+    const int insetTexWidth = (std::max)(1, static_cast<int>(std::lround(uSpan * static_cast<float>(fullWidth))));
+    const int insetTexHeight = (std::max)(1, static_cast<int>(std::lround(vSpan * static_cast<float>(fullHeight))));
+    ApplyHalfTexelInset(quad.u0, quad.v0, quad.u1, quad.v1, insetTexWidth, insetTexHeight);
+    return quad;
+}
+
+} // namespace aes_native
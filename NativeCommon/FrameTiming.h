@@ -0,0 +1,73 @@
+#pragma once
+
+// Frame-rate estimation from frame event times (XDamage notifies, presents),
+// shared by the capture bridges' stats paths.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace aes_native {
+
+// Snaps a measured rate to the common emulator rates (30, 60, 120) when it is
+// within 4% of one, so the reported fps does not wander with event jitter.
+inline double StabilizeReportedFps(double fps)
+{
+    if (fps <= 0.0)
+        return 0.0;
+
+    const double candidates[] = { 30.0, 60.0, 120.0 };
+    for (double candidate : candidates)
+    {
+        if (std::fabs(fps - candidate) <= candidate * 0.04)
+            return candidate;
+    }
+
+    return fps;
+}
+
+// Snaps a measured rate to the display refresh divided by 1-4 when it is
+// within 4% of one. Sources paced by the display run at those rates, which on
+// 75 or 144 Hz monitors are not among StabilizeReportedFps's candidates.
+inline double SnapFrameRateToRefresh(double fps, double refreshHz)
+{
+    if (fps <= 0.0 || refreshHz < 1.0)
+        return fps;
+
+    for (int divisor = 1; divisor <= 4; divisor++)
+    {
+        const double candidate = refreshHz / divisor;
+        if (std::fabs(fps - candidate) <= candidate * 0.04)
+            return candidate;
+    }
+
+    return fps;
+}
+
+// One step of the rate estimate after a frame interval of dtSeconds. Longer
+// intervals weigh more so drops to a lower rate show up quickly.
+inline double SmoothFrameRate(double currentFps, double dtSeconds)
+{
+    if (dtSeconds <= 0.0)
+        return currentFps;
+
+    const double instantFps = std::clamp(1.0 / dtSeconds, 1.0, 240.0);
+    const double alpha = dtSeconds >= 0.025 ? 0.22 : 0.14;
+    return currentFps > 0.0 ? (currentFps * (1.0 - alpha)) + (instantFps * alpha) : instantFps;
+}
+
+// Shortest interval between frame events that counts as a new frame.
+// XDamage can notify more than once per source frame; events closer than
+// about half the current frame time are duplicates. Before a rate is known
+// that is half a refresh of refreshHz, or 8 ms when that is unknown too.
+inline uint64_t MinFrameEventIntervalNs(double frameTimeMs, double refreshHz = 0.0)
+{
+    if (frameTimeMs <= 0.0 && refreshHz >= 1.0)
+        frameTimeMs = 1000.0 / refreshHz;
+    if (frameTimeMs <= 0.0)
+        return 8000000;
+
+    return static_cast<uint64_t>(std::ceil((std::max)(5000000.0, frameTimeMs * 1000000.0 * 0.55)));
+}
+
+} // namespace aes_native
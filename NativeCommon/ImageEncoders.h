@@ -0,0 +1,216 @@
+#pragma once
+
+// Still-image encoders for capture screenshots. Both take BGRA8 rows with an
+// arbitrary (possibly negative) stride, so a bottom-up GL readback can be
+// encoded without flipping it first, and drop alpha, which is meaningless
+// for captured windows.
+//
+// QOI is dependency-free and the fastest to write. PNG uses zlib at its
+// fastest level with the Up filter, which keeps the encode cost close to a
+// memcpy while still compressing flat game art well. Callers of EncodePng
+// link zlib.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <zlib.h>
+
+namespace aes_native {
+
+enum class ImageFormat
+{
+    Png = 0,
+    Qoi = 1
+};
+
+namespace detail {
+
+inline void AppendBe32(std::vector<uint8_t>& out, uint32_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline void AppendPngChunk(std::vector<uint8_t>& out, const char type[4], const uint8_t* data, size_t size)
+{
+    AppendBe32(out, static_cast<uint32_t>(size));
+    const size_t typeAt = out.size();
+    out.insert(out.end(), type, type + 4);
+    if (size > 0)
+        out.insert(out.end(), data, data + size);
+    const uint32_t crc = static_cast<uint32_t>(
+        crc32(0L, out.data() + typeAt, static_cast<uInt>(out.size() - typeAt)));
+    AppendBe32(out, crc);
+}
+
+} // namespace detail
+
+// QOI (https://qoiformat.org), 3 channels, sRGB.
+inline bool EncodeQoi(const uint8_t* pixels, ptrdiff_t stride, int width, int height, std::vector<uint8_t>& out)
+{
+    out.clear();
+    if (!pixels || width <= 0 || height <= 0)
+        return false;
+
+    // Worst case is QOI_OP_RGB for every pixel: 4 bytes each.
+    out.reserve(14 + static_cast<size_t>(width) * height * 4 + 8);
+    out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+    detail::AppendBe32(out, static_cast<uint32_t>(width));
+    detail::AppendBe32(out, static_cast<uint32_t>(height));
+    out.push_back(3);
+    out.push_back(0);
+
+    uint32_t index[64] = {};
+    uint8_t prevR = 0;
+    uint8_t prevG = 0;
+    uint8_t prevB = 0;
+    int run = 0;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* row = pixels + static_cast<ptrdiff_t>(y) * stride;
+        for (int x = 0; x < width; x++)
+        {
+            const uint8_t b = row[x * 4 + 0];
+            const uint8_t g = row[x * 4 + 1];
+            const uint8_t r = row[x * 4 + 2];
+
+            if (r == prevR && g == prevG && b == prevB)
+            {
+                if (++run == 62)
+                {
+                    out.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                out.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+                run = 0;
+            }
+
+            const uint32_t packed = (static_cast<uint32_t>(r) << 24) | (static_cast<uint32_t>(g) << 16) |
+                                    (static_cast<uint32_t>(b) << 8) | 0xffu;
+            const int slot = (r * 3 + g * 5 + b * 7 + 255 * 11) % 64;
+            if (index[slot] == packed)
+            {
+                out.push_back(static_cast<uint8_t>(slot));
+            }
+            else
+            {
+                index[slot] = packed;
+                const int dr = static_cast<int8_t>(static_cast<uint8_t>(r - prevR));
+                const int dg = static_cast<int8_t>(static_cast<uint8_t>(g - prevG));
+                const int db = static_cast<int8_t>(static_cast<uint8_t>(b - prevB));
+                const int drg = dr - dg;
+                const int dbg = db - dg;
+
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                {
+                    out.push_back(static_cast<uint8_t>(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                }
+                else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7)
+                {
+                    out.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+                    out.push_back(static_cast<uint8_t>(((drg + 8) << 4) | (dbg + 8)));
+                }
+                else
+                {
+                    out.push_back(0xfe);
+                    out.push_back(r);
+                    out.push_back(g);
+                    out.push_back(b);
+                }
+            }
+
+            prevR = r;
+            prevG = g;
+            prevB = b;
+        }
+    }
+
+    if (run > 0)
+        out.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+
+    static const uint8_t kEnd[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    out.insert(out.end(), kEnd, kEnd + 8);
+    return true;
+}
+
+// 8-bit RGB PNG. level is a zlib level; 1 (Z_BEST_SPEED) suits screenshots
+// taken while a game is running.
+inline bool EncodePng(const uint8_t* pixels, ptrdiff_t stride, int width, int height, std::vector<uint8_t>& out,
+                      int level = Z_BEST_SPEED)
+{
+    out.clear();
+    if (!pixels || width <= 0 || height <= 0)
+        return false;
+
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.insert(out.end(), kSignature, kSignature + 8);
+
+    std::vector<uint8_t> header;
+    detail::AppendBe32(header, static_cast<uint32_t>(width));
+    detail::AppendBe32(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), { 8, 2, 0, 0, 0 });
+    detail::AppendPngChunk(out, "IHDR", header.data(), header.size());
+
+    z_stream zs{};
+    if (deflateInit(&zs, level) != Z_OK)
+        return false;
+
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    std::vector<uint8_t> filtered(rowBytes);
+    std::vector<uint8_t> current(static_cast<size_t>(width) * 3);
+    std::vector<uint8_t> previous(static_cast<size_t>(width) * 3, 0);
+    std::vector<uint8_t> compressed(deflateBound(&zs, static_cast<uLong>(rowBytes * height)));
+    zs.next_out = compressed.data();
+    zs.avail_out = static_cast<uInt>(compressed.size());
+
+    bool ok = true;
+    for (int y = 0; y < height && ok; y++)
+    {
+        const uint8_t* row = pixels + static_cast<ptrdiff_t>(y) * stride;
+        for (int x = 0; x < width; x++)
+        {
+            current[x * 3 + 0] = row[x * 4 + 2];
+            current[x * 3 + 1] = row[x * 4 + 1];
+            current[x * 3 + 2] = row[x * 4 + 0];
+        }
+
+        // Filter type 2 (Up): each byte minus the byte above it.
+        filtered[0] = 2;
+        for (size_t i = 0; i < current.size(); i++)
+            filtered[i + 1] = static_cast<uint8_t>(current[i] - previous[i]);
+        current.swap(previous);
+
+        zs.next_in = filtered.data();
+        zs.avail_in = static_cast<uInt>(rowBytes);
+        ok = deflate(&zs, Z_NO_FLUSH) == Z_OK && zs.avail_in == 0;
+    }
+
+    ok = ok && deflate(&zs, Z_FINISH) == Z_STREAM_END;
+    const size_t compressedSize = compressed.size() - zs.avail_out;
+    deflateEnd(&zs);
+    if (!ok)
+        return false;
+
+    detail::AppendPngChunk(out, "IDAT", compressed.data(), compressedSize);
+    detail::AppendPngChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+inline bool EncodeImage(ImageFormat format, const uint8_t* pixels, ptrdiff_t stride, int width, int height,
+                        std::vector<uint8_t>& out)
+{
+    return format == ImageFormat::Qoi ? EncodeQoi(pixels, stride, width, height, out)
+                                      : EncodePng(pixels, stride, width, height, out);
+}
+
+} // namespace aes_native
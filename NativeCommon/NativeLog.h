@@ -0,0 +1,495 @@
+#pragma once
+
+// Asynchronous logger shared by the native bridges. Callers format into a
+// slot of a bounded lock-free ring and return; a background thread owns the
+// file and writes batches. Nothing on the calling side opens files or waits,
+// and only the first line after the writer went idle takes a lock, one the
+// writer holds just long enough to go to sleep. Logging from the render and
+// control paths cannot stall them. When the ring is full, lines are dropped
+// and counted rather than blocking the caller.
+//
+// Configuration comes from the environment (see LogConfig::FromEnvironment):
+//   AES_NATIVE_LOG_LEVEL       off, error, warn, info (default), debug, trace
+//   AES_NATIVE_LOG_CATEGORIES  comma list; "*" for all, "-name" to exclude
+//   AES_NATIVE_LOG_FILE        overrides the bridge's default path
+//
+// Timestamps are monotonic seconds since the logger started. The file's
+// first line records the wall-clock time of that start.
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace aes_native {
+
+enum class LogLevel
+{
+    Off = 0,
+    Error = 1,
+    Warn = 2,
+    Info = 3,
+    Debug = 4,
+    Trace = 5
+};
+
+inline const char* LogLevelName(LogLevel level)
+{
+    switch (level)
+    {
+    case LogLevel::Error: return "error";
+    case LogLevel::Warn: return "warn";
+    case LogLevel::Info: return "info";
+    case LogLevel::Debug: return "debug";
+    case LogLevel::Trace: return "trace";
+    default: return "off";
+    }
+}
+
+inline bool ParseLogLevel(const char* text, LogLevel* level)
+{
+    if (!text)
+        return false;
+    for (int i = 0; i <= static_cast<int>(LogLevel::Trace); i++)
+    {
+        const LogLevel candidate = static_cast<LogLevel>(i);
+        if (strcmp(text, LogLevelName(candidate)) == 0)
+        {
+            *level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::string GetEnvironmentString(const char* name)
+{
+#ifdef _MSC_VER
+    char* value = nullptr;
+    size_t length = 0;
+    if (_dupenv_s(&value, &length, name) != 0 || !value)
+        return std::string();
+    std::string result(value);
+    free(value);
+    return result;
+#else
+    const char* value = getenv(name);
+    return value ? std::string(value) : std::string();
+#endif
+}
+
+struct LogConfig
+{
+    std::string path;
+    LogLevel level = LogLevel::Info;
+    // Comma-separated; empty or "*" enables every category.
+    std::string categories;
+    // Ring slots; rounded up to a power of two.
+    uint32_t capacity = 1024;
+    // Lines per call site (format string) per second; 0 disables the limit.
+    uint32_t max_lines_per_second = 20;
+
+    static LogConfig FromEnvironment(const char* defaultPath)
+    {
+        LogConfig config;
+        const std::string path = GetEnvironmentString("AES_NATIVE_LOG_FILE");
+        config.path = !path.empty() ? path : std::string(defaultPath ? defaultPath : "");
+        ParseLogLevel(GetEnvironmentString("AES_NATIVE_LOG_LEVEL").c_str(), &config.level);
+        config.categories = GetEnvironmentString("AES_NATIVE_LOG_CATEGORIES");
+        return config;
+    }
+};
+
+class NativeLog
+{
+public:
+    static constexpr size_t kLineBytes = 480;
+    static constexpr int kRateSites = 128;
+
+    explicit NativeLog(const LogConfig& config)
+        : config_(config),
+          start_(std::chrono::steady_clock::now())
+    {
+        uint32_t capacity = 2;
+        while (capacity < config.capacity)
+            capacity <<= 1;
+        mask_ = capacity - 1;
+        slots_.reset(new Slot[capacity]);
+        for (uint32_t i = 0; i < capacity; i++)
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        ParseCategories(config.categories);
+    }
+
+    // Drains what is queued. The bridges keep their logger for the life of
+    // the process instead, so no exit path waits on the writer.
+    ~NativeLog()
+    {
+        Flush();
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        if (writer_.joinable())
+            writer_.join();
+        if (file_)
+            fclose(file_);
+    }
+
+    NativeLog(const NativeLog&) = delete;
+    NativeLog& operator=(const NativeLog&) = delete;
+
+    // category must have static storage; it is stored by pointer.
+    bool Enabled(LogLevel level, const char* category) const
+    {
+        if (level == LogLevel::Off || level > config_.level || config_.path.empty())
+            return false;
+        if (!category)
+            return all_categories_;
+        for (const std::string& name : excluded_)
+        {
+            if (name == category)
+                return false;
+        }
+        if (all_categories_)
+            return true;
+        for (const std::string& name : included_)
+        {
+            if (name == category)
+                return true;
+        }
+        return false;
+    }
+
+    void Write(LogLevel level, const char* category, const char* fmt, ...)
+    {
+        va_list args;
+        va_start(args, fmt);
+        WriteV(level, category, fmt, args);
+        va_end(args);
+    }
+
+    void WriteV(LogLevel level, const char* category, const char* fmt, va_list args)
+    {
+        Enqueue(level, category, fmt, fmt, args);
+    }
+
+    // Logs a preformatted message. key is the rate-limit key; it defaults to
+    // the message pointer, which only suits string literals. Messages
+    // formatted into a reused buffer need a key per call site (their format
+    // string, say), or unrelated lines share one budget.
+    void WriteMessage(LogLevel level, const char* category, const char* message, const void* key = nullptr)
+    {
+        EnqueueF(level, category, key ? key : message, "%s", message);
+    }
+
+    // Blocks until every line queued before the call is in the file. For
+    // tests and shutdown paths; never call it from a hot path.
+    void Flush()
+    {
+        const uint64_t target = enqueue_.load(std::memory_order_acquire);
+        if (!writer_started_.load(std::memory_order_acquire))
+            return;
+        while (written_.load(std::memory_order_acquire) < target)
+        {
+            wake_.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t Suppressed() const { return suppressed_.load(std::memory_order_relaxed); }
+    const LogConfig& Config() const { return config_; }
+
+private:
+    void EnqueueF(LogLevel level, const char* category, const void* site, const char* fmt, ...)
+    {
+        va_list args;
+        va_start(args, fmt);
+        Enqueue(level, category, site, fmt, args);
+        va_end(args);
+    }
+
+    void Enqueue(LogLevel level, const char* category, const void* site, const char* fmt, va_list args)
+    {
+        if (!fmt || !site || !Enabled(level, category))
+            return;
+
+        const uint64_t nowNs = NowNs();
+        uint32_t suppressed = 0;
+        if (!AllowSite(site, nowNs, &suppressed))
+            return;
+
+        uint64_t position = enqueue_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        for (;;)
+        {
+            slot = &slots_[position & mask_];
+            const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+            if (diff == 0)
+            {
+                if (enqueue_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+            {
+                position = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->time_ns = nowNs;
+        slot->level = level;
+        slot->category = category;
+        int length = vsnprintf(slot->text, kLineBytes, fmt, args);
+        length = length < 0 ? 0 : (length >= static_cast<int>(kLineBytes) ? static_cast<int>(kLineBytes) - 1 : length);
+        while (length > 0 && (slot->text[length - 1] == '\n' || slot->text[length - 1] == '\r'))
+            length--;
+        if (suppressed > 0)
+        {
+            const int extra = snprintf(slot->text + length, kLineBytes - length, " (%u similar suppressed)", suppressed);
+            if (extra > 0)
+                length += extra >= static_cast<int>(kLineBytes) - length ? static_cast<int>(kLineBytes) - 1 - length : extra;
+        }
+        slot->length = static_cast<uint32_t>(length);
+        slot->sequence.store(position + 1, std::memory_order_release);
+
+        EnsureWriter();
+        // Pairs with the fence in WriterMain: either the writer sees this
+        // slot before it sleeps, or this sees it asleep. One producer wakes
+        // it; the lock makes sure it is already waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (writer_sleeping_.load(std::memory_order_relaxed) && writer_sleeping_.exchange(false, std::memory_order_acq_rel))
+        {
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex_);
+            }
+            wake_.notify_one();
+        }
+    }
+
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{ 0 };
+        uint64_t time_ns = 0;
+        LogLevel level = LogLevel::Info;
+        const char* category = nullptr;
+        uint32_t length = 0;
+        char text[kLineBytes];
+    };
+
+    // Call sites are keyed by format string, or by message pointer for
+    // WriteMessage. window_count packs the second in the high 40 bits and
+    // that second's line count in the low 24.
+    struct RateSite
+    {
+        std::atomic<const void*> key{ nullptr };
+        std::atomic<uint64_t> window_count{ 0 };
+        std::atomic<uint32_t> suppressed{ 0 };
+    };
+
+    uint64_t NowNs() const
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count());
+    }
+
+    void ParseCategories(const std::string& list)
+    {
+        all_categories_ = true;
+        size_t begin = 0;
+        bool sawInclude = false;
+        bool sawAll = false;
+        while (begin <= list.size())
+        {
+            size_t end = list.find(',', begin);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string name = list.substr(begin, end - begin);
+            while (!name.empty() && name.front() == ' ')
+                name.erase(0, 1);
+            while (!name.empty() && name.back() == ' ')
+                name.pop_back();
+            if (name == "*")
+                sawAll = true;
+            else if (!name.empty() && name[0] == '-')
+                excluded_.push_back(name.substr(1));
+            else if (!name.empty())
+            {
+                included_.push_back(name);
+                sawInclude = true;
+            }
+            begin = end + 1;
+        }
+        all_categories_ = sawAll || !sawInclude;
+    }
+
+    bool AllowSite(const void* key, uint64_t nowNs, uint32_t* suppressedOut)
+    {
+        if (config_.max_lines_per_second == 0)
+            return true;
+
+        const uintptr_t hash = reinterpret_cast<uintptr_t>(key) >> 3;
+        RateSite* site = nullptr;
+        for (int probe = 0; probe < kRateSites; probe++)
+        {
+            RateSite& candidate = sites_[(hash + probe) % kRateSites];
+            const void* current = candidate.key.load(std::memory_order_acquire);
+            if (current == key)
+            {
+                site = &candidate;
+                break;
+            }
+            if (!current)
+            {
+                const void* expected = nullptr;
+                if (candidate.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel) || expected == key)
+                {
+                    site = &candidate;
+                    break;
+                }
+            }
+        }
+        if (!site)
+            return true; // Table full: more sites than slots, do not limit.
+
+        const uint64_t second = nowNs / 1000000000ULL;
+        uint64_t packed = site->window_count.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const uint64_t window = packed >> 24;
+            const uint64_t count = window == second ? (packed & 0xffffffULL) : 0;
+            if (count >= config_.max_lines_per_second)
+            {
+                site->suppressed.fetch_add(1, std::memory_order_relaxed);
+                suppressed_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            const uint64_t next = (second << 24) | (count + 1);
+            if (site->window_count.compare_exchange_weak(packed, next, std::memory_order_relaxed))
+                break;
+        }
+        *suppressedOut = site->suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    void EnsureWriter()
+    {
+        if (writer_started_.load(std::memory_order_acquire))
+            return;
+        bool expected = false;
+        if (!writer_starting_.compare_exchange_strong(expected, true))
+            return;
+        writer_ = std::thread([this] { WriterMain(); });
+        writer_started_.store(true, std::memory_order_release);
+    }
+
+    void OpenFile()
+    {
+#ifdef _MSC_VER
+        if (fopen_s(&file_, config_.path.c_str(), "a") != 0)
+            file_ = nullptr;
+#else
+        file_ = fopen(config_.path.c_str(), "a");
+#endif
+        if (!file_)
+            return;
+
+        const time_t now = time(nullptr);
+        tm local{};
+#ifdef _MSC_VER
+        localtime_s(&local, &now);
+#else
+        localtime_r(&now, &local);
+#endif
+        char stamp[64];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+        fprintf(file_, "--- log started %s (timestamps are seconds since then)\n", stamp);
+    }
+
+    // Single consumer: takes slots in order, writes a batch, flushes.
+    void WriterMain()
+    {
+        OpenFile();
+        for (;;)
+        {
+            uint64_t batch = 0;
+            for (;;)
+            {
+                Slot& slot = slots_[dequeue_ & mask_];
+                if (slot.sequence.load(std::memory_order_acquire) != dequeue_ + 1)
+                    break;
+                if (file_)
+                {
+                    const double seconds = static_cast<double>(slot.time_ns) / 1000000000.0;
+                    fprintf(file_, "[%12.6f] %-5s %s: %.*s\n", seconds, LogLevelName(slot.level),
+                            slot.category ? slot.category : "-", static_cast<int>(slot.length), slot.text);
+                }
+                slot.sequence.store(dequeue_ + mask_ + 1, std::memory_order_release);
+                dequeue_++;
+                batch++;
+            }
+            if (batch > 0)
+            {
+                if (file_)
+                    fflush(file_);
+                written_.store(dequeue_, std::memory_order_release);
+                continue;
+            }
+
+            // Sleeps until a producer clears writer_sleeping_ or the logger
+            // stops; an idle writer does not wake on its own.
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            if (stop_)
+                break;
+            writer_sleeping_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wake_.wait(lock, [this] {
+                return stop_ || !writer_sleeping_.load(std::memory_order_acquire) ||
+                       slots_[dequeue_ & mask_].sequence.load(std::memory_order_acquire) == dequeue_ + 1;
+            });
+            writer_sleeping_.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    LogConfig config_;
+    std::chrono::steady_clock::time_point start_;
+    std::unique_ptr<Slot[]> slots_;
+    uint64_t mask_ = 0;
+    bool all_categories_ = true;
+    std::vector<std::string> included_;
+    std::vector<std::string> excluded_;
+    RateSite sites_[kRateSites];
+
+    std::atomic<uint64_t> enqueue_{ 0 };
+    uint64_t dequeue_ = 0;
+    std::atomic<uint64_t> written_{ 0 };
+    std::atomic<uint64_t> dropped_{ 0 };
+    std::atomic<uint64_t> suppressed_{ 0 };
+
+    std::atomic<bool> writer_starting_{ false };
+    std::atomic<bool> writer_started_{ false };
+    std::atomic<bool> writer_sleeping_{ false };
+    std::thread writer_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    FILE* file_ = nullptr;
+};
+
+} // namespace aes_native
@@ -0,0 +1,117 @@
+#pragma once
+
+// Row copies into BGRA8 from BGRA8 or RGBA8 sources, used where the bridges
+// hand captured frames to shared memory.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AES_PIXEL_SWIZZLE_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AES_PIXEL_SWIZZLE_NEON 1
+#endif
+
+namespace aes_native {
+
+namespace detail {
+
+// Reference swizzle, one byte at a time.
+inline void SwizzleRgbaRowScalar(const uint8_t* src, uint8_t* dst, int width)
+{
+    for (int x = 0; x < width; x++)
+    {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst[3] = src[3];
+        src += 4;
+        dst += 4;
+    }
+}
+
+#if defined(AES_PIXEL_SWIZZLE_SSE2)
+// Swaps R and B in four pixels at a time with shifts and masks; SSE2 has no
+// byte shuffle.
+inline void SwizzleRgbaRowSimd(const uint8_t* src, uint8_t* dst, int width)
+{
+    const __m128i keep = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+    const __m128i low = _mm_set1_epi32(0x000000FF);
+    int x = 0;
+    for (; x + 4 <= width; x += 4)
+    {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + static_cast<size_t>(x) * 4));
+        const __m128i red = _mm_slli_epi32(_mm_and_si128(pixels, low), 16);
+        const __m128i blue = _mm_and_si128(_mm_srli_epi32(pixels, 16), low);
+        const __m128i swapped = _mm_or_si128(_mm_and_si128(pixels, keep), _mm_or_si128(red, blue));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + static_cast<size_t>(x) * 4), swapped);
+    }
+    SwizzleRgbaRowScalar(src + static_cast<size_t>(x) * 4, dst + static_cast<size_t>(x) * 4, width - x);
+}
+#elif defined(AES_PIXEL_SWIZZLE_NEON)
+inline void SwizzleRgbaRowSimd(const uint8_t* src, uint8_t* dst, int width)
+{
+    int x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        uint8x16x4_t pixels = vld4q_u8(src + static_cast<size_t>(x) * 4);
+        const uint8x16_t red = pixels.val[0];
+        pixels.val[0] = pixels.val[2];
+        pixels.val[2] = red;
+        vst4q_u8(dst + static_cast<size_t>(x) * 4, pixels);
+    }
+    SwizzleRgbaRowScalar(src + static_cast<size_t>(x) * 4, dst + static_cast<size_t>(x) * 4, width - x);
+}
+#endif
+
+} // namespace detail
+
+inline bool PixelSwizzleSimdAvailable()
+{
+#if defined(AES_PIXEL_SWIZZLE_SSE2) || defined(AES_PIXEL_SWIZZLE_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Copies width x height pixels into dst as BGRA8. srcRgba selects an RGBA8
+// source that needs its R and B swapped. allowSimd = false forces the scalar
+// reference (for tests and the benchmark).
+inline void CopyRowsToBgra(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height,
+    bool srcRgba, bool allowSimd = true)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    if (!srcRgba && srcStride == rowBytes && dstStride == rowBytes)
+    {
+        memcpy(dst, src, rowBytes * height);
+        return;
+    }
+
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* srcRow = src + srcStride * y;
+        uint8_t* dstRow = dst + dstStride * y;
+        if (!srcRgba)
+        {
+            memcpy(dstRow, srcRow, rowBytes);
+            continue;
+        }
+#if defined(AES_PIXEL_SWIZZLE_SSE2) || defined(AES_PIXEL_SWIZZLE_NEON)
+        if (allowSimd)
+        {
+            detail::SwizzleRgbaRowSimd(srcRow, dstRow, width);
+            continue;
+        }
+#endif
+        detail::SwizzleRgbaRowScalar(srcRow, dstRow, width);
+    }
+}
+
+} // namespace aes_native
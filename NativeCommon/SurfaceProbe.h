@@ -0,0 +1,64 @@
+#pragma once
+
+// Picks the window of a multi-window emulator that actually renders the game.
+// A Qt or wx front-end shows its frames in a child window inside a top-level
+// that also holds menus and status bars; capturing the top-level composites
+// and scales all of that too. For a short probe a bridge watches damage on
+// the top-level and its large descendants and feeds it here.
+//
+// Whether a window's damage includes its children's depends on the server,
+// so the top-level may report the child's frames as its own. Of the windows
+// that damaged close to the most pixels, the smallest is taken: the surface
+// the frames are drawn to, not something that happens to contain it.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aes_native {
+
+struct SurfaceProbeSample
+{
+    uint64_t window_area = 0;
+    uint64_t damaged_pixels = 0;
+    uint32_t frames = 0;
+    uint64_t last_frame_ns = 0;
+
+    // Notifies less than 4 ms after the last counted frame belong to it;
+    // one swap can damage a window in several pieces.
+    void OnDamage(uint64_t nowNs, uint64_t pixels)
+    {
+        damaged_pixels += pixels;
+        if (last_frame_ns == 0 || nowNs - last_frame_ns >= 4000000)
+        {
+            frames++;
+            last_frame_ns = nowNs;
+        }
+    }
+};
+
+// Index of the sample producing the frames, or -1 while none has shown
+// minFrames yet. Ties keep the earlier sample.
+inline int PickRenderSurface(const SurfaceProbeSample* samples, size_t count, uint32_t minFrames = 3)
+{
+    uint64_t mostPixels = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (samples[i].frames >= minFrames && samples[i].damaged_pixels > mostPixels)
+            mostPixels = samples[i].damaged_pixels;
+    }
+    if (mostPixels == 0)
+        return -1;
+
+    int best = -1;
+    for (size_t i = 0; i < count; i++)
+    {
+        const SurfaceProbeSample& sample = samples[i];
+        if (sample.frames < minFrames || sample.damaged_pixels * 2 < mostPixels)
+            continue;
+        if (best < 0 || sample.window_area < samples[best].window_area)
+            best = static_cast<int>(i);
+    }
+    return best;
+}
+
+} // namespace aes_native
@@ -0,0 +1,154 @@
+// Micro-benchmark for the pure per-frame kernels the bridges share: output
+// layout math, frame-rate estimation and the RGBA to BGRA row copy (SIMD
+// against the scalar reference). The content-bar scan has its own
+// benchmark, ContentBarDetectorBench.
+//
+//   BridgeKernelBench [iterations]
+
+#include "FrameLayout.h"
+#include "FrameTiming.h"
+#include "PixelSwizzle.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace aes_native;
+
+namespace {
+
+volatile double g_sink = 0.0;
+
+template <typename Body>
+double MeasureNsPerCall(int iterations, Body body)
+{
+    double sink = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        sink += body(i);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    g_sink = g_sink + sink;
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / iterations;
+}
+
+void BenchLayout(int iterations)
+{
+    const int sources[][2] = { { 256, 224 }, { 640, 480 }, { 1920, 1080 }, { 3840, 1600 } };
+    const int hosts[][2] = { { 1280, 720 }, { 1920, 1080 }, { 800, 1280 } };
+    const int crop[4] = { 8, 0, 8, 16 };
+    const int calls = iterations * 1000;
+
+    const double viewportNs = MeasureNsPerCall(calls, [&](int i) {
+        const int* source = sources[i & 3];
+        const int* host = hosts[i % 3];
+        const ViewportLayout layout = ComputeViewportLayout(source[0], source[1], crop, host[0], host[1], i & 3);
+        return static_cast<double>(layout.viewport[2]) + layout.uv[1];
+    });
+
+    QuadLayoutInput input;
+    input.texture_w = 3840;
+    input.texture_h = 2160;
+    input.crop_x = 64;
+    input.crop_y = 32;
+    input.crop_in_texture = true;
+    input.bars = { 12, 0, 12, 0 };
+    const double quadNs = MeasureNsPerCall(calls, [&](int i) {
+        input.frame_w = sources[i & 3][0];
+        input.frame_h = sources[i & 3][1];
+        input.crop_w = input.frame_w;
+        input.crop_h = input.frame_h;
+        input.view_w = hosts[i % 3][0];
+        input.view_h = hosts[i % 3][1];
+        input.stretch = i % 3;
+        const QuadLayout quad = ComputeQuadLayout(input);
+        return static_cast<double>(quad.left) + quad.u0 + quad.v1;
+    });
+
+    std::printf("viewport layout %8.1f ns   quad layout %8.1f ns\n", viewportNs, quadNs);
+}
+
+void BenchTiming(int iterations)
+{
+    // 60 fps damage with jitter and a duplicate notify on every other frame.
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<int> jitter(-800000, 800000);
+    std::vector<uint64_t> events;
+    uint64_t now = 1000000000ULL;
+    for (int frame = 0; frame < 4096; frame++)
+    {
+        now += 16666667 + jitter(rng);
+        events.push_back(now);
+        if (frame & 1)
+            events.push_back(now + 700000);
+    }
+
+    double fps = 0.0;
+    double frameTimeMs = 0.0;
+    uint64_t last = 0;
+    const double eventNs = MeasureNsPerCall(iterations * 100, [&](int i) {
+        const uint64_t event = events[static_cast<size_t>(i) % events.size()];
+        if (last != 0 && event > last)
+        {
+            if (event - last < MinFrameEventIntervalNs(frameTimeMs))
+                return 0.0;
+            fps = SmoothFrameRate(fps, static_cast<double>(event - last) / 1e9);
+            frameTimeMs = 1000.0 / fps;
+        }
+        last = event;
+        return StabilizeReportedFps(fps);
+    });
+
+    std::printf("damage cadence  %8.1f ns/event (estimate %.2f fps)\n", eventNs, fps);
+}
+
+void BenchSwizzle(int iterations)
+{
+    const int sizes[][2] = { { 640, 480 }, { 1920, 1080 }, { 3840, 2160 } };
+    for (const auto& size : sizes)
+    {
+        const int width = size[0];
+        const int height = size[1];
+        // Row pitch padded like a mapped D3D staging texture.
+        const size_t srcStride = (static_cast<size_t>(width) * 4 + 255) & ~static_cast<size_t>(255);
+        const size_t dstStride = static_cast<size_t>(width) * 4;
+        std::vector<uint8_t> src(srcStride * height);
+        std::mt19937 rng(1);
+        for (uint8_t& byte : src)
+            byte = static_cast<uint8_t>(rng());
+        std::vector<uint8_t> dst(dstStride * height);
+
+        const int frames = std::max(1, iterations * (640 * 480) / (width * height));
+        const double simdNs = MeasureNsPerCall(frames, [&](int) {
+            CopyRowsToBgra(src.data(), srcStride, dst.data(), dstStride, width, height, true, true);
+            return static_cast<double>(dst[dst.size() / 2]);
+        });
+        const double scalarNs = MeasureNsPerCall(frames, [&](int) {
+            CopyRowsToBgra(src.data(), srcStride, dst.data(), dstStride, width, height, true, false);
+            return static_cast<double>(dst[dst.size() / 2]);
+        });
+        const double copyNs = MeasureNsPerCall(frames, [&](int) {
+            CopyRowsToBgra(src.data(), srcStride, dst.data(), dstStride, width, height, false);
+            return static_cast<double>(dst[dst.size() / 2]);
+        });
+
+        std::printf("swizzle %5dx%-5d simd %8.1f us  scalar %8.1f us  speedup %.2fx  (bgra copy %8.1f us)\n",
+                    width, height, simdNs / 1000.0, scalarNs / 1000.0, simdNs > 0.0 ? scalarNs / simdNs : 0.0,
+                    copyNs / 1000.0);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 2000;
+
+    std::printf("bridge kernels, %d iterations, simd=%s\n", iterations, PixelSwizzleSimdAvailable() ? "yes" : "no");
+    BenchLayout(iterations);
+    BenchTiming(iterations);
+    BenchSwizzle(iterations);
+    return 0;
+}
@@ -0,0 +1,75 @@
+// Micro-benchmark for the content-bar detector. Prints the mean time per scan
+// for the SIMD and scalar kernels at the bridges' scan size and at full HD.
+//
+//   ContentBarDetectorBench [iterations]
+
+#include "ContentBarDetector.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+using namespace aes_native;
+
+namespace {
+
+std::vector<uint8_t> MakeFrame(int width, int height)
+{
+    std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4, 0);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> byte(0, 255);
+    const int barX = width / 8;
+    const int barY = height / 10;
+    for (int y = barY; y < height - barY; y++)
+    {
+        for (int x = barX; x < width - barX; x++)
+        {
+            uint8_t* p = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+            p[0] = static_cast<uint8_t>(byte(rng));
+            p[1] = static_cast<uint8_t>(byte(rng));
+            p[2] = static_cast<uint8_t>(byte(rng));
+            p[3] = 255;
+        }
+    }
+    return pixels;
+}
+
+double MeasureNsPerScan(const std::vector<uint8_t>& pixels, int width, int height, bool simd, int iterations)
+{
+    ContentBarStats stats;
+    int sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        ComputeContentBarStats(pixels.data(), width * 4, width, height, stats, simd);
+        sink += ClassifyContentBars(stats).insets.left;
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    if (sink == -1)
+        std::printf("unreachable\n");
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / iterations;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const int iterations = argc > 1 ? std::max(1, std::atoi(argv[1])) : 2000;
+    const int sizes[][2] = { { 320, 180 }, { 320, 240 }, { 1920, 1080 } };
+
+    std::printf("content bar detector, %d iterations, simd=%s\n", iterations, ContentBarSimdAvailable() ? "yes" : "no");
+    for (const auto& size : sizes)
+    {
+        const int width = size[0];
+        const int height = size[1];
+        const std::vector<uint8_t> pixels = MakeFrame(width, height);
+        const int scaledIterations = std::max(1, iterations * (320 * 180) / (width * height));
+
+        const double simdNs = MeasureNsPerScan(pixels, width, height, true, scaledIterations);
+        const double scalarNs = MeasureNsPerScan(pixels, width, height, false, scaledIterations);
+        std::printf("%5dx%-5d simd %10.1f us  scalar %10.1f us  speedup %.2fx\n",
+                    width, height, simdNs / 1000.0, scalarNs / 1000.0, simdNs > 0.0 ? scalarNs / simdNs : 0.0);
+    }
+    return 0;
+}
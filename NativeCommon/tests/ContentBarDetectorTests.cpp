@@ -0,0 +1,257 @@
+#include "ContentBarDetector.h"
+#include "NativeTest.h"
+
+#include <cstring>
+#include <random>
+
+using namespace aes_native;
+
+namespace {
+
+struct Image
+{
+    int width;
+    int height;
+    std::vector<uint8_t> pixels;
+
+    Image(int w, int h) : width(w), height(h), pixels(static_cast<size_t>(w) * h * 4, 0) {}
+
+    int Stride() const { return width * 4; }
+
+    void Set(int x, int y, uint8_t b, uint8_t g, uint8_t r)
+    {
+        uint8_t* p = pixels.data() + (static_cast<size_t>(y) * width + x) * 4;
+        p[0] = b;
+        p[1] = g;
+        p[2] = r;
+        p[3] = 255;
+    }
+
+    // Textured content in [x0, x1) x [y0, y1): a gradient plus noise, never black.
+    void FillContent(int x0, int y0, int x1, int y1, uint32_t seed = 7)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> noise(0, 40);
+        for (int y = y0; y < y1; y++)
+        {
+            for (int x = x0; x < x1; x++)
+            {
+                const int base = 60 + ((x * 3 + y * 2) % 120);
+                Set(x, y, static_cast<uint8_t>(base + noise(rng)), static_cast<uint8_t>(base), static_cast<uint8_t>(base + noise(rng) / 2));
+            }
+        }
+    }
+};
+
+ContentBarScan Scan(const Image& image, const ContentBarDetectorOptions& options = {})
+{
+    return DetectContentBars(image.pixels.data(), image.Stride(), image.width, image.height, options);
+}
+
+} // namespace
+
+NATIVE_TEST(DetectsCleanPillarbox)
+{
+    Image image(320, 180);
+    image.FillContent(40, 0, 280, 180);
+
+    const ContentBarScan scan = Scan(image);
+    CHECK(scan.has_content);
+    CHECK_EQ(40, scan.insets.left);
+    CHECK_EQ(40, scan.insets.right);
+    CHECK_EQ(0, scan.insets.top);
+    CHECK_EQ(0, scan.insets.bottom);
+}
+
+NATIVE_TEST(DetectsLetterboxWithDitheredBars)
+{
+    Image image(320, 240);
+    image.FillContent(0, 30, 320, 210);
+
+    // Dithered near-black bars with occasional brighter specks.
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<int> dither(0, 12);
+    for (int y = 0; y < 240; y++)
+    {
+        if (y >= 30 && y < 210)
+            continue;
+        for (int x = 0; x < 320; x++)
+        {
+            const uint8_t v = static_cast<uint8_t>(dither(rng));
+            image.Set(x, y, v, v, v);
+        }
+        image.Set((y * 37) % 320, y, 28, 28, 28);
+    }
+
+    const ContentBarScan scan = Scan(image);
+    CHECK(scan.has_content);
+    CHECK_EQ(30, scan.insets.top);
+    CHECK_EQ(30, scan.insets.bottom);
+    CHECK_EQ(0, scan.insets.left);
+    CHECK_EQ(0, scan.insets.right);
+}
+
+NATIVE_TEST(AllBlackFrameHasNoContent)
+{
+    Image image(320, 180);
+    const ContentBarScan scan = Scan(image);
+    CHECK(!scan.has_content);
+    CHECK_EQ(0, scan.insets.left);
+    CHECK_EQ(0, scan.insets.top);
+}
+
+NATIVE_TEST(DarkTexturedSceneIsNotABar)
+{
+    // A night scene: dark on average but with real detail across the frame.
+    Image image(320, 180);
+    for (int y = 0; y < 180; y++)
+    {
+        for (int x = 0; x < 320; x++)
+        {
+            const uint8_t v = static_cast<uint8_t>(((x / 3 + y / 2) % 5 == 0) ? 70 : 4);
+            image.Set(x, y, v, v, v);
+        }
+    }
+
+    const ContentBarScan scan = Scan(image);
+    CHECK(scan.has_content);
+    CHECK_EQ(0, scan.insets.left);
+    CHECK_EQ(0, scan.insets.right);
+    CHECK_EQ(0, scan.insets.top);
+    CHECK_EQ(0, scan.insets.bottom);
+}
+
+NATIVE_TEST(BarsWiderThanSearchLimitAreIgnored)
+{
+    Image image(320, 180);
+    image.FillContent(100, 0, 320, 180);
+
+    const ContentBarScan scan = Scan(image);
+    CHECK(scan.has_content);
+    CHECK_EQ(0, scan.insets.left);
+}
+
+NATIVE_TEST(ThinBarsBelowMinimumAreIgnored)
+{
+    Image image(320, 180);
+    image.FillContent(3, 0, 320, 180);
+
+    const ContentBarScan scan = Scan(image);
+    CHECK_EQ(0, scan.insets.left);
+
+    ContentBarDetectorOptions options;
+    options.min_bar_px = 2;
+    CHECK_EQ(3, Scan(image, options).insets.left);
+}
+
+NATIVE_TEST(LumaThresholdIsConfigurable)
+{
+    Image image(320, 180);
+    image.FillContent(32, 0, 320, 180);
+    for (int y = 0; y < 180; y++)
+    {
+        for (int x = 0; x < 32; x++)
+            image.Set(x, y, 24, 24, 24);
+    }
+
+    CHECK_EQ(0, Scan(image).insets.left);
+
+    ContentBarDetectorOptions options;
+    options.luma_threshold = 30;
+    CHECK_EQ(32, Scan(image, options).insets.left);
+}
+
+NATIVE_TEST(NegativeStrideReadsBottomUpBuffers)
+{
+    Image image(320, 180);
+    image.FillContent(0, 20, 320, 150);
+
+    // Flip rows to mimic a GL readback, then walk it top-down again.
+    Image flipped(320, 180);
+    for (int y = 0; y < 180; y++)
+        memcpy(flipped.pixels.data() + static_cast<size_t>(179 - y) * flipped.Stride(),
+               image.pixels.data() + static_cast<size_t>(y) * image.Stride(), image.Stride());
+
+    const uint8_t* lastRow = flipped.pixels.data() + static_cast<size_t>(179) * flipped.Stride();
+    const ContentBarScan scan = DetectContentBars(lastRow, -flipped.Stride(), 320, 180);
+    CHECK_EQ(20, scan.insets.top);
+    CHECK_EQ(30, scan.insets.bottom);
+}
+
+NATIVE_TEST(SimdStatsMatchScalarStats)
+{
+    // Odd width exercises the scalar tail after the vector loop.
+    Image image(333, 97);
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (uint8_t& v : image.pixels)
+        v = static_cast<uint8_t>(byte(rng));
+
+    ContentBarStats simd;
+    ContentBarStats scalar;
+    ComputeContentBarStats(image.pixels.data(), image.Stride(), image.width, image.height, simd, true);
+    ComputeContentBarStats(image.pixels.data(), image.Stride(), image.width, image.height, scalar, false);
+
+    CHECK(simd.col_max == scalar.col_max);
+    CHECK(simd.col_sum == scalar.col_sum);
+    CHECK(simd.col_sum_sq == scalar.col_sum_sq);
+    CHECK(simd.row_max == scalar.row_max);
+    CHECK(simd.row_sum == scalar.row_sum);
+    CHECK(simd.row_sum_sq == scalar.row_sum_sq);
+}
+
+NATIVE_TEST(TrackerShrinksImmediately)
+{
+    ContentBarTracker tracker{};
+    tracker.applied = { 40, 0, 40, 0 };
+
+    const ContentBarScan scan{ true, { 10, 0, 40, 0 } };
+    CHECK(UpdateContentBarTracker(tracker, scan));
+    CHECK_EQ(10, tracker.applied.left);
+    CHECK_EQ(40, tracker.applied.right);
+}
+
+NATIVE_TEST(TrackerGrowsOnlyAfterConfirmation)
+{
+    ContentBarTracker tracker{};
+    const ContentBarScan scan{ true, { 40, 0, 40, 0 } };
+
+    CHECK(!UpdateContentBarTracker(tracker, scan));
+    CHECK_EQ(0, tracker.applied.left);
+    CHECK(UpdateContentBarTracker(tracker, scan));
+    CHECK_EQ(40, tracker.applied.left);
+    CHECK_EQ(40, tracker.applied.right);
+}
+
+NATIVE_TEST(TrackerRestartsConfirmationWhenCandidateChanges)
+{
+    ContentBarTracker tracker{};
+    CHECK(!UpdateContentBarTracker(tracker, { true, { 40, 0, 40, 0 } }));
+    CHECK(!UpdateContentBarTracker(tracker, { true, { 60, 0, 60, 0 } }));
+    CHECK_EQ(0, tracker.applied.left);
+    CHECK(UpdateContentBarTracker(tracker, { true, { 60, 0, 60, 0 } }));
+    CHECK_EQ(60, tracker.applied.left);
+}
+
+NATIVE_TEST(TrackerIgnoresFramesWithoutContent)
+{
+    ContentBarTracker tracker{};
+    tracker.applied = { 40, 0, 40, 0 };
+
+    CHECK(!UpdateContentBarTracker(tracker, { false, { 0, 0, 0, 0 } }));
+    CHECK_EQ(40, tracker.applied.left);
+}
+
+NATIVE_TEST(TrackerToleratesOnePixelJitter)
+{
+    ContentBarTracker tracker{};
+    tracker.applied = { 40, 0, 40, 0 };
+
+    // One scan pixel wider is within tolerance: no growth, no pending candidate.
+    CHECK(!UpdateContentBarTracker(tracker, { true, { 41, 0, 41, 0 } }));
+    CHECK(!UpdateContentBarTracker(tracker, { true, { 41, 0, 41, 0 } }));
+    CHECK_EQ(40, tracker.applied.left);
+    CHECK_EQ(0, tracker.candidate_hits);
+}
+
+NATIVE_TEST_MAIN()
@@ -0,0 +1,56 @@
+#include "CpuSelection.h"
+#include "NativeTest.h"
+
+using namespace aes_native;
+
+NATIVE_TEST(CpuListsParseRangesAndSingles)
+{
+    std::vector<int> cpus;
+    CHECK(ParseCpuList("0-2,6", 8, &cpus));
+    CHECK(cpus == std::vector<int>({ 0, 1, 2, 6 }));
+
+    // Duplicates merge, order does not matter and CPUs past the end drop.
+    CHECK(ParseCpuList("7, 3,3-4,12", 8, &cpus));
+    CHECK(cpus == std::vector<int>({ 3, 4, 7 }));
+}
+
+NATIVE_TEST(CpuListsRejectMalformedInput)
+{
+    std::vector<int> cpus;
+    CHECK(!ParseCpuList("", 8, &cpus));
+    CHECK(!ParseCpuList(nullptr, 8, &cpus));
+    CHECK(!ParseCpuList("a", 8, &cpus));
+    CHECK(!ParseCpuList("3-1", 8, &cpus));
+    CHECK(!ParseCpuList("2x", 8, &cpus));
+    CHECK(!ParseCpuList("-1", 8, &cpus));
+    CHECK(!ParseCpuList("9-10", 8, &cpus));
+}
+
+NATIVE_TEST(TaskStatSkipsNamesWithSpacesAndParens)
+{
+    const char* line =
+        "4242 (EE (Core) 1) R 1 4240 4240 0 -1 4194560 1200 0 0 0 850 150 0 0 20 0 12 0 100 "
+        "1000000 500 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 5 0 0 0 0 0\n";
+    int processor = -1;
+    uint64_t ticks = 0;
+    CHECK(ParseTaskStat(line, &processor, &ticks));
+    CHECK_EQ(5, processor);
+    CHECK_EQ(1000u, ticks);
+
+    CHECK(!ParseTaskStat("4242 (short) R 1 2 3\n", &processor, &ticks));
+    CHECK(!ParseTaskStat("no name here", &processor, &ticks));
+}
+
+NATIVE_TEST(QuietCpusAvoidTheBusiestCores)
+{
+    const std::vector<int> allowed = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    const std::vector<uint64_t> busy = { 90, 5, 100, 100, 0, 100, 3, 100 };
+    CHECK(PickQuietCpus(allowed, busy, 2) == std::vector<int>({ 4, 6 }));
+    CHECK(PickQuietCpus(allowed, busy, 3) == std::vector<int>({ 1, 4, 6 }));
+
+    // Only allowed CPUs qualify; CPUs with no sample count as idle.
+    CHECK(PickQuietCpus({ 2, 3, 9 }, busy, 1) == std::vector<int>({ 9 }));
+    CHECK(PickQuietCpus({ 2, 3 }, busy, 4) == std::vector<int>({ 2, 3 }));
+}
+
+NATIVE_TEST_MAIN()
@@ -0,0 +1,125 @@
+#include "FrameFingerprint.h"
+#include "NativeTest.h"
+
+#include <vector>
+
+using namespace aes_native;
+
+namespace {
+
+std::vector<uint8_t> MakeGradient(int width, int height)
+{
+    std::vector<uint8_t> bgra(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            uint8_t* p = bgra.data() + (static_cast<size_t>(y) * width + x) * 4;
+            p[0] = static_cast<uint8_t>(x * 3);
+            p[1] = static_cast<uint8_t>(y * 5);
+            p[2] = static_cast<uint8_t>(x ^ y);
+            p[3] = 255;
+        }
+    }
+    return bgra;
+}
+
+} // namespace
+
+NATIVE_TEST(IdenticalFramesHashEqual)
+{
+    const std::vector<uint8_t> a = MakeGradient(63, 35);
+    const std::vector<uint8_t> b = a;
+    CHECK_EQ(HashFingerprint(a.data(), 63 * 4, 63, 35), HashFingerprint(b.data(), 63 * 4, 63, 35));
+}
+
+NATIVE_TEST(SingleChannelChangeChangesHash)
+{
+    const std::vector<uint8_t> a = MakeGradient(64, 36);
+    const uint64_t base = HashFingerprint(a.data(), 64 * 4, 64, 36);
+
+    // Every colour byte of the first, an interior and the odd last pixel.
+    const size_t pixels[] = { 0, (17 * 64 + 40) * 4, (36 * 64 - 1) * 4 };
+    for (size_t offset : pixels)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            std::vector<uint8_t> b = a;
+            b[offset + channel] ^= 1;
+            CHECK(HashFingerprint(b.data(), 64 * 4, 64, 36) != base);
+        }
+    }
+}
+
+NATIVE_TEST(AlphaIsIgnored)
+{
+    const std::vector<uint8_t> a = MakeGradient(33, 9);
+    std::vector<uint8_t> b = a;
+    for (size_t i = 3; i < b.size(); i += 4)
+        b[i] = static_cast<uint8_t>(i);
+    CHECK_EQ(HashFingerprint(a.data(), 33 * 4, 33, 9), HashFingerprint(b.data(), 33 * 4, 33, 9));
+}
+
+NATIVE_TEST(NegativeStrideHashesRowsInOrder)
+{
+    const int width = 16;
+    const int height = 8;
+    const std::vector<uint8_t> topDown = MakeGradient(width, height);
+    std::vector<uint8_t> bottomUp(topDown.size());
+    for (int y = 0; y < height; y++)
+        memcpy(&bottomUp[static_cast<size_t>(height - 1 - y) * width * 4], &topDown[static_cast<size_t>(y) * width * 4], width * 4);
+
+    const ptrdiff_t stride = width * 4;
+    CHECK_EQ(HashFingerprint(topDown.data(), stride, width, height),
+             HashFingerprint(bottomUp.data() + (height - 1) * stride, -stride, width, height));
+}
+
+NATIVE_TEST(DuplicateFramesSkipOnlyWhenNothingWaits)
+{
+    CHECK(CanSkipDuplicateFrame(true, true, false, false));
+    CHECK(!CanSkipDuplicateFrame(false, true, false, false));
+    CHECK(!CanSkipDuplicateFrame(true, false, false, false));
+    CHECK(!CanSkipDuplicateFrame(true, true, true, false));
+}
+
+NATIVE_TEST(PendingScreenshotKeepsDuplicatesRendering)
+{
+    // A paused emulator re-presents one picture; a queued or reading-back
+    // screenshot needs renders to start and collect it.
+    CHECK(!CanSkipDuplicateFrame(true, true, false, true));
+    CHECK(!CanSkipDuplicateFrame(true, false, false, true));
+    CHECK(!CanSkipDuplicateFrame(true, true, true, true));
+}
+
+NATIVE_TEST(RateWindowTracksCadence)
+{
+    FrameRateWindow window;
+    uint64_t now = 5000000000ULL;
+    const uint64_t period = 1000000000ULL / 30;
+    for (int i = 0; i < 90; i++)
+    {
+        window.Record(now);
+        now += period;
+    }
+    const double rate = window.Rate(now - period);
+    CHECK(rate > 29.5 && rate < 30.5);
+}
+
+NATIVE_TEST(RateWindowDecaysWhenIdle)
+{
+    FrameRateWindow window;
+    uint64_t now = 1000000000ULL;
+    for (int i = 0; i < 60; i++)
+    {
+        window.Record(now);
+        now += 1000000000ULL / 60;
+    }
+    const double afterHalfSecond = window.Rate(now + 500000000ULL);
+    CHECK(afterHalfSecond > 0.0 && afterHalfSecond < 45.0);
+    CHECK_EQ(0.0, window.Rate(now + 2000000000ULL));
+
+    window.Reset();
+    CHECK_EQ(0.0, window.Rate(now));
+}
+
+NATIVE_TEST_MAIN()
@@ -0,0 +1,194 @@
+#include "FrameLayout.h"
+#include "NativeTest.h"
+
+using namespace aes_native;
+
+namespace {
+
+const int kNoCrop[4] = { 0, 0, 0, 0 };
+const double kUvTolerance = 1e-6;
+
+void CheckViewport(const ViewportLayout& layout, int x, int y, int w, int h)
+{
+    CHECK_EQ(x, layout.viewport[0]);
+    CHECK_EQ(y, layout.viewport[1]);
+    CHECK_EQ(w, layout.viewport[2]);
+    CHECK_EQ(h, layout.viewport[3]);
+}
+
+void CheckUv(const ViewportLayout& layout, double u0, double v0, double u1, double v1)
+{
+    CHECK_NEAR(u0, layout.uv[0], kUvTolerance);
+    CHECK_NEAR(v0, layout.uv[1], kUvTolerance);
+    CHECK_NEAR(u1, layout.uv[2], kUvTolerance);
+    CHECK_NEAR(v1, layout.uv[3], kUvTolerance);
+}
+
+QuadLayoutInput MakeQuadInput(int stretch)
+{
+    QuadLayoutInput input;
+    input.frame_w = 640;
+    input.frame_h = 480;
+    input.view_w = 1280;
+    input.view_h = 720;
+    input.stretch = stretch;
+    return input;
+}
+
+} // namespace
+
+NATIVE_TEST(ViewportFillCoversHost)
+{
+    const ViewportLayout layout = ComputeViewportLayout(640, 480, kNoCrop, 1280, 720, 1);
+    CheckViewport(layout, 0, 0, 1280, 720);
+    CheckUv(layout, 0.0, 0.0, 1.0, 1.0);
+}
+
+NATIVE_TEST(ViewportUniformLetterboxes)
+{
+    CheckViewport(ComputeViewportLayout(640, 480, kNoCrop, 1280, 720, 2), 160, 0, 960, 720);
+    CheckViewport(ComputeViewportLayout(1920, 800, kNoCrop, 1280, 720, 2), 0, 93, 1280, 533);
+}
+
+NATIVE_TEST(ViewportNoneCentresAtPixelSize)
+{
+    CheckViewport(ComputeViewportLayout(320, 240, kNoCrop, 1280, 720, 0), 480, 240, 320, 240);
+    // Larger than the host: clamped to it, not cropped.
+    const ViewportLayout large = ComputeViewportLayout(1920, 1080, kNoCrop, 1280, 720, 0);
+    CheckViewport(large, 0, 0, 1280, 720);
+    CheckUv(large, 0.0, 0.0, 1.0, 1.0);
+}
+
+NATIVE_TEST(ViewportUniformToFillTrimsSource)
+{
+    // 4:3 into 16:9 keeps 360 of 480 rows: 60 trimmed top and bottom.
+    const ViewportLayout layout = ComputeViewportLayout(640, 480, kNoCrop, 1280, 720, 3);
+    CheckViewport(layout, 0, 0, 1280, 720);
+    CheckUv(layout, 0.0, 0.125, 1.0, 0.875);
+}
+
+NATIVE_TEST(ViewportCropInsetsMoveUvAndAspect)
+{
+    const int crop[4] = { 64, 0, 64, 0 };
+    // 512x480 cropped source letterboxed into 1280x720.
+    const ViewportLayout layout = ComputeViewportLayout(640, 480, crop, 1280, 720, 2);
+    CheckViewport(layout, 256, 0, 768, 720);
+    CheckUv(layout, 0.1, 0.0, 0.9, 1.0);
+}
+
+NATIVE_TEST(ViewportDegenerateSizesStayValid)
+{
+    const int crop[4] = { 500, 500, 500, 500 };
+    for (int stretch = 0; stretch <= 3; stretch++)
+    {
+        const ViewportLayout layout = ComputeViewportLayout(0, 0, crop, 0, 0, stretch);
+        CHECK(layout.viewport[2] >= 1 && layout.viewport[3] >= 1);
+        for (float uv : layout.uv)
+            CHECK(uv >= 0.0f && uv <= 1.0f);
+    }
+}
+
+NATIVE_TEST(OutputPointsMapBackThroughLetterbox)
+{
+    // 640x480 letterboxed into 1280x720: 960x720 picture from x = 160.
+    const ViewportLayout layout = ComputeViewportLayout(640, 480, kNoCrop, 1280, 720, 2);
+    int x = -1;
+    int y = -1;
+    CHECK(MapOutputToSource(layout, 720, 640, 480, 160.0, 0.0, &x, &y));
+    CHECK_EQ(0, x);
+    CHECK_EQ(0, y);
+    CHECK(MapOutputToSource(layout, 720, 640, 480, 640.5, 360.5, &x, &y));
+    CHECK_EQ(320, x);
+    CHECK_EQ(240, y);
+    CHECK(MapOutputToSource(layout, 720, 640, 480, 1119.9, 719.9, &x, &y));
+    CHECK_EQ(639, x);
+    CHECK_EQ(479, y);
+    // The bars show nothing of the source.
+    CHECK(!MapOutputToSource(layout, 720, 640, 480, 100.0, 360.0, &x, &y));
+    CHECK(!MapOutputToSource(layout, 720, 640, 480, 1200.0, 360.0, &x, &y));
+}
+
+NATIVE_TEST(OutputPointsMapBackThroughCropAndUnevenViewport)
+{
+    const int crop[4] = { 64, 20, 64, 0 };
+    // 512x460 of source into a 1000x501 output; the viewport is not centred
+    // to the pixel, so rows must be counted from the top of the output.
+    const ViewportLayout layout = ComputeViewportLayout(640, 480, crop, 1000, 501, 2);
+    const int top = 501 - layout.viewport[1] - layout.viewport[3];
+    int x = -1;
+    int y = -1;
+    CHECK(MapOutputToSource(layout, 501, 640, 480, layout.viewport[0] + 0.01, top + 0.01, &x, &y));
+    CHECK_EQ(64, x);
+    CHECK_EQ(20, y);
+    CHECK(!MapOutputToSource(layout, 501, 640, 480, layout.viewport[0] + 0.01, top - 0.5, &x, &y));
+
+    // Uniform to fill trims the sides; the view edge is the first kept column.
+    const ViewportLayout fill = ComputeViewportLayout(640, 480, kNoCrop, 1280, 720, 3);
+    CHECK(MapOutputToSource(fill, 720, 640, 480, 0.0, 0.0, &x, &y));
+    CHECK_EQ(0, x);
+    CHECK_EQ(60, y);
+}
+
+NATIVE_TEST(QuadFillSamplesInsideHalfTexel)
+{
+    const QuadLayout quad = ComputeQuadLayout(MakeQuadInput(0));
+    CHECK_NEAR(-1.0, quad.left, kUvTolerance);
+    CHECK_NEAR(1.0, quad.top, kUvTolerance);
+    CHECK_NEAR(0.5 / 640.0, quad.u0, kUvTolerance);
+    CHECK_NEAR(0.5 / 480.0, quad.v0, kUvTolerance);
+    CHECK_NEAR(1.0 - 0.5 / 640.0, quad.u1, kUvTolerance);
+    CHECK_NEAR(1.0 - 0.5 / 480.0, quad.v1, kUvTolerance);
+}
+
+NATIVE_TEST(QuadUniformShrinksCorners)
+{
+    const QuadLayout quad = ComputeQuadLayout(MakeQuadInput(1));
+    CHECK_NEAR(-0.75, quad.left, kUvTolerance);
+    CHECK_NEAR(0.75, quad.right, kUvTolerance);
+    CHECK_NEAR(1.0, quad.top, kUvTolerance);
+    CHECK_NEAR(-1.0, quad.bottom, kUvTolerance);
+}
+
+NATIVE_TEST(QuadUniformToFillTrimsUv)
+{
+    const QuadLayout quad = ComputeQuadLayout(MakeQuadInput(2));
+    CHECK_NEAR(-1.0, quad.left, kUvTolerance);
+    CHECK_NEAR(0.125 + 0.5 / 480.0, quad.v0, kUvTolerance);
+    CHECK_NEAR(0.875 - 0.5 / 480.0, quad.v1, kUvTolerance);
+}
+
+NATIVE_TEST(QuadCropInTextureMapsToSubRect)
+{
+    QuadLayoutInput input = MakeQuadInput(0);
+    input.texture_w = 1920;
+    input.texture_h = 1080;
+    input.crop_x = 100;
+    input.crop_y = 50;
+    input.crop_w = 640;
+    input.crop_h = 480;
+    input.crop_in_texture = true;
+    const QuadLayout quad = ComputeQuadLayout(input);
+    // The half-texel inset is sized by the crop, not the whole texture.
+    CHECK_NEAR(100.0 / 1920.0 + 0.5 / 640.0, quad.u0, 1e-5);
+    CHECK_NEAR(50.0 / 1080.0 + 0.5 / 480.0, quad.v0, 1e-5);
+    CHECK_NEAR(740.0 / 1920.0 - 0.5 / 640.0, quad.u1, 1e-5);
+    CHECK_NEAR(530.0 / 1080.0 - 0.5 / 480.0, quad.v1, 1e-5);
+
+    // The same rectangle in its own texture samples the whole texture.
+    input.crop_in_texture = false;
+    CHECK_NEAR(0.5 / 1920.0, ComputeQuadLayout(input).u0, 1e-5);
+}
+
+NATIVE_TEST(QuadContentBarsCropAndFillView)
+{
+    QuadLayoutInput input = MakeQuadInput(1);
+    input.bars = { 80, 0, 80, 0 };
+    const QuadLayout quad = ComputeQuadLayout(input);
+    // Bars are cut from the picture, so the letterboxed quad fills the view again.
+    CHECK_NEAR(-1.0, quad.left, kUvTolerance);
+    CHECK_NEAR(1.0, quad.right, kUvTolerance);
+    CHECK_NEAR(80.5 / 640.0, quad.u0, kUvTolerance);
+    CHECK_NEAR(559.5 / 640.0, quad.u1, kUvTolerance);
+}
+
+NATIVE_TEST_MAIN()
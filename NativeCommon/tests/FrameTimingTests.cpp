@@ -0,0 +1,103 @@
+#include "FrameTiming.h"
+#include "NativeTest.h"
+
+using namespace aes_native;
+
+namespace {
+
+// The Linux bridge's damage path: duplicate notifies are dropped, the rest
+// feed the rate estimate.
+struct DamageCadence
+{
+    double fps = 0.0;
+    double frame_time_ms = 0.0;
+    uint64_t last_event_ns = 0;
+    int accepted = 0;
+
+    void OnDamage(uint64_t now)
+    {
+        if (last_event_ns != 0 && now > last_event_ns)
+        {
+            const uint64_t dtNs = now - last_event_ns;
+            if (dtNs < MinFrameEventIntervalNs(frame_time_ms))
+                return;
+            fps = SmoothFrameRate(fps, static_cast<double>(dtNs) / 1e9);
+            frame_time_ms = fps > 0.0 ? 1000.0 / fps : 0.0;
+        }
+        last_event_ns = now;
+        accepted++;
+    }
+};
+
+} // namespace
+
+NATIVE_TEST(StabilizeSnapsNearCommonRates)
+{
+    CHECK_NEAR(60.0, StabilizeReportedFps(59.2), 0.0);
+    CHECK_NEAR(60.0, StabilizeReportedFps(62.3), 0.0);
+    CHECK_NEAR(30.0, StabilizeReportedFps(31.0), 0.0);
+    CHECK_NEAR(120.0, StabilizeReportedFps(116.0), 0.0);
+    CHECK_NEAR(57.0, StabilizeReportedFps(57.0), 0.0);
+    CHECK_NEAR(90.0, StabilizeReportedFps(90.0), 0.0);
+    CHECK_NEAR(0.0, StabilizeReportedFps(0.0), 0.0);
+    CHECK_NEAR(0.0, StabilizeReportedFps(-5.0), 0.0);
+}
+
+NATIVE_TEST(RefreshSnapFindsDivisorsOfTheDisplayRate)
+{
+    CHECK_NEAR(144.0, SnapFrameRateToRefresh(141.0, 144.0), 0.0);
+    CHECK_NEAR(72.0, SnapFrameRateToRefresh(73.5, 144.0), 0.0);
+    CHECK_NEAR(37.5, SnapFrameRateToRefresh(37.0, 75.0), 0.0);
+    CHECK_NEAR(60.0, SnapFrameRateToRefresh(60.0, 144.0), 0.0);
+    CHECK_NEAR(59.5, SnapFrameRateToRefresh(59.5, 0.0), 0.0);
+    CHECK_NEAR(0.0, SnapFrameRateToRefresh(0.0, 60.0), 0.0);
+}
+
+NATIVE_TEST(SmoothFrameRateStartsAtInstantRateAndClamps)
+{
+    CHECK_NEAR(50.0, SmoothFrameRate(0.0, 0.02), 1e-9);
+    CHECK_NEAR(240.0, SmoothFrameRate(0.0, 0.0001), 1e-9);
+    CHECK_NEAR(1.0, SmoothFrameRate(0.0, 5.0), 1e-9);
+    CHECK_NEAR(42.0, SmoothFrameRate(42.0, 0.0), 0.0);
+}
+
+NATIVE_TEST(SmoothFrameRateConvergesAndFollowsDrops)
+{
+    double fps = 0.0;
+    for (int i = 0; i < 100; i++)
+        fps = SmoothFrameRate(fps, 1.0 / 60.0);
+    CHECK_NEAR(60.0, fps, 0.01);
+
+    // Long intervals weigh more: a drop to 30 fps settles within 20 frames.
+    for (int i = 0; i < 20; i++)
+        fps = SmoothFrameRate(fps, 1.0 / 30.0);
+    CHECK_NEAR(30.0, fps, 0.5);
+}
+
+NATIVE_TEST(MinIntervalFollowsFrameTime)
+{
+    CHECK_EQ(8000000u, MinFrameEventIntervalNs(0.0));
+    CHECK_EQ(5000000u, MinFrameEventIntervalNs(4.0));
+    CHECK_EQ(18333334u, MinFrameEventIntervalNs(1000.0 / 30.0));
+    CHECK_EQ(9166667u, MinFrameEventIntervalNs(0.0, 60.0));
+    CHECK_EQ(5000000u, MinFrameEventIntervalNs(0.0, 144.0));
+    CHECK_EQ(18333334u, MinFrameEventIntervalNs(1000.0 / 30.0, 144.0));
+}
+
+NATIVE_TEST(DuplicateDamageNotifiesAreFiltered)
+{
+    DamageCadence cadence;
+    uint64_t now = 1000000000ULL;
+    const uint64_t period = 1000000000ULL / 60;
+    for (int frame = 0; frame < 120; frame++)
+    {
+        cadence.OnDamage(now);
+        // A second notify for the same frame 1 ms later.
+        cadence.OnDamage(now + 1000000);
+        now += period;
+    }
+    CHECK_EQ(120, cadence.accepted);
+    CHECK_NEAR(60.0, cadence.fps, 0.1);
+}
+
+NATIVE_TEST_MAIN()
@@ -0,0 +1,264 @@
+#include "ImageEncoders.h"
+#include "NativeTest.h"
+
+#include <random>
+
+using namespace aes_native;
+
+namespace {
+
+struct Frame
+{
+    int width;
+    int height;
+    std::vector<uint8_t> bgra;
+};
+
+Frame MakeFrame(int width, int height, uint32_t seed)
+{
+    Frame frame{ width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height * 4) };
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> noise(0, 255);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            uint8_t* p = frame.bgra.data() + (static_cast<size_t>(y) * width + x) * 4;
+            // Flat areas, gradients and noise so every QOI op and PNG filter path runs.
+            if (x < width / 3)
+            {
+                p[0] = 20; p[1] = 40; p[2] = 60;
+            }
+            else if (x < 2 * width / 3)
+            {
+                p[0] = static_cast<uint8_t>(x + y); p[1] = static_cast<uint8_t>(x * 2); p[2] = static_cast<uint8_t>(y * 3);
+            }
+            else
+            {
+                p[0] = static_cast<uint8_t>(noise(rng)); p[1] = static_cast<uint8_t>(noise(rng)); p[2] = static_cast<uint8_t>(noise(rng));
+            }
+            p[3] = static_cast<uint8_t>(noise(rng));
+        }
+    }
+    return frame;
+}
+
+uint32_t ReadBe32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+// Reference QOI decoder to RGB.
+bool DecodeQoi(const std::vector<uint8_t>& data, int& width, int& height, std::vector<uint8_t>& rgb)
+{
+    if (data.size() < 22 || memcmp(data.data(), "qoif", 4) != 0)
+        return false;
+    width = static_cast<int>(ReadBe32(&data[4]));
+    height = static_cast<int>(ReadBe32(&data[8]));
+    const size_t count = static_cast<size_t>(width) * height;
+    rgb.assign(count * 3, 0);
+
+    uint8_t index[64][4] = {};
+    uint8_t px[4] = { 0, 0, 0, 255 };
+    size_t pos = 14;
+    int run = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (run > 0)
+        {
+            run--;
+        }
+        else
+        {
+            const uint8_t b1 = data[pos++];
+            if (b1 == 0xfe)
+            {
+                px[0] = data[pos++]; px[1] = data[pos++]; px[2] = data[pos++];
+            }
+            else if ((b1 & 0xc0) == 0x00)
+            {
+                memcpy(px, index[b1], 4);
+            }
+            else if ((b1 & 0xc0) == 0x40)
+            {
+                px[0] = static_cast<uint8_t>(px[0] + ((b1 >> 4) & 3) - 2);
+                px[1] = static_cast<uint8_t>(px[1] + ((b1 >> 2) & 3) - 2);
+                px[2] = static_cast<uint8_t>(px[2] + (b1 & 3) - 2);
+            }
+            else if ((b1 & 0xc0) == 0x80)
+            {
+                const uint8_t b2 = data[pos++];
+                const int dg = (b1 & 0x3f) - 32;
+                px[0] = static_cast<uint8_t>(px[0] + dg - 8 + ((b2 >> 4) & 0x0f));
+                px[1] = static_cast<uint8_t>(px[1] + dg);
+                px[2] = static_cast<uint8_t>(px[2] + dg - 8 + (b2 & 0x0f));
+            }
+            else
+            {
+                run = b1 & 0x3f;
+            }
+            memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        }
+        memcpy(&rgb[i * 3], px, 3);
+    }
+
+    static const uint8_t kEnd[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+    return data.size() == pos + 8 && memcmp(&data[pos], kEnd, 8) == 0;
+}
+
+// Minimal PNG reader for what EncodePng writes: checks chunk CRCs, inflates
+// IDAT and undoes the Up filter.
+bool DecodePng(const std::vector<uint8_t>& data, int& width, int& height, std::vector<uint8_t>& rgb)
+{
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    if (data.size() < 8 || memcmp(data.data(), kSignature, 8) != 0)
+        return false;
+
+    std::vector<uint8_t> idat;
+    bool sawEnd = false;
+    for (size_t pos = 8; pos + 12 <= data.size() && !sawEnd;)
+    {
+        const uint32_t size = ReadBe32(&data[pos]);
+        const uint8_t* type = &data[pos + 4];
+        const uint8_t* body = type + 4;
+        if (pos + 12 + size > data.size())
+            return false;
+        if (ReadBe32(body + size) != static_cast<uint32_t>(crc32(0L, type, size + 4)))
+            return false;
+
+        if (memcmp(type, "IHDR", 4) == 0)
+        {
+            width = static_cast<int>(ReadBe32(body));
+            height = static_cast<int>(ReadBe32(body + 4));
+            if (body[8] != 8 || body[9] != 2)
+                return false;
+        }
+        else if (memcmp(type, "IDAT", 4) == 0)
+        {
+            idat.insert(idat.end(), body, body + size);
+        }
+        else if (memcmp(type, "IEND", 4) == 0)
+        {
+            sawEnd = true;
+        }
+        pos += 12 + size;
+    }
+    if (!sawEnd)
+        return false;
+
+    const size_t rowBytes = static_cast<size_t>(width) * 3 + 1;
+    std::vector<uint8_t> raw(rowBytes * height);
+    uLongf rawSize = static_cast<uLongf>(raw.size());
+    if (uncompress(raw.data(), &rawSize, idat.data(), static_cast<uLong>(idat.size())) != Z_OK || rawSize != raw.size())
+        return false;
+
+    rgb.assign(static_cast<size_t>(width) * height * 3, 0);
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* row = &raw[y * rowBytes];
+        if (row[0] != 2)
+            return false;
+        for (size_t i = 0; i + 1 < rowBytes; i++)
+        {
+            const uint8_t above = y > 0 ? rgb[(y - 1) * (rowBytes - 1) + i] : 0;
+            rgb[y * (rowBytes - 1) + i] = static_cast<uint8_t>(row[i + 1] + above);
+        }
+    }
+    return true;
+}
+
+std::vector<uint8_t> ExpectedRgb(const Frame& frame, bool bottomUp)
+{
+    std::vector<uint8_t> rgb;
+    for (int y = 0; y < frame.height; y++)
+    {
+        const int srcY = bottomUp ? frame.height - 1 - y : y;
+        for (int x = 0; x < frame.width; x++)
+        {
+            const uint8_t* p = frame.bgra.data() + (static_cast<size_t>(srcY) * frame.width + x) * 4;
+            rgb.push_back(p[2]);
+            rgb.push_back(p[1]);
+            rgb.push_back(p[0]);
+        }
+    }
+    return rgb;
+}
+
+} // namespace
+
+NATIVE_TEST(QoiRoundTrips)
+{
+    const Frame frame = MakeFrame(97, 61, 5);
+    std::vector<uint8_t> encoded;
+    CHECK(EncodeQoi(frame.bgra.data(), frame.width * 4, frame.width, frame.height, encoded));
+
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;
+    CHECK(DecodeQoi(encoded, width, height, rgb));
+    CHECK_EQ(97, width);
+    CHECK_EQ(61, height);
+    CHECK(rgb == ExpectedRgb(frame, false));
+}
+
+NATIVE_TEST(QoiLongRunsSplitAt62)
+{
+    Frame frame{ 200, 3, std::vector<uint8_t>(200 * 3 * 4, 0) };
+    std::vector<uint8_t> encoded;
+    CHECK(EncodeQoi(frame.bgra.data(), frame.width * 4, frame.width, frame.height, encoded));
+
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;
+    CHECK(DecodeQoi(encoded, width, height, rgb));
+    CHECK(rgb == ExpectedRgb(frame, false));
+    // 600 black pixels continue the implicit black start: ten runs only.
+    CHECK_EQ(14u + 10u + 8u, encoded.size());
+}
+
+NATIVE_TEST(PngRoundTrips)
+{
+    const Frame frame = MakeFrame(131, 47, 9);
+    std::vector<uint8_t> encoded;
+    CHECK(EncodePng(frame.bgra.data(), frame.width * 4, frame.width, frame.height, encoded));
+
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;
+    CHECK(DecodePng(encoded, width, height, rgb));
+    CHECK_EQ(131, width);
+    CHECK_EQ(47, height);
+    CHECK(rgb == ExpectedRgb(frame, false));
+}
+
+NATIVE_TEST(NegativeStrideFlipsBottomUpReadbacks)
+{
+    const Frame frame = MakeFrame(64, 32, 13);
+    const ptrdiff_t stride = frame.width * 4;
+    const uint8_t* lastRow = frame.bgra.data() + (frame.height - 1) * stride;
+
+    std::vector<uint8_t> png;
+    std::vector<uint8_t> qoi;
+    CHECK(EncodePng(lastRow, -stride, frame.width, frame.height, png));
+    CHECK(EncodeQoi(lastRow, -stride, frame.width, frame.height, qoi));
+
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgb;
+    CHECK(DecodePng(png, width, height, rgb));
+    CHECK(rgb == ExpectedRgb(frame, true));
+    CHECK(DecodeQoi(qoi, width, height, rgb));
+    CHECK(rgb == ExpectedRgb(frame, true));
+}
+
+NATIVE_TEST(RejectsEmptyImages)
+{
+    std::vector<uint8_t> encoded;
+    uint8_t pixel[4] = {};
+    CHECK(!EncodePng(pixel, 4, 0, 1, encoded));
+    CHECK(!EncodeQoi(pixel, 4, 1, 0, encoded));
+    CHECK(!EncodeImage(ImageFormat::Png, nullptr, 4, 1, 1, encoded));
+}
+
+NATIVE_TEST_MAIN()
@@ -0,0 +1,261 @@
+#include "NativeLog.h"
+#include "NativeTest.h"
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace aes_native;
+
+namespace {
+
+LogConfig MakeConfig(const char* path)
+{
+    std::remove(path);
+    LogConfig config;
+    config.path = path;
+    config.level = LogLevel::Info;
+    config.max_lines_per_second = 0;
+    return config;
+}
+
+// Log lines of the file, without the header line.
+std::vector<std::string> ReadLines(const char* path)
+{
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.rfind("---", 0) != 0)
+            lines.push_back(line);
+    }
+    return lines;
+}
+
+int CountContaining(const std::vector<std::string>& lines, const char* text)
+{
+    int count = 0;
+    for (const std::string& line : lines)
+        count += line.find(text) != std::string::npos ? 1 : 0;
+    return count;
+}
+
+} // namespace
+
+NATIVE_TEST(WritesFormattedLinesWithLevelAndCategory)
+{
+    const char* path = "native_log_format.log";
+    {
+        NativeLog log(MakeConfig(path));
+        log.Write(LogLevel::Info, "capture", "target=0x%x size=%dx%d\n", 0x2a, 640, 480);
+        log.Write(LogLevel::Error, "x11", "failed");
+        log.Flush();
+    }
+
+    const std::vector<std::string> lines = ReadLines(path);
+    CHECK_EQ(2u, lines.size());
+    CHECK_EQ(1, CountContaining(lines, "info  capture: target=0x2a size=640x480"));
+    CHECK_EQ(1, CountContaining(lines, "error x11: failed"));
+    // The trailing newline of the message is not doubled.
+    CHECK(lines.size() == 2 && lines[0].back() == '0');
+    std::remove(path);
+}
+
+NATIVE_TEST(FiltersByLevelAndCategory)
+{
+    const char* path = "native_log_filter.log";
+    LogConfig config = MakeConfig(path);
+    config.level = LogLevel::Warn;
+    config.categories = "capture, present,-noisy";
+    {
+        NativeLog log(config);
+        CHECK(log.Enabled(LogLevel::Warn, "capture"));
+        CHECK(!log.Enabled(LogLevel::Info, "capture"));
+        CHECK(!log.Enabled(LogLevel::Error, "window"));
+        log.Write(LogLevel::Error, "present", "kept");
+        log.Write(LogLevel::Debug, "present", "too verbose");
+        log.Write(LogLevel::Error, "window", "not enabled");
+        log.Flush();
+    }
+
+    const std::vector<std::string> lines = ReadLines(path);
+    CHECK_EQ(1u, lines.size());
+    CHECK_EQ(1, CountContaining(lines, "kept"));
+
+    config.categories = "*,-noisy";
+    NativeLog all(config);
+    CHECK(all.Enabled(LogLevel::Error, "window"));
+    CHECK(!all.Enabled(LogLevel::Error, "noisy"));
+    std::remove(path);
+}
+
+NATIVE_TEST(ParsesLevelNames)
+{
+    LogLevel level = LogLevel::Info;
+    CHECK(ParseLogLevel("trace", &level));
+    CHECK(level == LogLevel::Trace);
+    CHECK(ParseLogLevel("off", &level));
+    CHECK(level == LogLevel::Off);
+    CHECK(!ParseLogLevel("loud", &level));
+    CHECK(level == LogLevel::Off);
+}
+
+NATIVE_TEST(RateLimitsRepeatedCallSites)
+{
+    const char* path = "native_log_rate.log";
+    LogConfig config = MakeConfig(path);
+    config.max_lines_per_second = 5;
+    {
+        NativeLog log(config);
+        for (int i = 0; i < 200; i++)
+            log.Write(LogLevel::Info, "capture", "frame %d", i);
+        log.Write(LogLevel::Info, "capture", "other site");
+        log.Flush();
+        // A run that straddles a second boundary may let a second window in.
+        CHECK(log.Suppressed() >= 190);
+    }
+
+    const std::vector<std::string> lines = ReadLines(path);
+    const int frames = CountContaining(lines, "frame ");
+    CHECK(frames >= 5 && frames <= 10);
+    CHECK_EQ(1, CountContaining(lines, "other site"));
+    std::remove(path);
+}
+
+NATIVE_TEST(PreformattedMessagesRateLimitPerMessage)
+{
+    const char* path = "native_log_message.log";
+    LogConfig config = MakeConfig(path);
+    config.max_lines_per_second = 3;
+    {
+        NativeLog log(config);
+        for (int i = 0; i < 20; i++)
+        {
+            log.WriteMessage(LogLevel::Info, "wgc", "[WGC_NATIVE] frame arrived\n");
+            log.WriteMessage(LogLevel::Info, "wgc", "[WGC_NATIVE] swapchain present\n");
+        }
+        log.Flush();
+    }
+
+    const std::vector<std::string> lines = ReadLines(path);
+    const int arrived = CountContaining(lines, "frame arrived");
+    const int presented = CountContaining(lines, "swapchain present");
+    CHECK(arrived >= 3 && arrived <= 6);
+    CHECK(presented >= 3 && presented <= 6);
+    std::remove(path);
+}
+
+NATIVE_TEST(SharedBufferMessagesRateLimitPerKey)
+{
+    const char* path = "native_log_keyed.log";
+    LogConfig config = MakeConfig(path);
+    config.max_lines_per_second = 3;
+    static const char kFactoryKey[] = "factory";
+    static const char kDeviceKey[] = "device";
+    {
+        NativeLog log(config);
+        char buffer[64];
+        for (int i = 0; i < 20; i++)
+        {
+            snprintf(buffer, sizeof(buffer), "factory created %d", i);
+            log.WriteMessage(LogLevel::Info, "wgc", buffer, kFactoryKey);
+        }
+        snprintf(buffer, sizeof(buffer), "device failed 0x%08X", 0x887A0004u);
+        log.WriteMessage(LogLevel::Info, "wgc", buffer, kDeviceKey);
+        log.Flush();
+    }
+
+    // The burst on one key does not use up the other's budget.
+    const std::vector<std::string> lines = ReadLines(path);
+    const int factories = CountContaining(lines, "factory created");
+    CHECK(factories >= 3 && factories <= 6);
+    CHECK_EQ(1, CountContaining(lines, "device failed"));
+    std::remove(path);
+}
+
+NATIVE_TEST(ConcurrentProducersLoseNothingUnaccounted)
+{
+    const char* path = "native_log_concurrent.log";
+    LogConfig config = MakeConfig(path);
+    config.capacity = 64;
+    const int kThreads = 4;
+    const int kLines = 2000;
+    uint64_t dropped = 0;
+    {
+        NativeLog log(config);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++)
+        {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < kLines; i++)
+                    log.Write(LogLevel::Info, "capture", "thread %d line %d end", t, i);
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+        log.Flush();
+        dropped = log.Dropped();
+    }
+
+    const std::vector<std::string> lines = ReadLines(path);
+    CHECK_EQ(static_cast<uint64_t>(kThreads * kLines), lines.size() + dropped);
+    // Every line that made it is whole.
+    CHECK_EQ(static_cast<int>(lines.size()), CountContaining(lines, " end"));
+    std::remove(path);
+}
+
+NATIVE_TEST(IdleWriterWakesForEachLine)
+{
+    // The writer sleeps without a timeout once it runs dry; a lost wakeup
+    // would leave Flush spinning here.
+    const char* path = "native_log_idle.log";
+    {
+        NativeLog log(MakeConfig(path));
+        for (int i = 0; i < 100; i++)
+        {
+            log.Write(LogLevel::Info, "capture", "idle %d", i);
+            log.Flush();
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+    }
+
+    CHECK_EQ(100u, ReadLines(path).size());
+    std::remove(path);
+}
+
+NATIVE_TEST(TimestampsAreMonotonic)
+{
+    const char* path = "native_log_time.log";
+    {
+        NativeLog log(MakeConfig(path));
+        for (int i = 0; i < 50; i++)
+            log.Write(LogLevel::Info, "capture", "tick %d", i);
+        log.Flush();
+    }
+
+    double previous = -1.0;
+    bool ordered = true;
+    for (const std::string& line : ReadLines(path))
+    {
+        const double seconds = std::stod(line.substr(1));
+        ordered = ordered && seconds >= previous;
+        previous = seconds;
+    }
+    CHECK(ordered);
+    CHECK(previous >= 0.0);
+    std::remove(path);
+}
+
+NATIVE_TEST(DisabledWithoutPath)
+{
+    LogConfig config;
+    NativeLog log(config);
+    CHECK(!log.Enabled(LogLevel::Error, "capture"));
+    log.Write(LogLevel::Error, "capture", "nowhere");
+    log.Flush();
+    CHECK_EQ(0u, log.Dropped());
+}
+
+NATIVE_TEST_MAIN()
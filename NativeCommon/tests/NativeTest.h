@@ -0,0 +1,107 @@
+#pragma once
+
+// Minimal self-registering test harness for the NativeCommon headers, so the
+// native tests build with nothing but a C++17 compiler and CMake.
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+namespace native_test {
+
+struct TestCase
+{
+    const char* name;
+    std::function<void()> body;
+};
+
+inline std::vector<TestCase>& Registry()
+{
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int& FailureCount()
+{
+    static int failures = 0;
+    return failures;
+}
+
+struct Registrar
+{
+    Registrar(const char* name, std::function<void()> body)
+    {
+        Registry().push_back({ name, std::move(body) });
+    }
+};
+
+inline int RunAll()
+{
+    int failedTests = 0;
+    for (const TestCase& test : Registry())
+    {
+        const int before = FailureCount();
+        test.body();
+        const bool passed = FailureCount() == before;
+        if (!passed)
+            failedTests++;
+        std::printf("[%s] %s\n", passed ? "PASS" : "FAIL", test.name);
+    }
+
+    std::printf("%zu tests, %d failed\n", Registry().size(), failedTests);
+    return failedTests == 0 ? 0 : 1;
+}
+
+} // namespace native_test
+
+#define NATIVE_TEST_CONCAT_INNER(a, b) a##b
+#define NATIVE_TEST_CONCAT(a, b) NATIVE_TEST_CONCAT_INNER(a, b)
+
+#define NATIVE_TEST(name)                                                                        \
+    static void name();                                                                          \
+    static native_test::Registrar NATIVE_TEST_CONCAT(name, _registrar)(#name, name);             \
+    static void name()
+
+#define CHECK(expr)                                                                              \
+    do                                                                                           \
+    {                                                                                            \
+        if (!(expr))                                                                             \
+        {                                                                                        \
+            std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr);               \
+            native_test::FailureCount()++;                                                       \
+        }                                                                                        \
+    } while (0)
+
+#define CHECK_EQ(expected, actual)                                                               \
+    do                                                                                           \
+    {                                                                                            \
+        const auto checkExpected = (expected);                                                   \
+        const auto checkActual = (actual);                                                       \
+        if (!(checkExpected == checkActual))                                                     \
+        {                                                                                        \
+            std::printf("  %s:%d: CHECK_EQ(%s, %s) failed: %lld vs %lld\n", __FILE__, __LINE__,  \
+                        #expected, #actual, static_cast<long long>(checkExpected),               \
+                        static_cast<long long>(checkActual));                                    \
+            native_test::FailureCount()++;                                                       \
+        }                                                                                        \
+    } while (0)
+
+#define CHECK_NEAR(expected, actual, tolerance)                                                  \
+    do                                                                                           \
+    {                                                                                            \
+        const double checkExpected = (expected);                                                 \
+        const double checkActual = (actual);                                                     \
+        if (!(std::fabs(checkExpected - checkActual) <= (tolerance)))                            \
+        {                                                                                        \
+            std::printf("  %s:%d: CHECK_NEAR(%s, %s) failed: %g vs %g\n", __FILE__, __LINE__,    \
+                        #expected, #actual, checkExpected, checkActual);                         \
+            native_test::FailureCount()++;                                                       \
+        }                                                                                        \
+    } while (0)
+
+#define NATIVE_TEST_MAIN()                                                                       \
+    int main()                                                                                   \
+    {                                                                                            \
+        return native_test::RunAll();                                                            \
+    }
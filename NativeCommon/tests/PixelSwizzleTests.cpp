@@ -0,0 +1,80 @@
+#include "PixelSwizzle.h"
+#include "NativeTest.h"
+
+#include <random>
+#include <vector>
+
+using namespace aes_native;
+
+namespace {
+
+std::vector<uint8_t> MakeNoise(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> bytes(size);
+    std::mt19937 rng(seed);
+    for (uint8_t& byte : bytes)
+        byte = static_cast<uint8_t>(rng());
+    return bytes;
+}
+
+} // namespace
+
+NATIVE_TEST(RgbaSwapsRedAndBlue)
+{
+    const uint8_t rgba[8] = { 10, 20, 30, 40, 50, 60, 70, 80 };
+    uint8_t bgra[8] = {};
+    CopyRowsToBgra(rgba, 8, bgra, 8, 2, 1, true);
+    const uint8_t expected[8] = { 30, 20, 10, 40, 70, 60, 50, 80 };
+    CHECK(memcmp(expected, bgra, sizeof(expected)) == 0);
+}
+
+NATIVE_TEST(SimdSwizzleMatchesScalarWithPaddedStrides)
+{
+    const int width = 37;
+    const int height = 11;
+    const size_t srcStride = width * 4 + 12;
+    const size_t dstStride = width * 4 + 4;
+    const std::vector<uint8_t> src = MakeNoise(srcStride * height, 3);
+    std::vector<uint8_t> simd(dstStride * height, 0xcd);
+    std::vector<uint8_t> scalar(dstStride * height, 0xcd);
+
+    CopyRowsToBgra(src.data(), srcStride, simd.data(), dstStride, width, height, true, true);
+    CopyRowsToBgra(src.data(), srcStride, scalar.data(), dstStride, width, height, true, false);
+    CHECK(simd == scalar);
+    // Row padding in the destination is left alone.
+    CHECK_EQ(0xcd, simd[width * 4]);
+    CHECK_EQ(src[2], simd[0]);
+    CHECK_EQ(src[0], simd[2]);
+}
+
+NATIVE_TEST(BgraCopiesRowsUnchanged)
+{
+    const int width = 16;
+    const int height = 5;
+    const size_t packed = width * 4;
+    const std::vector<uint8_t> src = MakeNoise((packed + 8) * height, 9);
+
+    std::vector<uint8_t> dst(packed * height);
+    CopyRowsToBgra(src.data(), packed + 8, dst.data(), packed, width, height, false);
+    bool same = true;
+    for (int y = 0; y < height; y++)
+        same = same && memcmp(&src[(packed + 8) * y], &dst[packed * y], packed) == 0;
+    CHECK(same);
+
+    // Tightly packed on both sides: one block copy.
+    std::vector<uint8_t> block(packed * height);
+    CopyRowsToBgra(src.data(), packed, block.data(), packed, width, height, false);
+    CHECK(memcmp(src.data(), block.data(), block.size()) == 0);
+}
+
+NATIVE_TEST(EmptyFrameWritesNothing)
+{
+    uint8_t dst[4] = { 1, 2, 3, 4 };
+    const uint8_t src[4] = { 9, 9, 9, 9 };
+    CopyRowsToBgra(src, 4, dst, 4, 0, 1, true);
+    CopyRowsToBgra(src, 4, dst, 4, 1, 0, false);
+    CHECK_EQ(1, dst[0]);
+    CHECK_EQ(4, dst[3]);
+}
+
+NATIVE_TEST_MAIN()
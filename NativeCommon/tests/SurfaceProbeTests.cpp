@@ -0,0 +1,74 @@
+#include "SurfaceProbe.h"
+#include "NativeTest.h"
+
+using namespace aes_native;
+
+namespace {
+
+const uint64_t kFrameNs = 1000000000ULL / 60;
+
+// frames frames of w x h damage each, starting at t = 1 s.
+SurfaceProbeSample Probe(uint64_t windowArea, int frames, uint64_t w, uint64_t h)
+{
+    SurfaceProbeSample sample;
+    sample.window_area = windowArea;
+    for (int i = 0; i < frames; i++)
+        sample.OnDamage(1000000000ULL + kFrameNs * i, w * h);
+    return sample;
+}
+
+} // namespace
+
+NATIVE_TEST(SplitNotifiesCountAsOneFrame)
+{
+    SurfaceProbeSample sample;
+    sample.OnDamage(1000000000ULL, 100);
+    sample.OnDamage(1001000000ULL, 100);
+    sample.OnDamage(1003900000ULL, 100);
+    sample.OnDamage(1000000000ULL + kFrameNs, 100);
+    CHECK_EQ(2u, sample.frames);
+    CHECK_EQ(400u, sample.damaged_pixels);
+}
+
+NATIVE_TEST(ChildWinsWhenTopLevelIncludesItsDamage)
+{
+    // The top-level reports the child's frames plus a status bar.
+    const SurfaceProbeSample samples[] = {
+        Probe(1280 * 800, 30, 1280, 720),
+        Probe(1280 * 720, 30, 1280, 720),
+    };
+    CHECK_EQ(1, PickRenderSurface(samples, 2));
+}
+
+NATIVE_TEST(ChildWinsWhenTopLevelIsQuiet)
+{
+    const SurfaceProbeSample samples[] = {
+        Probe(1280 * 800, 1, 1280, 800),
+        Probe(1024 * 768, 30, 1024, 768),
+    };
+    CHECK_EQ(1, PickRenderSurface(samples, 2));
+}
+
+NATIVE_TEST(SmallBusyWidgetDoesNotWin)
+{
+    // A spinner redraws as often as the game but covers a fraction of it.
+    const SurfaceProbeSample samples[] = {
+        Probe(1280 * 800, 30, 1280, 720),
+        Probe(32 * 32, 60, 32, 32),
+        Probe(1280 * 720, 30, 1280, 720),
+    };
+    CHECK_EQ(2, PickRenderSurface(samples, 3));
+}
+
+NATIVE_TEST(NoPickUntilEnoughFrames)
+{
+    const SurfaceProbeSample samples[] = {
+        Probe(1280 * 800, 2, 1280, 800),
+        Probe(1280 * 720, 0, 0, 0),
+    };
+    CHECK_EQ(-1, PickRenderSurface(samples, 2));
+    CHECK_EQ(0, PickRenderSurface(samples, 2, 2));
+    CHECK_EQ(-1, PickRenderSurface(samples, 0));
+}
+
+NATIVE_TEST_MAIN()
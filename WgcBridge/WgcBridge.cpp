@@ -1,4 +1,8 @@
 #include "pch.h"
+#include "ContentBarDetector.h"
+#include "FrameLayout.h"
+#include "NativeLog.h"
+#include "PixelSwizzle.h"
 #include <d3dcompiler.h>
 #include <atomic>
 #include <algorithm>
@@ -6,6 +10,7 @@
 #include <dxgi1_2.h>
 #include <thread>
 #include <chrono>
+#include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <filesystem>
@@ -13,43 +18,40 @@
 #include <string>
 #include <sddl.h>
 
-static void FileDebugLog(char const* message)
+// AES_LACRIMA_LOG_FILE, else %TEMP%\aes_injection_<pid>.log, unless
+// AES_NATIVE_LOG_FILE overrides both.
+static std::string DefaultLogPath()
 {
     char logPath[MAX_PATH];
     DWORD logLen = GetEnvironmentVariableA("AES_LACRIMA_LOG_FILE", logPath, MAX_PATH);
     if (logLen > 0 && logLen < MAX_PATH)
-    {
-        HANDLE logFile = CreateFileA(logPath, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (logFile != INVALID_HANDLE_VALUE)
-        {
-            SetFilePointer(logFile, 0, nullptr, FILE_END);
-            DWORD written = 0;
-            WriteFile(logFile, message, static_cast<DWORD>(strlen(message)), &written, nullptr);
-            WriteFile(logFile, "\r\n", 2, &written, nullptr);
-            CloseHandle(logFile);
-            return;
-        }
-    }
+        return std::string(logPath);
 
     char tempPath[MAX_PATH];
     DWORD len = GetEnvironmentVariableA("TEMP", tempPath, MAX_PATH);
     if (len == 0 || len >= MAX_PATH)
-        return;
+        return std::string();
 
     std::string filePath(tempPath);
     filePath += "\\aes_injection_";
     filePath += std::to_string(GetCurrentProcessId());
     filePath += ".log";
+    return filePath;
+}
 
-    HANDLE file = CreateFileA(filePath.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-    if (file == INVALID_HANDLE_VALUE)
-        return;
+// Kept for the life of the process; DLL detach runs under the loader lock
+// and must not wait on the writer thread.
+static aes_native::NativeLog& BridgeLog()
+{
+    static aes_native::NativeLog* log =
+        new aes_native::NativeLog(aes_native::LogConfig::FromEnvironment(DefaultLogPath().c_str()));
+    return *log;
+}
 
-    SetFilePointer(file, 0, nullptr, FILE_END);
-    DWORD written = 0;
-    WriteFile(file, message, static_cast<DWORD>(strlen(message)), &written, nullptr);
-    WriteFile(file, "\r\n", 2, &written, nullptr);
-    CloseHandle(file);
+// key is the rate-limit key; see NativeLog::WriteMessage.
+static void FileDebugLog(char const* message, void const* key = nullptr)
+{
+    BridgeLog().WriteMessage(aes_native::LogLevel::Info, "wgc", message, key);
 }
 
 static void DebugLog(char const* message)
@@ -58,6 +60,19 @@ static void DebugLog(char const* message)
     FileDebugLog(message);
 }
 
+// Formatted DebugLog; the format string is the rate-limit key, so each call
+// site keeps its own budget.
+static void DebugLogF(char const* fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    _vsnprintf_s(buf, sizeof(buf), _TRUNCATE, fmt, args);
+    va_end(args);
+    OutputDebugStringA(buf);
+    FileDebugLog(buf, fmt);
+}
+
 static uint64_t QueryQpcTicks()
 {
     LARGE_INTEGER counter{};
@@ -228,6 +243,7 @@ struct CaptureSession
     std::atomic<int> dcompPillarboxTop{ 0 };
     std::atomic<int> dcompPillarboxBottom{ 0 };
     std::atomic<int> dcompPillarboxDetectCounter{ 0 };
+    aes_native::ContentBarTracker pillarboxTracker{};
     rt::com_ptr<ID3D11Texture2D> pillarboxStagingTexture;
     int pillarboxStagingWidth = 0;
     int pillarboxStagingHeight = 0;
@@ -529,9 +545,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(This, pDevice, pDesc, ppSwapChain);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_CreateSwapChain called hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_CreateSwapChain called hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
         if (SUCCEEDED(hr) && ppSwapChain && *ppSwapChain)
         {
             if (HookSwapChain(*ppSwapChain))
@@ -551,9 +565,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(This, pDevice, hWnd, pDesc, pFullscreenDesc, pRestrictToOutput, ppSwapChain);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_CreateSwapChainForHwnd called hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_CreateSwapChainForHwnd called hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
         if (SUCCEEDED(hr) && ppSwapChain && *ppSwapChain)
         {
             IDXGISwapChain* baseSwapChain = static_cast<IDXGISwapChain*>(*ppSwapChain);
@@ -574,9 +586,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(This, pDevice, pWindow, pDesc, pRestrictToOutput, ppSwapChain);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_CreateSwapChainForCoreWindow called hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_CreateSwapChainForCoreWindow called hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
         if (SUCCEEDED(hr) && ppSwapChain && *ppSwapChain)
         {
             IDXGISwapChain* baseSwapChain = static_cast<IDXGISwapChain*>(*ppSwapChain);
@@ -634,9 +644,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(riid, ppFactory);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_CreateDXGIFactory called hr=0x%08X factory=%p\n", static_cast<unsigned>(hr), ppFactory ? *ppFactory : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_CreateDXGIFactory called hr=0x%08X factory=%p\n", static_cast<unsigned>(hr), ppFactory ? *ppFactory : nullptr);
         if (SUCCEEDED(hr) && ppFactory && *ppFactory)
             HookDxgiFactory(reinterpret_cast<IUnknown*>(*ppFactory));
 
@@ -651,9 +659,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(riid, ppFactory);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_CreateDXGIFactory1 called hr=0x%08X factory=%p\n", static_cast<unsigned>(hr), ppFactory ? *ppFactory : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_CreateDXGIFactory1 called hr=0x%08X factory=%p\n", static_cast<unsigned>(hr), ppFactory ? *ppFactory : nullptr);
         if (SUCCEEDED(hr) && ppFactory && *ppFactory)
             HookDxgiFactory(reinterpret_cast<IUnknown*>(*ppFactory));
 
@@ -668,9 +674,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(Flags, riid, ppFactory);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_CreateDXGIFactory2 called hr=0x%08X factory=%p\n", static_cast<unsigned>(hr), ppFactory ? *ppFactory : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_CreateDXGIFactory2 called hr=0x%08X factory=%p\n", static_cast<unsigned>(hr), ppFactory ? *ppFactory : nullptr);
         if (SUCCEEDED(hr) && ppFactory && *ppFactory)
             HookDxgiFactory(reinterpret_cast<IUnknown*>(*ppFactory));
 
@@ -737,9 +741,7 @@ struct CaptureSession
                 return true;
         }
 
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] HookSwapChain called swapChain=%p\n", swapChain);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] HookSwapChain called swapChain=%p\n", swapChain);
 
         void* originalPresent = vtable[8];
         if (!originalPresent)
@@ -811,35 +813,7 @@ struct CaptureSession
         g_injectionHeader->FrameCounter = currentCounter;
         g_injectionHeader->Magic = InjectionMagic;
 
-        if (isBgra && dstStride == rowBytes)
-        {
-            memcpy(g_injectionPixels, src, totalSize);
-        }
-        else
-        {
-            for (int y = 0; y < height; y++)
-            {
-                uint8_t const* srcRow = src + static_cast<size_t>(rowBytes) * y;
-                uint8_t* dstRow = g_injectionPixels + dstStride * y;
-
-                if (isBgra)
-                {
-                    memcpy(dstRow, srcRow, dstStride);
-                }
-                else
-                {
-                    for (int x = 0; x < width; x++)
-                    {
-                        dstRow[0] = srcRow[2]; // B
-                        dstRow[1] = srcRow[1]; // G
-                        dstRow[2] = srcRow[0]; // R
-                        dstRow[3] = srcRow[3]; // A
-                        srcRow += 4;
-                        dstRow += 4;
-                    }
-                }
-            }
-        }
+        aes_native::CopyRowsToBgra(src, rowBytes, g_injectionPixels, dstStride, width, height, !isBgra);
 
         g_injectionHeader->Sequence2 = currentCounter;
         g_injectionHeader->Sequence1 = currentCounter;
@@ -1254,9 +1228,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(pAdapter, DriverType, Software, Flags, pFeatureLevels, FeatureLevels, SDKVersion, pSwapChainDesc, ppSwapChain, ppDevice, pFeatureLevel, ppImmediateContext);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_D3D11CreateDeviceAndSwapChain returned hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_D3D11CreateDeviceAndSwapChain returned hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
         if (SUCCEEDED(hr) && ppSwapChain && *ppSwapChain)
         {
             if (HookSwapChain(*ppSwapChain))
@@ -1306,9 +1278,7 @@ struct CaptureSession
             return E_FAIL;
 
         HRESULT hr = originalFn(pAdapter, DriverType, Software, Flags, pFeatureLevels, FeatureLevels, SDKVersion, pSwapChainDesc, ppSwapChain, ppDevice, pFeatureLevel, ppImmediateContext);
-        char buf[256];
-        _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] Hooked_D3D11CreateDeviceAndSwapChain1 returned hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
-        DebugLog(buf);
+        DebugLogF("[WGC_NATIVE] Hooked_D3D11CreateDeviceAndSwapChain1 returned hr=0x%08X ppSwapChain=%p\n", static_cast<unsigned>(hr), ppSwapChain ? *ppSwapChain : nullptr);
         if (SUCCEEDED(hr) && ppSwapChain && *ppSwapChain)
         {
             IDXGISwapChain* baseSwapChain = static_cast<IDXGISwapChain*>(*ppSwapChain);
@@ -1328,7 +1298,8 @@ struct CaptureSession
         {
             SetDirectCompositionStatus(message);
             OutputDebugStringA("[WGC_NATIVE] DirectComposition failure: ");
-            FileDebugLog(message);
+            static char const kFailureKey[] = "dcomp-failure";
+            FileDebugLog(message, kFailureKey);
             OutputDebugStringA(message);
             OutputDebugStringA("\n");
         }
@@ -1601,19 +1572,6 @@ struct CaptureSession
         dcompPillarboxDetectCounter.store(0, std::memory_order_relaxed);
     }
 
-    static void ApplyHalfTexelInset(float& u0, float& v0, float& u1, float& v1, int texWidth, int texHeight)
-    {
-        if (texWidth <= 1 || texHeight <= 1)
-            return;
-
-        const float du = 0.5f / static_cast<float>(texWidth);
-        const float dv = 0.5f / static_cast<float>(texHeight);
-        u0 = (std::min)(u1 - du, u0 + du);
-        v0 = (std::min)(v1 - dv, v0 + dv);
-        u1 = (std::max)(u0 + du, u1 - du);
-        v1 = (std::max)(v0 + dv, v1 - dv);
-    }
-
     void QueueDirectCompositionFrame(ID3D11Texture2D* texture, int width, int height)
     {
         if (!presentationHwnd || !texture || !dcompWorkerRunning.load())
@@ -1880,100 +1838,39 @@ struct CaptureSession
         if (useBlend && !EnsureDcompFrameGenPixelShader())
             return;
 
-        float viewAspect = renderHeight > 0 ? static_cast<float>(renderWidth) / static_cast<float>(renderHeight) : 1.0f;
-        float frameAspect = height > 0 ? static_cast<float>(width) / static_cast<float>(height) : 1.0f;
-        float left = -1.0f;
-        float right = 1.0f;
-        float top = 1.0f;
-        float bottom = -1.0f;
-        float u0 = 0.0f;
-        float v0 = 0.0f;
-        float u1 = 1.0f;
-        float v1 = 1.0f;
-        const int fullWidth = dcompSourceFullWidth > 0 ? dcompSourceFullWidth : width;
-        const int fullHeight = dcompSourceFullHeight > 0 ? dcompSourceFullHeight : height;
-        const bool useFullCaptureTexture = dcompCaptureSrv != nullptr;
-        if (useFullCaptureTexture &&
-            dcompSourceCropW > 0 && dcompSourceCropH > 0 && fullWidth > 0 && fullHeight > 0)
-        {
-            u0 = static_cast<float>(dcompSourceCropX) / static_cast<float>(fullWidth);
-            v0 = static_cast<float>(dcompSourceCropY) / static_cast<float>(fullHeight);
-            u1 = static_cast<float>(dcompSourceCropX + dcompSourceCropW) / static_cast<float>(fullWidth);
-            v1 = static_cast<float>(dcompSourceCropY + dcompSourceCropH) / static_cast<float>(fullHeight);
-        }
-
-        const float uSpan = u1 - u0;
-        const float vSpan = v1 - v0;
-        const int contentWidth = dcompSourceCropW > 0 ? dcompSourceCropW : width;
-        const int contentHeight = dcompSourceCropH > 0 ? dcompSourceCropH : height;
-
-        int stretch = dcompStretch.load();
-
-        if (stretch == 1)
-        {
-            if (frameAspect > viewAspect)
-            {
-                float scaleY = viewAspect / frameAspect;
-                top = scaleY;
-                bottom = -scaleY;
-            }
-            else
-            {
-                float scaleX = frameAspect / viewAspect;
-                left = -scaleX;
-                right = scaleX;
-            }
-        }
-        else if (stretch == 2)
-        {
-            if (frameAspect > viewAspect)
-            {
-                float visibleRatio = viewAspect / frameAspect;
-                float crop = (1.0f - visibleRatio) * 0.5f;
-                u0 += crop * uSpan;
-                u1 -= crop * uSpan;
-            }
-            else
-            {
-                float visibleRatio = frameAspect / viewAspect;
-                float crop = (1.0f - visibleRatio) * 0.5f;
-                v0 += crop * vSpan;
-                v1 -= crop * vSpan;
-            }
-        }
+        aes_native::QuadLayoutInput layoutInput;
+        layoutInput.frame_w = width;
+        layoutInput.frame_h = height;
+        layoutInput.view_w = renderWidth;
+        layoutInput.view_h = renderHeight;
+        layoutInput.texture_w = dcompSourceFullWidth;
+        layoutInput.texture_h = dcompSourceFullHeight;
+        layoutInput.crop_x = dcompSourceCropX;
+        layoutInput.crop_y = dcompSourceCropY;
+        layoutInput.crop_w = dcompSourceCropW;
+        layoutInput.crop_h = dcompSourceCropH;
+        layoutInput.crop_in_texture = dcompCaptureSrv != nullptr;
+        layoutInput.stretch = dcompStretch.load();
 
         static constexpr int kContentBarWarmupFrames = 30;
         if (dcompPillarboxCropEnabled.load(std::memory_order_relaxed) &&
-            frameCount.load(std::memory_order_relaxed) >= kContentBarWarmupFrames &&
-            contentWidth > 0 && contentHeight > 0)
+            frameCount.load(std::memory_order_relaxed) >= kContentBarWarmupFrames)
         {
-            const int cropLeft = dcompPillarboxLeft.load(std::memory_order_relaxed);
-            const int cropRight = dcompPillarboxRight.load(std::memory_order_relaxed);
-            const int cropTop = dcompPillarboxTop.load(std::memory_order_relaxed);
-            const int cropBottom = dcompPillarboxBottom.load(std::memory_order_relaxed);
-            if (cropLeft > 0 || cropRight > 0 || cropTop > 0 || cropBottom > 0)
-            {
-                const float insetLeft = (static_cast<float>(cropLeft) / static_cast<float>(contentWidth)) * uSpan;
-                const float insetRight = (static_cast<float>(cropRight) / static_cast<float>(contentWidth)) * uSpan;
-                const float insetTop = (static_cast<float>(cropTop) / static_cast<float>(contentHeight)) * vSpan;
-                const float insetBottom = (static_cast<float>(cropBottom) / static_cast<float>(contentHeight)) * vSpan;
-                u0 = (std::min)(1.0f, (std::max)(0.0f, u0 + insetLeft));
-                u1 = (std::max)(0.0f, (std::min)(1.0f, u1 - insetRight));
-                v0 = (std::min)(1.0f, (std::max)(0.0f, v0 + insetTop));
-                v1 = (std::max)(0.0f, (std::min)(1.0f, v1 - insetBottom));
-                if (u1 - u0 > 0.02f && v1 - v0 > 0.02f)
-                {
-                    left = -1.0f;
-                    right = 1.0f;
-                    top = 1.0f;
-                    bottom = -1.0f;
-                }
-            }
+            layoutInput.bars.left = dcompPillarboxLeft.load(std::memory_order_relaxed);
+            layoutInput.bars.top = dcompPillarboxTop.load(std::memory_order_relaxed);
+            layoutInput.bars.right = dcompPillarboxRight.load(std::memory_order_relaxed);
+            layoutInput.bars.bottom = dcompPillarboxBottom.load(std::memory_order_relaxed);
         }
 
-        const int insetTexWidth = (std::max)(1, static_cast<int>(std::lround(uSpan * static_cast<float>(fullWidth))));
-        const int insetTexHeight = (std::max)(1, static_cast<int>(std::lround(vSpan * static_cast<float>(fullHeight))));
-        ApplyHalfTexelInset(u0, v0, u1, v1, insetTexWidth, insetTexHeight);
+        const aes_native::QuadLayout quad = aes_native::ComputeQuadLayout(layoutInput);
+        const float left = quad.left;
+        const float right = quad.right;
+        const float top = quad.top;
+        const float bottom = quad.bottom;
+        const float u0 = quad.u0;
+        const float v0 = quad.v0;
+        const float u1 = quad.u1;
+        const float v1 = quad.v1;
 
         DcompVertex vertices[4] =
         {
@@ -2706,145 +2603,11 @@ struct CaptureSession
         dcompSmoothedFps.store(1000.0 / smoothedFrameTimeMs, std::memory_order_relaxed);
     }
 
-    static void DetectContentBarInsets(
-        const uint8_t* pixels,
-        int stride,
-        int width,
-        int height,
-        int& outLeft,
-        int& outRight,
-        int& outTop,
-        int& outBottom)
-    {
-        outLeft = 0;
-        outRight = 0;
-        outTop = 0;
-        outBottom = 0;
-        if (!pixels || width < 100 || height < 100)
-            return;
-
-        const int maxScanX = width / 4;
-        const int maxScanY = height / 4;
-        const int contentThreshold = 3;
-        const int rowCount = 15;
-        const int colCount = 15;
-        int rows[15] = {
-            height / 16, height / 8, 3 * height / 16, height / 4, 5 * height / 16,
-            3 * height / 8, 7 * height / 16, height / 2, 9 * height / 16, 5 * height / 8,
-            11 * height / 16, 3 * height / 4, 13 * height / 16, 7 * height / 8, 15 * height / 16
-        };
-        int cols[15] = {
-            width / 16, width / 8, 3 * width / 16, width / 4, 5 * width / 16,
-            3 * width / 8, 7 * width / 16, width / 2, 9 * width / 16, 5 * width / 8,
-            11 * width / 16, 3 * width / 4, 13 * width / 16, 7 * width / 8, 15 * width / 16
-        };
-
-        bool hasContent = false;
-        const int centerSamples[5] = { width / 2, width / 3, 2 * width / 3, width / 4, 3 * width / 4 };
-        for (int sample = 0; sample < 5 && !hasContent; ++sample)
-        {
-            const int x = centerSamples[sample];
-            for (int r = 0; r < rowCount; ++r)
-            {
-                const uint8_t* p = pixels + (rows[r] * stride) + (x * 4);
-                if (p[0] > 3 || p[1] > 3 || p[2] > 3)
-                {
-                    hasContent = true;
-                    break;
-                }
-            }
-        }
-        if (!hasContent)
-            return;
-
-        for (int x = 0; x < maxScanX; ++x)
-        {
-            bool hasContentInCol = false;
-            for (int r = 0; r < rowCount; ++r)
-            {
-                const uint8_t* p = pixels + (rows[r] * stride) + (x * 4);
-                if (p[0] > contentThreshold || p[1] > contentThreshold || p[2] > contentThreshold)
-                {
-                    hasContentInCol = true;
-                    break;
-                }
-            }
-            if (hasContentInCol)
-            {
-                outLeft = x;
-                break;
-            }
-        }
-
-        for (int x = width - 1; x > width - 1 - maxScanX; --x)
-        {
-            bool hasContentInCol = false;
-            for (int r = 0; r < rowCount; ++r)
-            {
-                const uint8_t* p = pixels + (rows[r] * stride) + (x * 4);
-                if (p[0] > contentThreshold || p[1] > contentThreshold || p[2] > contentThreshold)
-                {
-                    hasContentInCol = true;
-                    break;
-                }
-            }
-            if (hasContentInCol)
-            {
-                outRight = (std::max)(0, width - 1 - x);
-                break;
-            }
-        }
-
-        for (int y = 0; y < maxScanY; ++y)
-        {
-            bool hasContentInRow = false;
-            for (int c = 0; c < colCount; ++c)
-            {
-                const uint8_t* p = pixels + (y * stride) + (cols[c] * 4);
-                if (p[0] > contentThreshold || p[1] > contentThreshold || p[2] > contentThreshold)
-                {
-                    hasContentInRow = true;
-                    break;
-                }
-            }
-            if (hasContentInRow)
-            {
-                outTop = y;
-                break;
-            }
-        }
-
-        for (int y = height - 1; y > height - 1 - maxScanY; --y)
-        {
-            bool hasContentInRow = false;
-            for (int c = 0; c < colCount; ++c)
-            {
-                const uint8_t* p = pixels + (y * stride) + (cols[c] * 4);
-                if (p[0] > contentThreshold || p[1] > contentThreshold || p[2] > contentThreshold)
-                {
-                    hasContentInRow = true;
-                    break;
-                }
-            }
-            if (hasContentInRow)
-            {
-                outBottom = (std::max)(0, height - 1 - y);
-                break;
-            }
-        }
-
-        static constexpr int kMinBarPx = 4;
-        if (outLeft < kMinBarPx)
-            outLeft = 0;
-        if (outRight < kMinBarPx)
-            outRight = 0;
-        if (outTop < kMinBarPx)
-            outTop = 0;
-        if (outBottom < kMinBarPx)
-            outBottom = 0;
-    }
-
     static constexpr int kPillarboxDetectTargetWidth = 320;
+    // The bridge cropped at channel values of 3 and below before the shared
+    // detector; keep that rather than its default of 16, so dim letterboxed
+    // scenes on Windows are not cropped differently than before.
+    static constexpr int kPillarboxLumaThreshold = 3;
 
     bool EnsurePillarboxDetectDownscale(int fullWidth, int fullHeight)
     {
@@ -2969,6 +2732,10 @@ struct CaptureSession
             return;
 
         const int counter = dcompPillarboxDetectCounter.fetch_add(1, std::memory_order_relaxed);
+        // ResetContentBarCrop zeroes the counter from the caller's thread; the
+        // tracker belongs to this thread, so it restarts here instead.
+        if (counter == 0)
+            aes_native::ResetContentBarTracker(pillarboxTracker);
         if ((counter % 15) != 0)
             return;
 
@@ -2987,58 +2754,26 @@ struct CaptureSession
         if (FAILED(d3dContext->Map(pillarboxStagingTexture.get(), 0, D3D11_MAP_READ, 0, &mapped)))
             return;
 
-        int detectedLeft = 0;
-        int detectedRight = 0;
-        int detectedTop = 0;
-        int detectedBottom = 0;
-        DetectContentBarInsets(
+        aes_native::ContentBarDetectorOptions detectOptions;
+        detectOptions.luma_threshold = kPillarboxLumaThreshold;
+        const aes_native::ContentBarScan scan = aes_native::DetectContentBars(
             static_cast<const uint8_t*>(mapped.pData),
-            static_cast<int>(mapped.RowPitch),
+            static_cast<ptrdiff_t>(mapped.RowPitch),
             pillarboxDetectWidth,
             pillarboxDetectHeight,
-            detectedLeft,
-            detectedRight,
-            detectedTop,
-            detectedBottom);
+            detectOptions);
         d3dContext->Unmap(pillarboxStagingTexture.get(), 0);
 
+        if (!aes_native::UpdateContentBarTracker(pillarboxTracker, scan))
+            return;
+
         const int cropW = dcompSourceCropW > 0 ? dcompSourceCropW : width;
         const int cropH = dcompSourceCropH > 0 ? dcompSourceCropH : height;
-        if (pillarboxDetectWidth > 0)
-            detectedLeft = (detectedLeft * cropW) / pillarboxDetectWidth;
-        if (pillarboxDetectWidth > 0)
-            detectedRight = (detectedRight * cropW) / pillarboxDetectWidth;
-        if (pillarboxDetectHeight > 0)
-            detectedTop = (detectedTop * cropH) / pillarboxDetectHeight;
-        if (pillarboxDetectHeight > 0)
-            detectedBottom = (detectedBottom * cropH) / pillarboxDetectHeight;
-
-        const int currentLeft = dcompPillarboxLeft.load(std::memory_order_relaxed);
-        const int currentRight = dcompPillarboxRight.load(std::memory_order_relaxed);
-        const int currentTop = dcompPillarboxTop.load(std::memory_order_relaxed);
-        const int currentBottom = dcompPillarboxBottom.load(std::memory_order_relaxed);
-
-        if (detectedLeft < currentLeft)
-            dcompPillarboxLeft.store(detectedLeft, std::memory_order_relaxed);
-        if (detectedRight < currentRight)
-            dcompPillarboxRight.store(detectedRight, std::memory_order_relaxed);
-        if (detectedTop < currentTop)
-            dcompPillarboxTop.store(detectedTop, std::memory_order_relaxed);
-        if (detectedBottom < currentBottom)
-            dcompPillarboxBottom.store(detectedBottom, std::memory_order_relaxed);
-
-        if (detectedLeft > currentLeft || detectedRight > currentRight ||
-            detectedTop > currentTop || detectedBottom > currentBottom)
-        {
-            const int pending = dcompPillarboxDetectCounter.load(std::memory_order_relaxed);
-            if ((pending % 30) == 0)
-            {
-                dcompPillarboxLeft.store(detectedLeft, std::memory_order_relaxed);
-                dcompPillarboxRight.store(detectedRight, std::memory_order_relaxed);
-                dcompPillarboxTop.store(detectedTop, std::memory_order_relaxed);
-                dcompPillarboxBottom.store(detectedBottom, std::memory_order_relaxed);
-            }
-        }
+        const aes_native::ContentBarInsets& applied = pillarboxTracker.applied;
+        dcompPillarboxLeft.store((applied.left * cropW) / pillarboxDetectWidth, std::memory_order_relaxed);
+        dcompPillarboxRight.store((applied.right * cropW) / pillarboxDetectWidth, std::memory_order_relaxed);
+        dcompPillarboxTop.store((applied.top * cropH) / pillarboxDetectHeight, std::memory_order_relaxed);
+        dcompPillarboxBottom.store((applied.bottom * cropH) / pillarboxDetectHeight, std::memory_order_relaxed);
     }
 
     void PresentToDirectComposition(ID3D11Texture2D* texture, int width, int height)
@@ -3559,9 +3294,7 @@ extern "C" {
 
             if (FAILED(hr))
             {
-                char buf[256];
-                _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] D3D11CreateDevice failed: 0x%08X (Note: Host may need to run as Admin if target is Admin)\n", (unsigned)hr);
-                DebugLog(buf);
+                DebugLogF("[WGC_NATIVE] D3D11CreateDevice failed: 0x%08X (Note: Host may need to run as Admin if target is Admin)\n", (unsigned)hr);
                 delete s;
                 return nullptr;
             }
@@ -3688,9 +3421,7 @@ extern "C" {
 
                 if (FAILED(createHr) || !s->item)
                 {
-                    char buf[256];
-                    _snprintf_s(buf, sizeof(buf), _TRUNCATE, "[WGC_NATIVE] CreateForWindow failed: 0x%08X for HWND=%p (normalized=%p). Ensure the RPCS3 renderer window is ready.\n", (unsigned)createHr, targetHwnd, captureTargetHwnd);
-                    DebugLog(buf);
+                    DebugLogF("[WGC_NATIVE] CreateForWindow failed: 0x%08X for HWND=%p (normalized=%p). Ensure the RPCS3 renderer window is ready.\n", (unsigned)createHr, targetHwnd, captureTargetHwnd);
                     delete s;
                     return nullptr;
                 }